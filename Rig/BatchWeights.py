@@ -0,0 +1,116 @@
+import bpy
+import time
+from . import wynn_core
+from . import binary_weight
+
+class WYNN_OT_batch_weights(bpy.types.Operator):
+    """Run one weight operation on every selected mesh at once (one thread pool, balanced by vertex count)"""
+    bl_idname = "wynn.batch_weights"
+    bl_label = "Batch Weights (Selected Meshes)"
+    bl_options = {'REGISTER', 'UNDO'}
+
+    operation: bpy.props.EnumProperty(
+        name="Operation",
+        items=[
+            ('NORMALIZE', "Normalize", "Normalize deform groups (locked groups kept)"),
+            ('LIMIT', "Limit Total", "Remove the lightest influences beyond the limit"),
+            ('CLEAN', "Clean", "Remove weights at or below the threshold"),
+            ('SMOOTH', "Smooth Group", "Smooth the active mesh's active group on every mesh that has it"),
+            ('BINARY', "Binary Weights", "Parent to the selected armature, every vertex to its nearest bone"),
+        ],
+        default='NORMALIZE'
+    )
+
+    limit: bpy.props.IntProperty(name="Limit", default=4, min=1, max=8)
+
+    threshold: bpy.props.FloatProperty(name="Threshold", default=0.01, min=0.0, max=1.0)
+
+    factor: bpy.props.FloatProperty(name="Factor", default=0.5, min=0.0, max=1.0)
+
+    iterations: bpy.props.IntProperty(name="Iterations", default=1, min=1)
+
+    use_geodesic: bpy.props.BoolProperty(
+        name="Geodesic Flood",
+        description="Grow bone regions over the mesh surface so gaps (e.g. arm vs torso) don't leak",
+        default=True
+    )
+
+    @classmethod
+    def poll(cls, context):
+        return (context.mode == 'OBJECT' and
+                any(o.type == 'MESH' for o in context.selected_objects) and
+                wynn_core.dll_ready(cls, wynn_core.has_batch_api))
+
+    def draw(self, context):
+        layout = self.layout
+        layout.prop(self, "operation")
+        if self.operation == 'LIMIT':
+            layout.prop(self, "limit")
+        elif self.operation == 'CLEAN':
+            layout.prop(self, "threshold")
+        elif self.operation == 'SMOOTH':
+            layout.prop(self, "factor")
+            layout.prop(self, "iterations")
+        elif self.operation == 'BINARY':
+            layout.prop(self, "use_geodesic")
+
+    def execute(self, context):
+        dll = wynn_core.load_dll()
+        if not wynn_core.has_batch_api(dll):
+            self.report({'ERROR'}, "DLL Outdated: multi-mesh batches unavailable")
+            return {'CANCELLED'}
+        meshes = [o for o in context.selected_objects if o.type == 'MESH' and len(o.data.vertices) > 0]
+        if not meshes:
+            return {'CANCELLED'}
+
+        t0 = time.perf_counter()
+        if self.operation == 'SMOOTH':
+            active = context.active_object
+            if active is None or active.type != 'MESH' or active.vertex_groups.active is None:
+                self.report({'ERROR'}, "Smooth needs an active mesh with an active vertex group.")
+                return {'CANCELLED'}
+            changed = wynn_core.batch_smooth_group(dll, meshes, active.vertex_groups.active.name,
+                                                   self.factor, self.iterations)
+        elif self.operation == 'BINARY':
+            changed = self.batch_binary(context, dll, meshes)
+            if changed is None:
+                return {'CANCELLED'}
+        else:
+            ops = {
+                'NORMALIZE': [wynn_core.normalize_op(wynn_core.SUBSET_DEFORM)],
+                'LIMIT': [wynn_core.limit_op(self.limit)],
+                'CLEAN': [wynn_core.clean_op(self.threshold)],
+            }[self.operation]
+            changed = wynn_core.batch_weight_pipeline(dll, meshes, ops)
+
+        for obj in meshes:
+            obj.data.update()
+        t_total = (time.perf_counter() - t0) * 1000.0
+        skipped = sum(1 for c in changed if c < 0)
+        busy = f", {skipped} busy (background job)" if skipped else ""
+        self.report({'INFO'}, f"{self.operation.title()}: {len(meshes)} mesh(es), "
+                              f"{sum(c for c in changed if c > 0)} verts changed{busy} ({t_total:.0f}ms)")
+        return {'FINISHED'}
+
+    def batch_binary(self, context, dll, meshes):
+        armature = next((o for o in context.selected_objects if o.type == 'ARMATURE'), None)
+        if armature is None:
+            self.report({'ERROR'}, "Binary Weights needs an Armature in the selection.")
+            return None
+        # Meshes busy with a background job are skipped before anything is parented or added
+        busy = [wynn_core.job_running(obj.data) for obj in meshes]
+        ready = [obj for obj, b in zip(meshes, busy) if not b]
+        bindings = []
+        for obj in ready:
+            prepared = binary_weight.prepare_bone_groups(obj, armature)
+            if prepared is None:
+                self.report({'ERROR'}, "No deform bones to bind to.")
+                return None
+            bindings.append(prepared)
+        changed = iter(wynn_core.batch_binary_weights(dll, ready, bindings, self.use_geodesic) if ready else [])
+
+        # parent_to_armature leaves the last mesh active: restore the armature + selection
+        for obj in meshes + [armature]:
+            obj.select_set(True)
+        context.view_layer.objects.active = armature
+        return [-1 if b else next(changed) for b in busy]
@@ -3,6 +3,8 @@ import bmesh
 import ctypes
 import os
 import time
+from . import wynn_core
+from .WeightJobs import refuse_if_busy
 
 # --- UTILS ---
 def get_dll_path():
@@ -25,7 +27,7 @@ class WynnEditWeightBase(bpy.types.Operator):
         except Exception as e:
             print(f"WynnEditWeight Pref Error: {e}")
 
-    def get_falloff_targets(self, bm, selected_verts, steps):
+    def get_falloff_targets(self, bm, selected_verts, steps, obj=None):
         """
         Returns dict {bm_vert: factor}
         Selected verts = 1.0
@@ -33,6 +35,11 @@ class WynnEditWeightBase(bpy.types.Operator):
         """
         weights = {v: 1.0 for v in selected_verts}
         if steps <= 0: return weights
+
+        if obj is not None:
+            native = self.get_native_falloff(obj, bm, selected_verts, steps)
+            if native is not None:
+                return native
         
         visited = set(selected_verts)
         current_ring = set(selected_verts)
@@ -59,6 +66,127 @@ class WynnEditWeightBase(bpy.types.Operator):
             
         return weights
 
+    _full_csr = None # (mesh pointer, csr) of the running execute
+
+    def get_full_csr(self, obj, dll):
+        """
+        Full-mesh CSR (adj_starts, adj_indices, adj_weights) of the edit
+        mesh, shared per mesh through wynn_core.get_mesh_csr (rebuilt on
+        topology change, weights refreshed when only coords moved).
+        Fetched once per execute (falloff + subgraph share it; execute
+        resets _full_csr). Returns None if the DLL is too old.
+        """
+        key = obj.data.as_pointer()
+        if self._full_csr is None or self._full_csr[0] != key:
+            obj.update_from_editmode() # Flush the BMesh so foreach_get sees it
+            self._full_csr = (key, wynn_core.get_mesh_csr(dll, obj.data))
+        return self._full_csr[1]
+
+    def get_native_subgraph(self, obj, bm, dll, target_verts):
+        """
+        Working set (targets + one-ring) and its local CSR, cut from the
+        cached full-mesh CSR by extract_subgraph.
+        Returns (working_list, targets_local, c_adj_starts, c_adj_indices, c_adj_weights)
+        or None when the DLL path is unavailable.
+        """
+        if not hasattr(dll, 'extract_subgraph'):
+            return None
+        csr = self.get_full_csr(obj, dll)
+        if csr is None or len(csr[0]) != len(bm.verts) + 1:
+            return None
+        c_full_starts, c_full_indices, c_full_weights = csr
+        num_verts = len(bm.verts)
+        num_entries = c_full_starts[num_verts]
+        num_targets = len(target_verts)
+
+        bm.verts.ensure_lookup_table()
+        c_targets = (ctypes.c_int * num_targets)(*[v.index for v in target_verts])
+        if hasattr(dll, 'subgraph_size'):
+            # Exact outputs: a small selection on a dense mesh allocates its working set only
+            dll.subgraph_size.argtypes = [
+                ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+                ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_int)
+            ]
+            dll.subgraph_size.restype = ctypes.c_int
+            c_num_entries = ctypes.c_int(0)
+            num_local = dll.subgraph_size(c_full_starts, c_full_indices, num_verts, c_targets, num_targets,
+                                          ctypes.byref(c_num_entries))
+            num_entries = c_num_entries.value
+        else:
+            num_local = num_verts
+        c_local_to_global = (ctypes.c_int * num_local)()
+        c_local_targets = (ctypes.c_int * num_targets)()
+        c_adj_starts = (ctypes.c_int * (num_local + 1))()
+        c_adj_indices = (ctypes.c_int * max(num_entries, 1))()
+        c_adj_weights = (ctypes.c_float * max(num_entries, 1))()
+
+        dll.extract_subgraph.argtypes = [
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        dll.extract_subgraph.restype = ctypes.c_int
+        num_working = dll.extract_subgraph(
+            c_full_starts, c_full_indices, c_full_weights, num_verts,
+            c_targets, num_targets,
+            c_local_to_global, c_local_targets,
+            c_adj_starts, c_adj_indices, c_adj_weights
+        )
+
+        verts = bm.verts
+        working_list = [verts[i] for i in c_local_to_global[:num_working]]
+        return working_list, c_local_targets[:], c_adj_starts, c_adj_indices, c_adj_weights
+
+    def get_native_falloff(self, obj, bm, selected_verts, steps):
+        """
+        Ring falloff via geodesic_falloff (hop metric) over the full-mesh CSR.
+        Same factors as the Python BFS: ring i gets (steps - i + 1) / (steps + 1).
+        Returns None when the DLL path is unavailable.
+        """
+        dll = self.load_dll()
+        if not dll or not hasattr(dll, 'geodesic_falloff'):
+            return None
+        csr = self.get_full_csr(obj, dll)
+        if csr is None or len(csr[0]) != len(bm.verts) + 1:
+            return None
+        c_adj_starts, c_adj_indices, c_adj_weights = csr
+        num_verts = len(bm.verts)
+
+        dll.geodesic_create.argtypes = [ctypes.c_int]
+        dll.geodesic_create.restype = ctypes.c_void_p
+        dll.geodesic_destroy.argtypes = [ctypes.c_void_p]
+        dll.geodesic_falloff.argtypes = [
+            ctypes.c_void_p,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int,
+            ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_float,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int
+        ]
+        dll.geodesic_falloff.restype = ctypes.c_int
+
+        bm.verts.ensure_lookup_table()
+        c_seeds = (ctypes.c_int * len(selected_verts))(*[v.index for v in selected_verts])
+        c_out_indices = (ctypes.c_int * num_verts)()
+        c_out_factors = (ctypes.c_float * num_verts)()
+
+        scratch = dll.geodesic_create(num_verts)
+        try:
+            # Hop metric, Linear falloff over steps + 1 rings
+            count = dll.geodesic_falloff(
+                scratch, c_adj_starts, c_adj_indices, c_adj_weights, num_verts,
+                c_seeds, None, len(selected_verts),
+                float(steps + 1), 1, 1, 1.0,
+                c_out_indices, c_out_factors, num_verts
+            )
+        finally:
+            dll.geodesic_destroy(scratch)
+
+        verts = bm.verts
+        indices = c_out_indices[:count]
+        factors = c_out_factors[:count]
+        return {verts[i]: f for i, f in zip(indices, factors)}
+
     def get_active_group_index(self, obj, bm=None, selected_verts=None):
         # 1. Check for Active Bone (Priority 1)
         # If user explicitly selected a bone in Pose Mode, they imply intent.
@@ -98,70 +226,16 @@ class WynnEditWeightBase(bpy.types.Operator):
         # 4. Fallback to Obj Active
         return obj.vertex_groups.active_index
 
-    def get_c_arrays(self, bm, selected_verts, active_group_index):
-        """
-        Extract BMesh data into C-compatible arrays.
-        Returns: (c_weight_indices, c_weight_values, target_indices, base_offset_map)
-        
-        Note: C++ expects a FLATTENED array of ALL vertices (index*8). 
-        To avoid allocating 8 floats * 100k verts for just 5 selected verts,
-        we might need a mapping?
-        
-        WAIT: The C++ `smooth_strided` and `apply_vertex_logic_strided` 
-        take `weight_indices` ptr and `v_idx * stride`.
-        They assume a full buffer exists.
-        
-        Workaround for Sparse Edit Mode:
-        We will allocate a buffer JUST large enough for the MAXIMUM index in selected_verts?
-        No, that's wasteful if we select vert #100000.
-        
-        Strategy:
-        We will pass a "virtual" buffer to C++.
-        But C++ uses `v_idx * stride` to index into it.
-        We cannot easily change C++ logic without recompiling.
-        
-        Alternative:
-        We re-map vertex indices to local 0..N range for the C++ call.
-        Py: {RealID: LocalID}
-        C: receives LocalIDs.
-        
-        Issue: Adjacency (Smooth) relies on real topology indices.
-        If we remap, Adjacency indices must also be remapped.
-        
-        Conclusion:
-        For `apply_vertex_logic_strided` (Assign/Harden), it does NOT use adjacency.
-        So we can Remap indices easily.
-            - real_indices = [105, 209, ...]
-            - c_indices = [0, 1, ...]
-            - c_weights = [weight data for 0..N]
-            - Pass c_indices 0..N to C++.
-            - Write back to real_indices.
-            
-        For `smooth_strided` (Smooth):
-        It USES adjacency. Adjacency is built on Mesh indices.
-        If we rebuild adjacency for just selected + neighbors, we can use Local IDs.
-        
-        Step 1: Identify "Working Set" (Selected + Neighbors).
-        Step 2: Map RealID -> LocalID.
-        Step 3: Build Adjacency for LocalIDs.
-        Step 4: Build Weights for LocalIDs.
-        Step 5: Run C++.
-        Step 6: Write back.
-        """
-        pass
-
     def load_dll(self):
         dll_path = get_dll_path()
         if not os.path.exists(dll_path):
             self.report({'ERROR'}, "DLL not found")
             return None
         
-        try:
-            dll = ctypes.CDLL(dll_path)
-            return dll
-        except Exception as e:
-            self.report({'ERROR'}, f"Failed to load DLL: {e}")
-            return None
+        dll = wynn_core.load_dll() # Shared with the brush / Smooth (one CDLL per Blender session)
+        if dll is None:
+            self.report({'ERROR'}, "Failed to load DLL (see System Console)")
+        return dll
 
 
 
@@ -185,6 +259,9 @@ class WYNN_OT_harden_weights(WynnEditWeightBase):
         obj = context.active_object
         if obj.mode != 'EDIT' or obj.type != 'MESH':
             return {'CANCELLED'}
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
+        self._full_csr = None
 
         bm = bmesh.from_edit_mesh(obj.data)
         
@@ -197,7 +274,7 @@ class WYNN_OT_harden_weights(WynnEditWeightBase):
         dvert_layout = bm.verts.layers.deform.verify()
 
         if self.use_falloff:
-            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps)
+            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps, obj)
             target_verts = list(falloff_map.keys())
         else:
             target_verts = selected_verts
@@ -262,15 +339,15 @@ class WYNN_OT_harden_weights(WynnEditWeightBase):
             num_targets, active_index, 1, 0.0
         )
         
-        # Write Back
+        # Write Back (views: one slice per vertex, no per-slot ctypes access)
+        view_indices = wynn_core.buffer_view(c_weight_indices)
+        view_values = wynn_core.buffer_view(c_weight_values)
         for i, v in enumerate(target_verts):
             dvert = v[dvert_layout]
             base = i * 8
             
             new_map = {}
-            for k in range(8):
-                g = c_weight_indices[base + k]
-                w = c_weight_values[base + k]
+            for g, w in zip(view_indices[base:base + 8].tolist(), view_values[base:base + 8].tolist()):
                 if g >= 0 and w > 0.0001:
                     new_map[g] = w
             
@@ -294,7 +371,8 @@ class WYNN_OT_smooth_weights(WynnEditWeightBase):
     bl_label = "Smooth Weights (Edit)"
     
     factor: bpy.props.FloatProperty(name="Factor", default=0.5, min=0.0, max=1.0)
-    iterations: bpy.props.IntProperty(name="Iterations", default=1, min=1, max=10)
+    iterations: bpy.props.IntProperty(name="Iterations", default=1, min=1, max=50)
+    tolerance: bpy.props.FloatProperty(name="Tolerance", description="Stop early once no weight changes more than this per pass (0 = always run all iterations)", default=0.0001, min=0.0, max=0.1, precision=5)
     
     use_falloff: bpy.props.BoolProperty(name="Use Falloff", default=False)
     falloff_factor: bpy.props.FloatProperty(name="Falloff Factor", default=1.0, min=0.0, max=2.0)
@@ -304,6 +382,9 @@ class WYNN_OT_smooth_weights(WynnEditWeightBase):
     def execute(self, context):
         self.check_falloff_pref(context)
         obj = context.active_object
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
+        self._full_csr = None
         bm = bmesh.from_edit_mesh(obj.data)
         dvert_layout = bm.verts.layers.deform.verify()
         
@@ -311,55 +392,98 @@ class WYNN_OT_smooth_weights(WynnEditWeightBase):
         if not selected_verts: return {'FINISHED'}
         
         if self.use_falloff:
-            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps)
+            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps, obj)
             target_verts = list(falloff_map.keys())
         else:
             target_verts = selected_verts
             falloff_map = {v: 1.0 for v in selected_verts}
             
-        # 1. Build "Working Set": Selected + Neighbors
-        working_set = set(target_verts)
-        for v in target_verts:
-            for e in v.link_edges:
-                working_set.add(e.other_vert(v))
-        
-        working_list = list(working_set)
-        # Map Real -> Local
-        local_map = {v.index: i for i, v in enumerate(working_list)}
-        num_working = len(working_list)
-        
-        # 2. Build Mini-Adjacency (Python -> C++)
-        print(f"[Smooth] Processing {len(target_verts)} targets. Working Set: {num_working}. Falloff={self.use_falloff}")
-        
-        # ... (Adjacency Building - Copied from original) ...
-        adj_starts = [0] * (num_working + 1)
-        adj_indices = []
-        adj_weights = []
-        
-        neighbors = [[] for _ in range(num_working)]
-        
-        for v in working_list:
-            v_idx = local_map[v.index]
-            for e in v.link_edges:
-                other = e.other_vert(v)
-                if other.index in local_map:
-                    other_idx = local_map[other.index]
-                    dist = e.calc_length()
-                    w = 1.0 / (dist + 0.0001)
-                    neighbors[v_idx].append((other_idx, w))
-        
-        cursor = 0
-        for i in range(num_working):
-            adj_starts[i] = cursor
-            for n_idx, w in neighbors[i]:
-                adj_indices.append(n_idx)
-                adj_weights.append(w)
-                cursor += 1
-            adj_starts[i+1] = cursor 
+        dll = self.load_dll()
+        if not dll: return {'CANCELLED'}
+
+        # Working Set (Selected + Neighbors) + local CSR, cut from the cached full-mesh CSR
+        native = self.get_native_subgraph(obj, bm, dll, target_verts)
+        if native is not None:
+            working_list, targets_local, c_adj_starts, c_adj_indices, c_adj_weights = native
+            num_working = len(working_list)
+        else:
+            # 1. Build "Working Set": Selected + Neighbors (Python fallback)
+            working_set = set(target_verts)
+            for v in target_verts:
+                for e in v.link_edges:
+                    working_set.add(e.other_vert(v))
+        
+            working_list = list(working_set)
+            # Map Real -> Local
+            local_map = {v.index: i for i, v in enumerate(working_list)}
+            num_working = len(working_list)
+        
+            # 2. Build Mini-Adjacency (Python -> C++)
+            # ... (Adjacency Building - Copied from original) ...
+            adj_starts = [0] * (num_working + 1)
+            adj_indices = []
+            adj_weights = []
+        
+            neighbors = [[] for _ in range(num_working)]
+        
+            if hasattr(dll, 'compute_edge_weights'):
+                # Collect each local edge once, lengths are computed in C++ (SIMD batch)
+                edge_slots = {} # {BMEdge: slot}
+                edge_pairs = []
+                for v in working_list:
+                    v_idx = local_map[v.index]
+                    for e in v.link_edges:
+                        other = e.other_vert(v)
+                        other_idx = local_map.get(other.index)
+                        if other_idx is None: continue
+                        slot = edge_slots.get(e)
+                        if slot is None:
+                            slot = len(edge_slots)
+                            edge_slots[e] = slot
+                            edge_pairs.append(v_idx)
+                            edge_pairs.append(other_idx)
+                        neighbors[v_idx].append((other_idx, slot))
+            
+                num_local_edges = len(edge_slots)
+                c_edge_pairs = (ctypes.c_int * len(edge_pairs))(*edge_pairs)
+                c_coords = (ctypes.c_float * (num_working * 3))(*[c for v in working_list for c in v.co])
+                c_edge_weights = (ctypes.c_float * num_local_edges)()
+            
+                dll.compute_edge_weights.argtypes = [
+                    ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float)
+                ]
+                dll.compute_edge_weights(num_local_edges, c_edge_pairs, c_coords, c_edge_weights)
             
-        c_adj_starts = (ctypes.c_int * len(adj_starts))(*adj_starts)
-        c_adj_indices = (ctypes.c_int * len(adj_indices))(*adj_indices)
-        c_adj_weights = (ctypes.c_float * len(adj_weights))(*adj_weights)
+                edge_w = c_edge_weights[:] # Bulk copy
+                for n_list in neighbors:
+                    for k, (other_idx, slot) in enumerate(n_list):
+                        n_list[k] = (other_idx, edge_w[slot])
+            else:
+                for v in working_list:
+                    v_idx = local_map[v.index]
+                    for e in v.link_edges:
+                        other = e.other_vert(v)
+                        if other.index in local_map:
+                            other_idx = local_map[other.index]
+                            dist = e.calc_length()
+                            w = 1.0 / (dist + 0.0001)
+                            neighbors[v_idx].append((other_idx, w))
+        
+            cursor = 0
+            for i in range(num_working):
+                adj_starts[i] = cursor
+                for n_idx, w in neighbors[i]:
+                    adj_indices.append(n_idx)
+                    adj_weights.append(w)
+                    cursor += 1
+                adj_starts[i+1] = cursor 
+            
+            c_adj_starts = (ctypes.c_int * len(adj_starts))(*adj_starts)
+            c_adj_indices = (ctypes.c_int * len(adj_indices))(*adj_indices)
+            c_adj_weights = (ctypes.c_float * len(adj_weights))(*adj_weights)
+            targets_local = [local_map[v.index] for v in target_verts]
+
+        print(f"[Smooth] Processing {len(target_verts)} targets. Working Set: {num_working}. Falloff={self.use_falloff}")
         
         # 3. Weights Buffer
         stride = 8
@@ -384,27 +508,43 @@ class WYNN_OT_smooth_weights(WynnEditWeightBase):
                 col += 1
         
         # 4. Target Indices (Local IDs)
-        targets_local = [local_map[v.index] for v in target_verts]
         c_targets = (ctypes.c_int * len(targets_local))(*targets_local)
         
         # 5. Call C++
-        dll = self.load_dll()
-        if not dll: return {'CANCELLED'}
-        
-        dll.smooth_strided.argtypes = [
-            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
-            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
-            ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float
-        ]
-        
-        for _ in range(self.iterations):
-            dll.smooth_strided(
+        if hasattr(dll, 'smooth_strided_iterations'):
+            # All passes in C++ (Jacobi) with convergence early-out
+            dll.smooth_strided_iterations.argtypes = [
+                ctypes.c_void_p,
+                ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float,
+                ctypes.c_int, ctypes.c_float
+            ]
+            dll.smooth_strided_iterations.restype = ctypes.c_int
+            dll.smooth_strided_iterations(
+                None, # Single threaded (working set is small)
                 c_adj_starts, c_adj_indices, c_adj_weights,
                 c_weight_indices, c_weight_values,
-                c_targets, len(targets_local), self.factor # Factor applied in C++ is strict Lerp towards average
+                c_targets, len(targets_local), self.factor,
+                self.iterations, self.tolerance
             )
+        else:
+            dll.smooth_strided.argtypes = [
+                ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float
+            ]
+
+            for _ in range(self.iterations):
+                dll.smooth_strided(
+                    c_adj_starts, c_adj_indices, c_adj_weights,
+                    c_weight_indices, c_weight_values,
+                    c_targets, len(targets_local), self.factor # Factor applied in C++ is strict Lerp towards average
+                )
             
         # 6. Write Back with Falloff Blend
+        view_indices = wynn_core.buffer_view(c_weight_indices)
+        view_values = wynn_core.buffer_view(c_weight_values)
         for v_idx_local in targets_local:
             real_v = working_list[v_idx_local]
             dvert = real_v[dvert_layout]
@@ -412,9 +552,7 @@ class WYNN_OT_smooth_weights(WynnEditWeightBase):
             
             # Parse C++ Result (Smoothed)
             smoothed_map = {}
-            for k in range(stride):
-                g = c_weight_indices[base + k]
-                w = c_weight_values[base + k]
+            for g, w in zip(view_indices[base:base + stride].tolist(), view_values[base:base + stride].tolist()):
                 if g >= 0 and w > 0.0001:
                     smoothed_map[g] = w
             
@@ -466,6 +604,9 @@ class WYNN_OT_add_weight(WynnEditWeightBase):
         obj = context.active_object
         if obj.mode != 'EDIT' or obj.type != 'MESH':
             return {'CANCELLED'}
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
+        self._full_csr = None
 
         bm = bmesh.from_edit_mesh(obj.data)
         dvert_layout = bm.verts.layers.deform.verify()
@@ -517,7 +658,7 @@ class WYNN_OT_add_weight(WynnEditWeightBase):
 
         # 1. Get Targets with Falloff
         if self.use_falloff:
-            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps)
+            falloff_map = self.get_falloff_targets(bm, selected_verts, self.falloff_steps, obj)
             target_verts = list(falloff_map.keys())
         else:
             target_verts = selected_verts
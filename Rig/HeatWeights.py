@@ -0,0 +1,124 @@
+import bpy
+import time
+from . import wynn_core
+from . import binary_weight
+from .WeightJobs import WeightJobModal, BACKGROUND_WORK, refuse_if_busy
+
+class WYNN_OT_parent_heat_weights(WeightJobModal, bpy.types.Operator):
+    """Parent with smooth Auto Weights solved in the core DLL (works where Bone Heat fails)"""
+    bl_idname = "wynn.parent_heat_weights"
+    bl_label = "Parent Auto Weights (Native)"
+    bl_options = {'REGISTER', 'UNDO'}
+
+    max_influence: bpy.props.IntProperty(
+        name="Max Influence",
+        description="Bones kept per vertex (weights are normalized after the limit)",
+        default=4,
+        min=1,
+        max=8
+    )
+
+    use_geodesic: bpy.props.BoolProperty(
+        name="Geodesic Flood",
+        description="Seed each bone from the surface region it floods to, so gaps (e.g. arm vs torso) don't leak",
+        default=True
+    )
+
+    @classmethod
+    def poll(cls, context):
+        active = context.active_object
+        return (active is not None and
+                context.mode == 'OBJECT' and
+                any(o.type == 'ARMATURE' for o in context.selected_objects) and
+                any(o.type == 'MESH' for o in context.selected_objects) and
+                wynn_core.dll_ready(cls, wynn_core.has_heat_api))
+
+    def invoke(self, context, event):
+        # Dense meshes: one background solve per mesh, the viewport stays live
+        armature = next((o for o in context.selected_objects if o.type == 'ARMATURE'), None)
+        meshes = [o for o in context.selected_objects if o.type == 'MESH']
+        dll = wynn_core.load_dll()
+        heat_work = sum(len(o.data.vertices) for o in meshes) * 100 # A solve is hundreds of sweeps
+        if not wynn_core.has_heat_api(dll) or not wynn_core.has_job_api(dll) or heat_work < BACKGROUND_WORK:
+            return self.execute(context)
+
+        self._armature = armature
+        self._meshes = meshes
+        self._snapshots = {} # {mesh pointer: (group names before submit, active group index)}
+
+        def step(mesh_obj):
+            if wynn_core.job_running(mesh_obj.data):
+                return None
+            # Only the empty candidate groups are created here: parenting waits for
+            # the result, so a cancelled or dropped job leaves the mesh as it was
+            snapshot = ({vg.name for vg in mesh_obj.vertex_groups}, mesh_obj.vertex_groups.active_index)
+            prepared = binary_weight.prepare_bone_groups(mesh_obj, armature, parent=False)
+            if prepared is None:
+                return None
+            self._snapshots[mesh_obj.as_pointer()] = snapshot
+            segments, bone_groups = prepared
+            job = wynn_core.start_heat_job(dll, mesh_obj, segments, bone_groups, self.max_influence,
+                                           use_geodesic=self.use_geodesic)
+            if job is None:
+                self.job_dropped(context, mesh_obj)
+            return mesh_obj, job
+
+        return self.run_jobs(context, [lambda m=m: step(m) for m in meshes], "Heat Weights")
+
+    def job_finished(self, context, obj, result):
+        self._snapshots.pop(obj.as_pointer(), None)
+        if self.valid_object(self._armature) is not None:
+            binary_weight.parent_to_armature(obj, self._armature)
+        unconverged = wynn_core.heat_unconverged(self._job.iterations)
+        if unconverged:
+            self.report({'WARNING'}, f"Heat weights on {obj.name}: {unconverged} bone(s) did not converge, weights are approximate")
+
+    def job_dropped(self, context, obj):
+        # Remove the (still empty) groups the step created: nothing else was touched
+        snapshot = self._snapshots.pop(obj.as_pointer(), None)
+        if snapshot is None:
+            return
+        names, active_index = snapshot
+        for vg in [vg for vg in obj.vertex_groups if vg.name not in names]:
+            obj.vertex_groups.remove(vg)
+        if active_index < len(obj.vertex_groups):
+            obj.vertex_groups.active_index = active_index
+
+    def end_jobs(self, context, result):
+        self.restore_selection(context)
+        return super().end_jobs(context, result)
+
+    def restore_selection(self, context):
+        # parent_to_armature leaves the last mesh active: restore the armature + selection
+        for obj in self._meshes + [self._armature]:
+            if self.valid_object(obj) is not None:
+                obj.select_set(True)
+        if self.valid_object(self._armature) is not None:
+            context.view_layer.objects.active = self._armature
+
+    def execute(self, context):
+        armature = next((o for o in context.selected_objects if o.type == 'ARMATURE'), None)
+        meshes = [o for o in context.selected_objects if o.type == 'MESH']
+        if not wynn_core.has_heat_api(wynn_core.load_dll()):
+            self.report({'ERROR'}, "DLL Outdated: native heat weights unavailable")
+            return {'CANCELLED'}
+        if refuse_if_busy(self, meshes):
+            return {'CANCELLED'}
+        self._armature = armature
+        self._meshes = meshes
+
+        t0 = time.perf_counter()
+        for mesh_obj in meshes:
+            result = binary_weight.apply_heat_weights_native(
+                mesh_obj, armature, use_geodesic=self.use_geodesic, max_influence=self.max_influence,
+                report=self.report
+            )
+            if result != {'FINISHED'}:
+                self.report({'ERROR'}, f"Heat weights failed on {mesh_obj.name}. Check System Console.")
+                return {'CANCELLED'}
+
+        self.restore_selection(context)
+
+        t_total = (time.perf_counter() - t0) * 1000.0
+        self.report({'INFO'}, f"Heat weights on {len(meshes)} mesh(es) ({t_total:.0f}ms)")
+        return {'FINISHED'}
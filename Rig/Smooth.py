@@ -1,6 +1,10 @@
 import bpy
+import ctypes
+import time
+from . import wynn_core
+from .WeightJobs import WeightJobModal, BACKGROUND_WORK, refuse_if_busy
 
-class WYNN_OT_smooth_weights(bpy.types.Operator):
+class WYNN_OT_smooth_weights(WeightJobModal, bpy.types.Operator):
     """Smooth weights on the active vertex group, and if it's a symmetrical group (e.g., .L), smooth the other side as well."""
     bl_idname = "wynn.smooth_weights"
     bl_label = "Smooth Weights Symmetrically"
@@ -28,10 +32,32 @@ class WYNN_OT_smooth_weights(bpy.types.Operator):
                 context.object.mode == 'WEIGHT_PAINT' and
                 context.object.vertex_groups.active is not None)
 
+    def invoke(self, context, event):
+        # Big meshes x many iterations: smooth on a worker thread (viewport stays live)
+        obj = context.object
+        dll = wynn_core.load_dll()
+        if (wynn_core.has_job_api(dll) and not wynn_core.job_running(obj.data) and
+                len(obj.data.vertices) * self.iterations >= BACKGROUND_WORK):
+            symmetrical_group_name = self.get_symmetrical_group(obj.vertex_groups.active.name)
+            groups, c_targets, num_targets = self.smooth_targets(obj, obj.vertex_groups.active.name, symmetrical_group_name)
+            if not groups:
+                return {'FINISHED'}
+            step = lambda: (obj, wynn_core.start_smooth_job(dll, obj, groups, self.factor, self.iterations,
+                                                            c_targets, num_targets))
+            return self.run_jobs(context, [step], "Smooth Weights")
+        return self.execute(context)
+
     def execute(self, context):
         obj = context.object
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
         active_group = obj.vertex_groups.active
         active_group_name = active_group.name
+        symmetrical_group_name = self.get_symmetrical_group(active_group_name)
+
+        if self.smooth_native(obj, active_group_name, symmetrical_group_name):
+            self.report({'INFO'}, f"Smoothed '{active_group_name}'" + (f" and '{symmetrical_group_name}'" if symmetrical_group_name else ""))
+            return {'FINISHED'}
 
         # Initial smooth on the active group
         bpy.ops.object.vertex_group_smooth(factor=self.factor, repeat=self.iterations)
@@ -39,7 +65,6 @@ class WYNN_OT_smooth_weights(bpy.types.Operator):
 
 
         # Check for symmetrical group and smooth the counterpart
-        symmetrical_group_name = self.get_symmetrical_group(active_group_name)
         if symmetrical_group_name and symmetrical_group_name in obj.vertex_groups:
             # Store the original active group index
             original_active_group_index = obj.vertex_groups.active_index
@@ -58,6 +83,62 @@ class WYNN_OT_smooth_weights(bpy.types.Operator):
         self.report({'INFO'}, f"Smoothed '{active_group_name}'" + (f" and '{symmetrical_group_name}'" if symmetrical_group_name else ""))
         return {'FINISHED'}
 
+    def smooth_native(self, obj, active_group_name, symmetrical_group_name):
+        """
+        Smooths the active group (and its counterpart) in the core DLL on the
+        mesh's resident session (wynn_core cache: CSR + weights are reused
+        when the brush or another operator already prepared this mesh).
+        The kernel normalizes across deform groups only and keeps locked
+        groups, so no normalize_all pass follows (only touched vertices
+        change). Respects the vertex selection mask. Returns False to fall
+        back to Blender's operators (DLL missing or too old).
+        """
+        dll = wynn_core.load_dll()
+        if not wynn_core.has_session_api(dll) or not hasattr(dll, 'session_smooth_group'):
+            return False
+
+        groups, c_targets, num_targets = self.smooth_targets(obj, active_group_name, symmetrical_group_name)
+        if not groups:
+            return True
+
+        mesh = obj.data
+        core = wynn_core.acquire_core(mesh) or wynn_core.create_core(dll)
+        try:
+            has_flags = wynn_core.set_group_flags(dll, core.session, obj)
+            wynn_core.update_session(dll, core, obj)
+            for g_idx in groups:
+                dll.session_smooth_group(core.session, c_targets, num_targets, g_idx, self.factor, self.iterations)
+            wynn_core.apply_session_diff(dll, core, obj)
+        finally:
+            wynn_core.release_core(mesh, core)
+
+        if not has_flags:
+            # Old DLL normalizes across every group; BONE_DEFORM normalize keeps the old semantics
+            bpy.ops.object.vertex_group_normalize_all(group_select_mode='BONE_DEFORM')
+        return True
+
+    def smooth_targets(self, obj, active_group_name, symmetrical_group_name):
+        """
+        (group indices, c_targets, num_targets): the active group and its
+        counterpart, over the selection when the paint mask is on (None =
+        every vertex). No groups if the mask selects nothing.
+        """
+        vertex_groups = obj.vertex_groups
+        groups = [vertex_groups[active_group_name].index]
+        if symmetrical_group_name and symmetrical_group_name in vertex_groups:
+            groups.append(vertex_groups[symmetrical_group_name].index)
+
+        mesh = obj.data
+        if mesh.use_paint_mask_vertex or mesh.use_paint_mask:
+            num_verts = len(mesh.vertices)
+            select = [False] * num_verts
+            mesh.vertices.foreach_get("select", select)
+            selected = [i for i, sel in enumerate(select) if sel]
+            if not selected:
+                return [], None, 0
+            return groups, (ctypes.c_int * len(selected))(*selected), len(selected)
+        return groups, None, 0
+
     def get_symmetrical_group(self, name):
         """Gets the symmetrical counterpart of a vertex group name."""
         endings = {'.L': '.R', '_L': '_R', '.R': '.L', '_R': '_L', '.l': '.r', '.r': '.l'}
@@ -66,10 +147,105 @@ class WYNN_OT_smooth_weights(bpy.types.Operator):
                 return name[:-len(suffix)] + opposite
         return None
 
+class WYNN_OT_smooth_mesh_weights(WeightJobModal, bpy.types.Operator):
+    """Blur every vertex group over the whole mesh (on the GPU for dense meshes when one is available)"""
+    bl_idname = "wynn.smooth_mesh_weights"
+    bl_label = "Smooth All Groups (Whole Mesh)"
+    bl_options = {'REGISTER', 'UNDO'}
+
+    factor: bpy.props.FloatProperty(
+        name="Factor",
+        description="Blend toward the neighbour average per pass",
+        default=0.5,
+        min=0.0,
+        max=1.0
+    )
+
+    iterations: bpy.props.IntProperty(
+        name="Iterations",
+        description="Number of smoothing passes",
+        default=10,
+        min=1
+    )
+
+    tolerance: bpy.props.FloatProperty(
+        name="Tolerance",
+        description="Stop once a pass changes no weight by this much (0 = run every pass)",
+        default=0.0,
+        min=0.0,
+        max=0.1,
+        precision=5
+    )
+
+    backend: bpy.props.EnumProperty(
+        name="Device",
+        items=[
+            ('AUTO', "Auto", "GPU for dense meshes when an OpenCL GPU is available, else CPU"),
+            ('CPU', "CPU", "All cores"),
+            ('GPU', "GPU", "OpenCL GPU (falls back to the CPU if there is none)"),
+        ],
+        default='AUTO'
+    )
+
+    @classmethod
+    def poll(cls, context):
+        return (context.object is not None and
+                context.object.type == 'MESH' and
+                context.object.mode in {'OBJECT', 'WEIGHT_PAINT'} and
+                wynn_core.dll_ready(cls, wynn_core.has_mesh_smooth_api))
+
+    def draw(self, context):
+        layout = self.layout
+        layout.prop(self, "factor")
+        layout.prop(self, "iterations")
+        layout.prop(self, "tolerance")
+        layout.prop(self, "backend")
+        # Only the cached answer: the first probe builds the kernels, execute does that
+        if wynn_core.gpu_probed():
+            gpu = wynn_core.gpu_device_name(wynn_core.load_dll())
+            layout.label(text=f"GPU: {gpu}" if gpu else "GPU: none (CPU only)")
+
+    def native_backend(self):
+        return {'AUTO': wynn_core.SMOOTH_AUTO, 'CPU': wynn_core.SMOOTH_CPU, 'GPU': wynn_core.SMOOTH_GPU}[self.backend]
+
+    def invoke(self, context, event):
+        obj = context.object
+        dll = wynn_core.load_dll()
+        if self.backend != 'CPU':
+            wynn_core.gpu_device_name(dll) # Probe once here, draw() only shows the cached name
+        if (wynn_core.has_job_api(dll) and wynn_core.has_mesh_smooth_api(dll) and not wynn_core.job_running(obj.data) and
+                len(obj.data.vertices) * self.iterations >= BACKGROUND_WORK):
+            step = lambda: (obj, wynn_core.start_mesh_smooth_job(dll, obj, self.factor, self.iterations,
+                                                                 self.tolerance, self.native_backend()))
+            return self.run_jobs(context, [step], "Smooth All Groups")
+        return self.execute(context)
+
+    def execute(self, context):
+        obj = context.object
+        dll = wynn_core.load_dll()
+        if not wynn_core.has_mesh_smooth_api(dll):
+            self.report({'ERROR'}, "DLL Outdated: whole-mesh smoothing unavailable")
+            return {'CANCELLED'}
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
+        if self.backend != 'CPU':
+            wynn_core.gpu_device_name(dll)
+
+        t0 = time.perf_counter()
+        changed, used, passes = wynn_core.smooth_mesh(dll, obj, self.factor, self.iterations,
+                                                      self.tolerance, self.native_backend())
+        obj.data.update()
+        t_total = (time.perf_counter() - t0) * 1000.0
+        device = wynn_core.gpu_device_name(dll) if used == wynn_core.SMOOTH_GPU else "CPU"
+        self.report({'INFO'}, f"Smoothed all groups: {changed} verts changed, {passes} pass(es) on {device} ({t_total:.0f}ms)")
+        return {'FINISHED'}
+
 def register():
     bpy.utils.register_class(WYNN_OT_smooth_weights)
+    bpy.utils.register_class(WYNN_OT_smooth_mesh_weights)
 
 def unregister():
+    bpy.utils.unregister_class(WYNN_OT_smooth_mesh_weights)
     bpy.utils.unregister_class(WYNN_OT_smooth_weights)
 
 if __name__ == "__main__":
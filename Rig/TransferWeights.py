@@ -0,0 +1,81 @@
+import bpy
+import time
+from . import wynn_core
+from .WeightJobs import refuse_if_busy
+
+class WYNN_OT_transfer_weights(bpy.types.Operator):
+    """Transfer vertex group weights from the active mesh to the selected meshes (nearest surface point, interpolated)"""
+    bl_idname = "wynn.transfer_weights"
+    bl_label = "Transfer Weights"
+    bl_options = {'REGISTER', 'UNDO'}
+
+    max_influence: bpy.props.IntProperty(
+        name="Max Influence",
+        description="Groups kept per vertex (weights are normalized after the limit)",
+        default=4,
+        min=1,
+        max=8
+    )
+
+    max_distance: bpy.props.FloatProperty(
+        name="Max Distance",
+        description="Vertices farther than this from the source surface keep their weights (0 = no limit)",
+        default=0.0,
+        min=0.0,
+        subtype='DISTANCE'
+    )
+
+    create_groups: bpy.props.BoolProperty(
+        name="Create Groups",
+        description="Add the source's vertex groups missing on the targets",
+        default=True
+    )
+
+    only_selected: bpy.props.BoolProperty(
+        name="Only Selected Vertices",
+        description="Only transfer onto the selected vertices of each target",
+        default=False
+    )
+
+    @classmethod
+    def poll(cls, context):
+        source = context.active_object
+        return (source is not None and
+                source.type == 'MESH' and
+                context.mode == 'OBJECT' and
+                any(o is not source and o.type == 'MESH' for o in context.selected_objects))
+
+    def execute(self, context):
+        source = context.active_object
+        targets = [o for o in context.selected_objects if o is not source and o.type == 'MESH']
+        if refuse_if_busy(self, targets):
+            return {'CANCELLED'}
+
+        dll = wynn_core.load_dll()
+        if not wynn_core.has_transfer_api(dll):
+            # Blender's Data Transfer does the same projection (slower, single threaded)
+            bpy.ops.object.data_transfer(
+                data_type='VGROUP_WEIGHTS', vert_mapping='POLYINTERP_NEAREST',
+                layers_select_src='NAME', layers_select_dst='ALL'
+            )
+            self.report({'WARNING'}, "DLL Outdated: used Data Transfer instead")
+            return {'FINISHED'}
+
+        t0 = time.perf_counter()
+        surface = wynn_core.build_transfer_surface(dll, source)
+        changed = 0
+        try:
+            for target in targets:
+                group_map, num_map = wynn_core.transfer_group_map(source, target, self.create_groups)
+                mask = wynn_core.selection_mask(target.data, always=True) if self.only_selected else None
+                changed += wynn_core.transfer_weights(
+                    dll, surface, target, group_map, num_map,
+                    self.max_influence, self.max_distance, mask
+                )
+                target.data.update()
+        finally:
+            dll.surface_destroy(surface)
+
+        t_total = (time.perf_counter() - t0) * 1000.0
+        self.report({'INFO'}, f"Transferred weights to {len(targets)} mesh(es), {changed} verts changed ({t_total:.0f}ms)")
+        return {'FINISHED'}
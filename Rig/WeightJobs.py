@@ -0,0 +1,130 @@
+import bpy
+import time
+from . import wynn_core
+
+# Work (vertices x iterations) above which invoke() runs in the background
+BACKGROUND_WORK = 2_000_000
+
+# Events that still reach the viewport while a job runs: view navigation only
+NAVIGATION_EVENTS = {
+    'MIDDLEMOUSE', 'WHEELUPMOUSE', 'WHEELDOWNMOUSE', 'WHEELINMOUSE', 'WHEELOUTMOUSE',
+    'TRACKPADPAN', 'TRACKPADZOOM', 'MOUSEROTATE', 'MOUSESMARTZOOM',
+    'NUMPAD_0', 'NUMPAD_1', 'NUMPAD_2', 'NUMPAD_3', 'NUMPAD_4', 'NUMPAD_5', 'NUMPAD_6',
+    'NUMPAD_7', 'NUMPAD_8', 'NUMPAD_9', 'NUMPAD_PERIOD', 'NUMPAD_SLASH', 'NUMPAD_PLUS', 'NUMPAD_MINUS',
+}
+
+def is_navigation(event):
+    return event.type in NAVIGATION_EVENTS or event.type.startswith('NDOF_')
+
+def refuse_if_busy(operator, objects):
+    """
+    True (and reports it) if a background job owns one of the objects'
+    meshes: the caller cancels instead of touching weights the job's
+    result would be diffed against.
+    """
+    if any(obj is not None and obj.type == 'MESH' and wynn_core.job_running(obj.data) for obj in objects):
+        operator.report({'ERROR'}, "A background job is still running on this mesh.")
+        return True
+    return False
+
+class WeightJobModal:
+    """
+    Mixin for operators whose native work runs as wynn_core background jobs.
+    invoke() queues steps with run_jobs(context, steps, label): each step is
+    a callable returning (object, WeightJob), skipped when it returns None
+    or the job could not start (DLL too old, mesh busy). A window timer
+    polls the running job and the header shows its progress. Only view
+    navigation (NAVIGATION_EVENTS) passes through, every other event is
+    consumed so nothing edits the mesh under the job. Esc / right click
+    cancel: the running job rolls back, earlier steps stay applied. A job
+    whose mesh changed anyway is dropped with a warning (see
+    WeightJob.finish). Subclasses may override job_finished(context, obj,
+    result) and job_dropped(context, obj), which undoes what a step touched
+    before submitting a job that was cancelled or dropped.
+    """
+    _timer = None
+
+    def run_jobs(self, context, steps, label):
+        self._steps = list(steps)
+        self._label = label
+        self._job = None
+        self._job_obj = None
+        self._num_done = 0
+        self._changed = 0
+        self._t0 = time.perf_counter()
+        if not self.next_job(context):
+            return self.end_jobs(context, {'FINISHED'})
+        self._timer = context.window_manager.event_timer_add(0.05, window=context.window)
+        context.window_manager.modal_handler_add(self)
+        return {'RUNNING_MODAL'}
+
+    def next_job(self, context):
+        while self._steps:
+            started = self._steps.pop(0)()
+            if started is not None and started[1] is not None:
+                self._job_obj, self._job = started
+                return True
+        return False
+
+    def job_finished(self, context, obj, result):
+        pass
+
+    def job_dropped(self, context, obj):
+        pass
+
+    def end_jobs(self, context, result):
+        if self._timer is not None:
+            context.window_manager.event_timer_remove(self._timer)
+            self._timer = None
+        if context.area:
+            context.area.header_text_set(None)
+        if result == {'FINISHED'}:
+            t_total = (time.perf_counter() - self._t0) * 1000.0
+            self.report({'INFO'}, f"{self._label}: {self._num_done} job(s), {self._changed} verts changed ({t_total:.0f}ms)")
+        return result
+
+    def modal(self, context, event):
+        if event.type in {'ESC', 'RIGHTMOUSE'} and event.value == 'PRESS':
+            self._job.cancel()
+            obj = self.valid_object(self._job_obj)
+            self._job.finish(obj)
+            if obj is not None:
+                self.job_dropped(context, obj)
+            self.report({'WARNING'}, f"{self._label}: cancelled")
+            return self.end_jobs(context, {'CANCELLED'} if self._num_done == 0 else {'FINISHED'})
+
+        if event.type != 'TIMER' or event.timer is not self._timer:
+            if is_navigation(event) or event.type == 'TIMER': # Other handlers' timers too
+                return {'PASS_THROUGH'}
+            return {'RUNNING_MODAL'}
+
+        state, progress = self._job.poll()
+        if state == wynn_core.JOB_RUNNING:
+            if context.area:
+                queued = f" (+{len(self._steps)} queued)" if self._steps else ""
+                context.area.header_text_set(f"{self._label}: {progress * 100.0:.0f}%{queued} | Esc: Cancel")
+            return {'RUNNING_MODAL'}
+
+        obj = self.valid_object(self._job_obj)
+        result = self._job.finish(obj)
+        if result == wynn_core.JOB_STALE:
+            self.report({'WARNING'}, f"{self._label}: {obj.name} changed while the job ran, result dropped")
+        if obj is not None and result >= 0:
+            obj.data.update()
+            self._num_done += 1
+            self._changed += result
+            self.job_finished(context, obj, result)
+        elif obj is not None:
+            self.job_dropped(context, obj)
+        if self.next_job(context):
+            return {'RUNNING_MODAL'}
+        return self.end_jobs(context, {'FINISHED'})
+
+    @staticmethod
+    def valid_object(obj):
+        """obj unless it was deleted while the job ran (then its result is dropped)."""
+        try:
+            obj.name
+            return obj
+        except ReferenceError:
+            return None
@@ -0,0 +1,631 @@
+/**
+ * WynnWeightLogic Microbenchmark (standalone, build_bench.bat)
+ *
+ * Times the core kernels outside Blender on synthetic or imported meshes:
+ * - build_adjacency_graph / build_adjacency_graph_mt
+ * - smooth_strided (Seidel) / smooth_strided_jacobi
+ * - apply_vertex_logic_strided (Smear, Harden)
+ * - smooth_quantized_jacobi / apply_vertex_logic_quantized (16-bit storage),
+ *   each followed by a quantized_check line against the strided result
+ * - smear_strided_sampled (per-vertex smear, stroke delta = brush radius / 2)
+ * - weight_pipeline_strided (limit + clean + normalize, full mesh)
+ * - heat_weights_strided (bone chain along the longest axis, full mesh)
+ * - session_smooth_mesh (10 whole-mesh Jacobi passes; CPU, and the GPU if present)
+ * at several brush sizes and thread counts. One JSON object per line on
+ * stdout (progress on stderr), so runs can be diffed / plotted to catch
+ * regressions when kernels are rewritten.
+ *
+ * Usage: WynnWeightBench [--mesh grid:N | sphere:RINGSxSEGMENTS | obj:PATH]...
+ *                        [--threads 1,2,4,0] [--brush 0.02,0.05,0.1,0.25]
+ *                        [--reps 20] [--bones 24] [--dabs 8]
+ * Brush sizes are radii as a fraction of the mesh bounding box diagonal,
+ * thread count 0 = all hardware threads.
+ */
+#include "WynnWeightLogic.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+struct BenchMesh {
+    std::string name;
+    int num_verts = 0;
+    std::vector<float> coords; // [num_verts * 3]
+    std::vector<int> edges;    // [num_edges * 2]
+
+    int num_edges() const { return (int)(edges.size() / 2); }
+};
+
+struct BenchOptions {
+    std::vector<std::string> meshes;
+    std::vector<int> threads{1, 2, 4, 0};
+    std::vector<float> brushes{0.02f, 0.05f, 0.1f, 0.25f};
+    int reps = 20;
+    int bones = 24;
+    int dabs = 8;
+};
+
+// Deterministic across platforms (std::rand / distributions are not)
+struct Lcg {
+    uint64_t state;
+    explicit Lcg(uint64_t seed) : state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+    float next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (float)((state >> 40) & 0xFFFFFF) / 16777216.0f;
+    }
+};
+
+/**
+ * N x N vertex grid of quads in XY with a gentle Z wave (edge lengths vary,
+ * like a real surface).
+ */
+BenchMesh make_grid(int n) {
+    BenchMesh m;
+    m.name = "grid:" + std::to_string(n);
+    m.num_verts = n * n;
+    m.coords.resize((size_t)m.num_verts * 3);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            size_t v = (size_t)y * n + x;
+            float fx = (float)x / (n - 1), fy = (float)y / (n - 1);
+            m.coords[v * 3 + 0] = fx;
+            m.coords[v * 3 + 1] = fy;
+            m.coords[v * 3 + 2] = 0.05f * std::sin(fx * 12.0f) * std::cos(fy * 9.0f);
+        }
+    }
+    m.edges.reserve((size_t)n * (n - 1) * 4);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            int v = y * n + x;
+            if (x + 1 < n) { m.edges.push_back(v); m.edges.push_back(v + 1); }
+            if (y + 1 < n) { m.edges.push_back(v); m.edges.push_back(v + n); }
+        }
+    }
+    return m;
+}
+
+/**
+ * UV sphere (unit radius): two poles + (rings - 1) rings of `segments` verts.
+ * Pole fans give the high-valence vertices a grid lacks.
+ */
+BenchMesh make_sphere(int rings, int segments) {
+    BenchMesh m;
+    m.name = "sphere:" + std::to_string(rings) + "x" + std::to_string(segments);
+    int ring_verts = (rings - 1) * segments;
+    m.num_verts = ring_verts + 2;
+    m.coords.resize((size_t)m.num_verts * 3);
+    const float pi = 3.14159265358979f;
+    for (int r = 1; r < rings; ++r) {
+        float theta = pi * r / rings;
+        for (int s = 0; s < segments; ++s) {
+            float phi = 2.0f * pi * s / segments;
+            size_t v = (size_t)(r - 1) * segments + s;
+            m.coords[v * 3 + 0] = std::sin(theta) * std::cos(phi);
+            m.coords[v * 3 + 1] = std::sin(theta) * std::sin(phi);
+            m.coords[v * 3 + 2] = std::cos(theta);
+        }
+    }
+    int north = ring_verts, south = ring_verts + 1;
+    m.coords[(size_t)north * 3 + 2] = 1.0f;
+    m.coords[(size_t)south * 3 + 2] = -1.0f;
+
+    for (int r = 0; r < rings - 1; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            int v = r * segments + s;
+            m.edges.push_back(v); m.edges.push_back(r * segments + (s + 1) % segments);
+            if (r + 1 < rings - 1) { m.edges.push_back(v); m.edges.push_back(v + segments); }
+        }
+    }
+    for (int s = 0; s < segments; ++s) {
+        m.edges.push_back(north); m.edges.push_back(s);
+        m.edges.push_back(south); m.edges.push_back((rings - 2) * segments + s);
+    }
+    return m;
+}
+
+/**
+ * Wavefront OBJ: `v` lines + polygon edges of `f` lines (v, v/vt, v/vt/vn,
+ * negative indices). Shared edges are kept once. Empty mesh on failure.
+ */
+BenchMesh load_obj(const std::string& path) {
+    BenchMesh m;
+    m.name = "obj:" + path;
+    std::ifstream in(path);
+    if (!in) return m;
+
+    std::vector<uint64_t> keys;
+    std::string line;
+    std::vector<int> face;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string tag;
+        ls >> tag;
+        if (tag == "v") {
+            float x = 0, y = 0, z = 0;
+            ls >> x >> y >> z;
+            m.coords.push_back(x);
+            m.coords.push_back(y);
+            m.coords.push_back(z);
+        } else if (tag == "f") {
+            face.clear();
+            std::string tok;
+            int num_read = (int)(m.coords.size() / 3);
+            while (ls >> tok) {
+                int idx = std::atoi(tok.c_str());
+                idx = idx < 0 ? num_read + idx : idx - 1;
+                if (idx >= 0 && idx < num_read) face.push_back(idx);
+            }
+            for (size_t i = 0; i < face.size() && face.size() > 1; ++i) {
+                uint32_t a = face[i], b = face[(i + 1) % face.size()];
+                if (a == b) continue;
+                if (a > b) std::swap(a, b);
+                keys.push_back(((uint64_t)a << 32) | b);
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    m.num_verts = (int)(m.coords.size() / 3);
+    m.edges.reserve(keys.size() * 2);
+    for (uint64_t k : keys) {
+        m.edges.push_back((int)(k >> 32));
+        m.edges.push_back((int)(k & 0xFFFFFFFFu));
+    }
+    return m;
+}
+
+BenchMesh make_mesh(const std::string& spec) {
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::string arg = colon == std::string::npos ? "" : spec.substr(colon + 1);
+    if (kind == "grid") return make_grid(std::max(2, arg.empty() ? 256 : std::atoi(arg.c_str())));
+    if (kind == "sphere") {
+        int rings = 128, segments = 256;
+        if (!arg.empty()) std::sscanf(arg.c_str(), "%dx%d", &rings, &segments);
+        return make_sphere(std::max(3, rings), std::max(3, segments));
+    }
+    if (kind == "obj") return load_obj(arg);
+    return BenchMesh{};
+}
+
+void bounds(const BenchMesh& m, float* lo, float* hi) {
+    for (int a = 0; a < 3; ++a) { lo[a] = 1e30f; hi[a] = -1e30f; }
+    for (int v = 0; v < m.num_verts; ++v) {
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], m.coords[(size_t)v * 3 + a]);
+            hi[a] = std::max(hi[a], m.coords[(size_t)v * 3 + a]);
+        }
+    }
+}
+
+/**
+ * Rig-like influences: a chain of `num_bones` points along the longest
+ * bounding box axis, each vertex weighted by inverse squared distance to
+ * its 4 nearest bones, small weights dropped, normalized. Gives 1-4
+ * influences per vertex with soft transitions between neighbouring bones.
+ */
+void make_weights(const BenchMesh& m, int num_bones, std::vector<int>& wi, std::vector<float>& wv) {
+    float lo[3], hi[3];
+    bounds(m, lo, hi);
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) if (hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+
+    std::vector<float> bone_pos((size_t)num_bones * 3);
+    Lcg rng(num_bones);
+    for (int b = 0; b < num_bones; ++b) {
+        for (int a = 0; a < 3; ++a) {
+            float center = 0.5f * (lo[a] + hi[a]);
+            float extent = hi[a] - lo[a];
+            bone_pos[(size_t)b * 3 + a] = (a == axis)
+                ? lo[a] + extent * (b + 0.5f) / num_bones
+                : center + extent * 0.2f * (rng.next() - 0.5f);
+        }
+    }
+
+    wi.assign((size_t)m.num_verts * MAX_STORAGE, -1);
+    wv.assign((size_t)m.num_verts * MAX_STORAGE, 0.0f);
+    for (int v = 0; v < m.num_verts; ++v) {
+        VertexWeight all[64];
+        int n = std::min(num_bones, 64);
+        for (int b = 0; b < n; ++b) {
+            float d2 = 0.0f;
+            for (int a = 0; a < 3; ++a) {
+                float d = m.coords[(size_t)v * 3 + a] - bone_pos[(size_t)b * 3 + a];
+                d2 += d * d;
+            }
+            all[b] = {b, 1.0f / (d2 + 1e-4f)};
+        }
+        VertexWeight kept[4];
+        int num_kept = top_k_weights<4>(all, n, kept);
+        float total = 0.0f;
+        for (int k = 0; k < num_kept; ++k) total += kept[k].weight;
+        int count = 0;
+        for (int k = 0; k < num_kept; ++k) {
+            if (kept[k].weight / total < 0.02f) continue;
+            wi[(size_t)v * MAX_STORAGE + count] = kept[k].group_index;
+            wv[(size_t)v * MAX_STORAGE + count] = kept[k].weight;
+            count++;
+        }
+        float kept_total = 0.0f;
+        for (int k = 0; k < count; ++k) kept_total += wv[(size_t)v * MAX_STORAGE + k];
+        for (int k = 0; k < count; ++k) wv[(size_t)v * MAX_STORAGE + k] /= kept_total;
+    }
+}
+
+struct Timing {
+    double min_ms, median_ms, mean_ms;
+};
+
+/**
+ * Runs fn `reps` times after one warmup call; setup() runs before every
+ * call outside the timed region (e.g. restoring the weights).
+ */
+template <typename Setup, typename Fn>
+Timing time_reps(int reps, Setup&& setup, Fn&& fn) {
+    setup();
+    fn();
+    std::vector<double> samples;
+    samples.reserve(reps);
+    for (int r = 0; r < reps; ++r) {
+        setup();
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double s : samples) sum += s;
+    size_t mid = samples.size() / 2;
+    double median = samples.size() % 2 ? samples[mid] : 0.5 * (samples[mid - 1] + samples[mid]);
+    return Timing{samples.front(), median, sum / samples.size()};
+}
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+void emit(const char* bench, const BenchMesh& m, int threads, float brush, long long targets,
+          int reps, const Timing& t) {
+    std::printf("{\"bench\":\"%s\",\"mesh\":%s,\"verts\":%d,\"edges\":%d,\"threads\":%d,"
+                "\"brush\":%.4f,\"targets\":%lld,\"reps\":%d,"
+                "\"min_ms\":%.4f,\"median_ms\":%.4f,\"mean_ms\":%.4f,\"ns_per_target\":%.2f}\n",
+                bench, json_string(m.name).c_str(), m.num_verts, m.num_edges(), threads,
+                brush, targets, reps, t.min_ms, t.median_ms, t.mean_ms,
+                targets > 0 ? t.median_ms * 1e6 / targets : 0.0);
+    std::fflush(stdout);
+}
+
+// The quantized buffers after the same dabs as the strided ones: worst weight
+// difference over slots holding the same group, and slots whose group differs
+void emit_quantized_check(const char* kernel, const BenchMesh& m, float brush,
+                          const std::vector<int>& wi, const std::vector<float>& wv,
+                          const std::vector<uint16_t>& qi, const std::vector<uint16_t>& qv) {
+    std::vector<int> di(wi.size());
+    std::vector<float> dv(wv.size());
+    dequantize_weights_strided(m.num_verts, qi.data(), qv.data(), di.data(), dv.data());
+    float max_error = 0.0f;
+    long long mismatches = 0;
+    for (size_t slot = 0; slot < wi.size(); ++slot) {
+        if (di[slot] != wi[slot]) mismatches++;
+        else if (wi[slot] >= 0) max_error = std::max(max_error, std::fabs(dv[slot] - wv[slot]));
+    }
+    std::printf("{\"bench\":\"quantized_check\",\"kernel\":\"%s\",\"mesh\":%s,\"brush\":%.4f,"
+                "\"bytes_per_slot\":[%d,%d],\"max_weight_error\":%.7f,\"group_mismatches\":%lld}\n",
+                kernel, json_string(m.name).c_str(), brush, (int)(sizeof(int) + sizeof(float)),
+                (int)(2 * sizeof(uint16_t)), max_error, mismatches);
+    std::fflush(stdout);
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream ss(s);
+    while (std::getline(ss, part, sep)) if (!part.empty()) parts.push_back(part);
+    return parts;
+}
+
+bool parse_args(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string v = argv[++i];
+        if (a == "--mesh") opt.meshes.push_back(v);
+        else if (a == "--threads") {
+            opt.threads.clear();
+            for (auto& p : split(v, ',')) opt.threads.push_back(std::atoi(p.c_str()));
+        } else if (a == "--brush") {
+            opt.brushes.clear();
+            for (auto& p : split(v, ',')) opt.brushes.push_back((float)std::atof(p.c_str()));
+        } else if (a == "--reps") opt.reps = std::max(1, std::atoi(v.c_str()));
+        else if (a == "--bones") opt.bones = std::max(1, std::min(64, std::atoi(v.c_str())));
+        else if (a == "--dabs") opt.dabs = std::max(1, std::atoi(v.c_str()));
+        else return false;
+    }
+    if (opt.meshes.empty()) opt.meshes = {"grid:256", "sphere:256x512"};
+    return true;
+}
+
+void bench_mesh(const BenchMesh& m, const BenchOptions& opt) {
+    int nv = m.num_verts, ne = m.num_edges();
+    std::fprintf(stderr, "%s: %d verts, %d edges\n", m.name.c_str(), nv, ne);
+
+    std::vector<int> adj_starts(nv + 1), adj_indices((size_t)ne * 2);
+    std::vector<float> adj_weights((size_t)ne * 2);
+
+    // 1. Adjacency (serial export + pool per thread count)
+    Timing t = time_reps(opt.reps, [] {}, [&] {
+        build_adjacency_graph(nv, ne, m.edges.data(), m.coords.data(),
+                              adj_starts.data(), adj_indices.data(), adj_weights.data());
+    });
+    emit("build_adjacency_graph", m, 1, 0.0f, nv, opt.reps, t);
+
+    for (int threads : opt.threads) {
+        void* pool = pool_create(threads);
+        int used = pool_size(pool);
+        t = time_reps(opt.reps, [] {}, [&] {
+            build_adjacency_graph_mt(pool, nv, ne, m.edges.data(), m.coords.data(),
+                                     adj_starts.data(), adj_indices.data(), adj_weights.data());
+        });
+        emit("build_adjacency_graph_mt", m, used, 0.0f, nv, opt.reps, t);
+        pool_destroy(pool);
+    }
+
+    // 2. Weights + brush footprints (fixed dab centers on mesh vertices)
+    std::vector<int> base_wi, wi;
+    std::vector<float> base_wv, wv;
+    make_weights(m, opt.bones, base_wi, base_wv);
+    wi = base_wi;
+    wv = base_wv;
+    auto restore = [&] {
+        std::copy(base_wi.begin(), base_wi.end(), wi.begin());
+        std::copy(base_wv.begin(), base_wv.end(), wv.begin());
+    };
+    // Same weights in the 16-bit layout (QuantizedStorage)
+    std::vector<uint16_t> base_qi(base_wi.size()), base_qv(base_wv.size());
+    quantize_weights_strided(nv, base_wi.data(), base_wv.data(), base_qi.data(), base_qv.data());
+    std::vector<uint16_t> qi = base_qi, qv = base_qv;
+    auto restore_quantized = [&] {
+        std::copy(base_qi.begin(), base_qi.end(), qi.begin());
+        std::copy(base_qv.begin(), base_qv.end(), qv.begin());
+    };
+
+    // 3. Full-mesh cleanup pipeline (limit_total + clean + normalize_all)
+    const WeightOp cleanup[3] = {
+        {PIPE_LIMIT, 0, 3, 0.0f}, {PIPE_CLEAN, 0, 1, 0.05f}, {PIPE_NORMALIZE, 0, -1, 0.0f}
+    };
+    std::vector<unsigned char> changed(nv);
+    for (int threads : opt.threads) {
+        void* pool = pool_create(threads);
+        int used = pool_size(pool);
+        t = time_reps(opt.reps, restore, [&] {
+            weight_pipeline_strided(pool, nv, wi.data(), wv.data(), cleanup, 3,
+                                    nullptr, 0, nullptr, nullptr, nullptr, 0, changed.data());
+        });
+        emit("weight_pipeline_strided", m, used, 0.0f, nv, opt.reps, t);
+        pool_destroy(pool);
+    }
+
+    // 4. Heat weights: a chain of opt.bones segments through the bounding box (few reps, it's a full solve)
+    float lo_b[3], hi_b[3];
+    bounds(m, lo_b, hi_b);
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) if (hi_b[a] - lo_b[a] > hi_b[axis] - lo_b[axis]) axis = a;
+    std::vector<float> segments((size_t)opt.bones * 6);
+    std::vector<int> bone_groups(opt.bones);
+    for (int b = 0; b < opt.bones; ++b) {
+        for (int a = 0; a < 3; ++a) {
+            float center = 0.5f * (lo_b[a] + hi_b[a]);
+            float extent = hi_b[a] - lo_b[a];
+            segments[(size_t)b * 6 + a] = a == axis ? lo_b[a] + extent * b / opt.bones : center;
+            segments[(size_t)b * 6 + 3 + a] = a == axis ? lo_b[a] + extent * (b + 1) / opt.bones : center;
+        }
+        bone_groups[b] = b;
+    }
+    const HeatParams heat{1.0f, 0.01f, 1e-4f, 1000, 4, 0};
+    int heat_reps = std::min(opt.reps, 3);
+    for (int threads : opt.threads) {
+        void* pool = pool_create(threads);
+        int used = pool_size(pool);
+        t = time_reps(heat_reps, restore, [&] {
+            heat_weights_strided(pool, nv, m.coords.data(), adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                 opt.bones, segments.data(), nullptr, bone_groups.data(), &heat,
+                                 wi.data(), wv.data(), nullptr);
+        });
+        emit("heat_weights_strided", m, used, 0.0f, nv, heat_reps, t);
+        pool_destroy(pool);
+    }
+
+    // 5. Whole-mesh smooth on a session (targets = vertices x passes)
+    std::vector<int> counts(nv, 0), flat_groups;
+    std::vector<float> flat_weights;
+    for (size_t slot = 0; slot < base_wi.size(); ++slot) {
+        if (base_wi[slot] < 0) continue;
+        counts[slot / MAX_STORAGE]++;
+        flat_groups.push_back(base_wi[slot]);
+        flat_weights.push_back(base_wv[slot]);
+    }
+    const int mesh_passes = 10;
+    auto bench_smooth_mesh = [&](const char* bench, int threads, int backend) {
+        void* pool = pool_create(threads);
+        void* session = session_create(pool, nullptr);
+        session_set_adjacency(session, nv, ne, m.edges.data(), m.coords.data());
+        auto reset = [&] { session_set_weights(session, nv, counts.data(), flat_groups.data(), flat_weights.data()); };
+        t = time_reps(heat_reps, reset, [&] {
+            session_smooth_mesh(session, 0.5f, mesh_passes, 0.0f, backend, nullptr, nullptr);
+        });
+        emit(bench, m, pool_size(pool), 0.0f, (long long)nv * mesh_passes, heat_reps, t);
+        session_destroy(session);
+        pool_destroy(pool);
+    };
+    for (int threads : opt.threads) bench_smooth_mesh("session_smooth_mesh_cpu", threads, SMOOTH_CPU);
+    if (gpu_device_info(nullptr, 0)) bench_smooth_mesh("session_smooth_mesh_gpu", 1, SMOOTH_GPU);
+
+    void* grid = spatial_create();
+    spatial_build(grid, nullptr, nv, m.coords.data());
+    float lo[3], hi[3];
+    bounds(m, lo, hi);
+    float diag = std::sqrt((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1]) +
+                           (hi[2] - lo[2]) * (hi[2] - lo[2]));
+
+    Lcg rng(nv);
+    std::vector<int> centers(opt.dabs);
+    for (int& c : centers) c = std::min(nv - 1, (int)(rng.next() * nv));
+
+    std::vector<int> targets(nv);
+    std::vector<float> factors(nv);
+    for (float brush : opt.brushes) {
+        // Footprints of every dab, concatenated (each one is a separate kernel call)
+        std::vector<int> dab_start{0};
+        std::vector<int> all_targets;
+        std::vector<float> all_factors;
+        std::vector<int> dab_group;
+        for (int c : centers) {
+            int found = query_brush(grid, &m.coords[(size_t)c * 3], brush * diag, 0, 0.5f,
+                                    targets.data(), factors.data(), nv);
+            found = std::min(found, nv);
+            all_targets.insert(all_targets.end(), targets.begin(), targets.begin() + found);
+            all_factors.insert(all_factors.end(), factors.begin(), factors.begin() + found);
+            dab_start.push_back((int)all_targets.size());
+            dab_group.push_back(base_wi[(size_t)c * MAX_STORAGE]);
+        }
+        long long total_targets = (long long)all_targets.size();
+        int num_dabs = (int)centers.size();
+
+        t = time_reps(opt.reps, restore, [&] {
+            for (int d = 0; d < num_dabs; ++d) {
+                smooth_strided(adj_starts.data(), adj_indices.data(), adj_weights.data(), wi.data(), wv.data(),
+                               all_targets.data() + dab_start[d], dab_start[d + 1] - dab_start[d], 0.5f);
+            }
+        });
+        emit("smooth_strided", m, 1, brush, total_targets, opt.reps, t);
+
+        for (int threads : opt.threads) {
+            void* pool = pool_create(threads);
+            int used = pool_size(pool);
+            t = time_reps(opt.reps, restore, [&] {
+                for (int d = 0; d < num_dabs; ++d) {
+                    smooth_strided_jacobi(pool, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                          wi.data(), wv.data(), all_targets.data() + dab_start[d],
+                                          dab_start[d + 1] - dab_start[d], 0.5f);
+                }
+            });
+            emit("smooth_strided_jacobi", m, used, brush, total_targets, opt.reps, t);
+
+            t = time_reps(opt.reps, restore_quantized, [&] {
+                for (int d = 0; d < num_dabs; ++d) {
+                    smooth_quantized_jacobi(pool, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                            qi.data(), qv.data(), all_targets.data() + dab_start[d],
+                                            dab_start[d + 1] - dab_start[d], 0.5f);
+                }
+            });
+            emit("smooth_quantized_jacobi", m, used, brush, total_targets, opt.reps, t);
+            pool_destroy(pool);
+        }
+        {
+            void* pool = pool_create(1);
+            restore();
+            restore_quantized();
+            for (int d = 0; d < num_dabs; ++d) {
+                int count = dab_start[d + 1] - dab_start[d];
+                smooth_strided_jacobi(pool, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                      wi.data(), wv.data(), all_targets.data() + dab_start[d], count, 0.5f);
+                smooth_quantized_jacobi(pool, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                        qi.data(), qv.data(), all_targets.data() + dab_start[d], count, 0.5f);
+            }
+            emit_quantized_check("smooth_quantized_jacobi", m, brush, wi, wv, qi, qv);
+            pool_destroy(pool);
+        }
+
+        const char* logic_names[2] = {"apply_vertex_logic_strided:smear", "apply_vertex_logic_strided:harden"};
+        const char* quantized_names[2] = {"apply_vertex_logic_quantized:smear", "apply_vertex_logic_quantized:harden"};
+        for (int mode = 0; mode < 2; ++mode) {
+            t = time_reps(opt.reps, restore, [&] {
+                for (int d = 0; d < num_dabs; ++d) {
+                    apply_vertex_logic_strided(wi.data(), wv.data(), all_targets.data() + dab_start[d],
+                                               all_factors.data() + dab_start[d], dab_start[d + 1] - dab_start[d],
+                                               dab_group[d], mode, 0.75f);
+                }
+            });
+            emit(logic_names[mode], m, 1, brush, total_targets, opt.reps, t);
+
+            auto quantized_dabs = [&] {
+                for (int d = 0; d < num_dabs; ++d) {
+                    apply_vertex_logic_quantized(qi.data(), qv.data(), all_targets.data() + dab_start[d],
+                                                 all_factors.data() + dab_start[d], dab_start[d + 1] - dab_start[d],
+                                                 dab_group[d], mode, 0.75f);
+                }
+            };
+            t = time_reps(opt.reps, restore_quantized, quantized_dabs);
+            emit(quantized_names[mode], m, 1, brush, total_targets, opt.reps, t);
+            // Fresh copies of both layouts, the same dabs on each
+            restore();
+            restore_quantized();
+            for (int d = 0; d < num_dabs; ++d) {
+                apply_vertex_logic_strided(wi.data(), wv.data(), all_targets.data() + dab_start[d],
+                                           all_factors.data() + dab_start[d], dab_start[d + 1] - dab_start[d],
+                                           dab_group[d], mode, 0.75f);
+            }
+            quantized_dabs();
+            emit_quantized_check(quantized_names[mode], m, brush, wi, wv, qi, qv);
+        }
+
+        float offset[3] = {0.5f * brush * diag, 0.0f, 0.0f};
+        for (int threads : opt.threads) {
+            void* pool = pool_create(threads);
+            int used = pool_size(pool);
+            t = time_reps(opt.reps, restore, [&] {
+                for (int d = 0; d < num_dabs; ++d) {
+                    smear_strided_sampled(pool, grid, nv, m.coords.data(), wi.data(), wv.data(),
+                                          all_targets.data() + dab_start[d], all_factors.data() + dab_start[d],
+                                          dab_start[d + 1] - dab_start[d], offset,
+                                          nullptr, nullptr, nullptr, nullptr, nullptr);
+                }
+            });
+            emit("smear_strided_sampled", m, used, brush, total_targets, opt.reps, t);
+            pool_destroy(pool);
+        }
+    }
+    spatial_destroy(grid);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parse_args(argc, argv, opt)) {
+        std::fprintf(stderr,
+            "usage: WynnWeightBench [--mesh grid:N|sphere:RxS|obj:PATH]... [--threads 1,2,4,0]\n"
+            "                       [--brush 0.02,0.05,0.1,0.25] [--reps 20] [--bones 24] [--dabs 8]\n");
+        return 2;
+    }
+
+    const char* simd = "scalar";
+#if defined(WYNN_SIMD_AVX2)
+    if (cpu_has_avx2()) simd = "avx2";
+#elif defined(WYNN_SIMD_NEON)
+    simd = "neon";
+#endif
+    std::printf("{\"bench\":\"meta\",\"hardware_threads\":%u,\"simd\":\"%s\",\"reps\":%d,\"bones\":%d,\"dabs\":%d}\n",
+                std::thread::hardware_concurrency(), simd, opt.reps, opt.bones, opt.dabs);
+
+    for (const std::string& spec : opt.meshes) {
+        BenchMesh m = make_mesh(spec);
+        if (m.num_verts == 0 || m.edges.empty()) {
+            std::fprintf(stderr, "skipping %s (unknown spec or empty mesh)\n", spec.c_str());
+            continue;
+        }
+        bench_mesh(m, opt);
+    }
+    return 0;
+}
@@ -8,6 +8,8 @@ from bpy_extras import view3d_utils
 import math
 import time  # NEW: For performance timing
 import ctypes
+from . import wynn_core
+from .WeightJobs import refuse_if_busy
 
 # --- UTILS ---
 
@@ -62,7 +64,8 @@ def draw_text_callback(self, context):
     blf.position(font_id, x, y - 25, 0)
     blf.color(font_id, 0.8, 0.8, 0.8, 1)
     debug_text = "ON" if self.debug_mode else "OFF"
-    blf.draw(font_id, f"Undo: {len(self.undo_stack)} | Debug(D): {debug_text}")
+    mirror_text = "ON" if self.use_mirror else "OFF"
+    blf.draw(font_id, f"Undo: {self.undo_depth()} | Mirror(X): {mirror_text} | Debug(D): {debug_text}")
 
     # 5. PERFORMANCE (NEW)
     blf.position(font_id, x, y - 50, 0)
@@ -77,6 +80,20 @@ def draw_text_callback(self, context):
         
     blf.draw(font_id, f"Compute: {self.last_compute_time:.2f} ms")
 
+    # 6. NATIVE COUNTERS (session_get_stats)
+    stats = self.core_stats
+    if stats and stats.calls > 0:
+        blf.color(font_id, 0.8, 0.8, 0.8, 1)
+        last = stats.last_ms
+        blf.position(font_id, x, y - 75, 0)
+        blf.draw(font_id, f"Query {last[0]:.2f} | Kernel {last[1]:.2f} | Commit {last[2]:.2f} | Diff {last[3]:.2f} ms"
+                          f" (p95 kernel < {wynn_core.histogram_percentile(stats, 1, 0.95):.2f})")
+        changed = stats.verts_changed
+        groups_per_vert = stats.groups_touched / changed if changed else 0.0
+        blf.position(font_id, x, y - 100, 0)
+        blf.draw(font_id, f"Verts: {changed}/{stats.verts_processed} changed | {groups_per_vert:.1f} groups/vert"
+                          f" | Scratch: {stats.scratch_grows} grow / {stats.scratch_reuses} reuse")
+
 def draw_circles_callback(self, context):
     if not self.cursor_loc or self.world_radius <= 0: return
     
@@ -149,24 +166,61 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
     strength: bpy.props.FloatProperty(name="Strength", default=0.5, min=0.01, max=1.0)
 
     debug_mode: bpy.props.BoolProperty(name="Debug Mode", default=False)
+    undo_budget_mb: bpy.props.IntProperty(name="Undo Memory (MB)", default=256, min=1, max=8192)
+    stroke_spacing: bpy.props.FloatProperty(name="Spacing", description="Dab spacing (fraction of radius)", default=0.25, min=0.05, max=2.0)
+    stroke_merge: bpy.props.EnumProperty(
+        name="Overlap",
+        items=[('MAX', "Max", "Overlapping dabs keep the strongest factor"),
+               ('ACCUMULATE', "Accumulate", "Overlapping dabs build up")],
+        default='MAX'
+    )
+
+    max_influence: bpy.props.EnumProperty(
+        name="Max Influence",
+        description="Influences kept per vertex (limited + normalized inside every dab)",
+        items=[('1', "1", "Rigid"), ('2', "2", "Mobile"), ('4', "4", "Game engine (e.g. Unreal)"), ('8', "8", "Full storage")],
+        default='8'
+    )
+
+    connected_only: bpy.props.BoolProperty(
+        name="Connected Only",
+        description="Brush follows the surface (geodesic distance) so it doesn't bleed onto nearby unconnected parts like fingers or lips",
+        default=False
+    )
+
+    FLUSH_INTERVAL = 1.0 / 60.0 # Max Blender write-back rate while painting (s)
 
     def invoke(self, context, event):
         obj = context.active_object
         if not obj or obj.type != 'MESH':
             self.report({'ERROR'}, "Select a Mesh")
             return {'CANCELLED'}
+        if refuse_if_busy(self, [obj]):
+            return {'CANCELLED'}
         self.mesh_object = obj
 
         # --- C++ DLL SETUP ---
         import ctypes
         import os
         self.dll = None
+        self.c_pool = None # Thread pool handle (One per modal session)
+        self.has_tracked = False # *_tracked kernels (Dirty-vertex output)
+        self.c_delta_capacity = 0
+        self.c_undo = None # Native undo journal (Stroke deltas, all groups)
+        self.c_grid = None # Native spatial index (Replaces kd_visual)
+        self.c_session = None # Native brush session (CSR + weights + index in C++, one call per dab)
+        self.c_mirror_map = None # Vertex -> X-mirrored vertex (-1 = none)
+        self.core_reused = False # Handles taken over from the wynn_core cache
+        self.use_mirror = obj.data.use_mirror_x
         self.c_stride = 8 # Fixed stride matches C++
         
         dll_path = os.path.join(os.path.dirname(__file__), "WynnWeightLogic.dll")
         if os.path.exists(dll_path):
             try:
-                self.dll = ctypes.CDLL(dll_path)
+                self.dll = wynn_core.load_dll() # Shared CDLL (argtypes below are idempotent)
+                if self.dll is None:
+                    raise OSError("see WynnCore message above")
+                self.adopt_cached_core(obj)
                 # smooth_strided(adj_s, adj_i, adj_w, w_i, w_v, targets, num, factor)
                 self.dll.smooth_strided.argtypes = [
                     ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
@@ -193,6 +247,196 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
                 except AttributeError:
                     print("WynnWeightBrush: build_adjacency_graph MISSING (Old DLL?)")
 
+                try:
+                    self.dll.build_adjacency_graph_mt.argtypes = [
+                        ctypes.c_void_p,
+                        ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                except AttributeError:
+                    print("WynnWeightBrush: build_adjacency_graph_mt MISSING (Old DLL?)")
+
+                # Bulk weight transfer (pack on invoke, diff on apply)
+                try:
+                    self.dll.pack_weights_strided.argtypes = [
+                        ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.diff_weights_strided.argtypes = [
+                        ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.diff_weights_strided.restype = ctypes.c_int
+                except AttributeError:
+                    print("WynnWeightBrush: pack/diff_weights_strided MISSING (Old DLL?)")
+
+                # Thread Pool + Jacobi Smooth (Multithreaded Blur)
+                # smooth_strided_jacobi(pool, adj_s, adj_i, adj_w, w_i, w_v, targets, num, factor)
+                try:
+                    self.dll.pool_create.argtypes = [ctypes.c_int]
+                    self.dll.pool_create.restype = ctypes.c_void_p
+                    self.dll.pool_destroy.argtypes = [ctypes.c_void_p]
+                    self.dll.pool_size.argtypes = [ctypes.c_void_p]
+                    self.dll.smooth_strided_jacobi.argtypes = [
+                        ctypes.c_void_p,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float
+                    ]
+                    if not self.c_pool:
+                        self.c_pool = self.dll.pool_create(0) # 0 = All cores
+                    print(f"WynnWeightBrush: Thread Pool x{self.dll.pool_size(self.c_pool)}")
+                except AttributeError:
+                    print("WynnWeightBrush: smooth_strided_jacobi MISSING (Old DLL?)")
+
+                # Dirty Tracking: kernels also return the vertices they changed (+ before/after slots)
+                # (..., out_verts, out_before_i, out_before_v, out_after_i, out_after_v) -> changed count
+                try:
+                    delta_args = [
+                        ctypes.POINTER(ctypes.c_int),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.apply_vertex_logic_strided_tracked.argtypes = self.dll.apply_vertex_logic_strided.argtypes + delta_args
+                    self.dll.apply_vertex_logic_strided_tracked.restype = ctypes.c_int
+                    self.dll.smooth_strided_tracked.argtypes = self.dll.smooth_strided.argtypes + delta_args
+                    self.dll.smooth_strided_tracked.restype = ctypes.c_int
+                    if self.c_pool:
+                        self.dll.smooth_strided_jacobi_tracked.argtypes = self.dll.smooth_strided_jacobi.argtypes + delta_args
+                        self.dll.smooth_strided_jacobi_tracked.restype = ctypes.c_int
+                    self.has_tracked = True
+                except AttributeError:
+                    print("WynnWeightBrush: *_tracked kernels MISSING (Old DLL?)")
+
+                # Undo Journal (Fed by the tracked kernels' before-slots)
+                try:
+                    self.dll.undo_create.argtypes = [ctypes.c_longlong]
+                    self.dll.undo_create.restype = ctypes.c_void_p
+                    for name in ('undo_destroy', 'undo_begin_stroke', 'undo_end_stroke', 'undo_count', 'undo_peek_size'):
+                        getattr(self.dll, name).argtypes = [ctypes.c_void_p]
+                    self.dll.undo_bytes.argtypes = [ctypes.c_void_p]
+                    self.dll.undo_bytes.restype = ctypes.c_longlong
+                    self.dll.undo_record.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_int),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int
+                    ]
+                    self.dll.undo_pop.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int)
+                    ]
+                    if self.has_tracked and not self.c_undo:
+                        self.c_undo = self.dll.undo_create(self.undo_budget_mb * 1024 * 1024)
+                except AttributeError:
+                    print("WynnWeightBrush: undo journal MISSING (Old DLL?)")
+
+                # Spatial Index (Uniform grid over world-space coords)
+                try:
+                    self.dll.spatial_create.restype = ctypes.c_void_p
+                    self.dll.spatial_destroy.argtypes = [ctypes.c_void_p]
+                    self.dll.spatial_build.argtypes = [
+                        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float)
+                    ]
+                    # query_brush(grid, center[3], radius, falloff_mode, strength, out_indices, out_factors, max_out)
+                    self.dll.query_brush.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.c_float, ctypes.c_int, ctypes.c_float,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int
+                    ]
+                    self.dll.query_brush.restype = ctypes.c_int
+                    self.dll.find_nearest.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.find_nearest.restype = ctypes.c_int
+                    if not self.c_grid:
+                        self.c_grid = self.dll.spatial_create()
+                except AttributeError:
+                    print("WynnWeightBrush: spatial index MISSING (Old DLL?)")
+
+                # Sampled Smear: smear_strided_sampled(pool, grid, nv, coords, wi, wv, targets, factors, count, offset[3], delta...)
+                try:
+                    self.dll.smear_strided_sampled.argtypes = [
+                        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.smear_strided_sampled.restype = ctypes.c_int
+                except AttributeError:
+                    print("WynnWeightBrush: smear_strided_sampled MISSING (Old DLL?)")
+
+                # Brush Session (Fused dab: query + falloff + kernel + dirty tracking)
+                try:
+                    self.dll.session_create.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+                    self.dll.session_create.restype = ctypes.c_void_p
+                    self.dll.session_destroy.argtypes = [ctypes.c_void_p]
+                    self.dll.session_set_adjacency.argtypes = [
+                        ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.session_set_coords.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float)]
+                    self.dll.session_set_weights.argtypes = [
+                        ctypes.c_void_p, ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    # brush_dab(session, center[3], prev_center[3] or None, radius, strength, mode, falloff_mode, active_group)
+                    self.dll.brush_dab.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float),
+                        ctypes.c_float, ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_int
+                    ]
+                    self.dll.brush_dab.restype = ctypes.c_int
+                    self.dll.session_diff.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+                    ]
+                    self.dll.session_diff.restype = ctypes.c_int
+                    self.dll.session_undo_pop.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int)]
+                    self.dll.session_undo_pop.restype = ctypes.c_int
+                    self.dll.session_pending_count.argtypes = [ctypes.c_void_p]
+                    self.dll.session_pending_count.restype = ctypes.c_int
+                    self.dll.session_set_max_influence.argtypes = [ctypes.c_void_p, ctypes.c_int]
+                    # X-Mirror: build_mirror_map(pool, num_verts, local_coords, tolerance, out_map) -> matched
+                    self.dll.build_mirror_map.argtypes = [
+                        ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.c_float, ctypes.POINTER(ctypes.c_int)
+                    ]
+                    self.dll.build_mirror_map.restype = ctypes.c_int
+                    self.dll.session_set_mirror.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.c_int
+                    ]
+                    # Stroke engine: brush_stroke_to(session, center[3], radius, spacing, strength, mode, falloff, group, merge)
+                    self.dll.brush_stroke_begin.argtypes = [ctypes.c_void_p]
+                    self.dll.brush_stroke_to.argtypes = [
+                        ctypes.c_void_p, ctypes.POINTER(ctypes.c_float),
+                        ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int
+                    ]
+                    self.dll.brush_stroke_to.restype = ctypes.c_int
+                    if self.c_undo:
+                        if not self.c_session:
+                            self.c_session = self.dll.session_create(self.c_pool, self.c_undo)
+                        self.dll.session_set_max_influence(self.c_session, int(self.max_influence))
+                        self.c_diff_capacity = 0
+                        self.last_flush = 0.0
+                except AttributeError:
+                    print("WynnWeightBrush: brush session MISSING (Old DLL?)")
+
+                # Connected Only (geodesic footprints over the session CSR)
+                if self.c_session:
+                    try:
+                        self.dll.session_set_connected_only.argtypes = [ctypes.c_void_p, ctypes.c_int]
+                        self.dll.session_set_connected_only(self.c_session, 1 if self.connected_only else 0)
+                    except AttributeError:
+                        print("WynnWeightBrush: session_set_connected_only MISSING (Old DLL?)")
+
+                # Group flags: dabs normalize across deform groups only, locked groups stay
+                if self.c_session and not wynn_core.set_group_flags(self.dll, self.c_session, self.mesh_object):
+                    print("WynnWeightBrush: session_set_group_flags MISSING (Old DLL?)")
+
+                # HUD counters cover this modal session only (cached sessions keep theirs)
+                if self.c_session and hasattr(self.dll, 'session_reset_stats'):
+                    self.dll.session_reset_stats(self.c_session)
+
                 print(f"WynnWeightBrush: Accelerated Core Loaded from {dll_path}")
             except OSError as e:
                 print(f"WynnWeightBrush: DLL Found but Failed to Load: {e}")
@@ -203,6 +447,7 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
 
         # 2. CACHE
         if not self.refresh_geometry(context, self.mesh_object):
+            self.release_core()
             self.report({'ERROR'}, "Vertex mismatch")
             return {'CANCELLED'}
 
@@ -230,8 +475,30 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
         raw_vert_coords = (ctypes.c_float * (num_verts * 3))()
         vertices.foreach_get("co", raw_vert_coords)
         
-        # Call C++ Builder
-        if self.dll and hasattr(self.dll, 'build_adjacency_graph'):
+        # Call C++ Builder (Parallel if pool exists)
+        geometry_changed = 2
+        if self.c_session and self.core_reused and hasattr(self.dll, 'session_sync_geometry'):
+            # Re-entered: fingerprints decide between nothing / edge weights only / full rebuild
+            self.dll.session_sync_geometry.argtypes = [
+                ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+            ]
+            self.dll.session_sync_geometry.restype = ctypes.c_int
+            geometry_changed = self.dll.session_sync_geometry(
+                self.c_session, num_verts, num_edges, raw_edge_indices, raw_vert_coords
+            )
+            print(f"[Init] Cached session: {('unchanged', 'edge weights refreshed', 'rebuilt')[geometry_changed]}")
+        elif self.c_session:
+            # Session keeps its own CSR (brush_dab never crosses back into Python)
+            self.dll.session_set_adjacency(
+                self.c_session, num_verts, num_edges, raw_edge_indices, raw_vert_coords
+            )
+        elif self.dll and self.c_pool and hasattr(self.dll, 'build_adjacency_graph_mt'):
+            self.dll.build_adjacency_graph_mt(
+                self.c_pool,
+                num_verts, num_edges, raw_edge_indices, raw_vert_coords,
+                self.c_adj_starts, self.c_adj_indices, self.c_adj_weights
+            )
+        elif self.dll and hasattr(self.dll, 'build_adjacency_graph'):
             self.dll.build_adjacency_graph(
                 num_verts, num_edges, raw_edge_indices, raw_vert_coords,
                 self.c_adj_starts, self.c_adj_indices, self.c_adj_weights
@@ -258,6 +525,13 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
                     cursor += 1
             self.c_adj_starts[num_verts] = cursor
 
+        # X-Mirror Map (Once per session, object space)
+        if self.c_session:
+            if geometry_changed or self.c_mirror_map is None or len(self.c_mirror_map) != num_verts:
+                self.c_mirror_map = (ctypes.c_int * num_verts)()
+                matched = self.dll.build_mirror_map(self.c_pool, num_verts, raw_vert_coords, 0.001, self.c_mirror_map)
+                print(f"[Init] Mirror Map: {matched}/{num_verts} verts matched")
+
         # Legacy Dict (Only needed for fallback paint mode, skip if C++ active?)
         # Optim: Skip population if self.dll is working to save time
         self.adjacency = {} 
@@ -265,36 +539,8 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
         print(f"[Init] Fast Adjacency Build: {(time.perf_counter() - t_adj_start)*1000:.2f}ms")
 
         t_weights_start = time.perf_counter()
-        # Flatten Weights (Strided)
-        # Allocate: [num_verts * STRIDE]
-        total_slots = num_verts * self.c_stride
-        self.c_weight_indices = (ctypes.c_int * total_slots)()
-        self.c_weight_values = (ctypes.c_float * total_slots)()
-        
-        # Init with -1/0.0
-        # memset? ctypes init is 0. We need indices to be -1 or handle 0 carefully.
-        # Python loop to fill is slow but only run on Invoke.
-        # For 100k verts -> 800k slots. Python loop might take 0.5s. Acceptable for startup.
-        
-        # Initialize default state
-        # (Actually ctypes initializes to 0. Group 0 is valid. So we MUST init to -1)
-        # Fast fill? No easy way in pure Python without numpy.
-        # We'll just rely on the loop below fulfilling it.
-        # Pre-fill is safer.
-        
-        # Init with -1 (0xFFFFFFFF)
-        # Replaced slow Python loop with memset
-        t_memset = time.perf_counter()
-        ctypes.memset(self.c_weight_indices, 0xFF, ctypes.sizeof(self.c_weight_indices))
-        print(f"  [Init] Memset: {(time.perf_counter() - t_memset)*1000:.3f}ms")
-        
-        # Populate
-        for i, v in enumerate(vertices):
-            base = i * self.c_stride
-            for k, g in enumerate(v.groups):
-                if k >= self.c_stride: break # Max Storage Limit per vert (8)
-                self.c_weight_indices[base + k] = g.group
-                self.c_weight_values[base + k] = g.weight
+        self.populate_strided_weights(obj)
+        self.sync_mirror(obj)
         print(f"[Init] Populate Weights: {(time.perf_counter() - t_weights_start)*1000:.2f}ms")
 
         # State
@@ -318,6 +564,7 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
         self.message_text = ""
         self.message_timer = 0
         self.last_compute_time = 0.0 
+        self.core_stats = None # wynn_core.SessionStats (native session only, see paint_dab_session)
         self.debug_mode = self.debug_mode
         
         self.radius_px = context.scene.wynn_brush_radius
@@ -336,23 +583,235 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
     
     # Removed flatten_weights helper (Logic moved to Invoke)
 
+    def populate_strided_weights(self, obj):
+        """
+        Fill c_weight_indices/c_weight_values [num_verts * STRIDE] from Blender.
+        With the new DLL, Python only builds flat lists (C-speed comprehensions)
+        and C++ packs the strided layout. c_base_* mirrors what Blender holds,
+        diff_weights_strided compares against it on apply.
+        With a brush session the packed weights live in the session instead.
+        """
+        vertices = obj.data.vertices
+        num_verts = len(vertices)
+        total_slots = num_verts * self.c_stride
+        self.c_weight_indices = (ctypes.c_int * total_slots)()
+        self.c_weight_values = (ctypes.c_float * total_slots)()
+        self.c_base_indices = None
+        self.c_base_values = None
+
+        if self.dll and hasattr(self.dll, 'pack_weights_strided'):
+            c_counts, c_groups, c_weights = wynn_core.pack_mesh_weights(obj.data)
+            if self.c_session:
+                # Session owns the strided buffers + Blender mirror
+                self.dll.session_set_weights(self.c_session, num_verts, c_counts, c_groups, c_weights)
+                return
+            self.dll.pack_weights_strided(
+                num_verts, c_counts, c_groups, c_weights,
+                self.c_weight_indices, self.c_weight_values
+            )
+
+            if hasattr(self.dll, 'diff_weights_strided'):
+                self.c_base_indices = (ctypes.c_int * total_slots)()
+                self.c_base_values = (ctypes.c_float * total_slots)()
+                ctypes.memmove(self.c_base_indices, self.c_weight_indices, ctypes.sizeof(self.c_weight_indices))
+                ctypes.memmove(self.c_base_values, self.c_weight_values, ctypes.sizeof(self.c_weight_values))
+            return
+
+        # Init with -1 (0xFFFFFFFF)
+        # (ctypes initializes to 0. Group 0 is valid. So we MUST init to -1)
+        ctypes.memset(self.c_weight_indices, 0xFF, ctypes.sizeof(self.c_weight_indices))
+        
+        # Populate (Old DLL)
+        for i, v in enumerate(vertices):
+            base = i * self.c_stride
+            for k, g in enumerate(v.groups):
+                if k >= self.c_stride: break # Max Storage Limit per vert (8)
+                self.c_weight_indices[base + k] = g.group
+                self.c_weight_values[base + k] = g.weight
+
+    def apply_weight_diff(self, obj, target_indices, count):
+        """Write only the changed (vertex, group, weight) triples back to Blender, batched per group."""
+        max_out = count * self.c_stride * 2
+        out_verts = (ctypes.c_int * max_out)()
+        out_groups = (ctypes.c_int * max_out)()
+        out_weights = (ctypes.c_float * max_out)()
+        
+        num_changes = self.dll.diff_weights_strided(
+            len(obj.data.vertices),
+            self.c_base_indices, self.c_base_values,
+            self.c_weight_indices, self.c_weight_values,
+            target_indices, count,
+            out_verts, out_groups, out_weights
+        )
+        return self.write_weight_changes(obj, out_verts, out_groups, out_weights, num_changes)
+
+    def apply_session_diff(self, obj, vertex_list, count):
+        """Same as apply_weight_diff, against the session's buffers (vertex_list None = last dab)."""
+        # Run-batched diff read in place from session memory (no output arrays)
+        written = wynn_core.write_session_diff_runs(self.dll, self.c_session, obj, vertex_list, count)
+        if written is not None:
+            return written
+        max_out = count * self.c_stride * 2
+        if max_out > self.c_diff_capacity:
+            self.c_diff_capacity = max(max_out, self.c_diff_capacity * 2, 4096)
+            self.c_diff_verts = (ctypes.c_int * self.c_diff_capacity)()
+            self.c_diff_groups = (ctypes.c_int * self.c_diff_capacity)()
+            self.c_diff_weights = (ctypes.c_float * self.c_diff_capacity)()
+
+        num_changes = self.dll.session_diff(
+            self.c_session, vertex_list, count if vertex_list else 0,
+            self.c_diff_verts, self.c_diff_groups, self.c_diff_weights
+        )
+        return self.write_weight_changes(obj, self.c_diff_verts, self.c_diff_groups, self.c_diff_weights, num_changes)
+
+    def write_weight_changes(self, obj, out_verts, out_groups, out_weights, num_changes):
+        """(vertex, group, weight) triples -> Blender, batched per group (weight 0 = remove)."""
+        return wynn_core.write_weight_changes(obj, out_verts, out_groups, out_weights, num_changes)
+
+    def sync_mirror(self, obj):
+        """Push the X-Mirror state (vertex map + L/R group remap) into the session."""
+        if not self.c_session or self.c_mirror_map is None: return
+        if not self.use_mirror:
+            self.dll.session_set_mirror(self.c_session, None, None, 0)
+            return
+        remap, num_groups = wynn_core.mirror_group_remap(obj)
+        self.dll.session_set_mirror(self.c_session, self.c_mirror_map, remap, num_groups)
+
+    def ensure_delta_buffers(self, count):
+        """Grow the persistent dirty-vertex buffers (reused across dabs)."""
+        if count <= self.c_delta_capacity: return
+        capacity = max(count, self.c_delta_capacity * 2, 1024)
+        slots = capacity * self.c_stride
+        self.c_delta_verts = (ctypes.c_int * capacity)()
+        self.c_delta_before_indices = (ctypes.c_int * slots)()
+        self.c_delta_before_values = (ctypes.c_float * slots)()
+        self.c_delta_after_indices = (ctypes.c_int * slots)()
+        self.c_delta_after_values = (ctypes.c_float * slots)()
+        self.c_delta_capacity = capacity
+
+    def delta_args(self):
+        return (
+            self.c_delta_verts,
+            self.c_delta_before_indices, self.c_delta_before_values,
+            self.c_delta_after_indices, self.c_delta_after_values
+        )
+
+    def adopt_cached_core(self, obj):
+        """
+        Takes over the native handles resident for this mesh (see wynn_core):
+        pool, journal (cleared), index and the session with its CSR, left by
+        the last brush, Smooth or edit-mode session on the same mesh.
+        """
+        self.core_reused = False
+        if not wynn_core.has_session_api(self.dll):
+            return
+        core = wynn_core.acquire_core(obj.data, self.undo_budget_mb)
+        if core is None:
+            return
+        self.c_pool = core.pool
+        self.c_undo = core.undo
+        self.c_grid = core.grid
+        self.c_session = core.session
+        self.c_mirror_map = core.mirror_map
+        self.core_reused = True
+
+    def release_core(self):
+        # Keep a complete session resident for the next operator on this mesh
+        if self.dll and self.c_session and self.c_pool and self.c_undo and self.c_grid and wynn_core.has_session_api(self.dll):
+            wynn_core.release_core(self.mesh_object.data, wynn_core.CoreHandles(
+                self.c_pool, self.c_undo, self.c_grid, self.c_session, self.c_mirror_map
+            ))
+            self.c_session = self.c_pool = self.c_undo = self.c_grid = None
+            return
+
+        # Free native resources owned by this modal session (Session first: it borrows pool + journal)
+        if self.dll and self.c_session:
+            self.dll.session_destroy(self.c_session)
+        self.c_session = None
+        if self.dll and self.c_pool:
+            self.dll.pool_destroy(self.c_pool)
+        self.c_pool = None
+        if self.dll and self.c_undo:
+            self.dll.undo_destroy(self.c_undo)
+        self.c_undo = None
+        if self.dll and self.c_grid:
+            self.dll.spatial_destroy(self.c_grid)
+        self.c_grid = None
+
+    def paint_dab_session(self, context):
+        """
+        Native stroke: dabs are interpolated along the path and merged into one
+        kernel call per event. Blender is only written at FLUSH_INTERVAL.
+        """
+        obj = self.mesh_object
+        t0 = time.perf_counter()
+
+        center = (ctypes.c_float * 3)(*self.cursor_loc)
+        if self.is_blur:
+            mode, strength = 2, self.strength * 0.5 # Uniform factor (Legacy Blur)
+        else:
+            mode, strength = (1 if self.is_harden else 0), self.strength
+        merge_mode = 1 if self.stroke_merge == 'ACCUMULATE' else 0
+
+        dirty_count = self.dll.brush_stroke_to(
+            self.c_session, center, self.world_radius, self.stroke_spacing, strength,
+            mode, 0, obj.vertex_groups.active_index, merge_mode
+        )
+        t1 = time.perf_counter()
+
+        flushed = 0
+        if t1 - self.last_flush >= self.FLUSH_INTERVAL:
+            flushed = self.flush_session(obj)
+        t2 = time.perf_counter()
+
+        # Native counters for the HUD (one call, no console spam)
+        self.core_stats = wynn_core.read_session_stats(self.dll, self.c_session, self.core_stats)
+        if self.debug_mode:
+            print(f"[Core: Session] Dab: {(t1 - t0)*1000:.2f}ms | Apply: {(t2 - t1)*1000:.2f}ms ({dirty_count} dirty, {flushed} written)")
+
+    def flush_session(self, obj):
+        """Write every pending session change to Blender (one batched update)."""
+        self.last_flush = time.perf_counter()
+        pending = self.dll.session_pending_count(self.c_session)
+        if pending == 0: return 0
+        self.apply_session_diff(obj, None, pending)
+        obj.data.update()
+        return pending
+
     def paint_stroke(self, context):
         if not self.cursor_loc: 
             # print("DEBUG: No Cursor Loc") 
+            if self.c_session:
+                # Off the mesh: don't interpolate dabs across the gap
+                self.dll.brush_stroke_begin(self.c_session)
+            return
+
+        if self.c_session:
+            self.paint_dab_session(context)
             return
         
-        # DEBUG: Verify we entered paint_stroke
-        found = self.kd_visual.find_range(self.cursor_loc, self.world_radius)
-        print(f"DEBUG: Stroke. Radius={self.world_radius:.4f} Found={len(found)} Blur={self.is_blur} DLL={self.dll is not None}")
+        # TIMER START: PREP (Range query included)
+        t0 = time.perf_counter()
+
+        if self.c_grid:
+            # Native: indices + quadratic falloff factors in one call (no Python loop)
+            found = None
+            num_found = self.query_brush(self.cursor_loc, self.world_radius, self.strength)
+        else:
+            found = self.kd_visual.find_range(self.cursor_loc, self.world_radius)
+            num_found = len(found)
+
+        if self.debug_mode:
+            print(f"DEBUG: Stroke. Radius={self.world_radius:.4f} Found={num_found} Blur={self.is_blur} DLL={self.dll is not None}")
         
         obj = self.mesh_object
         vertices = obj.data.vertices
         vertex_groups = obj.vertex_groups
         
         idx_active = obj.vertex_groups.active_index
-        # ... Mirror/Smear logic ...
+        # Mirror: native session only (see sync_mirror)
         
-        if not found: return
+        if not num_found: return
         
         # --- C++ FAST PATH (Zero-Copy) ---
         has_new_api = hasattr(self.dll, 'apply_vertex_logic_strided') if self.dll else False
@@ -363,43 +822,44 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             use_cpp = False
 
         if use_cpp:
-            # TIMER START: PREP
-            t0 = time.perf_counter()
-            
             # Prepare Common Data
             base_factor = self.strength * 0.5 # For Blur (Legacy)
             
-            # Prepare Lists
-            # Max possible size = len(found) * 2
-            max_targets = len(found) * 2
-            target_indices = (ctypes.c_int * max_targets)()
+            if self.c_grid:
+                # Query already wrote the target arrays (factors unused by Blur)
+                target_indices = self.c_query_indices
+                target_factors = self.c_query_factors
+                count = num_found
+            else:
+                # Prepare Lists
+                # Max possible size = len(found) * 2
+                max_targets = len(found) * 2
+                target_indices = (ctypes.c_int * max_targets)()
             
-            # For Paint/Harden we need factors
-            if not self.is_blur:
-               target_factors = (ctypes.c_float * max_targets)()
+                # For Paint/Harden we need factors
+                if not self.is_blur:
+                   target_factors = (ctypes.c_float * max_targets)()
             
-            count = 0
+                count = 0
             
-            # Pre-calc for Factors
-            radius_sq = self.world_radius * self.world_radius
-            inv_radius_sq = 1.0 / radius_sq if radius_sq > 0 else 0
-            strength_factor = self.strength
+                # Pre-calc for Factors
+                radius_sq = self.world_radius * self.world_radius
+                inv_radius_sq = 1.0 / radius_sq if radius_sq > 0 else 0
+                strength_factor = self.strength
             
-            for (co, index, dist) in found:
-                # Factor Calc
-                dist_sq = dist * dist
-                falloff = 1.0 - (dist_sq * inv_radius_sq)
-                if falloff <= 0: continue
+                for (co, index, dist) in found:
+                    # Factor Calc
+                    dist_sq = dist * dist
+                    falloff = 1.0 - (dist_sq * inv_radius_sq)
+                    if falloff <= 0: continue
                 
-                current_factor = strength_factor * falloff
-                
-                # Add Primary
-                target_indices[count] = index
-                if not self.is_blur: target_factors[count] = current_factor
-                count += 1
+                    current_factor = strength_factor * falloff
                 
+                    # Add Primary
+                    target_indices[count] = index
+                    if not self.is_blur: target_factors[count] = current_factor
+                    count += 1
 
-            
             if count == 0: return
 
             # TIMER START: CALC
@@ -407,86 +867,152 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             t_prep = (t1 - t0) * 1000.0
 
             # Dispatch
+            # Tracked kernels report the vertices that actually changed -> Apply only touches those
+            tracked = self.has_tracked
+            if tracked:
+                self.ensure_delta_buffers(count)
+            dirty_count = count
+
             if self.is_blur:
-                 self.dll.smooth_strided(
-                    self.c_adj_starts, self.c_adj_indices, self.c_adj_weights,
-                    self.c_weight_indices, self.c_weight_values,
-                    target_indices, count, base_factor
-                )
+                if self.c_pool and tracked:
+                    # Jacobi (Snapshot) -> Order independent, split across cores
+                    dirty_count = self.dll.smooth_strided_jacobi_tracked(
+                        self.c_pool,
+                        self.c_adj_starts, self.c_adj_indices, self.c_adj_weights,
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, count, base_factor,
+                        *self.delta_args()
+                    )
+                elif self.c_pool:
+                    self.dll.smooth_strided_jacobi(
+                        self.c_pool,
+                        self.c_adj_starts, self.c_adj_indices, self.c_adj_weights,
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, count, base_factor
+                    )
+                elif tracked:
+                    dirty_count = self.dll.smooth_strided_tracked(
+                        self.c_adj_starts, self.c_adj_indices, self.c_adj_weights,
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, count, base_factor,
+                        *self.delta_args()
+                    )
+                else:
+                    self.dll.smooth_strided(
+                        self.c_adj_starts, self.c_adj_indices, self.c_adj_weights,
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, count, base_factor
+                    )
             else:
                  # Paint (0) or Harden (1)
                  mode = 1 if self.is_harden else 0
                  
                  smear_val = -1.0
-                 if mode == 0 and self.prev_cursor_loc:
+                 sampled = (mode == 0 and self.prev_cursor_loc and tracked and self.c_grid
+                            and getattr(self, 'c_world_coords', None) is not None
+                            and hasattr(self.dll, 'smear_strided_sampled'))
+                 if mode == 0 and self.prev_cursor_loc and not sampled:
                       smear_val = self.get_source_weight(obj, self.prev_cursor_loc, idx_active, method='NEAREST')
                  
-                 self.dll.apply_vertex_logic_strided(
-                    self.c_weight_indices, self.c_weight_values,
-                    target_indices, target_factors,
-                    count, idx_active, mode, smear_val
-                 )
+                 if sampled:
+                     # Per-vertex: each target pulls every group from under (itself - stroke delta)
+                     offset = (ctypes.c_float * 3)(*[self.cursor_loc[a] - self.prev_cursor_loc[a] for a in range(3)])
+                     dirty_count = self.dll.smear_strided_sampled(
+                        self.c_pool, self.c_grid, len(vertices), self.c_world_coords,
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, target_factors, count, offset,
+                        *self.delta_args()
+                     )
+                 elif tracked:
+                     dirty_count = self.dll.apply_vertex_logic_strided_tracked(
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, target_factors,
+                        count, idx_active, mode, smear_val,
+                        *self.delta_args()
+                     )
+                 else:
+                     self.dll.apply_vertex_logic_strided(
+                        self.c_weight_indices, self.c_weight_values,
+                        target_indices, target_factors,
+                        count, idx_active, mode, smear_val
+                     )
             
             # TIMER START: APPLY
             t2 = time.perf_counter()
             t_calc = (t2 - t1) * 1000.0
 
+            # Journal the pre-stroke state of the changed vertices (first touch only)
+            if tracked and self.c_undo and dirty_count > 0:
+                self.dll.undo_record(
+                    self.c_undo, self.c_delta_verts,
+                    self.c_delta_before_indices, self.c_delta_before_values, dirty_count
+                )
+
             # 3. Apply Back to Blender (Optimized)
             stride = self.c_stride
-            ptr_indices = self.c_weight_indices
-            ptr_values = self.c_weight_values
             
-            for i in range(count):
-                v_idx = target_indices[i]
-                v = vertices[v_idx]
+            # Fast: C++ diff -> only changed triples, batched per group
+            if tracked and dirty_count == 0:
+                pass # Nothing changed (e.g. already hard / fully smoothed)
+            elif tracked and self.c_base_indices is not None:
+                self.apply_weight_diff(obj, self.c_delta_verts, dirty_count)
+            elif self.c_base_indices is not None:
+                self.apply_weight_diff(obj, target_indices, count)
+            else:
+                # Views: one slice per vertex instead of 2 * stride ctypes lookups
+                ptr_indices = wynn_core.buffer_view(self.c_weight_indices)
+                ptr_values = wynn_core.buffer_view(self.c_weight_values)
+                for v_idx in wynn_core.buffer_view(target_indices)[:count].tolist():
+                    v = vertices[v_idx]
                 
-                base = v_idx * stride
+                    base = v_idx * stride
                 
-                # Build Map of Desired State
-                new_map = {}
-                for k in range(stride):
-                    g_idx = ptr_indices[base + k]
-                    if g_idx < 0: continue 
-                    val = ptr_values[base + k]
-                    if val > 0.0001: new_map[g_idx] = val
+                    # Build Map of Desired State
+                    new_map = {}
+                    for g_idx, val in zip(ptr_indices[base:base + stride].tolist(), ptr_values[base:base + stride].tolist()):
+                        if g_idx < 0: continue 
+                        if val > 0.0001: new_map[g_idx] = val
                 
-                # Single Pass Update: Iterate existing groups once
-                to_remove = []
+                    # Single Pass Update: Iterate existing groups once
+                    to_remove = []
                 
-                # Update existing & Mark for removal
-                for g in v.groups:
-                    g_id = g.group
-                    if g_id in new_map:
-                        # Update in-place (Fastest)
-                        w = new_map[g_id]
-                        if abs(g.weight - w) > 0.00001:
-                            g.weight = w
-                        # Remove from map so we know it's handled
-                        del new_map[g_id]
-                    else:
-                        # Existing group not in new set -> Remove
-                        to_remove.append(g_id)
+                    # Update existing & Mark for removal
+                    for g in v.groups:
+                        g_id = g.group
+                        if g_id in new_map:
+                            # Update in-place (Fastest)
+                            w = new_map[g_id]
+                            if abs(g.weight - w) > 0.00001:
+                                g.weight = w
+                            # Remove from map so we know it's handled
+                            del new_map[g_id]
+                        else:
+                            # Existing group not in new set -> Remove
+                            to_remove.append(g_id)
                 
-                # Exec Removals
-                for g_id in to_remove:
-                    try: vertex_groups[g_id].remove([v_idx])
-                    except RuntimeError: pass
+                    # Exec Removals
+                    for g_id in to_remove:
+                        try: vertex_groups[g_id].remove([v_idx])
+                        except RuntimeError: pass
                 
-                # Exec Adds (Remaining items in new_map are new groups)
-                for g_id, val in new_map.items():
-                    try: vertex_groups[g_id].add([v_idx], val, 'REPLACE')
-                    except RuntimeError: pass
+                    # Exec Adds (Remaining items in new_map are new groups)
+                    for g_id, val in new_map.items():
+                        try: vertex_groups[g_id].add([v_idx], val, 'REPLACE')
+                        except RuntimeError: pass
             
-            obj.data.update()
+            if dirty_count > 0:
+                obj.data.update()
             
             t3 = time.perf_counter()
             t_apply = (t3 - t2) * 1000.0
             
-            print(f"[Core: C++] Prep: {t_prep:.2f}ms | Calc: {t_calc:.2f}ms | Apply: {t_apply:.2f}ms | Total: {(t_prep+t_calc+t_apply):.2f}ms")
+            if self.debug_mode:
+                print(f"[Core: C++] Prep: {t_prep:.2f}ms | Calc: {t_calc:.2f}ms | Apply: {t_apply:.2f}ms ({dirty_count}/{count} dirty) | Total: {(t_prep+t_calc+t_apply):.2f}ms")
             return
 
         # --- FALLBACK PYTHON ---
-        print("[Core: Python] Fallback Used")
+        if self.debug_mode:
+            print("[Core: Python] Fallback Used")
         did_update = False
         
         # Pre-calc constants
@@ -532,6 +1058,21 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
         # Optimization: Transform entire mesh to world space in C (much faster than Python loop)
         temp_mesh.transform(eval_obj.matrix_world)
 
+        if self.c_grid:
+            # Native: one bulk copy of the coords, grid built on the pool
+            num_verts = len(temp_mesh.vertices)
+            self.c_world_coords = (ctypes.c_float * (num_verts * 3))()
+            temp_mesh.vertices.foreach_get("co", self.c_world_coords)
+            self.dll.spatial_build(self.c_grid, self.c_pool, num_verts, self.c_world_coords)
+            if self.c_session:
+                self.dll.session_set_coords(self.c_session, num_verts, self.c_world_coords)
+            if getattr(self, 'c_query_capacity', 0) != num_verts:
+                self.c_query_indices = (ctypes.c_int * num_verts)()
+                self.c_query_factors = (ctypes.c_float * num_verts)()
+                self.c_query_capacity = num_verts
+            eval_obj.to_mesh_clear()
+            return True
+
         self.kd_visual = KDTree(len(temp_mesh.vertices))
         self.cached_coords = [None] * len(temp_mesh.vertices)
         kd_insert = self.kd_visual.insert
@@ -555,6 +1096,21 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
         loc_shifted = view3d_utils.region_2d_to_location_3d(region, rv3d, coord_2d_shifted, location_3d)
         return (loc_shifted - location_3d).length
 
+    def undo_depth(self):
+        if self.c_undo:
+            return self.dll.undo_count(self.c_undo)
+        return len(self.undo_stack)
+
+    def begin_undo_step(self, obj):
+        if self.c_undo:
+            self.dll.undo_begin_stroke(self.c_undo)
+        else:
+            self.save_undo_snapshot(obj)
+
+    def end_undo_step(self):
+        if self.c_undo:
+            self.dll.undo_end_stroke(self.c_undo)
+
     def save_undo_snapshot(self, obj):
         idx_active = obj.vertex_groups.active_index
         if idx_active == -1: return
@@ -585,6 +1141,26 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             self.undo_stack.pop(0)
 
     def perform_undo(self, obj):
+        if self.c_session:
+            self.flush_session(obj) # Blender must match the session before restoring
+
+        if self.c_undo:
+            # Native: restore the strided buffers, then write back only the restored vertices
+            count = self.dll.undo_peek_size(self.c_undo)
+            if count == 0:
+                self.show_message("Undo Stack Empty!")
+                return
+            restored = (ctypes.c_int * count)()
+            if self.c_session:
+                count = self.dll.session_undo_pop(self.c_session, restored)
+                self.apply_session_diff(obj, restored, count)
+            else:
+                count = self.dll.undo_pop(self.c_undo, self.c_weight_indices, self.c_weight_values, restored)
+                self.apply_weight_diff(obj, restored, count)
+            obj.data.update()
+            self.show_message("Undo!")
+            return
+
         if not self.undo_stack:
             self.show_message("Undo Stack Empty!")
             return
@@ -602,6 +1178,10 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
                         group.remove([v_idx])
                     except RuntimeError: pass 
         obj.data.update()
+        
+        # Keep the C++ buffers in sync with what Blender holds now
+        if self.dll:
+            self.populate_strided_weights(obj)
 
     def show_message(self, text):
         self.message_text = text
@@ -631,6 +1211,16 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             self.perform_undo(context.active_object)
             return {'RUNNING_MODAL'}
 
+        # Toggle X-Mirror
+        if event.type == 'X' and event.value == 'PRESS' and not self.painting:
+            self.use_mirror = not self.use_mirror
+            self.sync_mirror(self.mesh_object)
+            if not self.c_session:
+                self.show_message("Mirror needs the updated core DLL")
+            else:
+                self.show_message(f"Mirror X: {'ON' if self.use_mirror else 'OFF'}")
+            return {'RUNNING_MODAL'}
+
         # Toggle Overlays (Shift + Alt + Z)
         if event.type == 'Z' and event.value == 'PRESS' and event.shift and event.alt:
             context.space_data.overlay.show_overlays = not context.space_data.overlay.show_overlays
@@ -687,20 +1277,28 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
                     return {'PASS_THROUGH'}
 
                 self.refresh_geometry(context, self.mesh_object)
-                self.save_undo_snapshot(self.mesh_object)
+                self.begin_undo_step(self.mesh_object)
+                if self.c_session:
+                    self.dll.brush_stroke_begin(self.c_session)
                 self.painting = True
                 self.prev_cursor_loc = self.cursor_loc
             elif event.value == 'RELEASE':
                 self.painting = False
+                if self.c_session:
+                    self.flush_session(self.mesh_object)
+                self.end_undo_step()
         
         if event.type == 'RIGHTMOUSE' and event.value == 'PRESS':
             bpy.ops.wm.call_menu(name="WYNN_MT_brush_context_menu")
             return {'RUNNING_MODAL'}
         
         if event.type == 'ESC':
+            if self.c_session:
+                self.flush_session(self.mesh_object)
             bpy.types.SpaceView3D.draw_handler_remove(self._handle_3d, 'WINDOW')
             bpy.types.SpaceView3D.draw_handler_remove(self._handle_2d, 'WINDOW')
             context.area.header_text_set(None)
+            self.release_core()
             return {'FINISHED'}
 
         if self.painting:
@@ -743,10 +1341,23 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             self.cursor_loc = None
 
 
+    def query_brush(self, location, radius, strength, falloff_mode=0):
+        """Native range query -> count (results in c_query_indices / c_query_factors)."""
+        center = (ctypes.c_float * 3)(location[0], location[1], location[2])
+        return self.dll.query_brush(
+            self.c_grid, center, radius, falloff_mode, strength,
+            self.c_query_indices, self.c_query_factors, self.c_query_capacity
+        )
+
     def get_source_weight(self, obj, location, group_idx, method='NEAREST'):
         if not location: return -1.0
         if method == 'NEAREST':
-            co, index, dist = self.kd_visual.find(location)
+            if self.c_grid:
+                center = (ctypes.c_float * 3)(location[0], location[1], location[2])
+                index = self.dll.find_nearest(self.c_grid, center, None)
+                if index < 0: return -1.0
+            else:
+                co, index, dist = self.kd_visual.find(location)
             v = obj.data.vertices[index]
             try:
                 for g in v.groups:
@@ -754,7 +1365,11 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
             except IndexError: pass
             return 0.0
         else: 
-            found = self.kd_visual.find_range(location, self.world_radius)
+            if self.c_grid:
+                num_found = self.query_brush(location, self.world_radius, 1.0, 3)
+                found = [(None, index, None) for index in self.c_query_indices[:num_found]]
+            else:
+                found = self.kd_visual.find_range(location, self.world_radius)
             if not found: return -1.0
             total = 0.0
             count = 0
@@ -860,7 +1475,7 @@ class WYNN_OT_smear_perf_monitor(bpy.types.Operator):
                 vertex_groups[g_idx].remove([vertex.index])
                 
     def update_header(self, context):
-        context.area.header_text_set(f"F: Size | Shift+F: Strength | D: Debug | Undo: {len(self.undo_stack)} | Perf: {self.last_compute_time:.2f}ms")
+        context.area.header_text_set(f"F: Size | Shift+F: Strength | D: Debug | Undo: {self.undo_depth()} | Perf: {self.last_compute_time:.2f}ms")
 
 def register():
     bpy.types.Scene.wynn_brush_radius = bpy.props.IntProperty(name="Radius (Px)", default=50, min=1, max=1000)
@@ -868,6 +1483,7 @@ def register():
     bpy.utils.register_class(WYNN_MT_brush_context_menu)
     bpy.utils.register_class(WYNN_OT_smear_perf_monitor)
 def unregister():
+    wynn_core.free_all_cores()
     del bpy.types.Scene.wynn_brush_radius
     del bpy.types.Scene.wynn_brush_strength
     bpy.utils.unregister_class(WYNN_MT_brush_context_menu)
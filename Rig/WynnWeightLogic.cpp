@@ -1,7 +1,36 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
-#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <queue>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WYNN_SIMD_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define WYNN_SIMD_NEON 1
+#endif
+
+// OpenCL is opened at runtime (see GPU Whole-Mesh Smoothing), nothing to link
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 
 // Export macro for Windows DLL
 #ifdef _WIN32
@@ -10,386 +39,6582 @@
 #define EXPORT
 #endif
 
-extern "C" {
+struct VertexWeight {
+    int group_index;
+    float weight;
+};
+
+// Fixed stride for weight storage (Group Index, Weight Value)
+// We allow up to 8 weights per vertex in storage. Output is clamped to the
+// influence cap (kernels are instantiated for 1/2/4/8, see with_influence_cap).
+const int MAX_STORAGE = 8;
+const int MAX_INFLUENCE = 8;
+
+/**
+ * Fixed-size Top-K (Sort + Limit in one step)
+ * Keeps the K heaviest entries in descending order. On ties the earlier
+ * entry wins (same result as a stable sort + resize), no allocation.
+ * top_k_weights_if only considers the entries keep() accepts.
+ */
+template <int K, typename Pred>
+static int top_k_weights_if(const VertexWeight* in, int n, VertexWeight* out, Pred&& keep) {
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!keep(in[i])) continue;
+        float w = in[i].weight;
+        if (count == K && !(w > out[K - 1].weight)) continue;
+        int pos = (count < K) ? count++ : K - 1;
+        while (pos > 0 && w > out[pos - 1].weight) {
+            out[pos] = out[pos - 1];
+            --pos;
+        }
+        out[pos] = in[i];
+    }
+    return count;
+}
+
+template <int K>
+static int top_k_weights(const VertexWeight* in, int n, VertexWeight* out) {
+    return top_k_weights_if<K>(in, n, out, [](const VertexWeight&) { return true; });
+}
+
+/**
+ * Calls fn(std::integral_constant<int, K>) for the instantiated cap >= max_influence
+ * (1/2/4/8, anything above 8 -> 8). Used to pick the kernel per session.
+ */
+template <typename Fn>
+static void with_influence_cap(int max_influence, Fn&& fn) {
+    if (max_influence <= 1) fn(std::integral_constant<int, 1>());
+    else if (max_influence <= 2) fn(std::integral_constant<int, 2>());
+    else if (max_influence <= 4) fn(std::integral_constant<int, 4>());
+    else fn(std::integral_constant<int, MAX_INFLUENCE>());
+}
+
+/**
+ * Weight Storage Policies
+ *
+ * Kernels access slots only through a policy, so every layout shares one
+ * implementation. Slot index = vertex * MAX_STORAGE + k in both layouts;
+ * kernels always work on decoded int group / float weight scratch.
+ *
+ * StridedStorage: int group (-1 = empty) + float weight, 8 bytes per slot
+ * (the layout the Python side reads and writes).
+ * QuantizedStorage: uint16 group (0xFFFF = empty) + uint16 unorm weight,
+ * 4 bytes per slot -> half the bandwidth per dab. Groups < 65535, weights
+ * in 1/65535 steps.
+ */
+struct StridedStorage {
+    int* indices;
+    float* values;
+
+    int group(size_t slot) const { return indices[slot]; }
+    float weight(size_t slot) const { return values[slot]; }
+
+    void load(size_t base, int* g, float* w) const {
+        std::copy(indices + base, indices + base + MAX_STORAGE, g);
+        std::copy(values + base, values + base + MAX_STORAGE, w);
+    }
+    void store(size_t base, const int* g, const float* w) const {
+        std::copy(g, g + MAX_STORAGE, indices + base);
+        std::copy(w, w + MAX_STORAGE, values + base);
+    }
+    // What store + load hands back (lossless here)
+    static void round_trip(int*, float*) {}
+};
+
+struct QuantizedStorage {
+    uint16_t* indices;
+    uint16_t* values;
+
+    static const uint16_t EMPTY = 0xFFFF;
+
+    static uint16_t encode_group(int g) { return (g < 0 || g >= EMPTY) ? EMPTY : (uint16_t)g; }
+    static int decode_group(uint16_t q) { return q == EMPTY ? -1 : (int)q; }
+    static uint16_t encode_weight(float w) {
+        w = std::min(std::max(w, 0.0f), 1.0f);
+        return (uint16_t)(w * 65535.0f + 0.5f);
+    }
+    static float decode_weight(uint16_t q) { return q * (1.0f / 65535.0f); }
+
+    int group(size_t slot) const { return decode_group(indices[slot]); }
+    float weight(size_t slot) const { return decode_weight(values[slot]); }
+
+    void load(size_t base, int* g, float* w) const {
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            g[k] = decode_group(indices[base + k]);
+            w[k] = decode_weight(values[base + k]);
+        }
+    }
+    void store(size_t base, const int* g, const float* w) const {
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            bool empty = g[k] < 0 || g[k] >= EMPTY;
+            indices[base + k] = empty ? EMPTY : (uint16_t)g[k];
+            values[base + k] = empty ? 0 : encode_weight(w[k]);
+        }
+    }
+    static void round_trip(int* g, float* w) {
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || g[k] >= EMPTY) { g[k] = -1; w[k] = 0.0f; }
+            else w[k] = decode_weight(encode_weight(w[k]));
+        }
+    }
+};
 
-    struct VertexWeight {
-        int group_index;
-        float weight;
+/**
+ * Group Accumulator (Scratch)
+ *
+ * Replaces the per-vertex std::map<int, float>.
+ * Dense arrays indexed by group index that live for a whole kernel call.
+ * A vertex "touches" a group by stamping it, so resetting between vertices
+ * is just bumping the stamp + clearing the touched list (no memset, no malloc).
+ * Arrays only grow when a higher group index shows up.
+ */
+struct GroupAccumulator {
+    struct Slot {
+        float sum;
+        int stamp;      // == current_stamp once touched by a neighbour
+        float self_w;
+        int self_stamp; // == current_stamp if the vertex itself has this group
     };
+    std::vector<Slot> slots;
+    std::vector<int> touched;          // Groups touched by the current vertex
+    std::vector<VertexWeight> blended; // Reused output list for the current vertex
+    int current_stamp = 0;
 
-    bool compareWeights(const VertexWeight& a, const VertexWeight& b) {
-        return a.weight > b.weight;
+    GroupAccumulator() {
+        touched.reserve(64);
+        blended.reserve(64);
     }
 
-    // Fixed stride for weight storage (Group Index, Weight Value)
-    // We allow up to 8 weights per vertex in storage, but clamp to 4 for output.
-    const int MAX_STORAGE = 8;
-    const int MAX_INFLUENCE = 8;
+    void begin() {
+        touched.clear();
+        if (++current_stamp == 0x7FFFFFFF) {
+            for (auto& sl : slots) sl.stamp = sl.self_stamp = 0;
+            current_stamp = 1;
+        }
+    }
 
-    /**
-     * Optimized Smoothing with Strided Data and In-Place Updates
-     * 
-     * Pointers:
-     * - adj_starts/indices/weights: Standard CSR graph (Read Only)
-     * 
-     * - weight_indices: [num_verts * MAX_STORAGE] (Read/Write)
-     * - weight_values:  [num_verts * MAX_STORAGE] (Read/Write)
-     * 
-     * - target_indices: Vertices to process
-     * - num_targets: Count
-     * - factor: usage varies (0.0 - 1.0)
-     */
-    EXPORT void smooth_strided(
-        const int* adj_starts,
-        const int* adj_indices,
-        const float* adj_weights,
-        
-        int* weight_indices,
-        float* weight_values,
-        
-        const int* target_indices,
-        int num_targets,
-        float factor
-    ) {
-        float inv_factor = 1.0f - factor;
+    Slot& slot(int g) {
+        if (g >= (int)slots.size()) slots.resize(g + 1, Slot{0.0f, 0, 0.0f, 0});
+        return slots[g];
+    }
 
-        // We need a temp buffer for the NEW weights to avoid reading partially updated state?
-        // Actually, pure smoothing usually wants snapshot state. 
-        // If we write back immediately, the next vertex might read the SMOOTHED value of its neighbor.
-        // This is "Seidel" iteration vs "Jacobi". 
-        // Seidel (immediate write) converges faster but is order-dependent.
-        // Jacobi (buffer write) is stable.
-        // Visual brushes usually prefer Seidel (smearing feel).
-        // BUT strict correctness suggests Jacobi. 
-        // Given we process a "Subset" (Brush Radius), order dependence is minimal visually.
-        // To be safe and maximize speed optimization (avoid allocs), we will try Immediate Write first.
-        
-        // HOWEVER: If we write fewer weights than existed, we must ensure we clean up.
+    void add(int g, float w) {
+        Slot& sl = slot(g);
+        if (sl.stamp != current_stamp) {
+            sl.stamp = current_stamp;
+            sl.sum = 0.0f;
+            touched.push_back(g);
+        }
+        sl.sum += w;
+    }
 
-        for (int t = 0; t < num_targets; ++t) {
-            int v_idx = target_indices[t];
-            
-            // Map: GroupIndex -> WeightedSum
-            // Using a small local buffer/vector is faster than std::map for <10 items
-            // But map is easiest to write. Optimization: Use stack vector.
-            std::map<int, float> accum_weights;
-
-            // 1. Accumulate Neighbors
-            int n_start = adj_starts[v_idx];
-            int n_end = adj_starts[v_idx + 1];
-            
-            float total_edge_w = 0.0f;
-
-            for (int i = n_start; i < n_end; ++i) {
-                int n_idx = adj_indices[i];
-                float edge_w = adj_weights[i];
-                total_edge_w += edge_w;
-
-                // Read neighbor weights from Strided Array
-                int base = n_idx * MAX_STORAGE;
-                for (int k = 0; k < MAX_STORAGE; ++k) {
-                    int g = weight_indices[base + k];
-                    float w = weight_values[base + k];
-                    if (g < 0 || w <= 0.0f) continue; // Empty slot
-                    
-                    accum_weights[g] += (w * edge_w);
-                }
+    // First slot wins (same as the linear "find current weight" scan)
+    void set_self(int g, float w) {
+        Slot& sl = slot(g);
+        if (sl.self_stamp != current_stamp) {
+            sl.self_stamp = current_stamp;
+            sl.self_w = w;
+        }
+    }
+
+    float self_weight(int g) const {
+        const Slot& sl = slots[g];
+        return (sl.self_stamp == current_stamp) ? sl.self_w : 0.0f;
+    }
+
+    bool contains(int g) const {
+        return g < (int)slots.size() && slots[g].stamp == current_stamp;
+    }
+
+    // std::map iterated groups in ascending order. Keep that order so the
+    // blended list (and therefore the sort result) is identical.
+    void sort_touched() {
+        for (size_t i = 1; i < touched.size(); ++i) {
+            int g = touched[i];
+            size_t j = i;
+            while (j > 0 && touched[j - 1] > g) {
+                touched[j] = touched[j - 1];
+                --j;
             }
+            touched[j] = g;
+        }
+    }
+};
 
-            // 2. Blend
-            std::vector<VertexWeight> blended_weights;
-            
-            int v_base = v_idx * MAX_STORAGE;
+/**
+ * Per-Group Flags (optional, NULL = every group deforms, none locked)
+ *
+ * One byte per vertex group index, bits GROUP_*:
+ * - DEFORM: normalized against the other deform groups (BONE_DEFORM) and
+ *   subject to the influence cap. Others keep whatever the kernel computes.
+ * - LOCKED: weight stays as stored (Blender's lock_weight). Locked deform
+ *   groups still use up part of the 1.0 total and of the cap.
+ * - EXCLUDED: stays as stored and takes no part in normalization at all.
+ * Groups at or past num_groups count as plain deform groups.
+ */
+const unsigned char GROUP_DEFORM = 1;
+const unsigned char GROUP_LOCKED = 2;
+const unsigned char GROUP_EXCLUDED = 4;
 
-            if (total_edge_w > 0.00001f) {
-                float inv_total_edge = 1.0f / total_edge_w;
+struct GroupFlags {
+    const unsigned char* flags;
+    int num_groups;
 
-                // Accumulate current vertex weights into the map logic or separate?
-                // Logic: New = Current*InvF + Avg*F
-                
-                // Get all potential groups (Neighbors + Self)
-                // We iterate the map (Neighbors)
-                for (auto& [g_idx, w_sum] : accum_weights) {
-                    float avg_w = w_sum * inv_total_edge;
-                    
-                    // Find current weight in self
-                    float cur_w = 0.0f;
-                    for (int k = 0; k < MAX_STORAGE; ++k) {
-                        if (weight_indices[v_base + k] == g_idx) {
-                            cur_w = weight_values[v_base + k];
-                            break;
-                        }
-                    }
+    unsigned char get(int g) const { return (g >= 0 && g < num_groups) ? flags[g] : GROUP_DEFORM; }
+    // Kernel must keep the stored weight
+    bool pinned(int g) const { return (get(g) & (GROUP_LOCKED | GROUP_EXCLUDED)) != 0; }
+    // Counts toward the normalized deform total
+    bool normalized(int g) const { return (get(g) & (GROUP_DEFORM | GROUP_EXCLUDED)) == GROUP_DEFORM; }
+    // Free deform group (what normalization may rescale)
+    bool free_deform(int g) const { return (get(g) & (GROUP_DEFORM | GROUP_LOCKED | GROUP_EXCLUDED)) == GROUP_DEFORM; }
+};
 
-                    float new_w = (cur_w * inv_factor) + (avg_w * factor);
-                    if (new_w > 0.0001f) {
-                        blended_weights.push_back({g_idx, new_w});
-                    }
-                }
-                
-                // Add Self-Only groups (not in neighbors)
-                for (int k = 0; k < MAX_STORAGE; ++k) {
-                    int g = weight_indices[v_base + k];
-                    float w = weight_values[v_base + k];
-                    if (g < 0 || w <= 0.0f) continue;
-                     
-                    if (accum_weights.find(g) == accum_weights.end()) {
-                        float new_w = w * inv_factor;
-                        if (new_w > 0.0001f) {
-                            blended_weights.push_back({g, new_w});
-                        }
-                    }
-                }
+/**
+ * Limit + normalize the new weights of one vertex into out_groups/out_weights
+ * (sorted by weight, padded with -1/0.0 up to MAX_STORAGE).
+ *
+ * flags NULL: the MaxInfluence heaviest entries of `list`, normalized to 1.
+ * flags set: pinned groups keep their stored slot (self_groups/self_weights,
+ * `list` entries for them are ignored). Free deform groups share what the
+ * locked deform groups leave of 1.0 and of the cap; other groups pass
+ * through unnormalized. If more than MAX_STORAGE survive, pinned slots win,
+ * then deform, then the heaviest others.
+ */
+template <int MaxInfluence>
+static void finalize_vertex_weights(
+    const VertexWeight* list,
+    int n,
+    const int* self_groups,
+    const float* self_weights,
+    const GroupFlags* flags,
+    int* out_groups,
+    float* out_weights
+) {
+    int count = 0;
+    if (!flags) {
+        VertexWeight kept[MaxInfluence];
+        int num_kept = top_k_weights<MaxInfluence>(list, n, kept);
 
-            } else {
-                 // No neighbors? Keep as is.
-                 continue; 
+        float total = 0.0f;
+        for (int i = 0; i < num_kept; ++i) total += kept[i].weight;
+        if (total > 0.00001f) {
+            float ratio = 1.0f / total;
+            for (int i = 0; i < num_kept; ++i) {
+                out_groups[count] = kept[i].group_index;
+                out_weights[count] = kept[i].weight * ratio;
+                count++;
             }
+        }
+        for (int k = count; k < MAX_STORAGE; ++k) {
+            out_groups[k] = -1;
+            out_weights[k] = 0.0f;
+        }
+        return;
+    }
 
-            // 3. Limit & Sort
-            std::sort(blended_weights.begin(), blended_weights.end(), compareWeights);
-            
-            if (blended_weights.size() > MAX_INFLUENCE) {
-                blended_weights.resize(MAX_INFLUENCE);
-            }
+    VertexWeight merged[MAX_STORAGE * 3];
+    int num_merged = 0;
+
+    // 1. Pinned slots as stored
+    float locked_total = 0.0f;
+    int locked_slots = 0;
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        int g = self_groups[k];
+        if (g < 0 || self_weights[k] <= 0.0f || !flags->pinned(g)) continue;
+        merged[num_merged++] = {g, self_weights[k]};
+        if (flags->normalized(g)) {
+            locked_total += self_weights[k];
+            locked_slots++;
+        }
+    }
 
-            // Normalize
-            float total_final = 0.0f;
-            for (const auto& vw : blended_weights) total_final += vw.weight;
+    // 2. Free deform groups: limit to the slots left, fill what is left of 1.0
+    VertexWeight deform[MaxInfluence] = {};
+    int num_deform = top_k_weights_if<MaxInfluence>(list, n, deform,
+        [&](const VertexWeight& e) { return flags->free_deform(e.group_index); });
+    num_deform = std::min(num_deform, std::max(0, MaxInfluence - locked_slots));
 
-            // 4. Write Back to Strided Array
-            // Clear current slots first (or just overwrite)
-            // We overwrite and set remainder to -1/0.0
-            
-            if (total_final > 0.00001f) {
-                float ratio = 1.0f / total_final;
-                int count = 0;
-                for (const auto& vw : blended_weights) {
-                    weight_indices[v_base + count] = vw.group_index;
-                    weight_values[v_base + count] = vw.weight * ratio;
-                    count++;
-                }
-                // Zero out remaining slots
-                for (int k = count; k < MAX_STORAGE; ++k) {
-                    weight_indices[v_base + k] = -1;
-                    weight_values[v_base + k] = 0.0f;
-                }
-            } else {
-                // Zero all
-                for (int k = 0; k < MAX_STORAGE; ++k) {
-                     weight_indices[v_base + k] = -1;
-                     weight_values[v_base + k] = 0.0f;
-                }
-            }
+    float deform_total = 0.0f;
+    for (int i = 0; i < num_deform; ++i) deform_total += deform[i].weight;
+    if (deform_total > 0.00001f) {
+        float ratio = std::max(0.0f, 1.0f - locked_total) / deform_total;
+        for (int i = 0; i < num_deform; ++i) {
+            float w = deform[i].weight * ratio;
+            if (w > 0.0f) merged[num_merged++] = {deform[i].group_index, w};
         }
     }
-    /**
-     * Optimized Vertex Logic (Smear / Harden)
-     * Does NOT use Adjacency (Vertex independent)
-     * 
-     * target_factors: Per-vertex factor (strength * falloff)
-     */
-    EXPORT void apply_vertex_logic_strided(
-        int* weight_indices,
-        float* weight_values,
-        const int* target_indices,
-        const float* target_factors,
-        int num_targets,
-        int active_group_index,
-        int mode, // 0=Smear, 1=Harden
-        float smear_value
-    ) {
-        for (int t = 0; t < num_targets; ++t) {
-            int v_idx = target_indices[t];
-            float factor = target_factors[t];
-            int v_base = v_idx * MAX_STORAGE;
-            
-            // 1. Read Current Weights
-            VertexWeight weights[MAX_STORAGE];
-            int count = 0;
-            float cur_w = 0.0f;
-            
-            // For Harden Mode (1), track the dominant influence
-            int best_idx = -1;
-            float best_w = -1.0f;
 
-            for(int k=0; k<MAX_STORAGE; ++k) {
-                int g = weight_indices[v_base + k];
-                float w = weight_values[v_base + k];
-                if (g >= 0 && w > 0.0f) {
-                    weights[count] = {g, w};
-                    
-                    if (g == active_group_index) {
-                         cur_w = w;
-                    }
-                    // Track max for Harden
-                    if (w > best_w) {
-                        best_w = w;
-                        best_idx = count; 
-                    }
-                    count++;
-                }
-            }
-            
-            // 2. Compute New Weight
-            float new_w = cur_w;
-            int target_group = active_group_index; // Default to active
-
-            if (mode == 0) { // Smear
-                 // If smear_value is -1, usually we do nothing, but Python handles that check.
-                 // checking here just in case.
-                 if (smear_value >= 0.0f) {
-                     new_w = cur_w + (smear_value - cur_w) * factor;
-                 }
-            } else if (mode == 1) { // Harden (Push Dominant to 1.0)
-                // Identify dominant
-                if (best_idx >= 0) {
-                    target_group = weights[best_idx].group_index;
-                    float dom_w = weights[best_idx].weight;
-                    
-                    // Logic: Push towards 1.0
-                    // new = dom + (1.0 - dom) * factor
-                    // or linear add?
-                    // User: "60% -> 70%". If factor is "strength", let's assume factor is approx 0.1-0.5 range.
-                    // Lerp approach is safer (no overshoot).
-                    new_w = dom_w + (1.0f - dom_w) * factor;
-                }
-            }
-            
-            if (active_group_index == target_group && std::abs(new_w - cur_w) < 0.0001f) continue;
-            // For harden, target_group might not be active_group_index.
-            // But we check change against the target's old weight.
-            if (mode == 1 && best_idx >= 0) {
-                 if (std::abs(new_w - weights[best_idx].weight) < 0.0001f) continue;
-            }
-
-            // 3. Update Buffer
-            bool found = false;
-            for(int k=0; k<count; ++k) {
-                if (weights[k].group_index == target_group) {
-                    weights[k].weight = new_w;
-                    found = true;
-                    break;
-                }
+    // 3. Non-deform groups unnormalized
+    num_merged += top_k_weights_if<MAX_STORAGE>(list, n, merged + num_merged,
+        [&](const VertexWeight& e) { return !flags->pinned(e.group_index) && !flags->normalized(e.group_index); });
+
+    // 4. Keep the first MAX_STORAGE by priority, store sorted by weight (stable)
+    num_merged = std::min(num_merged, MAX_STORAGE);
+    for (int i = 1; i < num_merged; ++i) {
+        VertexWeight e = merged[i];
+        int j = i;
+        while (j > 0 && e.weight > merged[j - 1].weight) {
+            merged[j] = merged[j - 1];
+            --j;
+        }
+        merged[j] = e;
+    }
+    for (; count < num_merged; ++count) {
+        out_groups[count] = merged[count].group_index;
+        out_weights[count] = merged[count].weight;
+    }
+    for (int k = count; k < MAX_STORAGE; ++k) {
+        out_groups[k] = -1;
+        out_weights[k] = 0.0f;
+    }
+}
+
+/**
+ * Smooth a single vertex (all groups) into out_groups/out_weights.
+ *
+ * Reads neighbours + self from src_indices/src_values (strided).
+ * Returns false if the vertex has no neighbours (caller keeps it as is).
+ * Output is sorted by weight, limited to MaxInfluence, normalized and
+ * padded with -1/0.0 up to MAX_STORAGE (see finalize_vertex_weights for flags).
+ */
+template <typename Storage, int MaxInfluence = MAX_INFLUENCE>
+static bool smooth_vertex_strided(
+    const int* adj_starts,
+    const int* adj_indices,
+    const float* adj_weights,
+    const Storage& src,
+    int v_idx,
+    float factor,
+    GroupAccumulator& acc,
+    int* out_groups,
+    float* out_weights,
+    const GroupFlags* flags = nullptr
+) {
+    float inv_factor = 1.0f - factor;
+    acc.begin();
+
+    int v_base = v_idx * MAX_STORAGE;
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        int g = src.group(v_base + k);
+        if (g >= 0) acc.set_self(g, src.weight(v_base + k));
+    }
+
+    // 1. Accumulate Neighbors
+    int n_start = adj_starts[v_idx];
+    int n_end = adj_starts[v_idx + 1];
+
+    float total_edge_w = 0.0f;
+
+    for (int i = n_start; i < n_end; ++i) {
+        int n_idx = adj_indices[i];
+        float edge_w = adj_weights[i];
+        total_edge_w += edge_w;
+
+        // Read neighbor weights from Strided Array
+        int base = n_idx * MAX_STORAGE;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            int g = src.group(base + k);
+            float w = src.weight(base + k);
+            if (g < 0 || w <= 0.0f) continue; // Empty slot
+
+            acc.add(g, w * edge_w);
+        }
+    }
+
+    // No neighbors? Keep as is.
+    if (total_edge_w <= 0.00001f) return false;
+
+    // 2. Blend
+    // Logic: New = Current*InvF + Avg*F
+    std::vector<VertexWeight>& blended_weights = acc.blended;
+    blended_weights.clear();
+
+    float inv_total_edge = 1.0f / total_edge_w;
+
+    acc.sort_touched();
+    for (int g_idx : acc.touched) {
+        float avg_w = acc.slots[g_idx].sum * inv_total_edge;
+
+        // Current weight in self
+        float cur_w = acc.self_weight(g_idx);
+
+        float new_w = (cur_w * inv_factor) + (avg_w * factor);
+        if (new_w > 0.0001f) {
+            blended_weights.push_back({g_idx, new_w});
+        }
+    }
+
+    // Add Self-Only groups (not in neighbors)
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        int g = src.group(v_base + k);
+        float w = src.weight(v_base + k);
+        if (g < 0 || w <= 0.0f) continue;
+
+        if (!acc.contains(g)) {
+            float new_w = w * inv_factor;
+            if (new_w > 0.0001f) {
+                blended_weights.push_back({g, new_w});
             }
-            if (!found && new_w > 0.0001f) {
-                if (count < MAX_STORAGE) {
-                    weights[count++] = {target_group, new_w};
-                } else {
-                     // Replace smallest if new_w is significant?
-                     // Simplest: Replace index 0?
-                     // Implementation: Sort by weight ascending and replace first if smaller?
-                     // For now, if full, we skip adding (rare case for >8 groups).
-                }
+        }
+    }
+
+    // 3. Limit & Sort & Normalize (remainder set to -1/0.0)
+    int self_groups[MAX_STORAGE];
+    float self_weights[MAX_STORAGE];
+    if (flags) src.load(v_base, self_groups, self_weights);
+    finalize_vertex_weights<MaxInfluence>(blended_weights.data(), (int)blended_weights.size(),
+                                          self_groups, self_weights, flags, out_groups, out_weights);
+    return true;
+}
+
+/**
+ * Thread Pool
+ *
+ * Fixed set of worker threads that sleep until parallel_for hands them a job.
+ * The calling thread works too, so a pool of N has N-1 std::threads.
+ * Meant to be created once (per modal session) and reused for every dab.
+ *
+ * parallel_for(count, grain, fn): fn(begin, end, worker) over [0, count)
+ * in chunks of `grain`. `worker` is in [0, size()) and can index per-worker
+ * scratch. Not re-entrant: don't call parallel_for from inside fn.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads) {
+        if (num_threads <= 0) num_threads = (int)std::thread::hardware_concurrency();
+        if (num_threads <= 0) num_threads = 1;
+        for (int i = 1; i < num_threads; ++i) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    template <typename Fn>
+    void parallel_for(int count, int grain, Fn&& fn) {
+        if (count <= 0) return;
+        if (grain < 1) grain = 1;
+        int num_chunks = (count + grain - 1) / grain;
+        if (workers.empty() || num_chunks <= 1) {
+            fn(0, count, 0);
+            return;
+        }
+
+        std::lock_guard<std::mutex> run_guard(run_mutex); // One job at a time
+
+        Job job;
+        job.fn = [&fn](int b, int e, int w) { fn(b, e, w); };
+        job.count = count;
+        job.grain = grain;
+        job.num_chunks = num_chunks;
+        job.next_chunk = 0;
+        job.done_chunks = 0;
+        job.users = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &job;
+            ++generation;
+        }
+        wake.notify_all();
+
+        run_chunks(job, 0);
+
+        // Wait until every chunk ran AND no worker still holds the job.
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return job.done_chunks.load() == job.num_chunks && job.users == 0; });
+        current = nullptr;
+    }
+
+private:
+    struct Job {
+        std::function<void(int, int, int)> fn;
+        int count;
+        int grain;
+        int num_chunks;
+        std::atomic<int> next_chunk;
+        std::atomic<int> done_chunks;
+        int users; // Workers inside run_chunks (guarded by mutex)
+    };
+
+    void run_chunks(Job& job, int worker) {
+        for (;;) {
+            int c = job.next_chunk.fetch_add(1);
+            if (c >= job.num_chunks) break;
+            int begin = c * job.grain;
+            int end = std::min(begin + job.grain, job.count);
+            job.fn(begin, end, worker);
+            job.done_chunks.fetch_add(1);
+        }
+    }
+
+    void worker_loop(int worker) {
+        unsigned long long seen = 0;
+        for (;;) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || (current && generation != seen); });
+                if (stopping) return;
+                seen = generation;
+                job = current;
+                job->users++;
             }
-            
-            // 4. Sort & Limit & Normalize
-            std::sort(weights, weights + count, compareWeights); // usages ptr math
-            
-            int final_count = (count > MAX_INFLUENCE) ? MAX_INFLUENCE : count;
-            
-            float total = 0.0f;
-            for(int k=0; k<final_count; ++k) total += weights[k].weight;
-            
-            // Normalize
-            if (total > 0.00001f) {
-                float ratio = 1.0f / total;
-                // Write back
-                int write_cursor = 0;
-                for(int k=0; k<final_count; ++k) {
-                     weight_indices[v_base + write_cursor] = weights[k].group_index;
-                     weight_values[v_base + write_cursor] = weights[k].weight * ratio;
-                     write_cursor++;
-                }
-                 // Zero remainder
-                for(int k=write_cursor; k<MAX_STORAGE; ++k) {
-                    weight_indices[v_base + k] = -1;
-                    weight_values[v_base + k] = 0.0f;
-                }
-            } else {
-                 // Zero all
-                for(int k=0; k<MAX_STORAGE; ++k) {
-                    weight_indices[v_base + k] = -1;
-                    weight_values[v_base + k] = 0.0f;
-                }
+            run_chunks(*job, worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job->users--;
             }
+            done.notify_all();
         }
     }
-    /**
-     * Build Adjacency Graph (CSR) from Raw Edges
-     * Replaces slow Python loop.
-     * 
-     * edge_indices: [num_edges * 2] (flattened pairs)
-     * vert_coords: [num_verts * 3] (flattened x,y,z)
-     * 
-     * Output:
-     * adj_starts: [num_verts + 1] (Pre-allocated)
-     * adj_indices: [num_edges * 2] (Pre-allocated)
-     * adj_weights: [num_edges * 2] (Pre-allocated)
-     */
-    EXPORT void build_adjacency_graph(
-        int num_verts,
-        int num_edges,
-        const int* edge_indices,
-        const float* vert_coords,
-        int* adj_starts,
-        int* adj_indices,
-        float* adj_weights
-    ) {
-        // 1. Calculate Degree per Vertex
-        // Using adj_starts temporarily as counts
-        std::fill(adj_starts, adj_starts + num_verts + 1, 0);
 
-        for (int i = 0; i < num_edges; ++i) {
-            int v1 = edge_indices[i * 2];
-            int v2 = edge_indices[i * 2 + 1];
-            adj_starts[v1]++;
-            adj_starts[v2]++;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex run_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Job* current = nullptr;
+    unsigned long long generation = 0;
+    bool stopping = false;
+};
+
+/**
+ * Kernel Pool (Exported as an opaque handle)
+ *
+ * Thread pool + per-worker scratch + the Jacobi output buffer.
+ * Everything here is reused across calls so dabs don't allocate.
+ */
+struct KernelPool {
+    ThreadPool threads;
+    std::vector<GroupAccumulator> accumulators; // One per worker
+
+    // Jacobi output (per target, strided)
+    std::vector<int> out_groups;
+    std::vector<float> out_weights;
+    std::vector<unsigned char> out_valid; // 0 = no neighbours, 1 = smoothed, 2 = smoothed + changed (tracked)
+    std::vector<int> out_pos;             // Dirty-vertex output position per target (tracked)
+
+    std::vector<float> worker_delta; // Per-worker max weight change (convergence)
+
+    explicit KernelPool(int num_threads)
+        : threads(num_threads), accumulators(threads.size()), worker_delta(threads.size()) {}
+
+    void reserve_targets(int num_targets) {
+        size_t slots = (size_t)num_targets * MAX_STORAGE;
+        if (out_groups.size() < slots) {
+            out_groups.resize(slots);
+            out_weights.resize(slots);
+        }
+        if (out_valid.size() < (size_t)num_targets) {
+            out_valid.resize(num_targets);
+            out_pos.resize(num_targets);
         }
+    }
+};
 
-        // 2. Prefix Sum -> Starts (CSR format)
-        int current_cursor = 0;
-        for (int i = 0; i < num_verts; ++i) {
-            int count = adj_starts[i];
-            adj_starts[i] = current_cursor;
-            current_cursor += count;
+/**
+ * Resolves an exported pool handle. NULL -> private single-threaded pool
+ * (no worker threads are spawned), so every entry point accepts NULL.
+ */
+struct PoolRef {
+    std::unique_ptr<KernelPool> local;
+    KernelPool* kp;
+
+    explicit PoolRef(void* handle) : kp(static_cast<KernelPool*>(handle)) {
+        if (!kp) {
+            local.reset(new KernelPool(1));
+            kp = local.get();
         }
-        adj_starts[num_verts] = current_cursor;
+    }
+    KernelPool& operator*() { return *kp; }
+};
 
-        // 3. Populate (Need temp cursors to track insertion position)
-        // We can allocate a temp vector for current written count
-        std::vector<int> current_pos(num_verts);
-        for(int i=0; i<num_verts; ++i) current_pos[i] = adj_starts[i];
+/**
+ * Progress + cancel flag of a background job (see SessionJob). Long loops
+ * report finished units (iterations, solver batches) with advance() and
+ * stop when it returns false. NULL everywhere outside a job.
+ */
+struct JobControl {
+    std::atomic<int> done{0};
+    int total = 1;
+    std::atomic<bool> cancel{false};
 
-        for (int i = 0; i < num_edges; ++i) {
-            int v1 = edge_indices[i * 2];
-            int v2 = edge_indices[i * 2 + 1];
+    bool cancelled() const { return cancel.load(std::memory_order_relaxed); }
+    bool advance(int count = 1) {
+        done.fetch_add(count, std::memory_order_relaxed);
+        return !cancelled();
+    }
+};
 
-            // Calc Distance
-            float x1 = vert_coords[v1*3];
-            float y1 = vert_coords[v1*3+1];
-            float z1 = vert_coords[v1*3+2];
-            
-            float x2 = vert_coords[v2*3];
-            float y2 = vert_coords[v2*3+1];
-            float z2 = vert_coords[v2*3+2];
-
-            float dx = x1 - x2;
-            float dy = y1 - y2;
-            float dz = z1 - z2;
-            float dist_sq = dx*dx + dy*dy + dz*dz;
-            float dist = std::sqrt(dist_sq);
-            float weight = 1.0f / (dist + 0.0001f);
+// Targets per parallel chunk. Small enough to balance, big enough to amortize scheduling.
+const int TARGET_GRAIN = 256;
 
-            // Add v2 to v1 list
-            int pos1 = current_pos[v1]++;
-            adj_indices[pos1] = v2;
-            adj_weights[pos1] = weight;
+/**
+ * Largest per-group weight change between two strided slot sets.
+ * Groups missing on one side count as weight 0.
+ */
+static float max_slot_delta(const int* old_g, const float* old_w, const int* new_g, const float* new_w) {
+    float max_d = 0.0f;
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        int g = new_g[k];
+        if (g < 0) continue;
+        float prev = 0.0f;
+        for (int j = 0; j < MAX_STORAGE; ++j) {
+            if (old_g[j] == g) { prev = old_w[j]; break; }
+        }
+        max_d = std::max(max_d, std::abs(new_w[k] - prev));
+    }
+    for (int j = 0; j < MAX_STORAGE; ++j) {
+        int g = old_g[j];
+        if (g < 0) continue;
+        bool kept = false;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (new_g[k] == g) { kept = true; break; }
+        }
+        if (!kept) max_d = std::max(max_d, std::abs(old_w[j]));
+    }
+    return max_d;
+}
 
-            // Add v1 to v2 list
-            int pos2 = current_pos[v2]++;
-            adj_indices[pos2] = v1;
-            adj_weights[pos2] = weight;
+/**
+ * Dirty-Vertex Output (optional, NULL = not tracked)
+ *
+ * Compact list of the vertices a kernel actually changed, with the slot
+ * contents before and after. Arrays are caller owned:
+ * verts [num_targets], *_indices / *_values [num_targets * MAX_STORAGE].
+ * A vertex counts as changed if a group moved slot or a weight changed by
+ * more than 0.00001 (the same threshold the apply loop used).
+ */
+struct DeltaOut {
+    int* verts;
+    int* before_indices;
+    float* before_values;
+    int* after_indices;
+    float* after_values;
+    int count;
+
+    static bool changed(const int* old_g, const float* old_w, const int* new_g, const float* new_w) {
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (old_g[k] != new_g[k]) return true;
+            if (std::abs(old_w[k] - new_w[k]) > 0.00001f) return true;
         }
+        return false;
+    }
+
+    void write_at(int pos, int v_idx, const int* old_g, const float* old_w, const int* new_g, const float* new_w) {
+        verts[pos] = v_idx;
+        size_t base = (size_t)pos * MAX_STORAGE;
+        std::copy(old_g, old_g + MAX_STORAGE, before_indices + base);
+        std::copy(old_w, old_w + MAX_STORAGE, before_values + base);
+        std::copy(new_g, new_g + MAX_STORAGE, after_indices + base);
+        std::copy(new_w, new_w + MAX_STORAGE, after_values + base);
+    }
+
+    void record_if_changed(int v_idx, const int* old_g, const float* old_w, const int* new_g, const float* new_w) {
+        if (changed(old_g, old_w, new_g, new_w)) write_at(count++, v_idx, old_g, old_w, new_g, new_w);
+    }
+};
+
+/**
+ * Phase 2 of the snapshot kernels: pool output buffers -> store.
+ * out_valid per target: 0 = keep, 1 = store, 2 = store + dirty record.
+ * Dirty list positions follow target order, so the output is deterministic.
+ */
+template <typename Storage>
+static void commit_pool_output(KernelPool& kp, const Storage& store, const int* target_indices,
+                               int num_targets, DeltaOut* delta) {
+    int* out_groups = kp.out_groups.data();
+    float* out_weights = kp.out_weights.data();
+    unsigned char* out_valid = kp.out_valid.data();
+    int* out_pos = kp.out_pos.data();
+    if (delta) {
+        int count = delta->count;
+        for (int t = 0; t < num_targets; ++t) {
+            out_pos[t] = count;
+            if (out_valid[t] == 2) ++count;
+        }
+        delta->count = count;
+    }
+
+    kp.threads.parallel_for(num_targets, TARGET_GRAIN, [&](int begin, int end, int) {
+        for (int t = begin; t < end; ++t) {
+            if (!out_valid[t]) continue;
+            size_t v_base = (size_t)target_indices[t] * MAX_STORAGE;
+            const int* src_g = out_groups + (size_t)t * MAX_STORAGE;
+            const float* src_w = out_weights + (size_t)t * MAX_STORAGE;
+            if (out_valid[t] == 2) {
+                int cur_g[MAX_STORAGE];
+                float cur_w[MAX_STORAGE];
+                store.load(v_base, cur_g, cur_w);
+                delta->write_at(out_pos[t], target_indices[t], cur_g, cur_w, src_g, src_w);
+            }
+            store.store(v_base, src_g, src_w);
+        }
+    });
+}
+
+/**
+ * Jacobi smoothing pass over the targets.
+ *
+ * Phase 1 reads only the (unmodified) input buffers = the snapshot, and writes
+ * each result into the pool's per-target output buffer. Phase 2 commits.
+ * Result is independent of target order and of the thread count.
+ * Targets must be unique.
+ *
+ * Returns the largest weight change of the pass if track_delta is set (else 0).
+ */
+template <typename Storage, int MaxInfluence = MAX_INFLUENCE>
+static float smooth_jacobi_pass(
+    KernelPool& kp,
+    const int* adj_starts,
+    const int* adj_indices,
+    const float* adj_weights,
+    const Storage& store,
+    const int* target_indices,
+    int num_targets,
+    float factor,
+    bool track_delta = false,
+    DeltaOut* delta = nullptr,
+    const GroupFlags* flags = nullptr
+) {
+    kp.reserve_targets(num_targets);
+    std::fill(kp.worker_delta.begin(), kp.worker_delta.end(), 0.0f);
+    int* out_groups = kp.out_groups.data();
+    float* out_weights = kp.out_weights.data();
+    unsigned char* out_valid = kp.out_valid.data();
+
+    // 1. Compute (Read snapshot -> Write output buffer)
+    kp.threads.parallel_for(num_targets, TARGET_GRAIN, [&](int begin, int end, int worker) {
+        GroupAccumulator& acc = kp.accumulators[worker];
+        float max_d = 0.0f;
+        for (int t = begin; t < end; ++t) {
+            int* dst_g = out_groups + (size_t)t * MAX_STORAGE;
+            float* dst_w = out_weights + (size_t)t * MAX_STORAGE;
+            out_valid[t] = smooth_vertex_strided<Storage, MaxInfluence>(
+                adj_starts, adj_indices, adj_weights,
+                store, target_indices[t], factor, acc, dst_g, dst_w, flags) ? 1 : 0;
+
+            if (!out_valid[t]) continue;
+            Storage::round_trip(dst_g, dst_w); // Output = exactly what gets stored
+            if (!track_delta && !delta) continue;
+
+            int cur_g[MAX_STORAGE];
+            float cur_w[MAX_STORAGE];
+            store.load((size_t)target_indices[t] * MAX_STORAGE, cur_g, cur_w);
+            if (track_delta) {
+                max_d = std::max(max_d, max_slot_delta(cur_g, cur_w, dst_g, dst_w));
+            }
+            if (delta && DeltaOut::changed(cur_g, cur_w, dst_g, dst_w)) {
+                out_valid[t] = 2;
+            }
+        }
+        kp.worker_delta[worker] = std::max(kp.worker_delta[worker], max_d);
+    });
+
+    // 2. Commit (Output buffer -> Strided Array)
+    commit_pool_output(kp, store, target_indices, num_targets, delta);
+
+    float max_delta = 0.0f;
+    for (float d : kp.worker_delta) max_delta = std::max(max_delta, d);
+    return max_delta;
+}
+
+// Inverse distance edge weight (shared by every CSR builder)
+static inline float edge_weight(const float* vert_coords, int v1, int v2) {
+    float x1 = vert_coords[v1*3];
+    float y1 = vert_coords[v1*3+1];
+    float z1 = vert_coords[v1*3+2];
+
+    float x2 = vert_coords[v2*3];
+    float y2 = vert_coords[v2*3+1];
+    float z2 = vert_coords[v2*3+2];
+
+    float dx = x1 - x2;
+    float dy = y1 - y2;
+    float dz = z1 - z2;
+    float dist_sq = dx*dx + dy*dy + dz*dz;
+    float dist = std::sqrt(dist_sq);
+    return 1.0f / (dist + 0.0001f);
+}
+
+/**
+ * Edge Weight Batch Kernels
+ *
+ * out_weights[i] = 1 / (|p(v1) - p(v2)| + 0.0001) for every edge.
+ * The SIMD paths do the exact same IEEE ops in the same order as edge_weight
+ * (mul/add, sqrt, add, div; no FMA), so results are bit-identical.
+ *
+ * AVX2 is compiled per-function (target attribute) and picked at runtime,
+ * so the shipped DLL still loads on CPUs without AVX2.
+ */
+static void edge_weights_scalar(int begin, int end, const int* edge_indices, const float* vert_coords, float* out_weights) {
+    for (int i = begin; i < end; ++i) {
+        out_weights[i] = edge_weight(vert_coords, edge_indices[i * 2], edge_indices[i * 2 + 1]);
+    }
+}
+
+#if defined(WYNN_SIMD_AVX2)
+__attribute__((target("avx2")))
+static void edge_weights_avx2(int begin, int end, const int* edge_indices, const float* vert_coords, float* out_weights) {
+    const __m256i pair_offsets = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256 eps = _mm256_set1_ps(0.0001f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        // Gather 8 (v1, v2) pairs
+        const int* pairs = edge_indices + (size_t)i * 2;
+        __m256i v1 = _mm256_i32gather_epi32(pairs, pair_offsets, 4);
+        __m256i v2 = _mm256_i32gather_epi32(pairs + 1, pair_offsets, 4);
+        __m256i o1 = _mm256_mullo_epi32(v1, three);
+        __m256i o2 = _mm256_mullo_epi32(v2, three);
+
+        // Gather xyz triples (AoS)
+        __m256 x1 = _mm256_i32gather_ps(vert_coords, o1, 4);
+        __m256 y1 = _mm256_i32gather_ps(vert_coords + 1, o1, 4);
+        __m256 z1 = _mm256_i32gather_ps(vert_coords + 2, o1, 4);
+        __m256 x2 = _mm256_i32gather_ps(vert_coords, o2, 4);
+        __m256 y2 = _mm256_i32gather_ps(vert_coords + 1, o2, 4);
+        __m256 z2 = _mm256_i32gather_ps(vert_coords + 2, o2, 4);
+
+        __m256 dx = _mm256_sub_ps(x1, x2);
+        __m256 dy = _mm256_sub_ps(y1, y2);
+        __m256 dz = _mm256_sub_ps(z1, z2);
+        __m256 dist_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 dist = _mm256_sqrt_ps(dist_sq);
+        _mm256_storeu_ps(out_weights + i, _mm256_div_ps(one, _mm256_add_ps(dist, eps)));
+    }
+    edge_weights_scalar(i, end, edge_indices, vert_coords, out_weights);
+}
+
+static bool cpu_has_avx2() {
+    static const bool has = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return has;
+}
+#endif
+
+#if defined(WYNN_SIMD_NEON)
+static void edge_weights_neon(int begin, int end, const int* edge_indices, const float* vert_coords, float* out_weights) {
+    const float32x4_t eps = vdupq_n_f32(0.0001f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const int* pairs = edge_indices + (size_t)i * 2;
+        for (int half = 0; half < 2; ++half) {
+            int32x4x2_t vv = vld2q_s32(pairs + half * 8); // De-interleave (v1, v2)
+            int a[4], b[4];
+            vst1q_s32(a, vv.val[0]);
+            vst1q_s32(b, vv.val[1]);
+
+            float xs1[4], ys1[4], zs1[4], xs2[4], ys2[4], zs2[4];
+            for (int k = 0; k < 4; ++k) {
+                const float* p1 = vert_coords + (size_t)a[k] * 3;
+                const float* p2 = vert_coords + (size_t)b[k] * 3;
+                xs1[k] = p1[0]; ys1[k] = p1[1]; zs1[k] = p1[2];
+                xs2[k] = p2[0]; ys2[k] = p2[1]; zs2[k] = p2[2];
+            }
+            float32x4_t dx = vsubq_f32(vld1q_f32(xs1), vld1q_f32(xs2));
+            float32x4_t dy = vsubq_f32(vld1q_f32(ys1), vld1q_f32(ys2));
+            float32x4_t dz = vsubq_f32(vld1q_f32(zs1), vld1q_f32(zs2));
+            float32x4_t dist_sq = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz));
+            float32x4_t dist = vsqrtq_f32(dist_sq);
+            vst1q_f32(out_weights + i + half * 4, vdivq_f32(one, vaddq_f32(dist, eps)));
+        }
+    }
+    edge_weights_scalar(i, end, edge_indices, vert_coords, out_weights);
+}
+#endif
+
+// Runtime dispatch
+static void edge_weights_batch(int begin, int end, const int* edge_indices, const float* vert_coords, float* out_weights) {
+#if defined(WYNN_SIMD_AVX2)
+    if (cpu_has_avx2()) {
+        edge_weights_avx2(begin, end, edge_indices, vert_coords, out_weights);
+        return;
+    }
+#elif defined(WYNN_SIMD_NEON)
+    edge_weights_neon(begin, end, edge_indices, vert_coords, out_weights);
+    return;
+#endif
+    edge_weights_scalar(begin, end, edge_indices, vert_coords, out_weights);
+}
+
+// Edges per histogram chunk, and a cap on chunks (each costs num_verts ints)
+const int CSR_EDGE_GRAIN = 65536;
+const int CSR_MAX_CHUNKS = 16;
+
+/**
+ * Build CSR adjacency (shared implementation).
+ *
+ * Serial path: degree count -> prefix sum -> scatter (edge order).
+ *
+ * Parallel path (big meshes):
+ * 1. Edges are cut into contiguous chunks, each chunk counts degrees into
+ *    its own histogram row (no atomics, no sharing).
+ * 2. Per vertex, rows are turned into offsets: chunk c writes after the
+ *    entries of chunks 0..c-1, i.e. exactly where the serial loop would.
+ * 3. Parallel prefix scan of degrees -> adj_starts.
+ * 4. Every chunk scatters its edges through its own cursors.
+ * Output is identical to the serial build.
+ * Edge weights are computed up front in SIMD batches (edge_weights_batch).
+ */
+static void build_adjacency_impl(
+    KernelPool& kp,
+    int num_verts,
+    int num_edges,
+    const int* edge_indices,
+    const float* vert_coords,
+    int* adj_starts,
+    int* adj_indices,
+    float* adj_weights
+) {
+    ThreadPool& threads = kp.threads;
+    int num_chunks = std::min({threads.size(), CSR_MAX_CHUNKS, (num_edges + CSR_EDGE_GRAIN - 1) / CSR_EDGE_GRAIN});
+
+    // 0. Edge weights (SIMD, once per edge)
+    std::vector<float> edge_w(num_edges);
+    threads.parallel_for(num_edges, CSR_EDGE_GRAIN, [&](int begin, int end, int) {
+        edge_weights_batch(begin, end, edge_indices, vert_coords, edge_w.data());
+    });
+
+    if (num_chunks <= 1) {
+        // 1. Calculate Degree per Vertex
+        // Using adj_starts temporarily as counts
+        std::fill(adj_starts, adj_starts + num_verts + 1, 0);
+
+        for (int i = 0; i < num_edges; ++i) {
+            adj_starts[edge_indices[i * 2]]++;
+            adj_starts[edge_indices[i * 2 + 1]]++;
+        }
+
+        // 2. Prefix Sum -> Starts (CSR format)
+        int current_cursor = 0;
+        for (int i = 0; i < num_verts; ++i) {
+            int count = adj_starts[i];
+            adj_starts[i] = current_cursor;
+            current_cursor += count;
+        }
+        adj_starts[num_verts] = current_cursor;
+
+        // 3. Populate (Need temp cursors to track insertion position)
+        std::vector<int> current_pos(adj_starts, adj_starts + num_verts);
+
+        for (int i = 0; i < num_edges; ++i) {
+            int v1 = edge_indices[i * 2];
+            int v2 = edge_indices[i * 2 + 1];
+            float weight = edge_w[i];
+
+            // Add v2 to v1 list
+            int pos1 = current_pos[v1]++;
+            adj_indices[pos1] = v2;
+            adj_weights[pos1] = weight;
+
+            // Add v1 to v2 list
+            int pos2 = current_pos[v2]++;
+            adj_indices[pos2] = v1;
+            adj_weights[pos2] = weight;
+        }
+        return;
+    }
+
+    int edges_per_chunk = (num_edges + num_chunks - 1) / num_chunks;
+    std::vector<int> hist((size_t)num_chunks * num_verts);
+
+    // 1. Per-chunk degree histograms
+    threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            int* row = hist.data() + (size_t)c * num_verts;
+            std::fill(row, row + num_verts, 0);
+            int e_end = std::min(num_edges, (c + 1) * edges_per_chunk);
+            for (int i = c * edges_per_chunk; i < e_end; ++i) {
+                row[edge_indices[i * 2]]++;
+                row[edge_indices[i * 2 + 1]]++;
+            }
+        }
+    });
+
+    // 2. Rows -> per-chunk offsets inside each vertex list, degree -> adj_starts
+    const int vert_grain = 16384;
+    threads.parallel_for(num_verts, vert_grain, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            int running = 0;
+            for (int c = 0; c < num_chunks; ++c) {
+                int& h = hist[(size_t)c * num_verts + v];
+                int count = h;
+                h = running;
+                running += count;
+            }
+            adj_starts[v] = running;
+        }
+    });
+
+    // 3. Parallel prefix scan (block sums -> serial scan of blocks -> block fill)
+    int num_blocks = (num_verts + vert_grain - 1) / vert_grain;
+    std::vector<int> block_offset(num_blocks + 1, 0);
+    threads.parallel_for(num_blocks, 1, [&](int begin, int end, int) {
+        for (int b = begin; b < end; ++b) {
+            int v_end = std::min(num_verts, (b + 1) * vert_grain);
+            int sum = 0;
+            for (int v = b * vert_grain; v < v_end; ++v) sum += adj_starts[v];
+            block_offset[b + 1] = sum;
+        }
+    });
+    for (int b = 0; b < num_blocks; ++b) block_offset[b + 1] += block_offset[b];
+    threads.parallel_for(num_blocks, 1, [&](int begin, int end, int) {
+        for (int b = begin; b < end; ++b) {
+            int v_end = std::min(num_verts, (b + 1) * vert_grain);
+            int cursor = block_offset[b];
+            for (int v = b * vert_grain; v < v_end; ++v) {
+                int count = adj_starts[v];
+                adj_starts[v] = cursor;
+                cursor += count;
+            }
+        }
+    });
+    adj_starts[num_verts] = block_offset[num_blocks];
+
+    // 4. Scatter (each chunk owns its cursors)
+    threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            int* cursor = hist.data() + (size_t)c * num_verts;
+            int e_end = std::min(num_edges, (c + 1) * edges_per_chunk);
+            for (int i = c * edges_per_chunk; i < e_end; ++i) {
+                int v1 = edge_indices[i * 2];
+                int v2 = edge_indices[i * 2 + 1];
+                float weight = edge_w[i];
+
+                int pos1 = adj_starts[v1] + cursor[v1]++;
+                adj_indices[pos1] = v2;
+                adj_weights[pos1] = weight;
+
+                int pos2 = adj_starts[v2] + cursor[v2]++;
+                adj_indices[pos2] = v1;
+                adj_weights[pos2] = weight;
+            }
+        }
+    });
+}
+
+/**
+ * Edge Weights In Place (CSR structure unchanged)
+ * Recomputes every slot from new coordinates: same edge_weight as the
+ * builders, so the result is bit-identical to a full rebuild. Rows are
+ * independent -> parallel over vertices.
+ */
+static void update_edge_weights_impl(
+    KernelPool& kp, int num_verts,
+    const int* adj_starts, const int* adj_indices, const float* vert_coords, float* adj_weights
+) {
+    kp.threads.parallel_for(num_verts, CSR_EDGE_GRAIN / 8, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+                // edge_weight(v, u) == edge_weight(u, v): only squared differences enter
+                adj_weights[i] = edge_weight(vert_coords, v, adj_indices[i]);
+            }
+        }
+    });
+}
+
+/**
+ * Buffer Fingerprints (topology / coordinate change detection)
+ *
+ * 64-bit FNV-1a over 8-byte words, in fixed-size chunks hashed on the
+ * pool and folded in order, so the value doesn't depend on the thread
+ * count. Not cryptographic: it only has to notice that an edge list or
+ * coordinate array changed between two brush sessions.
+ */
+const size_t FINGERPRINT_CHUNK = 1 << 20; // Bytes
+
+static uint64_t fingerprint_chunk(const unsigned char* data, size_t bytes) {
+    uint64_t h = 1469598103934665603ULL;
+    size_t words = bytes / 8;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t w;
+        std::memcpy(&w, data + i * 8, 8);
+        h = (h ^ w) * 1099511628211ULL;
+    }
+    for (size_t i = words * 8; i < bytes; ++i) {
+        h = (h ^ data[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t fingerprint_buffer(KernelPool& kp, const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    int num_chunks = (int)((bytes + FINGERPRINT_CHUNK - 1) / FINGERPRINT_CHUNK);
+    std::vector<uint64_t> chunk_hash(num_chunks);
+    kp.threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            size_t offset = (size_t)c * FINGERPRINT_CHUNK;
+            chunk_hash[c] = fingerprint_chunk(p + offset, std::min(FINGERPRINT_CHUNK, bytes - offset));
+        }
+    });
+
+    // Fold (splitmix64 finalizer per step), length first so "" != "\0"
+    uint64_t h = bytes;
+    for (int c = 0; c < num_chunks; ++c) {
+        h ^= chunk_hash[c] + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+/**
+ * Subgraph Extraction (edit-mode working sets)
+ *
+ * Local set = targets (deduplicated, in order) followed by their one-ring
+ * in discovery order, so a kernel over local ids 0..num_targets sees every
+ * neighbour it reads. The local CSR keeps every full-mesh edge between two
+ * local vertices, weights copied unchanged. One pass over the touched rows.
+ * The global -> local map is kept per thread and only the entries a call
+ * set are reset, so a small selection on a dense mesh costs O(working set),
+ * not O(num_verts). out_starts == NULL: sizes only (*out_num_entries).
+ */
+static int extract_subgraph_impl(
+    const int* adj_starts, const int* adj_indices, const float* adj_weights, int num_verts,
+    const int* targets, int num_targets,
+    int* out_local_to_global, int* out_local_targets,
+    int* out_starts, int* out_indices, float* out_weights, int* out_num_entries
+) {
+    thread_local std::vector<int> local; // -1 = not local
+    thread_local std::vector<int> order; // local id -> global id
+    if (local.size() < (size_t)num_verts) local.resize(num_verts, -1);
+    order.clear();
+    for (int t = 0; t < num_targets; ++t) {
+        int v = targets[t];
+        if (local[v] < 0) {
+            local[v] = (int)order.size();
+            order.push_back(v);
+        }
+        if (out_local_targets) out_local_targets[t] = local[v];
+    }
+    int num_core = (int)order.size();
+    for (int l = 0; l < num_core; ++l) {
+        int v = order[l];
+        for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+            int u = adj_indices[i];
+            if (local[u] < 0) {
+                local[u] = (int)order.size();
+                order.push_back(u);
+            }
+        }
+    }
+
+    int num_local = (int)order.size();
+    int cursor = 0;
+    for (int l = 0; l < num_local; ++l) {
+        int v = order[l];
+        if (out_starts) out_starts[l] = cursor;
+        for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+            int u = local[adj_indices[i]];
+            if (u < 0) continue;
+            if (out_starts) {
+                out_indices[cursor] = u;
+                out_weights[cursor] = adj_weights[i];
+            }
+            cursor++;
+        }
+    }
+    if (out_starts) out_starts[num_local] = cursor;
+    if (out_local_to_global) std::copy(order.begin(), order.end(), out_local_to_global);
+    if (out_num_entries) *out_num_entries = cursor;
+    for (int v : order) local[v] = -1;
+    return num_local;
+}
+
+const int GRID_VERT_GRAIN = 65536;
+const int GRID_VERTS_PER_CELL = 2; // Target density (cell count ~ num_verts / 2)
+
+/**
+ * Uniform Grid Spatial Index (Brush Range Queries)
+ *
+ * Vertices are counting-sorted by cell; ids and coordinates are stored in
+ * cell order, so a query walks a few short contiguous runs instead of
+ * chasing tree nodes. Within a cell the original vertex order is kept,
+ * which makes the output independent of the thread count.
+ */
+struct SpatialGrid {
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    float cell_size = 1.0f;
+    float inv_cell = 1.0f;
+    int dims[3] = {1, 1, 1};
+    int num_verts = 0;
+
+    std::vector<int> cell_starts;     // [cells + 1]
+    std::vector<int> sorted_verts;    // [num_verts] vertex ids in cell order
+    std::vector<float> sorted_coords; // [num_verts * 3] same order
+    std::vector<int> vert_cell;       // Build scratch
+
+    int cell_coord(float p, int axis) const {
+        int c = (int)std::floor((p - origin[axis]) * inv_cell);
+        return std::min(std::max(c, 0), dims[axis] - 1);
+    }
+
+    int cell_index(int x, int y, int z) const {
+        return (z * dims[1] + y) * dims[0] + x;
+    }
+};
+
+/**
+ * Brush falloff for a point inside the radius (dist_sq < radius_sq).
+ * 0 = Quadratic (1 - d^2/r^2, the brush default), 1 = Linear,
+ * 2 = Smooth (smoothstep of 1 - d/r), 3 = Constant.
+ */
+static inline float brush_falloff(float dist_sq, float radius_sq, float radius, int mode) {
+    switch (mode) {
+        case 1: return 1.0f - std::sqrt(dist_sq) / radius;
+        case 2: {
+            float t = 1.0f - std::sqrt(dist_sq) / radius;
+            return t * t * (3.0f - 2.0f * t);
+        }
+        case 3: return 1.0f;
+        default: return 1.0f - dist_sq / radius_sq;
+    }
+}
+
+/**
+ * Build the grid from flat world-space coordinates [num_verts * 3].
+ * Bounds, cell assignment, per-chunk histograms and the scatter run on the pool.
+ */
+static void build_spatial_grid(KernelPool& kp, SpatialGrid& grid, int num_verts, const float* coords) {
+    ThreadPool& threads = kp.threads;
+    grid.num_verts = num_verts;
+    if (num_verts <= 0) {
+        grid.dims[0] = grid.dims[1] = grid.dims[2] = 1;
+        grid.cell_starts.assign(2, 0);
+        grid.sorted_verts.clear();
+        grid.sorted_coords.clear();
+        return;
+    }
+
+    int num_chunks = std::max(1, std::min({threads.size(), CSR_MAX_CHUNKS, (num_verts + GRID_VERT_GRAIN - 1) / GRID_VERT_GRAIN}));
+    int verts_per_chunk = (num_verts + num_chunks - 1) / num_chunks;
+
+    // 1. Bounds (per chunk -> reduce)
+    std::vector<float> chunk_bounds((size_t)num_chunks * 6);
+    threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            float* b = chunk_bounds.data() + (size_t)c * 6;
+            b[0] = b[1] = b[2] = INFINITY;
+            b[3] = b[4] = b[5] = -INFINITY;
+            int v_end = std::min(num_verts, (c + 1) * verts_per_chunk);
+            for (int v = c * verts_per_chunk; v < v_end; ++v) {
+                for (int a = 0; a < 3; ++a) {
+                    float p = coords[v * 3 + a];
+                    b[a] = std::min(b[a], p);
+                    b[3 + a] = std::max(b[3 + a], p);
+                }
+            }
+        }
+    });
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (int c = 0; c < num_chunks; ++c) {
+        const float* b = chunk_bounds.data() + (size_t)c * 6;
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], b[a]);
+            hi[a] = std::max(hi[a], b[3 + a]);
+        }
+    }
+
+    // 2. Cell size: ~GRID_VERTS_PER_CELL per cell. Flat axes are padded so
+    //    planar meshes don't collapse the volume estimate.
+    float extent[3];
+    float max_extent = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+        extent[a] = hi[a] - lo[a];
+        max_extent = std::max(max_extent, extent[a]);
+    }
+    if (max_extent <= 0.0f) max_extent = 1.0f;
+    double volume = 1.0;
+    for (int a = 0; a < 3; ++a) volume *= std::max(extent[a], max_extent * 0.01f);
+    double target_cells = std::max(1, num_verts / GRID_VERTS_PER_CELL);
+    float cell = (float)std::cbrt(volume / target_cells);
+    for (;;) {
+        double total = 1.0;
+        for (int a = 0; a < 3; ++a) {
+            grid.dims[a] = std::max(1, (int)std::ceil(extent[a] / cell));
+            total *= grid.dims[a];
+        }
+        if (total <= target_cells * 4.0 + 64.0) break;
+        cell *= 1.25f;
+    }
+    for (int a = 0; a < 3; ++a) grid.origin[a] = lo[a];
+    grid.cell_size = cell;
+    grid.inv_cell = 1.0f / cell;
+    int num_cells = grid.dims[0] * grid.dims[1] * grid.dims[2];
+
+    // 3. Cell per vertex
+    grid.vert_cell.resize(num_verts);
+    threads.parallel_for(num_verts, GRID_VERT_GRAIN, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            const float* p = coords + v * 3;
+            grid.vert_cell[v] = grid.cell_index(grid.cell_coord(p[0], 0), grid.cell_coord(p[1], 1), grid.cell_coord(p[2], 2));
+        }
+    });
+
+    // 4. Per-chunk histograms -> per-chunk cursors + cell_starts (stable counting sort)
+    std::vector<int> hist((size_t)num_chunks * num_cells);
+    threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            int* row = hist.data() + (size_t)c * num_cells;
+            std::fill(row, row + num_cells, 0);
+            int v_end = std::min(num_verts, (c + 1) * verts_per_chunk);
+            for (int v = c * verts_per_chunk; v < v_end; ++v) row[grid.vert_cell[v]]++;
+        }
+    });
+    grid.cell_starts.resize((size_t)num_cells + 1);
+    int cursor = 0;
+    for (int cell_id = 0; cell_id < num_cells; ++cell_id) {
+        grid.cell_starts[cell_id] = cursor;
+        for (int c = 0; c < num_chunks; ++c) {
+            int& h = hist[(size_t)c * num_cells + cell_id];
+            int count = h;
+            h = cursor;
+            cursor += count;
+        }
+    }
+    grid.cell_starts[num_cells] = cursor;
+
+    // 5. Scatter (each chunk owns its cursors)
+    grid.sorted_verts.resize(num_verts);
+    grid.sorted_coords.resize((size_t)num_verts * 3);
+    threads.parallel_for(num_chunks, 1, [&](int begin, int end, int) {
+        for (int c = begin; c < end; ++c) {
+            int* row = hist.data() + (size_t)c * num_cells;
+            int v_end = std::min(num_verts, (c + 1) * verts_per_chunk);
+            for (int v = c * verts_per_chunk; v < v_end; ++v) {
+                int pos = row[grid.vert_cell[v]]++;
+                grid.sorted_verts[pos] = v;
+                std::copy(coords + v * 3, coords + v * 3 + 3, grid.sorted_coords.data() + (size_t)pos * 3);
+            }
+        }
+    });
+}
+
+/**
+ * All vertices strictly inside the sphere, with factor = strength * falloff.
+ * Writes at most max_out entries; returns the number found.
+ */
+static int query_spatial_grid(
+    const SpatialGrid& grid,
+    const float* center,
+    float radius,
+    int falloff_mode,
+    float strength,
+    int* out_indices,
+    float* out_factors,
+    int max_out
+) {
+    if (grid.num_verts <= 0 || radius <= 0.0f) return 0;
+    float radius_sq = radius * radius;
+
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; ++a) {
+        lo[a] = grid.cell_coord(center[a] - radius, a);
+        hi[a] = grid.cell_coord(center[a] + radius, a);
+    }
+
+    int count = 0;
+    const float* sc = grid.sorted_coords.data();
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            // Cells along x are contiguous -> one run per row
+            int run_begin = grid.cell_starts[grid.cell_index(lo[0], y, z)];
+            int run_end = grid.cell_starts[grid.cell_index(hi[0], y, z) + 1];
+            for (int i = run_begin; i < run_end; ++i) {
+                float dx = sc[i * 3] - center[0];
+                float dy = sc[i * 3 + 1] - center[1];
+                float dz = sc[i * 3 + 2] - center[2];
+                float dist_sq = dx * dx + dy * dy + dz * dz;
+                if (dist_sq >= radius_sq) continue;
+                if (count < max_out) {
+                    out_indices[count] = grid.sorted_verts[i];
+                    out_factors[count] = strength * brush_falloff(dist_sq, radius_sq, radius, falloff_mode);
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Nearest vertex (ring search around the point's cell).
+ * Returns -1 for an empty grid.
+ */
+static int nearest_spatial_grid(const SpatialGrid& grid, const float* point, float* out_dist) {
+    if (grid.num_verts <= 0) return -1;
+    int c[3];
+    for (int a = 0; a < 3; ++a) c[a] = grid.cell_coord(point[a], a);
+    int max_ring = std::max({grid.dims[0], grid.dims[1], grid.dims[2]});
+
+    int best = -1;
+    float best_sq = INFINITY;
+    const float* sc = grid.sorted_coords.data();
+    for (int ring = 0; ring <= max_ring; ++ring) {
+        for (int z = std::max(0, c[2] - ring); z <= std::min(grid.dims[2] - 1, c[2] + ring); ++z) {
+            for (int y = std::max(0, c[1] - ring); y <= std::min(grid.dims[1] - 1, c[1] + ring); ++y) {
+                bool shell_yz = std::abs(z - c[2]) == ring || std::abs(y - c[1]) == ring;
+                for (int x = std::max(0, c[0] - ring); x <= std::min(grid.dims[0] - 1, c[0] + ring); ++x) {
+                    // Only the shell of this ring (inner cells were visited before)
+                    if (!shell_yz && std::abs(x - c[0]) != ring) continue;
+                    int cell_id = grid.cell_index(x, y, z);
+                    for (int i = grid.cell_starts[cell_id]; i < grid.cell_starts[cell_id + 1]; ++i) {
+                        float dx = sc[i * 3] - point[0];
+                        float dy = sc[i * 3 + 1] - point[1];
+                        float dz = sc[i * 3 + 2] - point[2];
+                        float dist_sq = dx * dx + dy * dy + dz * dz;
+                        if (dist_sq < best_sq || (dist_sq == best_sq && grid.sorted_verts[i] < best)) {
+                            best_sq = dist_sq;
+                            best = grid.sorted_verts[i];
+                        }
+                    }
+                }
+            }
+        }
+        // Cells beyond this ring are at least ring * cell_size away
+        float reach = ring * grid.cell_size;
+        if (best >= 0 && best_sq <= reach * reach) break;
+    }
+    if (out_dist) *out_dist = std::sqrt(best_sq);
+    return best;
+}
+
+/**
+ * Bone Capsule BVH (Binary / Rigid Weights)
+ *
+ * One capsule per bone: segment head -> tail plus a radius (0 = plain
+ * segment). Built top-down with a median split on the longest centroid
+ * axis; leaves hold a few bones. Bone counts are small, so the build is
+ * serial and the per-vertex queries run on the pool.
+ */
+const int BONE_BVH_LEAF = 4;
+const int BINARY_VERT_GRAIN = 4096;
+
+struct BoneBVH {
+    struct Node {
+        float lo[3];    // Segment bounds (radius not included)
+        float hi[3];
+        float max_radius = 0.0f;
+        int left = -1;  // Child pair (left, left + 1), -1 = leaf
+        int first = 0;  // Leaf range in order[]
+        int count = 0;
+    };
+
+    const float* segments = nullptr; // [num_bones * 6] head xyz, tail xyz
+    const float* radii = nullptr;    // [num_bones] or NULL
+    std::vector<Node> nodes;
+    std::vector<int> order;
+
+    float radius(int b) const { return radii ? radii[b] : 0.0f; }
+};
+
+static void build_bone_bvh(BoneBVH& bvh, int num_bones, const float* segments, const float* radii) {
+    bvh.segments = segments;
+    bvh.radii = radii;
+    bvh.nodes.clear();
+    bvh.order.resize(num_bones);
+    for (int b = 0; b < num_bones; ++b) bvh.order[b] = b;
+    if (num_bones <= 0) return;
+
+    auto centroid = [&](int b, int axis) {
+        return 0.5f * (segments[b * 6 + axis] + segments[b * 6 + 3 + axis]);
+    };
+
+    // (node, first, count) work list; children are always allocated in pairs
+    struct Task { int node, first, count; };
+    std::vector<Task> tasks;
+    bvh.nodes.emplace_back();
+    tasks.push_back({0, 0, num_bones});
+    while (!tasks.empty()) {
+        Task t = tasks.back();
+        tasks.pop_back();
+
+        BoneBVH::Node node;
+        float c_lo[3] = {INFINITY, INFINITY, INFINITY};
+        float c_hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (int a = 0; a < 3; ++a) { node.lo[a] = INFINITY; node.hi[a] = -INFINITY; }
+        for (int i = t.first; i < t.first + t.count; ++i) {
+            int b = bvh.order[i];
+            node.max_radius = std::max(node.max_radius, bvh.radius(b));
+            for (int a = 0; a < 3; ++a) {
+                float h = segments[b * 6 + a];
+                float e = segments[b * 6 + 3 + a];
+                node.lo[a] = std::min(node.lo[a], std::min(h, e));
+                node.hi[a] = std::max(node.hi[a], std::max(h, e));
+                c_lo[a] = std::min(c_lo[a], centroid(b, a));
+                c_hi[a] = std::max(c_hi[a], centroid(b, a));
+            }
+        }
+        node.first = t.first;
+        node.count = t.count;
+
+        if (t.count > BONE_BVH_LEAF) {
+            int axis = 0;
+            for (int a = 1; a < 3; ++a) {
+                if (c_hi[a] - c_lo[a] > c_hi[axis] - c_lo[axis]) axis = a;
+            }
+            int half = t.count / 2;
+            std::nth_element(bvh.order.begin() + t.first, bvh.order.begin() + t.first + half,
+                             bvh.order.begin() + t.first + t.count,
+                             [&](int x, int y) { return centroid(x, axis) < centroid(y, axis); });
+            node.left = (int)bvh.nodes.size();
+            bvh.nodes.emplace_back();
+            bvh.nodes.emplace_back();
+            tasks.push_back({node.left, t.first, half});
+            tasks.push_back({node.left + 1, t.first + half, t.count - half});
+        }
+        bvh.nodes[t.node] = node;
+    }
+}
+
+// Distance from p to the capsule surface (negative inside)
+static inline float capsule_distance(const BoneBVH& bvh, int b, const float* p) {
+    const float* h = bvh.segments + b * 6;
+    float d[3] = {h[3] - h[0], h[4] - h[1], h[5] - h[2]};
+    float w[3] = {p[0] - h[0], p[1] - h[1], p[2] - h[2]};
+    float len_sq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    float t = len_sq > 0.0f ? (w[0] * d[0] + w[1] * d[1] + w[2] * d[2]) / len_sq : 0.0f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    float dx = w[0] - t * d[0];
+    float dy = w[1] - t * d[1];
+    float dz = w[2] - t * d[2];
+    return std::sqrt(dx * dx + dy * dy + dz * dz) - bvh.radius(b);
+}
+
+/**
+ * Nearest capsule to p. Ties go to the lower bone index, so the result
+ * doesn't depend on the tree layout. Returns -1 for an empty BVH.
+ */
+static int nearest_bone_bvh(const BoneBVH& bvh, const float* p, float* out_dist) {
+    int best = -1;
+    float best_dist = INFINITY;
+    if (bvh.nodes.empty()) {
+        if (out_dist) *out_dist = best_dist;
+        return best;
+    }
+
+    // Lower bound for every capsule in the node (segments lie inside the
+    // box, radii are at most max_radius); can be negative inside
+    auto box_distance = [&](const BoneBVH::Node& n) {
+        float sq = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+            float e = std::max(std::max(n.lo[a] - p[a], p[a] - n.hi[a]), 0.0f);
+            sq += e * e;
+        }
+        return std::sqrt(sq) - n.max_radius;
+    };
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BoneBVH::Node& n = bvh.nodes[stack[--top]];
+        if (box_distance(n) > best_dist) continue;
+        if (n.left < 0) {
+            for (int i = n.first; i < n.first + n.count; ++i) {
+                int b = bvh.order[i];
+                float dist = capsule_distance(bvh, b, p);
+                if (dist < best_dist || (dist == best_dist && b < best)) {
+                    best_dist = dist;
+                    best = b;
+                }
+            }
+            continue;
+        }
+        // Visit the nearer child first (pushed last)
+        int a = n.left, b = n.left + 1;
+        if (box_distance(bvh.nodes[a]) < box_distance(bvh.nodes[b])) std::swap(a, b);
+        stack[top++] = a;
+        stack[top++] = b;
+    }
+    if (out_dist) *out_dist = best_dist;
+    return best;
+}
+
+/**
+ * Geodesic Flood (optional refinement of the nearest-bone labels)
+ *
+ * Euclidean nearest-bone assignment leaks across gaps: an inner-arm
+ * vertex can be closer to the torso bone than to its own. Here each bone
+ * is seeded with the vertices that are both labelled for it and within
+ * max(1.25 * its closest vertex distance, its radius) - the core of the
+ * limb around the bone - and labels then grow over the mesh edges
+ * (multi-source Dijkstra on edge length, seeded with the bone distance).
+ * Vertices no seed can reach (loose parts without a core) keep the
+ * Euclidean label.
+ */
+static void flood_bone_labels(
+    int num_verts, const float* vert_coords,
+    const int* adj_starts, const int* adj_indices,
+    const BoneBVH& bvh, int num_bones,
+    int* labels, float* dist
+) {
+    std::vector<float> bone_min(num_bones, INFINITY);
+    for (int v = 0; v < num_verts; ++v) {
+        int b = labels[v];
+        if (b >= 0) bone_min[b] = std::min(bone_min[b], dist[v]);
+    }
+
+    typedef std::pair<float, int> Entry; // (geodesic distance, vertex)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<float> geo(num_verts, INFINITY);
+    std::vector<int> geo_label(num_verts, -1);
+    for (int v = 0; v < num_verts; ++v) {
+        int b = labels[v];
+        if (b < 0) continue;
+        float core = std::max(bone_min[b] * 1.25f, bvh.radius(b));
+        if (dist[v] <= core) {
+            float start = std::max(dist[v], 0.0f);
+            geo[v] = start;
+            geo_label[v] = b;
+            heap.push(Entry(start, v));
+        }
+    }
+
+    while (!heap.empty()) {
+        Entry top = heap.top();
+        heap.pop();
+        int v = top.second;
+        if (top.first > geo[v]) continue; // Stale entry
+        const float* pv = vert_coords + v * 3;
+        for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+            int u = adj_indices[i];
+            const float* pu = vert_coords + u * 3;
+            float dx = pu[0] - pv[0], dy = pu[1] - pv[1], dz = pu[2] - pv[2];
+            float d = top.first + std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (d < geo[u] || (d == geo[u] && geo_label[v] < geo_label[u])) {
+                geo[u] = d;
+                geo_label[u] = geo_label[v];
+                heap.push(Entry(d, u));
+            }
+        }
+    }
+
+    for (int v = 0; v < num_verts; ++v) {
+        if (geo_label[v] >= 0 && geo_label[v] != labels[v]) {
+            labels[v] = geo_label[v];
+            dist[v] = capsule_distance(bvh, geo_label[v], vert_coords + v * 3);
+        }
+    }
+}
+
+// Body of binary_weights_strided (see there), also run on sessions
+static int binary_weights_impl(
+    KernelPool& kp,
+    int num_verts,
+    const float* vert_coords,
+    int num_bones,
+    const float* bone_segments,
+    const float* bone_radii,
+    const int* bone_groups,
+    const int* adj_starts,
+    const int* adj_indices,
+    int* out_bone,
+    float* out_dist,
+    int* weight_indices,
+    float* weight_values
+) {
+    if (num_verts <= 0 || num_bones <= 0) {
+        for (int v = 0; v < num_verts; ++v) {
+            if (out_bone) out_bone[v] = -1;
+            if (out_dist) out_dist[v] = INFINITY;
+        }
+        return 0;
+    }
+    BoneBVH bvh;
+    build_bone_bvh(bvh, num_bones, bone_segments, bone_radii);
+
+    std::vector<int> labels(num_verts);
+    std::vector<float> dist(num_verts);
+    kp.threads.parallel_for(num_verts, BINARY_VERT_GRAIN, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            labels[v] = nearest_bone_bvh(bvh, vert_coords + v * 3, &dist[v]);
+        }
+    });
+
+    if (adj_starts && adj_indices) {
+        flood_bone_labels(num_verts, vert_coords, adj_starts, adj_indices, bvh, num_bones,
+                          labels.data(), dist.data());
+    }
+
+    if (out_bone) std::copy(labels.begin(), labels.end(), out_bone);
+    if (out_dist) std::copy(dist.begin(), dist.end(), out_dist);
+
+    if (weight_indices && weight_values && bone_groups) {
+        int max_group = -1;
+        for (int b = 0; b < num_bones; ++b) max_group = std::max(max_group, bone_groups[b]);
+        std::vector<unsigned char> is_bone(max_group + 1, 0);
+        for (int b = 0; b < num_bones; ++b) {
+            if (bone_groups[b] >= 0) is_bone[bone_groups[b]] = 1;
+        }
+
+        kp.threads.parallel_for(num_verts, BINARY_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int v = begin; v < end; ++v) {
+                int v_base = v * MAX_STORAGE;
+                int g[MAX_STORAGE];
+                float w[MAX_STORAGE];
+                int count = 0;
+                g[count] = bone_groups[labels[v]];
+                w[count++] = 1.0f;
+                for (int k = 0; k < MAX_STORAGE && count < MAX_STORAGE; ++k) {
+                    int grp = weight_indices[v_base + k];
+                    if (grp < 0) continue;
+                    if (grp <= max_group && is_bone[grp]) continue;
+                    g[count] = grp;
+                    w[count++] = weight_values[v_base + k];
+                }
+                for (int k = 0; k < MAX_STORAGE; ++k) {
+                    weight_indices[v_base + k] = k < count ? g[k] : -1;
+                    weight_values[v_base + k] = k < count ? w[k] : 0.0f;
+                }
+            }
+        });
+    }
+    return num_verts;
+}
+
+/**
+ * Heat Diffusion Weights (Bone Heat without Blender's solver)
+ *
+ * Per bone j: (L + H) w_j = H p_j over the CSR graph, as in Blender's
+ * bone heat. L is the graph Laplacian of the CSR edge weights, and H is
+ * diagonal. Vertex i gets H_ii = heat * h_i / d_i^2, where d_i is its
+ * distance to the nearest bone and h_i its mean edge length (the graph
+ * Laplacian carries one length factor the continuous one doesn't). p_j
+ * is 1 on the vertices labelled for bone j (nearest bone, optionally
+ * geodesic flood) and 0 elsewhere. L + H is SPD on any graph, including
+ * non-manifold edges, holes and loose parts, so the solve can't fail the
+ * way the Blender operator does.
+ *
+ * Solved with multigrid-preconditioned CG (see HeatMultigrid), HEAT_BATCH
+ * bones at a time. The
+ * right-hand sides share each CSR sweep, and vectors are interleaved
+ * [vertex * HEAT_BATCH + j]. Sweeps and dot products run on fixed vertex
+ * chunks and reduce in chunk order, so results don't depend on the
+ * thread count.
+ */
+const int HEAT_BATCH = 4;
+const int HEAT_VERT_GRAIN = 4096;
+
+struct HeatParams {
+    float heat;         // H scale (Blender: 1.0)
+    float min_weight;   // Solved weights below this are dropped
+    float tolerance;    // Relative residual |r| / |b| per bone
+    int max_iterations; // Per batch
+    int max_influence;  // Bone groups kept per vertex (normalized)
+    int use_geodesic;   // Labels refined by flood_bone_labels
+};
+
+/**
+ * Heat Multigrid (aggregation AMG, the PCG preconditioner)
+ *
+ * Jacobi-PCG needs O(sqrt n) iterations on a mesh Laplacian. Each level
+ * instead groups every vertex with its free neighbours (aggregate_level),
+ * and the coarse operator is the Galerkin sum of L + H over aggregates
+ * (piecewise-constant prolongation, so it is again "diag - CSR weights").
+ * One symmetric V-cycle with weighted Jacobi smoothing and a scaled
+ * coarse correction approximates (L + H)^-1; the coarsest level is
+ * factored densely (Cholesky). Aggregation is
+ * sequential and every sweep runs per vertex, so the preconditioner
+ * doesn't depend on the thread count either.
+ */
+const int HEAT_COARSE_VERTS = 256; // Dense solve at or below this size
+const int HEAT_MAX_LEVELS = 16;
+const int HEAT_SMOOTH_SWEEPS = 2;  // Jacobi sweeps before and after the coarse correction
+const float HEAT_JACOBI_OMEGA = 0.9f;
+const float HEAT_COARSE_SCALE = 1.8f; // Over-correction: piecewise-constant aggregates undershoot
+
+struct HeatLevel {
+    int num_verts = 0;
+    const int* starts = nullptr;   // A_ij = -weights[e] for j = indices[e]
+    const int* indices = nullptr;
+    const float* weights = nullptr;
+    const float* diag = nullptr;   // A_ii
+    std::vector<int> own_starts, own_indices;  // Coarse levels own their CSR
+    std::vector<float> own_weights, own_diag;
+    std::vector<int> aggregate;    // Vertex -> coarse vertex (all but the coarsest)
+    std::vector<int> member_starts, members; // Coarse vertex -> its vertices
+    std::vector<float> b, x, r;    // Batched [num_verts * HEAT_BATCH]
+
+    void own() {
+        starts = own_starts.data(); indices = own_indices.data();
+        weights = own_weights.data(); diag = own_diag.data();
+    }
+};
+
+// Vaněk-style aggregation: roots with all neighbours free take them, the
+// leftovers join their strongest aggregated neighbour. Returns the count.
+static int aggregate_level(const HeatLevel& fine, std::vector<int>& agg) {
+    const int n = fine.num_verts;
+    agg.assign(n, -1);
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        if (agg[i] >= 0) continue;
+        bool free = true;
+        for (int e = fine.starts[i]; e < fine.starts[i + 1] && free; ++e) free = agg[fine.indices[e]] < 0;
+        if (!free) continue;
+        agg[i] = count;
+        for (int e = fine.starts[i]; e < fine.starts[i + 1]; ++e) agg[fine.indices[e]] = count;
+        ++count;
+    }
+    std::vector<int> joined(agg);
+    for (int i = 0; i < n; ++i) {
+        if (agg[i] >= 0) continue;
+        float strongest = -1.0f;
+        for (int e = fine.starts[i]; e < fine.starts[i + 1]; ++e) {
+            int a = agg[fine.indices[e]];
+            if (a >= 0 && fine.weights[e] > strongest) { strongest = fine.weights[e]; joined[i] = a; }
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (joined[i] < 0) joined[i] = count++; // No aggregated neighbour (loose vertex)
+    }
+    agg.swap(joined);
+    return count;
+}
+
+struct HeatMultigrid {
+    KernelPool& kp;
+    std::vector<HeatLevel> levels;
+    int dense_n = 0;
+    std::vector<double> chol; // Coarsest level, lower triangle [dense_n * dense_n]
+
+    HeatMultigrid(KernelPool& pool, int num_verts, const int* adj_starts, const int* adj_indices,
+                  const float* adj_weights, const float* diag) : kp(pool) {
+        levels.reserve(HEAT_MAX_LEVELS);
+        levels.emplace_back();
+        HeatLevel& top = levels.back();
+        top.num_verts = num_verts;
+        top.starts = adj_starts; top.indices = adj_indices; top.weights = adj_weights; top.diag = diag;
+
+        while ((int)levels.size() < HEAT_MAX_LEVELS && levels.back().num_verts > HEAT_COARSE_VERTS) {
+            HeatLevel& fine = levels.back();
+            int nc = aggregate_level(fine, fine.aggregate);
+            if (nc * 4 > fine.num_verts * 3) { fine.aggregate.clear(); break; } // Stalled (loose parts)
+
+            fine.member_starts.assign(nc + 1, 0);
+            for (int i = 0; i < fine.num_verts; ++i) fine.member_starts[fine.aggregate[i] + 1]++;
+            for (int c = 0; c < nc; ++c) fine.member_starts[c + 1] += fine.member_starts[c];
+            fine.members.resize(fine.num_verts);
+            std::vector<int> fill(fine.member_starts.begin(), fine.member_starts.end() - 1);
+            for (int i = 0; i < fine.num_verts; ++i) fine.members[fill[fine.aggregate[i]]++] = i;
+
+            // Galerkin: A_c[I][J] = sum of A_ij over i in I, j in J
+            HeatLevel coarse;
+            coarse.num_verts = nc;
+            coarse.own_diag.assign(nc, 0.0f);
+            coarse.own_starts.assign(nc + 1, 0);
+            std::vector<int> slot(nc, -1);
+            for (int c = 0; c < nc; ++c) {
+                int row_begin = (int)coarse.own_indices.size();
+                double d = 0.0;
+                for (int m = fine.member_starts[c]; m < fine.member_starts[c + 1]; ++m) {
+                    int i = fine.members[m];
+                    d += fine.diag[i];
+                    for (int e = fine.starts[i]; e < fine.starts[i + 1]; ++e) {
+                        int cj = fine.aggregate[fine.indices[e]];
+                        if (cj == c) { d -= fine.weights[e]; continue; }
+                        if (slot[cj] < row_begin) {
+                            slot[cj] = (int)coarse.own_indices.size();
+                            coarse.own_indices.push_back(cj);
+                            coarse.own_weights.push_back(0.0f);
+                        }
+                        coarse.own_weights[slot[cj]] += fine.weights[e];
+                    }
+                }
+                coarse.own_diag[c] = (float)d;
+                coarse.own_starts[c + 1] = (int)coarse.own_indices.size();
+            }
+            levels.push_back(std::move(coarse));
+            levels.back().own();
+        }
+        for (HeatLevel& l : levels) {
+            size_t slots = (size_t)l.num_verts * HEAT_BATCH;
+            l.b.resize(slots); l.x.resize(slots); l.r.resize(slots);
+        }
+        factor_coarsest();
+    }
+
+    // Dense Cholesky of the coarsest level when it is small enough
+    void factor_coarsest() {
+        const HeatLevel& l = levels.back();
+        if (l.num_verts > HEAT_COARSE_VERTS * 4) return; // Stalled large: Jacobi sweeps only
+        const int n = dense_n = l.num_verts;
+        chol.assign((size_t)n * n, 0.0);
+        for (int i = 0; i < n; ++i) {
+            chol[(size_t)i * n + i] = l.diag[i];
+            for (int e = l.starts[i]; e < l.starts[i + 1]; ++e) chol[(size_t)i * n + l.indices[e]] -= l.weights[e];
+        }
+        for (int j = 0; j < n; ++j) {
+            double* row_j = chol.data() + (size_t)j * n;
+            double d = row_j[j];
+            for (int k = 0; k < j; ++k) d -= row_j[k] * row_j[k];
+            row_j[j] = std::sqrt(std::max(d, 1e-30));
+            for (int i = j + 1; i < n; ++i) {
+                double* row_i = chol.data() + (size_t)i * n;
+                double s = row_i[j];
+                for (int k = 0; k < j; ++k) s -= row_i[k] * row_j[k];
+                row_i[j] = s / row_j[j];
+            }
+        }
+    }
+
+    // r = b - A x on level l
+    void residual(HeatLevel& l) {
+        kp.threads.parallel_for(l.num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                float sum[HEAT_BATCH];
+                for (int j = 0; j < HEAT_BATCH; ++j) sum[j] = l.b[(size_t)i * HEAT_BATCH + j] - l.diag[i] * l.x[(size_t)i * HEAT_BATCH + j];
+                for (int e = l.starts[i]; e < l.starts[i + 1]; ++e) {
+                    const float* xk = l.x.data() + (size_t)l.indices[e] * HEAT_BATCH;
+                    for (int j = 0; j < HEAT_BATCH; ++j) sum[j] += l.weights[e] * xk[j];
+                }
+                for (int j = 0; j < HEAT_BATCH; ++j) l.r[(size_t)i * HEAT_BATCH + j] = sum[j];
+            }
+        });
+    }
+
+    // x += omega D^-1 (b - A x), sweeps times
+    void smooth(HeatLevel& l, int sweeps) {
+        for (int s = 0; s < sweeps; ++s) {
+            residual(l);
+            kp.threads.parallel_for(l.num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+                for (int i = begin; i < end; ++i) {
+                    float scale = HEAT_JACOBI_OMEGA / l.diag[i];
+                    for (int j = 0; j < HEAT_BATCH; ++j) l.x[(size_t)i * HEAT_BATCH + j] += scale * l.r[(size_t)i * HEAT_BATCH + j];
+                }
+            });
+        }
+    }
+
+    void solve_coarsest(HeatLevel& l) {
+        if (dense_n != l.num_verts) {
+            std::fill(l.x.begin(), l.x.end(), 0.0f);
+            smooth(l, HEAT_SMOOTH_SWEEPS * 4);
+            return;
+        }
+        const int n = dense_n;
+        std::vector<double> y(n);
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            for (int i = 0; i < n; ++i) {
+                double s = l.b[(size_t)i * HEAT_BATCH + j];
+                for (int k = 0; k < i; ++k) s -= chol[(size_t)i * n + k] * y[k];
+                y[i] = s / chol[(size_t)i * n + i];
+            }
+            for (int i = n - 1; i >= 0; --i) {
+                double s = y[i];
+                for (int k = i + 1; k < n; ++k) s -= chol[(size_t)k * n + i] * y[k];
+                y[i] = s / chol[(size_t)i * n + i];
+            }
+            for (int i = 0; i < n; ++i) l.x[(size_t)i * HEAT_BATCH + j] = (float)y[i];
+        }
+    }
+
+    void vcycle(int level) {
+        HeatLevel& l = levels[level];
+        if (level + 1 == (int)levels.size()) { solve_coarsest(l); return; }
+        std::fill(l.x.begin(), l.x.end(), 0.0f);
+        smooth(l, HEAT_SMOOTH_SWEEPS);
+        residual(l);
+
+        HeatLevel& c = levels[level + 1];
+        kp.threads.parallel_for(c.num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int ci = begin; ci < end; ++ci) {
+                float sum[HEAT_BATCH] = {};
+                for (int m = l.member_starts[ci]; m < l.member_starts[ci + 1]; ++m) {
+                    const float* rk = l.r.data() + (size_t)l.members[m] * HEAT_BATCH;
+                    for (int j = 0; j < HEAT_BATCH; ++j) sum[j] += rk[j];
+                }
+                for (int j = 0; j < HEAT_BATCH; ++j) c.b[(size_t)ci * HEAT_BATCH + j] = sum[j];
+            }
+        });
+        vcycle(level + 1);
+
+        kp.threads.parallel_for(l.num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                const float* xc = c.x.data() + (size_t)l.aggregate[i] * HEAT_BATCH;
+                for (int j = 0; j < HEAT_BATCH; ++j) l.x[(size_t)i * HEAT_BATCH + j] += HEAT_COARSE_SCALE * xc[j];
+            }
+        });
+        smooth(l, HEAT_SMOOTH_SWEEPS);
+    }
+
+    // z = M^-1 r (one V-cycle), both [num_verts * HEAT_BATCH]
+    void precondition(const float* r, float* z) {
+        HeatLevel& top = levels[0];
+        std::copy(r, r + top.b.size(), top.b.begin());
+        vcycle(0);
+        std::copy(top.x.begin(), top.x.end(), z);
+    }
+};
+
+// Batched PCG state and the fixed-chunk reductions
+struct HeatSolver {
+    KernelPool& kp;
+    int num_verts;
+    const int* adj_starts;
+    const int* adj_indices;
+    const float* adj_weights;
+    const std::vector<float>& diag; // L_ii + H_ii
+    HeatMultigrid& mg;
+    int num_chunks;
+    std::vector<double> partial;    // [num_chunks * HEAT_BATCH * 2]
+
+    // q = (L + H) p.  out_pq[j] = dot(p_j, q_j)
+    void apply(const float* p, float* q, double* out_pq) {
+        kp.threads.parallel_for(num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            double* acc = partial.data() + (size_t)(begin / HEAT_VERT_GRAIN) * HEAT_BATCH * 2;
+            for (int j = 0; j < HEAT_BATCH; ++j) acc[j] = 0.0;
+            for (int i = begin; i < end; ++i) {
+                float sum[HEAT_BATCH];
+                for (int j = 0; j < HEAT_BATCH; ++j) sum[j] = diag[i] * p[(size_t)i * HEAT_BATCH + j];
+                for (int e = adj_starts[i]; e < adj_starts[i + 1]; ++e) {
+                    const float* pk = p + (size_t)adj_indices[e] * HEAT_BATCH;
+                    float a = adj_weights[e];
+                    for (int j = 0; j < HEAT_BATCH; ++j) sum[j] -= a * pk[j];
+                }
+                for (int j = 0; j < HEAT_BATCH; ++j) {
+                    q[(size_t)i * HEAT_BATCH + j] = sum[j];
+                    acc[j] += (double)p[(size_t)i * HEAT_BATCH + j] * sum[j];
+                }
+            }
+        });
+        reduce(out_pq, nullptr);
+    }
+
+    // Sums the first (and second) HEAT_BATCH partials of every chunk in order
+    void reduce(double* out_a, double* out_b) {
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            double a = 0.0, b = 0.0;
+            for (int c = 0; c < num_chunks; ++c) {
+                a += partial[(size_t)c * HEAT_BATCH * 2 + j];
+                b += partial[(size_t)c * HEAT_BATCH * 2 + HEAT_BATCH + j];
+            }
+            if (out_a) out_a[j] = a;
+            if (out_b) out_b[j] = b;
+        }
+    }
+};
+
+/**
+ * Solves bones [first, first + count) (count <= HEAT_BATCH) into
+ * x [num_verts * HEAT_BATCH]. rhs_scale: H_ii, labels: bone per vertex.
+ * Warm start: x = p, preconditioned by one multigrid V-cycle per
+ * iteration. Returns the iterations used (max over the batch), which is
+ * params.max_iterations when a bone did not converge.
+ */
+static int heat_solve_batch(HeatSolver& solver, const std::vector<float>& h, const std::vector<int>& labels,
+                            int first, int count, const HeatParams& params,
+                            std::vector<float>& x, std::vector<float>& r,
+                            std::vector<float>& p, std::vector<float>& q, const JobControl* job) {
+    const int nv = solver.num_verts;
+    auto in_batch = [&](int j) { return j < count; };
+
+    // x0 = p_j, r0 = b - A x0 (b = H p_j), z0 = M^-1 r0, p0 = z0
+    for (int i = 0; i < nv; ++i) {
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            x[(size_t)i * HEAT_BATCH + j] = (in_batch(j) && labels[i] == first + j) ? 1.0f : 0.0f;
+        }
+    }
+    double unused[HEAT_BATCH];
+    solver.apply(x.data(), q.data(), unused);
+
+    double rz[HEAT_BATCH], rr[HEAT_BATCH], bb[HEAT_BATCH] = {};
+    for (int i = 0; i < nv; ++i) {
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            size_t s = (size_t)i * HEAT_BATCH + j;
+            float b = x[s] > 0.0f ? h[i] : 0.0f;
+            bb[j] += (double)b * b;
+            r[s] = b - q[s];
+        }
+    }
+    // z (kept in q until the next apply) = M^-1 r, then rz = r.z, rr = r.r
+    auto precondition_dots = [&]() {
+        solver.mg.precondition(r.data(), q.data());
+        solver.kp.threads.parallel_for(nv, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            double* acc = solver.partial.data() + (size_t)(begin / HEAT_VERT_GRAIN) * HEAT_BATCH * 2;
+            for (int j = 0; j < HEAT_BATCH * 2; ++j) acc[j] = 0.0;
+            for (int i = begin; i < end; ++i) {
+                for (int j = 0; j < HEAT_BATCH; ++j) {
+                    double rv = r[(size_t)i * HEAT_BATCH + j];
+                    acc[j] += rv * q[(size_t)i * HEAT_BATCH + j];
+                    acc[HEAT_BATCH + j] += rv * rv;
+                }
+            }
+        });
+        solver.reduce(rz, rr);
+    };
+    precondition_dots();
+    std::copy(q.begin(), q.end(), p.begin());
+
+    bool active[HEAT_BATCH];
+    for (int j = 0; j < HEAT_BATCH; ++j) {
+        double tol = (double)params.tolerance * params.tolerance * bb[j];
+        active[j] = in_batch(j) && bb[j] > 0.0 && rr[j] > tol;
+    }
+
+    int iter = 0;
+    for (; iter < params.max_iterations; ++iter) {
+        bool any = false;
+        for (int j = 0; j < HEAT_BATCH; ++j) any |= active[j];
+        if (!any || (job && job->cancelled())) break;
+
+        double pq[HEAT_BATCH];
+        solver.apply(p.data(), q.data(), pq);
+        float alpha[HEAT_BATCH];
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            alpha[j] = (active[j] && pq[j] > 0.0) ? (float)(rz[j] / pq[j]) : 0.0f;
+        }
+        solver.kp.threads.parallel_for(nv, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                for (int j = 0; j < HEAT_BATCH; ++j) {
+                    size_t s = (size_t)i * HEAT_BATCH + j;
+                    x[s] += alpha[j] * p[s];
+                    r[s] -= alpha[j] * q[s];
+                }
+            }
+        });
+
+        double rz_old[HEAT_BATCH];
+        std::copy(rz, rz + HEAT_BATCH, rz_old);
+        precondition_dots();
+        float beta[HEAT_BATCH];
+        for (int j = 0; j < HEAT_BATCH; ++j) {
+            if (active[j] && rr[j] <= (double)params.tolerance * params.tolerance * bb[j]) active[j] = false;
+            beta[j] = (active[j] && rz_old[j] > 0.0) ? (float)(rz[j] / rz_old[j]) : 0.0f;
+        }
+        solver.kp.threads.parallel_for(nv, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                for (int j = 0; j < HEAT_BATCH; ++j) {
+                    size_t s = (size_t)i * HEAT_BATCH + j;
+                    p[s] = active[j] ? q[s] + beta[j] * p[s] : 0.0f;
+                }
+            }
+        });
+    }
+    return iter;
+}
+
+/**
+ * Heat weights for every vertex: bones' solved weights (>= min_weight),
+ * the max_influence heaviest, normalized, replace the bone group slots of
+ * weight_indices / weight_values [num_verts * MAX_STORAGE] in place
+ * (bone group ids from bone_groups). Non-bone groups are kept after them,
+ * as in binary_weights_strided. A vertex no bone reaches keeps its nearest
+ * bone at 1.0. out_iterations: [num_bones] or NULL. job: one unit per
+ * batch of HEAT_BATCH bones, weights untouched when cancelled.
+ * Returns the largest iteration count, -1 if cancelled.
+ */
+static int heat_weights_impl(
+    KernelPool& kp,
+    int num_verts,
+    const float* vert_coords,
+    const int* adj_starts,
+    const int* adj_indices,
+    const float* adj_weights,
+    int num_bones,
+    const float* bone_segments,
+    const float* bone_radii,
+    const int* bone_groups,
+    const HeatParams& params,
+    int* weight_indices,
+    float* weight_values,
+    int* out_iterations,
+    JobControl* job = nullptr
+) {
+    BoneBVH bvh;
+    build_bone_bvh(bvh, num_bones, bone_segments, bone_radii);
+    std::vector<int> labels(num_verts);
+    std::vector<float> dist(num_verts);
+    kp.threads.parallel_for(num_verts, BINARY_VERT_GRAIN, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) labels[v] = nearest_bone_bvh(bvh, vert_coords + (size_t)v * 3, &dist[v]);
+    });
+    if (params.use_geodesic) {
+        flood_bone_labels(num_verts, vert_coords, adj_starts, adj_indices, bvh, num_bones, labels.data(), dist.data());
+    }
+
+    // diag = L_ii + H_ii, h = H_ii
+    std::vector<float> diag(num_verts), h(num_verts);
+    kp.threads.parallel_for(num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            float a_sum = 0.0f, len_sum = 0.0f;
+            int degree = adj_starts[v + 1] - adj_starts[v];
+            for (int e = adj_starts[v]; e < adj_starts[v + 1]; ++e) {
+                a_sum += adj_weights[e];
+                len_sum += adj_weights[e] > 0.0f ? 1.0f / adj_weights[e] : 0.0f;
+            }
+            float mean_len = degree > 0 ? len_sum / degree : 1.0f;
+            float d = std::max(dist[v], 0.5f * mean_len); // Inside a capsule / on the bone: finite heat
+            h[v] = params.heat * mean_len / (d * d);
+            diag[v] = a_sum + h[v];
+        }
+    });
+
+    int num_chunks = std::max(1, (num_verts + HEAT_VERT_GRAIN - 1) / HEAT_VERT_GRAIN);
+    HeatMultigrid mg(kp, num_verts, adj_starts, adj_indices, adj_weights, diag.data());
+    HeatSolver solver{kp, num_verts, adj_starts, adj_indices, adj_weights, diag, mg, num_chunks,
+                      std::vector<double>((size_t)num_chunks * HEAT_BATCH * 2)};
+    size_t slots = (size_t)num_verts * HEAT_BATCH;
+    std::vector<float> x(slots), r(slots), p(slots), q(slots);
+
+    // Running top MAX_STORAGE bones per vertex
+    std::vector<VertexWeight> best((size_t)num_verts * MAX_STORAGE, VertexWeight{-1, 0.0f});
+    int max_iter = 0;
+    for (int first = 0; first < num_bones; first += HEAT_BATCH) {
+        int count = std::min(HEAT_BATCH, num_bones - first);
+        int iters = heat_solve_batch(solver, h, labels, first, count, params, x, r, p, q, job);
+        if (job && !job->advance()) return -1;
+        max_iter = std::max(max_iter, iters);
+        if (out_iterations) for (int j = 0; j < count; ++j) out_iterations[first + j] = iters;
+
+        kp.threads.parallel_for(num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int v = begin; v < end; ++v) {
+                VertexWeight* list = best.data() + (size_t)v * MAX_STORAGE;
+                for (int j = 0; j < count; ++j) {
+                    float w = std::min(x[(size_t)v * HEAT_BATCH + j], 1.0f);
+                    if (w < params.min_weight || w <= 0.0f || bone_groups[first + j] < 0) continue;
+                    // Insert sorted (descending), drop the lightest when full
+                    int pos = MAX_STORAGE;
+                    while (pos > 0 && (list[pos - 1].group_index < 0 || w > list[pos - 1].weight)) --pos;
+                    if (pos >= MAX_STORAGE) continue;
+                    for (int k = MAX_STORAGE - 1; k > pos; --k) list[k] = list[k - 1];
+                    list[pos] = {first + j, w};
+                }
+            }
+        });
+    }
+
+    int max_group = -1;
+    for (int b = 0; b < num_bones; ++b) max_group = std::max(max_group, bone_groups[b]);
+    std::vector<unsigned char> is_bone(max_group + 1, 0);
+    for (int b = 0; b < num_bones; ++b) {
+        if (bone_groups[b] >= 0) is_bone[bone_groups[b]] = 1;
+    }
+
+    int cap = std::min(std::max(params.max_influence, 1), MAX_STORAGE);
+    kp.threads.parallel_for(num_verts, HEAT_VERT_GRAIN, [&](int begin, int end, int) {
+        for (int v = begin; v < end; ++v) {
+            const VertexWeight* list = best.data() + (size_t)v * MAX_STORAGE;
+            int g[MAX_STORAGE];
+            float w[MAX_STORAGE];
+            int count = 0;
+            float total = 0.0f;
+            while (count < cap && list[count].group_index >= 0) total += list[count++].weight;
+            if (count == 0 || total <= 0.0f) {
+                g[0] = bone_groups[labels[v]];
+                w[0] = 1.0f;
+                count = g[0] >= 0 ? 1 : 0;
+            } else {
+                for (int k = 0; k < count; ++k) {
+                    g[k] = bone_groups[list[k].group_index];
+                    w[k] = list[k].weight / total;
+                }
+            }
+
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            for (int k = 0; k < MAX_STORAGE && count < MAX_STORAGE; ++k) {
+                int grp = weight_indices[v_base + k];
+                if (grp < 0) continue;
+                if (grp <= max_group && is_bone[grp]) continue;
+                g[count] = grp;
+                w[count++] = weight_values[v_base + k];
+            }
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                weight_indices[v_base + k] = k < count ? g[k] : -1;
+                weight_values[v_base + k] = k < count ? w[k] : 0.0f;
+            }
+        }
+    });
+    return max_iter;
+}
+
+/**
+ * Bounded Geodesic Distance (Dijkstra over the CSR)
+ *
+ * Distances grow from the seeds along mesh edges and stop at max_distance,
+ * so brushes and falloffs don't bleed across surfaces that are close in
+ * space but not connected (fingers, lips). Scratch is sized once per mesh
+ * and reset by stamping, and the heap keeps its capacity: a query only
+ * touches the vertices it reaches.
+ *
+ * metric: 0 = edge length (recovered from the CSR inverse-distance
+ *         weights), 1 = hop count (edit-mode falloff rings).
+ */
+struct GeodesicScratch {
+    std::vector<float> dist;
+    std::vector<int> stamp;   // dist[v] valid when stamp[v] == current
+    std::vector<int> settled; // settled[v] == current once popped
+    std::vector<std::pair<float, int>> heap;
+    int current = 0;
+
+    void begin(int num_verts) {
+        if (stamp.size() < (size_t)num_verts) {
+            dist.resize(num_verts);
+            stamp.assign(num_verts, 0);
+            settled.assign(num_verts, 0);
+            current = 0;
+        }
+        if (++current == 0x7FFFFFFF) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            std::fill(settled.begin(), settled.end(), 0);
+            current = 1;
+        }
+        heap.clear();
+    }
+
+    void push(int v, float d) {
+        if (stamp[v] == current && dist[v] <= d) return;
+        stamp[v] = current;
+        dist[v] = d;
+        heap.push_back(std::make_pair(d, v));
+        std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<float, int>>());
+    }
+
+    /**
+     * seeds / seed_dist: start vertices and their initial distance (NULL = 0).
+     * Writes reached vertices (distance < max_distance) in settle order,
+     * i.e. by increasing distance. Returns the count (capped at max_out).
+     */
+    int run(int num_verts,
+            const int* adj_starts, const int* adj_indices, const float* adj_weights,
+            const int* seeds, const float* seed_dist, int num_seeds,
+            float max_distance, int metric,
+            int* out_indices, float* out_dist, int max_out) {
+        begin(num_verts);
+        for (int i = 0; i < num_seeds; ++i) {
+            int v = seeds[i];
+            if (v < 0 || v >= num_verts) continue;
+            float d = seed_dist ? std::max(seed_dist[i], 0.0f) : 0.0f;
+            if (d < max_distance) push(v, d);
+        }
+
+        int count = 0;
+        std::greater<std::pair<float, int>> cmp;
+        while (!heap.empty() && count < max_out) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            std::pair<float, int> top = heap.back();
+            heap.pop_back();
+            int v = top.second;
+            if (settled[v] == current || top.first > dist[v]) continue; // Stale entry
+            settled[v] = current;
+            out_indices[count] = v;
+            if (out_dist) out_dist[count] = top.first;
+            count++;
+
+            for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+                int u = adj_indices[i];
+                if (settled[u] == current) continue;
+                // edge_weight = 1 / (length + 0.0001)
+                float len = metric == 1 ? 1.0f : std::max(1.0f / adj_weights[i] - 0.0001f, 0.0f);
+                float d = top.first + len;
+                if (d < max_distance) push(u, d);
+            }
+        }
+        return count;
+    }
+};
+
+/**
+ * Geodesic footprint: run() + brush_falloff on the distances
+ * (radius = max_distance), factor = strength * falloff.
+ */
+static int geodesic_falloff_query(
+    GeodesicScratch& scratch, int num_verts,
+    const int* adj_starts, const int* adj_indices, const float* adj_weights,
+    const int* seeds, const float* seed_dist, int num_seeds,
+    float max_distance, int metric, int falloff_mode, float strength,
+    int* out_indices, float* out_factors, int max_out
+) {
+    if (max_distance <= 0.0f) return 0;
+    int count = scratch.run(num_verts, adj_starts, adj_indices, adj_weights, seeds, seed_dist, num_seeds,
+                            max_distance, metric, out_indices, out_factors, max_out);
+    float r_sq = max_distance * max_distance;
+    for (int i = 0; i < count; ++i) {
+        float d = out_factors[i];
+        out_factors[i] = strength * brush_falloff(d * d, r_sq, max_distance, falloff_mode);
+    }
+    return count;
+}
+
+/**
+ * Smear / Harden (shared implementation, see apply_vertex_logic_strided)
+ */
+template <typename Storage, int MaxInfluence = MAX_INFLUENCE>
+static void apply_vertex_logic_impl(
+    const Storage& store,
+    const int* target_indices,
+    const float* target_factors,
+    int num_targets,
+    int active_group_index,
+    int mode, // 0=Smear, 1=Harden
+    float smear_value,
+    DeltaOut* delta,
+    const GroupFlags* flags = nullptr
+) {
+    // Smear never edits a locked / excluded active group
+    if (mode == 0 && flags && flags->pinned(active_group_index)) return;
+
+    for (int t = 0; t < num_targets; ++t) {
+        int v_idx = target_indices[t];
+        float factor = target_factors[t];
+        int v_base = v_idx * MAX_STORAGE;
+        
+        // 1. Read Current Weights
+        VertexWeight weights[MAX_STORAGE];
+        int count = 0;
+        float cur_w = 0.0f;
+        
+        // For Harden Mode (1), track the dominant influence
+        int best_idx = -1;
+        float best_w = -1.0f;
+
+        for(int k=0; k<MAX_STORAGE; ++k) {
+            int g = store.group(v_base + k);
+            float w = store.weight(v_base + k);
+            if (g >= 0 && w > 0.0f) {
+                weights[count] = {g, w};
+                
+                if (g == active_group_index) {
+                     cur_w = w;
+                }
+                // Track max for Harden (free deform groups only when flagged)
+                if (w > best_w && (!flags || flags->free_deform(g))) {
+                    best_w = w;
+                    best_idx = count; 
+                }
+                count++;
+            }
+        }
+        
+        // 2. Compute New Weight
+        float new_w = cur_w;
+        int target_group = active_group_index; // Default to active
+
+        if (mode == 0) { // Smear
+             // If smear_value is -1, usually we do nothing, but Python handles that check.
+             // checking here just in case.
+             if (smear_value >= 0.0f) {
+                 new_w = cur_w + (smear_value - cur_w) * factor;
+             }
+        } else if (mode == 1) { // Harden (Push Dominant to 1.0)
+            // Identify dominant
+            if (best_idx >= 0) {
+                target_group = weights[best_idx].group_index;
+                float dom_w = weights[best_idx].weight;
+                
+                // Logic: Push towards 1.0
+                // new = dom + (1.0 - dom) * factor
+                // or linear add?
+                // User: "60% -> 70%". If factor is "strength", let's assume factor is approx 0.1-0.5 range.
+                // Lerp approach is safer (no overshoot).
+                new_w = dom_w + (1.0f - dom_w) * factor;
+            }
+        }
+        
+        if (active_group_index == target_group && std::abs(new_w - cur_w) < 0.0001f) continue;
+        // For harden, target_group might not be active_group_index.
+        // But we check change against the target's old weight.
+        if (mode == 1 && best_idx >= 0) {
+             if (std::abs(new_w - weights[best_idx].weight) < 0.0001f) continue;
+        }
+
+        // Snapshot for dirty tracking + pinned slots (early-outs above never get here)
+        int before_g[MAX_STORAGE];
+        float before_w[MAX_STORAGE];
+        store.load(v_base, before_g, before_w);
+
+        // 3. Update Buffer
+        bool found = false;
+        for(int k=0; k<count; ++k) {
+            if (weights[k].group_index == target_group) {
+                weights[k].weight = new_w;
+                found = true;
+                break;
+            }
+        }
+        if (!found && new_w > 0.0001f) {
+            if (count < MAX_STORAGE) {
+                weights[count++] = {target_group, new_w};
+            } else {
+                 // Replace smallest if new_w is significant?
+                 // Simplest: Replace index 0?
+                 // Implementation: Sort by weight ascending and replace first if smaller?
+                 // For now, if full, we skip adding (rare case for >8 groups).
+            }
+        }
+        
+        // 4. Sort & Limit & Normalize
+        int out_g[MAX_STORAGE];
+        float out_w[MAX_STORAGE];
+        finalize_vertex_weights<MaxInfluence>(weights, count, before_g, before_w, flags, out_g, out_w);
+
+        Storage::round_trip(out_g, out_w);
+        store.store(v_base, out_g, out_w);
+
+        if (delta) delta->record_if_changed(v_idx, before_g, before_w, out_g, out_w);
+    }
+}
+
+/**
+ * Sampled Smear (Jacobi, snapshot like smooth_jacobi_pass)
+ *
+ * Each target pulls every group from the surface the stroke dragged over
+ * it: the nearest vertex (spatial index) to its position minus `offset`
+ * (stroke delta), blended as lerp(self, source, factor). Phase 1 only
+ * reads the unmodified store, so a dab never smears its own output and
+ * the result is independent of target order and thread count. Pinned
+ * groups keep their slots (finalize_vertex_weights).
+ *
+ * vert_coords: [num_verts * 3] in the grid's space.
+ * mirror_map (optional): targets [mirror_from, num_targets) are the
+ * X-mirror side; they sample at their counterpart's displaced position
+ * and read that source's counterpart (same side groups, no remap).
+ */
+template <typename Storage, int MaxInfluence = MAX_INFLUENCE>
+static void smear_sampled_pass(
+    KernelPool& kp,
+    const SpatialGrid& grid,
+    const float* vert_coords,
+    int num_verts,
+    const Storage& store,
+    const int* target_indices,
+    const float* target_factors,
+    int num_targets,
+    const float* offset,
+    const int* mirror_map,
+    int mirror_from,
+    DeltaOut* delta,
+    const GroupFlags* flags = nullptr
+) {
+    kp.reserve_targets(num_targets);
+    int* out_groups = kp.out_groups.data();
+    float* out_weights = kp.out_weights.data();
+    unsigned char* out_valid = kp.out_valid.data();
+
+    // 1. Compute (Read snapshot -> Write output buffer)
+    kp.threads.parallel_for(num_targets, TARGET_GRAIN, [&](int begin, int end, int) {
+        for (int t = begin; t < end; ++t) {
+            out_valid[t] = 0;
+            int v = target_indices[t];
+            bool mirrored = mirror_map && t >= mirror_from;
+            int q = mirrored ? mirror_map[v] : v;
+            if (q < 0 || q >= num_verts) continue;
+            float p[3];
+            for (int a = 0; a < 3; ++a) p[a] = vert_coords[(size_t)q * 3 + a] - offset[a];
+            int src = nearest_spatial_grid(grid, p, nullptr);
+            if (mirrored && src >= 0) src = mirror_map[src];
+            if (src < 0 || src >= num_verts || src == v) continue;
+
+            float f = std::min(std::max(target_factors[t], 0.0f), 1.0f);
+            int cur_g[MAX_STORAGE], src_g[MAX_STORAGE];
+            float cur_w[MAX_STORAGE], src_w[MAX_STORAGE];
+            store.load((size_t)v * MAX_STORAGE, cur_g, cur_w);
+            store.load((size_t)src * MAX_STORAGE, src_g, src_w);
+
+            VertexWeight list[MAX_STORAGE * 2];
+            int n = 0;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                if (cur_g[k] >= 0 && cur_w[k] > 0.0f) list[n++] = {cur_g[k], cur_w[k] * (1.0f - f)};
+            }
+            int own = n;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                if (src_g[k] < 0 || src_w[k] <= 0.0f) continue;
+                int i = 0;
+                while (i < own && list[i].group_index != src_g[k]) ++i;
+                if (i < own) list[i].weight += src_w[k] * f;
+                else list[n++] = {src_g[k], src_w[k] * f};
+            }
+
+            int* dst_g = out_groups + (size_t)t * MAX_STORAGE;
+            float* dst_w = out_weights + (size_t)t * MAX_STORAGE;
+            finalize_vertex_weights<MaxInfluence>(list, n, cur_g, cur_w, flags, dst_g, dst_w);
+            Storage::round_trip(dst_g, dst_w);
+            if (!DeltaOut::changed(cur_g, cur_w, dst_g, dst_w)) continue;
+            out_valid[t] = delta ? 2 : 1;
+        }
+    });
+
+    // 2. Commit (Output buffer -> Store)
+    commit_pool_output(kp, store, target_indices, num_targets, delta);
+}
+
+/**
+ * Gauss-Seidel smoothing (shared implementation, see smooth_strided)
+ */
+template <typename Storage, int MaxInfluence = MAX_INFLUENCE>
+static void smooth_seidel_impl(
+    const int* adj_starts,
+    const int* adj_indices,
+    const float* adj_weights,
+    const Storage& store,
+    const int* target_indices,
+    int num_targets,
+    float factor,
+    DeltaOut* delta,
+    const GroupFlags* flags = nullptr
+) {
+    // We need a temp buffer for the NEW weights to avoid reading partially updated state?
+    // Actually, pure smoothing usually wants snapshot state. 
+    // If we write back immediately, the next vertex might read the SMOOTHED value of its neighbor.
+    // This is "Seidel" iteration vs "Jacobi". 
+    // Seidel (immediate write) converges faster but is order-dependent.
+    // Jacobi (buffer write) is stable.
+    // Visual brushes usually prefer Seidel (smearing feel).
+    // BUT strict correctness suggests Jacobi. 
+    // Given we process a "Subset" (Brush Radius), order dependence is minimal visually.
+    // To be safe and maximize speed optimization (avoid allocs), we will try Immediate Write first.
+    
+    // HOWEVER: If we write fewer weights than existed, we must ensure we clean up.
+    // (smooth_vertex_strided always pads the remaining slots with -1/0.0)
+
+    // One accumulator for the whole call (no per-vertex allocation).
+    GroupAccumulator acc;
+
+    for (int t = 0; t < num_targets; ++t) {
+        int v_idx = target_indices[t];
+        int v_base = v_idx * MAX_STORAGE;
+
+        int new_groups[MAX_STORAGE];
+        float new_weights[MAX_STORAGE];
+        if (!smooth_vertex_strided<Storage, MaxInfluence>(
+                adj_starts, adj_indices, adj_weights,
+                store, v_idx, factor, acc, new_groups, new_weights, flags)) {
+            continue;
+        }
+        Storage::round_trip(new_groups, new_weights);
+
+        if (delta) {
+            int cur_g[MAX_STORAGE];
+            float cur_w[MAX_STORAGE];
+            store.load(v_base, cur_g, cur_w);
+            delta->record_if_changed(v_idx, cur_g, cur_w, new_groups, new_weights);
+        }
+
+        // Immediate Write (Seidel)
+        store.store(v_base, new_groups, new_weights);
+    }
+}
+
+/**
+ * Weight Pipeline (full-mesh cleanup, see weight_pipeline_strided)
+ *
+ * Blender's normalize_all / clean / limit_total / mirror each walk every
+ * deform-vert list. Here a sequence of them runs per vertex on its 8 slots
+ * in registers: consecutive per-vertex ops share one parallel sweep, only
+ * MIRROR (reads the counterpart vertex) splits the sequence into a second
+ * sweep over a snapshot. Slot order is kept (removed slots are compacted
+ * away), so untouched vertices compare equal.
+ *
+ * WeightOp.subset: 0 = all groups, 1 = deform groups only (group flags).
+ * Locked / excluded groups (GROUP_*) are never changed by any op.
+ */
+const int PIPE_NORMALIZE = 0; // ivalue: group kept as is (lock_active), -1 = none
+const int PIPE_CLEAN = 1;     // fvalue: remove weights <= limit, ivalue: 1 = keep the heaviest (keep_single)
+const int PIPE_LIMIT = 2;     // ivalue: influences kept per vertex (lightest removed, no normalize)
+const int PIPE_MIRROR = 3;    // Take the mirror vertex's weights (mirror_map + group_remap)
+
+struct WeightOp {
+    int type;
+    int subset;
+    int ivalue;
+    float fvalue;
+};
+
+const int PIPE_GRAIN = 4096;
+
+struct PipelineContext {
+    const GroupFlags* flags;
+    const unsigned char* vertex_mask; // NULL = every vertex
+    const int* mirror_map;            // NULL = MIRROR is a no-op
+    const int* group_remap;
+    int num_remap;
+
+    // Group takes part in an op of this subset
+    bool member(int g, int subset) const {
+        if (!flags) return true;
+        return subset == 1 ? flags->normalized(g) : !(flags->get(g) & GROUP_EXCLUDED);
+    }
+    bool pinned(int g) const { return flags && flags->pinned(g); }
+    int remap(int g) const { return (g >= 0 && g < num_remap && group_remap[g] >= 0) ? group_remap[g] : g; }
+};
+
+// Drops empty slots, keeps the order of the rest
+static void compact_slots(int* g, float* w) {
+    int count = 0;
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        if (g[k] < 0) continue;
+        g[count] = g[k];
+        w[count] = w[k];
+        count++;
+    }
+    for (int k = count; k < MAX_STORAGE; ++k) { g[k] = -1; w[k] = 0.0f; }
+}
+
+static void pipeline_vertex_op(const PipelineContext& ctx, const WeightOp& op, int* g, float* w) {
+    if (op.type == PIPE_NORMALIZE) {
+        float fixed = 0.0f, free_total = 0.0f;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || !ctx.member(g[k], op.subset)) continue;
+            if (ctx.pinned(g[k]) || g[k] == op.ivalue) fixed += w[k];
+            else free_total += w[k];
+        }
+        if (free_total <= 0.0f) return;
+        float ratio = std::max(0.0f, 1.0f - fixed) / free_total;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || !ctx.member(g[k], op.subset) || ctx.pinned(g[k]) || g[k] == op.ivalue) continue;
+            w[k] *= ratio;
+        }
+    } else if (op.type == PIPE_CLEAN) {
+        int heaviest = -1, members = 0, removed = 0;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || !ctx.member(g[k], op.subset)) continue;
+            members++;
+            if (heaviest < 0 || w[k] > w[heaviest]) heaviest = k;
+            if (!ctx.pinned(g[k]) && w[k] <= op.fvalue) removed++;
+        }
+        if (removed == 0) return;
+        bool keep_heaviest = op.ivalue == 1 && removed == members;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || !ctx.member(g[k], op.subset) || ctx.pinned(g[k]) || w[k] > op.fvalue) continue;
+            if (keep_heaviest && k == heaviest) continue;
+            g[k] = -1;
+            w[k] = 0.0f;
+        }
+        compact_slots(g, w);
+    } else if (op.type == PIPE_LIMIT) {
+        // Pinned members count toward the limit but are always kept
+        int budget = std::max(0, op.ivalue);
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] >= 0 && ctx.member(g[k], op.subset) && ctx.pinned(g[k])) budget--;
+        }
+        bool keep[MAX_STORAGE] = {};
+        for (int kept = 0; kept < budget; ++kept) {
+            int best = -1;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                if (g[k] < 0 || keep[k] || !ctx.member(g[k], op.subset) || ctx.pinned(g[k])) continue;
+                if (best < 0 || w[k] > w[best]) best = k; // Ties: earlier slot wins
+            }
+            if (best < 0) break;
+            keep[best] = true;
+        }
+        bool any = false;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (g[k] < 0 || keep[k] || !ctx.member(g[k], op.subset) || ctx.pinned(g[k])) continue;
+            g[k] = -1;
+            w[k] = 0.0f;
+            any = true;
+        }
+        if (any) compact_slots(g, w);
+    }
+}
+
+// Counterpart slots (groups remapped), own pinned slots kept first
+static void pipeline_mirror_vertex(const PipelineContext& ctx, const int* src_g, const float* src_w,
+                                   const int* own_g, const float* own_w, int* g, float* w) {
+    int count = 0;
+    for (int k = 0; k < MAX_STORAGE; ++k) {
+        if (own_g[k] >= 0 && ctx.pinned(own_g[k])) { g[count] = own_g[k]; w[count] = own_w[k]; count++; }
+    }
+    for (int k = 0; k < MAX_STORAGE && count < MAX_STORAGE; ++k) {
+        int m = src_g[k] >= 0 ? ctx.remap(src_g[k]) : -1;
+        if (m < 0 || ctx.pinned(m)) continue;
+        g[count] = m;
+        w[count] = src_w[k];
+        count++;
+    }
+    for (int k = count; k < MAX_STORAGE; ++k) { g[k] = -1; w[k] = 0.0f; }
+}
+
+// Pre-pipeline slots of the changed vertices, one list per (stage, chunk)
+struct PipelineRecord {
+    std::vector<std::vector<int>> verts;
+    std::vector<std::vector<int>> indices;
+    std::vector<std::vector<float>> values;
+};
+
+/**
+ * Runs ops[0..num_ops) over every (masked) vertex, in place.
+ * changed: [num_verts], zeroed by the caller, set to 1 for changed vertices.
+ * before (optional): slots of each changed vertex before its first change,
+ * in vertex order per stage (same for any thread count).
+ * Returns the number of changed vertices.
+ */
+static int weight_pipeline_impl(
+    KernelPool& kp,
+    int num_verts,
+    const StridedStorage& store,
+    const WeightOp* ops,
+    int num_ops,
+    const PipelineContext& ctx,
+    unsigned char* changed,
+    PipelineRecord* before
+) {
+    int num_chunks = (num_verts + PIPE_GRAIN - 1) / PIPE_GRAIN;
+    std::vector<int> chunk_changed(num_chunks, 0);
+    std::vector<int> snap_g;
+    std::vector<float> snap_w;
+
+    auto record = [&](size_t slot_base, int chunk, int v, const int* old_g, const float* old_w) {
+        if (!changed[v]) {
+            changed[v] = 1;
+            chunk_changed[chunk]++;
+            if (before) {
+                before->verts[slot_base + chunk].push_back(v);
+                before->indices[slot_base + chunk].insert(before->indices[slot_base + chunk].end(), old_g, old_g + MAX_STORAGE);
+                before->values[slot_base + chunk].insert(before->values[slot_base + chunk].end(), old_w, old_w + MAX_STORAGE);
+            }
+        }
+    };
+
+    int op = 0;
+    while (op < num_ops) {
+        bool mirror = ops[op].type == PIPE_MIRROR;
+        int stage_end = op + 1;
+        if (!mirror) {
+            while (stage_end < num_ops && ops[stage_end].type != PIPE_MIRROR) ++stage_end;
+        }
+        if (mirror && !ctx.mirror_map) { op = stage_end; continue; }
+
+        size_t slot_base = 0;
+        if (before) {
+            slot_base = before->verts.size();
+            before->verts.resize(slot_base + num_chunks);
+            before->indices.resize(slot_base + num_chunks);
+            before->values.resize(slot_base + num_chunks);
+        }
+        if (mirror) {
+            snap_g.assign(store.indices, store.indices + (size_t)num_verts * MAX_STORAGE);
+            snap_w.assign(store.values, store.values + (size_t)num_verts * MAX_STORAGE);
+        }
+
+        kp.threads.parallel_for(num_verts, PIPE_GRAIN, [&](int begin, int end, int) {
+            int chunk = begin / PIPE_GRAIN;
+            for (int v = begin; v < end; ++v) {
+                if (ctx.vertex_mask && !ctx.vertex_mask[v]) continue;
+                size_t v_base = (size_t)v * MAX_STORAGE;
+                int old_g[MAX_STORAGE], g[MAX_STORAGE];
+                float old_w[MAX_STORAGE], w[MAX_STORAGE];
+                store.load(v_base, old_g, old_w);
+                if (mirror) {
+                    int u = ctx.mirror_map[v];
+                    if (u < 0 || u >= num_verts) continue; // Center verts (u == v) still get their groups flipped
+                    size_t u_base = (size_t)u * MAX_STORAGE;
+                    pipeline_mirror_vertex(ctx, snap_g.data() + u_base, snap_w.data() + u_base, old_g, old_w, g, w);
+                } else {
+                    std::copy(old_g, old_g + MAX_STORAGE, g);
+                    std::copy(old_w, old_w + MAX_STORAGE, w);
+                    for (int i = op; i < stage_end; ++i) pipeline_vertex_op(ctx, ops[i], g, w);
+                }
+                if (!DeltaOut::changed(old_g, old_w, g, w)) continue;
+                record(slot_base, chunk, v, old_g, old_w);
+                store.store(v_base, g, w);
+            }
+        });
+        op = stage_end;
+    }
+
+    int total = 0;
+    for (int c : chunk_changed) total += c;
+    return total;
+}
+
+/**
+ * Weight Transfer (Surface Projection)
+ *
+ * Source mesh held as a triangle BVH plus its strided weights. Each
+ * target vertex takes the closest point on the source surface and blends
+ * the weights of that triangle's corners with the barycentrics of the
+ * point (Data Transfer "Nearest Face Interpolated"), then goes through
+ * finalize_vertex_weights: influence cap, normalization and group flags
+ * exactly as the brush kernels. Built top-down with a median split like
+ * the bone BVH; queries run on the pool.
+ */
+const int TRI_BVH_LEAF = 4;
+const int TRANSFER_VERT_GRAIN = 1024;
+
+struct TransferSurface {
+    struct Node {
+        float lo[3];
+        float hi[3];
+        int left = -1;  // Child pair (left, left + 1), -1 = leaf
+        int first = 0;  // Leaf range in order[]
+        int count = 0;
+    };
+
+    int num_verts = 0;
+    std::vector<float> coords;       // [num_verts * 3] (source space after the matrix)
+    std::vector<int> tris;           // [num_tris * 3]
+    std::vector<int> weight_indices; // [num_verts * MAX_STORAGE]
+    std::vector<float> weight_values;
+    std::vector<Node> nodes;
+    std::vector<int> order;
+
+    int num_tris() const { return (int)(tris.size() / 3); }
+};
+
+// p' = M * p for a row-major 4x4 (NULL = identity)
+static inline void transform_point(const float* matrix, const float* p, float* out) {
+    if (!matrix) {
+        out[0] = p[0]; out[1] = p[1]; out[2] = p[2];
+        return;
+    }
+    for (int r = 0; r < 3; ++r) {
+        out[r] = matrix[r * 4 + 0] * p[0] + matrix[r * 4 + 1] * p[1] + matrix[r * 4 + 2] * p[2] + matrix[r * 4 + 3];
+    }
+}
+
+static void build_triangle_bvh(TransferSurface& surf) {
+    int num_tris = surf.num_tris();
+    surf.nodes.clear();
+    surf.order.resize(num_tris);
+    for (int t = 0; t < num_tris; ++t) surf.order[t] = t;
+    if (num_tris <= 0) return;
+
+    auto corner = [&](int t, int c) { return surf.coords.data() + (size_t)surf.tris[t * 3 + c] * 3; };
+    std::vector<float> centroids((size_t)num_tris * 3);
+    for (int t = 0; t < num_tris; ++t) {
+        for (int a = 0; a < 3; ++a) {
+            centroids[(size_t)t * 3 + a] = (corner(t, 0)[a] + corner(t, 1)[a] + corner(t, 2)[a]) * (1.0f / 3.0f);
+        }
+    }
+
+    struct Task { int node, first, count; };
+    std::vector<Task> tasks;
+    surf.nodes.emplace_back();
+    tasks.push_back({0, 0, num_tris});
+    while (!tasks.empty()) {
+        Task t = tasks.back();
+        tasks.pop_back();
+
+        TransferSurface::Node node;
+        float c_lo[3] = {INFINITY, INFINITY, INFINITY};
+        float c_hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (int a = 0; a < 3; ++a) { node.lo[a] = INFINITY; node.hi[a] = -INFINITY; }
+        for (int i = t.first; i < t.first + t.count; ++i) {
+            int tri = surf.order[i];
+            for (int a = 0; a < 3; ++a) {
+                for (int c = 0; c < 3; ++c) {
+                    node.lo[a] = std::min(node.lo[a], corner(tri, c)[a]);
+                    node.hi[a] = std::max(node.hi[a], corner(tri, c)[a]);
+                }
+                c_lo[a] = std::min(c_lo[a], centroids[(size_t)tri * 3 + a]);
+                c_hi[a] = std::max(c_hi[a], centroids[(size_t)tri * 3 + a]);
+            }
+        }
+        node.first = t.first;
+        node.count = t.count;
+
+        if (t.count > TRI_BVH_LEAF) {
+            int axis = 0;
+            for (int a = 1; a < 3; ++a) {
+                if (c_hi[a] - c_lo[a] > c_hi[axis] - c_lo[axis]) axis = a;
+            }
+            int half = t.count / 2;
+            std::nth_element(surf.order.begin() + t.first, surf.order.begin() + t.first + half,
+                             surf.order.begin() + t.first + t.count,
+                             [&](int x, int y) { return centroids[(size_t)x * 3 + axis] < centroids[(size_t)y * 3 + axis]; });
+            node.left = (int)surf.nodes.size();
+            surf.nodes.emplace_back();
+            surf.nodes.emplace_back();
+            tasks.push_back({node.left, t.first, half});
+            tasks.push_back({node.left + 1, t.first + half, t.count - half});
+        }
+        surf.nodes[t.node] = node;
+    }
+}
+
+/**
+ * Closest point to p on triangle (a, b, c) (Ericson, Real-Time Collision
+ * Detection 5.1.5). Returns the squared distance, bary = weights of a, b, c.
+ */
+static float closest_point_triangle(const float* p, const float* a, const float* b, const float* c, float* bary) {
+    float ab[3], ac[3], ap[3];
+    for (int i = 0; i < 3; ++i) { ab[i] = b[i] - a[i]; ac[i] = c[i] - a[i]; ap[i] = p[i] - a[i]; }
+    auto dot = [](const float* x, const float* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+
+    float u, v, w; // Barycentrics of a, b, c
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        u = 1.0f; v = 0.0f; w = 0.0f;
+    } else {
+        float bp[3], cp[3];
+        for (int i = 0; i < 3; ++i) { bp[i] = p[i] - b[i]; cp[i] = p[i] - c[i]; }
+        float d3 = dot(ab, bp), d4 = dot(ac, bp);
+        float d5 = dot(ab, cp), d6 = dot(ac, cp);
+        float vc = d1 * d4 - d3 * d2;
+        float vb = d5 * d2 - d1 * d6;
+        float va = d3 * d6 - d5 * d4;
+        if (d3 >= 0.0f && d4 <= d3) {
+            u = 0.0f; v = 1.0f; w = 0.0f;
+        } else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            float t = d1 / (d1 - d3);
+            u = 1.0f - t; v = t; w = 0.0f;
+        } else if (d6 >= 0.0f && d5 <= d6) {
+            u = 0.0f; v = 0.0f; w = 1.0f;
+        } else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            float t = d2 / (d2 - d6);
+            u = 1.0f - t; v = 0.0f; w = t;
+        } else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            u = 0.0f; v = 1.0f - t; w = t;
+        } else {
+            float denom = va + vb + vc;
+            if (denom <= 0.0f) { // Degenerate (zero area): nearest corner
+                u = 1.0f; v = 0.0f; w = 0.0f;
+            } else {
+                v = vb / denom;
+                w = vc / denom;
+                u = 1.0f - v - w;
+            }
+        }
+    }
+    bary[0] = u; bary[1] = v; bary[2] = w;
+    float sq = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        float q = u * a[i] + v * b[i] + w * c[i] - p[i];
+        sq += q * q;
+    }
+    return sq;
+}
+
+/**
+ * Nearest source triangle to p (ties: lower triangle index, so the result
+ * doesn't depend on the tree layout). Returns -1 for an empty surface.
+ */
+static int nearest_triangle(const TransferSurface& surf, const float* p, float* out_dist_sq, float* out_bary) {
+    int best = -1;
+    float best_sq = INFINITY;
+    if (!surf.nodes.empty()) {
+        auto box_distance_sq = [&](const TransferSurface::Node& n) {
+            float sq = 0.0f;
+            for (int a = 0; a < 3; ++a) {
+                float e = std::max(std::max(n.lo[a] - p[a], p[a] - n.hi[a]), 0.0f);
+                sq += e * e;
+            }
+            return sq;
+        };
+
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const TransferSurface::Node& n = surf.nodes[stack[--top]];
+            if (box_distance_sq(n) > best_sq) continue;
+            if (n.left < 0) {
+                for (int i = n.first; i < n.first + n.count; ++i) {
+                    int t = surf.order[i];
+                    const int* tri = surf.tris.data() + (size_t)t * 3;
+                    float bary[3];
+                    float sq = closest_point_triangle(p,
+                        surf.coords.data() + (size_t)tri[0] * 3,
+                        surf.coords.data() + (size_t)tri[1] * 3,
+                        surf.coords.data() + (size_t)tri[2] * 3, bary);
+                    if (sq < best_sq || (sq == best_sq && t < best)) {
+                        best_sq = sq;
+                        best = t;
+                        std::copy(bary, bary + 3, out_bary);
+                    }
+                }
+                continue;
+            }
+            // Visit the nearer child first (pushed last)
+            int a = n.left, b = n.left + 1;
+            if (box_distance_sq(surf.nodes[a]) < box_distance_sq(surf.nodes[b])) std::swap(a, b);
+            stack[top++] = a;
+            stack[top++] = b;
+        }
+    }
+    if (out_dist_sq) *out_dist_sq = best_sq;
+    return best;
+}
+
+struct TransferParams {
+    const int* group_map;   // Source group -> target group (-1 = not transferred), NULL = same index
+    int num_map;
+    const float* matrix;    // Target coords -> source space (row-major 4x4), NULL = same space
+    float max_distance;     // <= 0: unlimited
+    const unsigned char* vertex_mask; // NULL = every vertex
+    const GroupFlags* flags;
+
+    int map(int g) const {
+        if (!group_map) return g;
+        return (g >= 0 && g < num_map) ? group_map[g] : -1;
+    }
+};
+
+/**
+ * Projects the surface weights onto every (masked) target vertex in place.
+ * A vertex farther than max_distance from the surface keeps its weights.
+ * Target groups the source doesn't provide are dropped unless pinned, as
+ * with Data Transfer's replace mode (lock a group to keep it).
+ * changed: [num_verts], set to 0 / 1. Returns the number of changed vertices.
+ */
+template <int MaxInfluence>
+static int transfer_weights_impl(
+    KernelPool& kp,
+    const TransferSurface& surf,
+    int num_verts,
+    const float* vert_coords,
+    const StridedStorage& store,
+    const TransferParams& params,
+    unsigned char* changed
+) {
+    int num_chunks = (num_verts + TRANSFER_VERT_GRAIN - 1) / TRANSFER_VERT_GRAIN;
+    std::vector<int> chunk_changed(std::max(num_chunks, 1), 0);
+    float max_sq = params.max_distance > 0.0f ? params.max_distance * params.max_distance : INFINITY;
+
+    kp.threads.parallel_for(num_verts, TRANSFER_VERT_GRAIN, [&](int begin, int end, int) {
+        int chunk = begin / TRANSFER_VERT_GRAIN;
+        for (int v = begin; v < end; ++v) {
+            changed[v] = 0;
+            if (params.vertex_mask && !params.vertex_mask[v]) continue;
+            float p[3], bary[3], dist_sq;
+            transform_point(params.matrix, vert_coords + (size_t)v * 3, p);
+            int t = nearest_triangle(surf, p, &dist_sq, bary);
+            if (t < 0 || dist_sq > max_sq) continue;
+
+            // Barycentric blend of the corner slots (merged per target group)
+            VertexWeight list[3 * MAX_STORAGE];
+            int n = 0;
+            for (int c = 0; c < 3; ++c) {
+                if (bary[c] <= 0.0f) continue;
+                size_t s_base = (size_t)surf.tris[(size_t)t * 3 + c] * MAX_STORAGE;
+                for (int k = 0; k < MAX_STORAGE; ++k) {
+                    int g = surf.weight_indices[s_base + k];
+                    if (g < 0) continue;
+                    g = params.map(g);
+                    float w = bary[c] * surf.weight_values[s_base + k];
+                    if (g < 0 || w <= 0.0f) continue;
+                    int i = 0;
+                    while (i < n && list[i].group_index != g) ++i;
+                    if (i == n) list[n++] = {g, w};
+                    else list[i].weight += w;
+                }
+            }
+
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            int old_g[MAX_STORAGE], g[MAX_STORAGE];
+            float old_w[MAX_STORAGE], w[MAX_STORAGE];
+            store.load(v_base, old_g, old_w);
+            finalize_vertex_weights<MaxInfluence>(list, n, old_g, old_w, params.flags, g, w);
+            if (!DeltaOut::changed(old_g, old_w, g, w)) continue;
+            store.store(v_base, g, w);
+            changed[v] = 1;
+            chunk_changed[chunk]++;
+        }
+    });
+
+    int total = 0;
+    for (int c : chunk_changed) total += c;
+    return total;
+}
+
+/**
+ * GPU Whole-Mesh Smoothing (OpenCL, opened at runtime)
+ *
+ * On sculpt / scan resolution meshes the CPU Jacobi pass is memory bound.
+ * This backend keeps a session's CSR on the device (re-sent only when its
+ * topology / coords fingerprint changes), uploads the weights once per
+ * call, runs every pass there (ping-pong between two buffers) and
+ * downloads only the vertices that differ from the upload.
+ *
+ * The runtime is opened with LoadLibrary / dlopen and the few types and
+ * entry points used are declared below, so the DLL links nothing extra
+ * and loads where no driver is installed. No runtime / GPU, a failed build
+ * or allocation: run_mesh_smooth takes the CPU path.
+ *
+ * The device kernel is smooth_vertex_strided + finalize_vertex_weights
+ * statement for statement: same accumulation order, no contraction and
+ * correctly rounded division (devices without it are skipped), so its
+ * output equals the CPU Jacobi pass. Its group list is private and fixed:
+ * a vertex whose neighbourhood holds more than GPU_MAX_GROUPS groups sets
+ * a flag and the whole call reruns on the CPU.
+ */
+const int GPU_MAX_GROUPS = 32;
+const int GPU_MIN_VERTS = 200000; // SMOOTH_AUTO: smaller meshes don't amortize the transfers
+const int GPU_LOCAL_SIZE = 64;    // Global sizes are rounded up to this
+
+// Backends of session_smooth_mesh
+const int SMOOTH_AUTO = 0;
+const int SMOOTH_CPU = 1;
+const int SMOOTH_GPU = 2;
+
+typedef int32_t cl_int;
+typedef uint32_t cl_uint;
+typedef uint64_t cl_bitfield;
+typedef struct _cl_platform_id* cl_platform_id;
+typedef struct _cl_device_id* cl_device_id;
+typedef struct _cl_context* cl_context;
+typedef struct _cl_command_queue* cl_command_queue;
+typedef struct _cl_mem* cl_mem;
+typedef struct _cl_program* cl_program;
+typedef struct _cl_kernel* cl_kernel;
+
+#ifdef _WIN32
+#define WYNN_CL_CALL __stdcall
+#else
+#define WYNN_CL_CALL
+#endif
+
+const cl_int CL_SUCCESS = 0;
+const cl_bitfield CL_DEVICE_TYPE_GPU = 1 << 2;
+const cl_uint CL_DEVICE_SINGLE_FP_CONFIG = 0x101B;
+const cl_uint CL_DEVICE_NAME = 0x102B;
+const cl_bitfield CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT = 1 << 7;
+const cl_bitfield CL_MEM_READ_WRITE = 1 << 0;
+
+static void* cl_library_open() {
+#ifdef _WIN32
+    return (void*)LoadLibraryA("OpenCL.dll");
+#else
+    void* lib = dlopen("libOpenCL.so.1", RTLD_NOW | RTLD_LOCAL);
+    return lib ? lib : dlopen("libOpenCL.so", RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* cl_library_symbol(void* lib, const char* name) {
+#ifdef _WIN32
+    return (void*)GetProcAddress((HMODULE)lib, name);
+#else
+    return dlsym(lib, name);
+#endif
+}
+
+// The OpenCL 1.2 entry points used (callback arguments are always NULL here)
+struct OpenCLApi {
+    cl_int (WYNN_CL_CALL* GetPlatformIDs)(cl_uint, cl_platform_id*, cl_uint*);
+    cl_int (WYNN_CL_CALL* GetDeviceIDs)(cl_platform_id, cl_bitfield, cl_uint, cl_device_id*, cl_uint*);
+    cl_int (WYNN_CL_CALL* GetDeviceInfo)(cl_device_id, cl_uint, size_t, void*, size_t*);
+    cl_context (WYNN_CL_CALL* CreateContext)(const intptr_t*, cl_uint, const cl_device_id*, void*, void*, cl_int*);
+    cl_command_queue (WYNN_CL_CALL* CreateCommandQueue)(cl_context, cl_device_id, cl_bitfield, cl_int*);
+    cl_program (WYNN_CL_CALL* CreateProgramWithSource)(cl_context, cl_uint, const char**, const size_t*, cl_int*);
+    cl_int (WYNN_CL_CALL* BuildProgram)(cl_program, cl_uint, const cl_device_id*, const char*, void*, void*);
+    cl_kernel (WYNN_CL_CALL* CreateKernel)(cl_program, const char*, cl_int*);
+    cl_mem (WYNN_CL_CALL* CreateBuffer)(cl_context, cl_bitfield, size_t, void*, cl_int*);
+    cl_int (WYNN_CL_CALL* SetKernelArg)(cl_kernel, cl_uint, size_t, const void*);
+    cl_int (WYNN_CL_CALL* EnqueueNDRangeKernel)(cl_command_queue, cl_kernel, cl_uint, const size_t*, const size_t*,
+                                                const size_t*, cl_uint, const void*, void*);
+    cl_int (WYNN_CL_CALL* EnqueueWriteBuffer)(cl_command_queue, cl_mem, cl_uint, size_t, size_t, const void*,
+                                              cl_uint, const void*, void*);
+    cl_int (WYNN_CL_CALL* EnqueueReadBuffer)(cl_command_queue, cl_mem, cl_uint, size_t, size_t, void*,
+                                             cl_uint, const void*, void*);
+    cl_int (WYNN_CL_CALL* Finish)(cl_command_queue);
+    cl_int (WYNN_CL_CALL* ReleaseMemObject)(cl_mem);
+    cl_int (WYNN_CL_CALL* ReleaseKernel)(cl_kernel);
+    cl_int (WYNN_CL_CALL* ReleaseProgram)(cl_program);
+    cl_int (WYNN_CL_CALL* ReleaseCommandQueue)(cl_command_queue);
+    cl_int (WYNN_CL_CALL* ReleaseContext)(cl_context);
+
+    template <typename Fn>
+    static bool bind(void* lib, Fn& fn, const char* name) {
+        fn = reinterpret_cast<Fn>(cl_library_symbol(lib, name));
+        return fn != nullptr;
+    }
+
+    bool load() {
+        void* lib = cl_library_open();
+        return lib &&
+            bind(lib, GetPlatformIDs, "clGetPlatformIDs") &&
+            bind(lib, GetDeviceIDs, "clGetDeviceIDs") &&
+            bind(lib, GetDeviceInfo, "clGetDeviceInfo") &&
+            bind(lib, CreateContext, "clCreateContext") &&
+            bind(lib, CreateCommandQueue, "clCreateCommandQueue") &&
+            bind(lib, CreateProgramWithSource, "clCreateProgramWithSource") &&
+            bind(lib, BuildProgram, "clBuildProgram") &&
+            bind(lib, CreateKernel, "clCreateKernel") &&
+            bind(lib, CreateBuffer, "clCreateBuffer") &&
+            bind(lib, SetKernelArg, "clSetKernelArg") &&
+            bind(lib, EnqueueNDRangeKernel, "clEnqueueNDRangeKernel") &&
+            bind(lib, EnqueueWriteBuffer, "clEnqueueWriteBuffer") &&
+            bind(lib, EnqueueReadBuffer, "clEnqueueReadBuffer") &&
+            bind(lib, Finish, "clFinish") &&
+            bind(lib, ReleaseMemObject, "clReleaseMemObject") &&
+            bind(lib, ReleaseKernel, "clReleaseKernel") &&
+            bind(lib, ReleaseProgram, "clReleaseProgram") &&
+            bind(lib, ReleaseCommandQueue, "clReleaseCommandQueue") &&
+            bind(lib, ReleaseContext, "clReleaseContext");
+    }
+};
+
+/**
+ * Device side (OpenCL C). smooth_jacobi: one pass, src -> dst for every
+ * vertex; status[0] = max weight change (float bits, track_delta),
+ * status[1] = group list overflow. mark_changed + gather_slots: vertices
+ * that differ from the upload, compacted (status[2] = count).
+ */
+static const char* GPU_SMOOTH_SOURCE = R"CL(
+#pragma OPENCL FP_CONTRACT OFF
+
+typedef struct { int group_index; float weight; } VertexWeight;
+
+uchar group_flag(__global const uchar* flags, int num_groups, int g) {
+    return (g >= 0 && g < num_groups) ? flags[g] : (uchar)1;
+}
+
+// keep: 0 = every entry, 1 = free deform groups, 2 = unpinned non-deform groups
+int top_k_weights_if(const VertexWeight* in, int n, VertexWeight* out, int k, int keep,
+                     __global const uchar* flags, int num_groups) {
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        uchar f = group_flag(flags, num_groups, in[i].group_index);
+        if (keep == 1 && (f & 7) != 1) continue;
+        if (keep == 2 && ((f & 6) != 0 || (f & 5) == 1)) continue;
+        float w = in[i].weight;
+        if (count == k && !(w > out[k - 1].weight)) continue;
+        int pos = (count < k) ? count++ : k - 1;
+        while (pos > 0 && w > out[pos - 1].weight) {
+            out[pos] = out[pos - 1];
+            --pos;
+        }
+        out[pos] = in[i];
+    }
+    return count;
+}
+
+void finalize_vertex_weights(const VertexWeight* list, int n, const int* self_groups, const float* self_weights,
+                             int k, int use_flags, __global const uchar* flags, int num_groups,
+                             int* out_groups, float* out_weights) {
+    int count = 0;
+    if (!use_flags) {
+        VertexWeight kept[MAX_STORAGE];
+        int num_kept = top_k_weights_if(list, n, kept, k, 0, flags, num_groups);
+        float total = 0.0f;
+        for (int i = 0; i < num_kept; ++i) total += kept[i].weight;
+        if (total > 0.00001f) {
+            float ratio = 1.0f / total;
+            for (int i = 0; i < num_kept; ++i) {
+                out_groups[count] = kept[i].group_index;
+                out_weights[count] = kept[i].weight * ratio;
+                count++;
+            }
+        }
+        for (int s = count; s < MAX_STORAGE; ++s) {
+            out_groups[s] = -1;
+            out_weights[s] = 0.0f;
+        }
+        return;
+    }
+
+    VertexWeight merged[MAX_STORAGE * 3];
+    int num_merged = 0;
+    float locked_total = 0.0f;
+    int locked_slots = 0;
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        int g = self_groups[s];
+        if (g < 0 || self_weights[s] <= 0.0f) continue;
+        uchar f = group_flag(flags, num_groups, g);
+        if ((f & 6) == 0) continue;
+        merged[num_merged].group_index = g;
+        merged[num_merged].weight = self_weights[s];
+        num_merged++;
+        if ((f & 5) == 1) {
+            locked_total += self_weights[s];
+            locked_slots++;
+        }
+    }
+
+    VertexWeight deform[MAX_STORAGE];
+    int num_deform = top_k_weights_if(list, n, deform, k, 1, flags, num_groups);
+    num_deform = min(num_deform, max(0, k - locked_slots));
+    float deform_total = 0.0f;
+    for (int i = 0; i < num_deform; ++i) deform_total += deform[i].weight;
+    if (deform_total > 0.00001f) {
+        float rest = 1.0f - locked_total;
+        float ratio = (0.0f < rest ? rest : 0.0f) / deform_total;
+        for (int i = 0; i < num_deform; ++i) {
+            float w = deform[i].weight * ratio;
+            if (w > 0.0f) {
+                merged[num_merged].group_index = deform[i].group_index;
+                merged[num_merged].weight = w;
+                num_merged++;
+            }
+        }
+    }
+
+    num_merged += top_k_weights_if(list, n, merged + num_merged, MAX_STORAGE, 2, flags, num_groups);
+    num_merged = min(num_merged, MAX_STORAGE);
+    for (int i = 1; i < num_merged; ++i) {
+        VertexWeight e = merged[i];
+        int j = i;
+        while (j > 0 && e.weight > merged[j - 1].weight) {
+            merged[j] = merged[j - 1];
+            --j;
+        }
+        merged[j] = e;
+    }
+    for (; count < num_merged; ++count) {
+        out_groups[count] = merged[count].group_index;
+        out_weights[count] = merged[count].weight;
+    }
+    for (int s = count; s < MAX_STORAGE; ++s) {
+        out_groups[s] = -1;
+        out_weights[s] = 0.0f;
+    }
+}
+
+float max_slot_delta(const int* old_g, const float* old_w, const int* new_g, const float* new_w) {
+    float max_d = 0.0f;
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        int g = new_g[s];
+        if (g < 0) continue;
+        float prev = 0.0f;
+        for (int j = 0; j < MAX_STORAGE; ++j) {
+            if (old_g[j] == g) { prev = old_w[j]; break; }
+        }
+        float d = fabs(new_w[s] - prev);
+        if (max_d < d) max_d = d;
+    }
+    for (int j = 0; j < MAX_STORAGE; ++j) {
+        int g = old_g[j];
+        if (g < 0) continue;
+        bool kept = false;
+        for (int s = 0; s < MAX_STORAGE; ++s) {
+            if (new_g[s] == g) { kept = true; break; }
+        }
+        float d = fabs(old_w[j]);
+        if (!kept && max_d < d) max_d = d;
+    }
+    return max_d;
+}
+
+__kernel void smooth_jacobi(
+    __global const int* adj_starts, __global const int* adj_indices, __global const float* adj_weights,
+    __global const int* src_groups, __global const float* src_values,
+    __global int* dst_groups, __global float* dst_values,
+    int num_verts, float factor, int max_influence,
+    __global const uchar* flags, int num_groups, int use_flags,
+    int track_delta, __global uint* status
+) {
+    int v = get_global_id(0);
+    if (v >= num_verts) return;
+    size_t v_base = (size_t)v * MAX_STORAGE;
+    int self_g[MAX_STORAGE];
+    float self_w[MAX_STORAGE];
+    int out_g[MAX_STORAGE];
+    float out_w[MAX_STORAGE];
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        self_g[s] = out_g[s] = src_groups[v_base + s];
+        self_w[s] = out_w[s] = src_values[v_base + s];
+    }
+
+    // 1. Neighbour sums per group, list kept in ascending group order
+    int acc_g[GPU_MAX_GROUPS];
+    float acc_sum[GPU_MAX_GROUPS];
+    int num_acc = 0;
+    float total_edge_w = 0.0f;
+    bool overflow = false;
+    for (int i = adj_starts[v]; i < adj_starts[v + 1] && !overflow; ++i) {
+        size_t base = (size_t)adj_indices[i] * MAX_STORAGE;
+        float edge_w = adj_weights[i];
+        total_edge_w += edge_w;
+        for (int s = 0; s < MAX_STORAGE; ++s) {
+            int g = src_groups[base + s];
+            float w = src_values[base + s];
+            if (g < 0 || w <= 0.0f) continue;
+            int pos = num_acc;
+            while (pos > 0 && acc_g[pos - 1] > g) --pos;
+            if (pos > 0 && acc_g[pos - 1] == g) {
+                acc_sum[pos - 1] += w * edge_w;
+                continue;
+            }
+            if (num_acc == GPU_MAX_GROUPS) { overflow = true; break; }
+            for (int j = num_acc; j > pos; --j) {
+                acc_g[j] = acc_g[j - 1];
+                acc_sum[j] = acc_sum[j - 1];
+            }
+            acc_g[pos] = g;
+            acc_sum[pos] = w * edge_w;
+            num_acc++;
+        }
+    }
+    if (overflow) atomic_max(&status[1], 1u); // Host reruns the call on the CPU
+
+    // 2. Blend (no neighbours: kept as is)
+    if (!overflow && total_edge_w > 0.00001f) {
+        float inv_factor = 1.0f - factor;
+        float inv_total_edge = 1.0f / total_edge_w;
+        VertexWeight blended[GPU_MAX_GROUPS + MAX_STORAGE];
+        int num_blended = 0;
+        for (int j = 0; j < num_acc; ++j) {
+            float avg_w = acc_sum[j] * inv_total_edge;
+            float cur_w = 0.0f;
+            for (int s = 0; s < MAX_STORAGE; ++s) {
+                if (self_g[s] == acc_g[j]) { cur_w = self_w[s]; break; }
+            }
+            float new_w = (cur_w * inv_factor) + (avg_w * factor);
+            if (new_w > 0.0001f) {
+                blended[num_blended].group_index = acc_g[j];
+                blended[num_blended].weight = new_w;
+                num_blended++;
+            }
+        }
+        for (int s = 0; s < MAX_STORAGE; ++s) {
+            int g = self_g[s];
+            float w = self_w[s];
+            if (g < 0 || w <= 0.0f) continue;
+            bool touched = false;
+            for (int j = 0; j < num_acc; ++j) touched = touched || acc_g[j] == g;
+            if (touched) continue;
+            float new_w = w * inv_factor;
+            if (new_w > 0.0001f) {
+                blended[num_blended].group_index = g;
+                blended[num_blended].weight = new_w;
+                num_blended++;
+            }
+        }
+
+        // 3. Limit & Sort & Normalize
+        finalize_vertex_weights(blended, num_blended, self_g, self_w, max_influence,
+                                use_flags, flags, num_groups, out_g, out_w);
+        if (track_delta) atomic_max(&status[0], as_uint(max_slot_delta(self_g, self_w, out_g, out_w)));
+    }
+
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        dst_groups[v_base + s] = out_g[s];
+        dst_values[v_base + s] = out_w[s];
+    }
+}
+
+__kernel void mark_changed(
+    __global const int* base_groups, __global const float* base_values,
+    __global const int* groups, __global const float* values,
+    int num_verts, __global int* out_verts, __global uint* status
+) {
+    int v = get_global_id(0);
+    if (v >= num_verts) return;
+    size_t v_base = (size_t)v * MAX_STORAGE;
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        if (groups[v_base + s] != base_groups[v_base + s] || values[v_base + s] != base_values[v_base + s]) {
+            out_verts[atomic_inc(&status[2])] = v;
+            return;
+        }
+    }
+}
+
+__kernel void gather_slots(
+    __global const int* verts, int count,
+    __global const int* groups, __global const float* values,
+    __global int* out_groups, __global float* out_values
+) {
+    int i = get_global_id(0);
+    if (i >= count) return;
+    size_t src = (size_t)verts[i] * MAX_STORAGE;
+    size_t dst = (size_t)i * MAX_STORAGE;
+    for (int s = 0; s < MAX_STORAGE; ++s) {
+        out_groups[dst + s] = groups[src + s];
+        out_values[dst + s] = values[src + s];
+    }
+}
+)CL";
+
+// The first GPU that builds the kernels, shared by every session
+struct GpuDevice {
+    OpenCLApi cl{};
+    bool ready = false;
+    char name[256] = {};
+    cl_context context = nullptr;
+    cl_command_queue queue = nullptr;
+    cl_program program = nullptr;
+    cl_kernel smooth = nullptr;
+    cl_kernel mark = nullptr;
+    cl_kernel gather = nullptr;
+    std::mutex lock; // One queue + shared kernel arguments: calls take turns
+
+    bool init() {
+        if (!cl.load()) return false;
+        cl_platform_id platforms[8];
+        cl_uint num_platforms = 0;
+        if (cl.GetPlatformIDs(8, platforms, &num_platforms) != CL_SUCCESS) return false;
+        for (cl_uint p = 0; p < std::min<cl_uint>(num_platforms, 8); ++p) {
+            cl_device_id devices[8];
+            cl_uint num_devices = 0;
+            if (cl.GetDeviceIDs(platforms[p], CL_DEVICE_TYPE_GPU, 8, devices, &num_devices) != CL_SUCCESS) continue;
+            for (cl_uint d = 0; d < std::min<cl_uint>(num_devices, 8); ++d) {
+                if (build(devices[d])) return true;
+            }
+        }
+        return false;
+    }
+
+    bool build(cl_device_id device) {
+        cl_bitfield fp_config = 0;
+        if (cl.GetDeviceInfo(device, CL_DEVICE_SINGLE_FP_CONFIG, sizeof(fp_config), &fp_config, nullptr) != CL_SUCCESS ||
+            !(fp_config & CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT)) {
+            return false;
+        }
+        cl_int err = CL_SUCCESS;
+        context = cl.CreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+        if (err == CL_SUCCESS) queue = cl.CreateCommandQueue(context, device, 0, &err);
+        if (err == CL_SUCCESS) program = cl.CreateProgramWithSource(context, 1, &GPU_SMOOTH_SOURCE, nullptr, &err);
+        if (err == CL_SUCCESS) {
+            std::string options = "-cl-fp32-correctly-rounded-divide-sqrt -DMAX_STORAGE=" +
+                std::to_string(MAX_STORAGE) + " -DGPU_MAX_GROUPS=" + std::to_string(GPU_MAX_GROUPS);
+            err = cl.BuildProgram(program, 1, &device, options.c_str(), nullptr, nullptr);
+        }
+        if (err == CL_SUCCESS) smooth = cl.CreateKernel(program, "smooth_jacobi", &err);
+        if (err == CL_SUCCESS) mark = cl.CreateKernel(program, "mark_changed", &err);
+        if (err == CL_SUCCESS) gather = cl.CreateKernel(program, "gather_slots", &err);
+        if (err == CL_SUCCESS) err = cl.GetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+        if (err != CL_SUCCESS) release();
+        return err == CL_SUCCESS;
+    }
+
+    void release() {
+        for (cl_kernel* k : {&smooth, &mark, &gather}) {
+            if (*k) cl.ReleaseKernel(*k);
+            *k = nullptr;
+        }
+        if (program) cl.ReleaseProgram(program);
+        if (queue) cl.ReleaseCommandQueue(queue);
+        if (context) cl.ReleaseContext(context);
+        program = nullptr;
+        queue = nullptr;
+        context = nullptr;
+    }
+};
+
+// Opens the runtime and builds the kernels on first use (check .ready)
+static GpuDevice& gpu_device() {
+    static GpuDevice device;
+    static std::once_flag once;
+    std::call_once(once, [] { device.ready = device.init(); });
+    return device;
+}
+
+// Device buffer that only grows
+struct GpuBuffer {
+    cl_mem mem = nullptr;
+    size_t bytes = 0;
+
+    bool reserve(GpuDevice& dev, size_t size) {
+        size = std::max<size_t>(size, 4);
+        if (mem && bytes >= size) return true;
+        release(dev);
+        cl_int err = CL_SUCCESS;
+        cl_mem created = dev.cl.CreateBuffer(dev.context, CL_MEM_READ_WRITE, size, nullptr, &err);
+        if (err != CL_SUCCESS) return false;
+        mem = created;
+        bytes = size;
+        return true;
+    }
+    // Non-blocking: data must stay untouched until the queue is drained
+    bool write(GpuDevice& dev, const void* data, size_t size) const {
+        return size == 0 || dev.cl.EnqueueWriteBuffer(dev.queue, mem, 0, 0, size, data, 0, nullptr, nullptr) == CL_SUCCESS;
+    }
+    bool read(GpuDevice& dev, void* data, size_t size) const {
+        return size == 0 || dev.cl.EnqueueReadBuffer(dev.queue, mem, 1, 0, size, data, 0, nullptr, nullptr) == CL_SUCCESS;
+    }
+    void release(GpuDevice& dev) {
+        if (mem) dev.cl.ReleaseMemObject(mem);
+        mem = nullptr;
+        bytes = 0;
+    }
+};
+
+/**
+ * A session's device copy: CSR (tagged with the fingerprints it was sent
+ * for) and the weight buffers ([0] = upload, kept for the final diff,
+ * [1] / [2] = ping-pong; the one not holding the result packs the download).
+ */
+struct GpuMeshBuffers {
+    GpuBuffer adj_starts, adj_indices, adj_weights;
+    int csr_verts = -1;
+    size_t csr_edges = 0;
+    uint64_t topology_fp = 0;
+    uint64_t coords_fp = 0;
+    GpuBuffer groups[3], values[3];
+    GpuBuffer flags, verts, status;
+
+    ~GpuMeshBuffers() {
+        GpuDevice& dev = gpu_device();
+        for (GpuBuffer* b : {&adj_starts, &adj_indices, &adj_weights, &groups[0], &groups[1], &groups[2],
+                             &values[0], &values[1], &values[2], &flags, &verts, &status}) {
+            b->release(dev);
+        }
+    }
+};
+
+template <typename... Args>
+static bool set_kernel_args(GpuDevice& dev, cl_kernel kernel, const Args&... args) {
+    cl_uint index = 0;
+    bool ok = true;
+    ((ok = ok && dev.cl.SetKernelArg(kernel, index++, sizeof(Args), &args) == CL_SUCCESS), ...);
+    return ok;
+}
+
+static bool run_kernel_1d(GpuDevice& dev, cl_kernel kernel, int count) {
+    size_t global = ((size_t)count + GPU_LOCAL_SIZE - 1) / GPU_LOCAL_SIZE * GPU_LOCAL_SIZE;
+    size_t local = GPU_LOCAL_SIZE;
+    return dev.cl.EnqueueNDRangeKernel(dev.queue, kernel, 1, nullptr, &global, &local, 0, nullptr, nullptr) == CL_SUCCESS;
+}
+
+/**
+ * Up to `iterations` smooth_jacobi_pass passes over every vertex on the
+ * device, stopping like smooth_strided_iterations once the largest change
+ * of a pass drops below tolerance (<= 0: every pass). group_flags: NULL or
+ * GROUP_* per group. out_verts (ascending) + out_indices / out_values
+ * [count * MAX_STORAGE]: the vertices that changed, as computed.
+ * Returns the passes run, 0 if the job was cancelled (nothing downloaded),
+ * -1 if the caller has to run the CPU path instead.
+ */
+static int gpu_smooth_mesh(
+    GpuMeshBuffers& buf,
+    int num_verts,
+    const int* adj_starts,
+    const int* adj_indices,
+    const float* adj_weights,
+    uint64_t topology_fp,
+    uint64_t coords_fp,
+    const int* weight_indices,
+    const float* weight_values,
+    const unsigned char* group_flags,
+    int num_groups,
+    int max_influence,
+    float factor,
+    int iterations,
+    float tolerance,
+    JobControl* job,
+    std::vector<int>& out_verts,
+    std::vector<int>& out_indices,
+    std::vector<float>& out_values
+) {
+    GpuDevice& dev = gpu_device();
+    if (!dev.ready || num_verts <= 0 || iterations <= 0) return -1;
+    std::lock_guard<std::mutex> guard(dev.lock);
+    // Writes are non-blocking: every exit (the -1 ones too, whose caller reuses
+    // the session arrays) waits for the queue before the host memory moves on
+    struct QueueDrain {
+        GpuDevice& dev;
+        ~QueueDrain() { dev.cl.Finish(dev.queue); }
+    } drain{dev};
+    size_t num_edges = (size_t)adj_starts[num_verts];
+    size_t slot_bytes = (size_t)num_verts * MAX_STORAGE * sizeof(int);
+
+    // 1. CSR: structure only when the topology changed, edge weights when the coords did
+    bool same_topology = buf.csr_verts == num_verts && buf.csr_edges == num_edges && buf.topology_fp == topology_fp;
+    if (!same_topology || buf.coords_fp != coords_fp) {
+        buf.csr_verts = -1;
+        bool ok = buf.adj_weights.reserve(dev, num_edges * sizeof(float)) &&
+                  buf.adj_weights.write(dev, adj_weights, num_edges * sizeof(float));
+        if (ok && !same_topology) {
+            ok = buf.adj_starts.reserve(dev, ((size_t)num_verts + 1) * sizeof(int)) &&
+                 buf.adj_indices.reserve(dev, num_edges * sizeof(int)) &&
+                 buf.adj_starts.write(dev, adj_starts, ((size_t)num_verts + 1) * sizeof(int)) &&
+                 buf.adj_indices.write(dev, adj_indices, num_edges * sizeof(int));
+        }
+        if (!ok) return -1;
+        buf.csr_verts = num_verts;
+        buf.csr_edges = num_edges;
+        buf.topology_fp = topology_fp;
+        buf.coords_fp = coords_fp;
+    }
+
+    // 2. Weights (one upload) + flags + status
+    static const cl_uint zeros[3] = {0, 0, 0};
+    bool ok = true;
+    for (int i = 0; i < 3; ++i) {
+        ok = ok && buf.groups[i].reserve(dev, slot_bytes) && buf.values[i].reserve(dev, slot_bytes);
+    }
+    ok = ok && buf.flags.reserve(dev, (size_t)std::max(num_groups, 0)) &&
+         buf.verts.reserve(dev, (size_t)num_verts * sizeof(int)) &&
+         buf.status.reserve(dev, sizeof(zeros)) &&
+         buf.groups[0].write(dev, weight_indices, slot_bytes) &&
+         buf.values[0].write(dev, weight_values, slot_bytes) &&
+         (!group_flags || buf.flags.write(dev, group_flags, (size_t)num_groups)) &&
+         buf.status.write(dev, zeros, sizeof(zeros));
+    if (!ok) return -1;
+
+    // 3. Passes: [0] -> [1] -> [2] -> [1] ...
+    int use_flags = group_flags ? 1 : 0;
+    int track_delta = tolerance > 0.0f ? 1 : 0;
+    int cur = 0;
+    int passes = 0;
+    cl_uint status[3] = {0, 0, 0};
+    while (passes < iterations) {
+        int next = cur == 1 ? 2 : 1;
+        if (!set_kernel_args(dev, dev.smooth, buf.adj_starts.mem, buf.adj_indices.mem, buf.adj_weights.mem,
+                             buf.groups[cur].mem, buf.values[cur].mem, buf.groups[next].mem, buf.values[next].mem,
+                             num_verts, factor, max_influence, buf.flags.mem, num_groups, use_flags,
+                             track_delta, buf.status.mem) ||
+            (track_delta && !buf.status.write(dev, zeros, sizeof(cl_uint))) ||
+            !run_kernel_1d(dev, dev.smooth, num_verts)) {
+            return -1;
+        }
+        cur = next;
+        passes++;
+        if (track_delta) {
+            if (!buf.status.read(dev, status, sizeof(status))) return -1;
+            if (status[1]) return -1;
+            float max_delta;
+            std::memcpy(&max_delta, &status[0], sizeof(float));
+            if (max_delta < tolerance) break;
+        }
+        if (job) {
+            // Progress follows the device, not the queue
+            if (dev.cl.Finish(dev.queue) != CL_SUCCESS) return -1;
+            if (!job->advance()) return 0;
+        }
+    }
+
+    // 4. Changed vertices, compacted + sorted, then only their slots come back
+    int spare = cur == 1 ? 2 : 1;
+    if (!set_kernel_args(dev, dev.mark, buf.groups[0].mem, buf.values[0].mem, buf.groups[cur].mem,
+                         buf.values[cur].mem, num_verts, buf.verts.mem, buf.status.mem) ||
+        !run_kernel_1d(dev, dev.mark, num_verts) ||
+        !buf.status.read(dev, status, sizeof(status)) || status[1]) {
+        return -1;
+    }
+    int count = (int)status[2];
+    out_verts.resize(count);
+    out_indices.resize((size_t)count * MAX_STORAGE);
+    out_values.resize((size_t)count * MAX_STORAGE);
+    if (count == 0) return passes;
+    if (!buf.verts.read(dev, out_verts.data(), (size_t)count * sizeof(int))) return -1;
+    std::sort(out_verts.begin(), out_verts.end());
+    if (!buf.verts.write(dev, out_verts.data(), (size_t)count * sizeof(int)) ||
+        !set_kernel_args(dev, dev.gather, buf.verts.mem, count, buf.groups[cur].mem, buf.values[cur].mem,
+                         buf.groups[spare].mem, buf.values[spare].mem) ||
+        !run_kernel_1d(dev, dev.gather, count) ||
+        !buf.groups[spare].read(dev, out_indices.data(), out_indices.size() * sizeof(int)) ||
+        !buf.values[spare].read(dev, out_values.data(), out_values.size() * sizeof(float))) {
+        return -1;
+    }
+    return passes;
+}
+
+/**
+ * Undo Journal (Stroke Deltas)
+ *
+ * Each stroke stores the pre-stroke slots of every vertex it changed, all
+ * groups included. A vertex is captured the first time a stroke touches it,
+ * so later dabs over the same area cost nothing. Oldest strokes are dropped
+ * once the journal exceeds its byte budget (the newest stroke is always kept).
+ */
+struct UndoJournal {
+    struct Stroke {
+        std::vector<int> verts;
+        std::vector<int> indices;  // [verts * MAX_STORAGE]
+        std::vector<float> values; // [verts * MAX_STORAGE]
+
+        size_t bytes() const {
+            return verts.size() * sizeof(int) + indices.size() * sizeof(int) + values.size() * sizeof(float);
+        }
+    };
+
+    size_t budget_bytes;
+    size_t used_bytes = 0;
+    std::deque<Stroke> strokes;
+
+    Stroke open;
+    bool recording = false;
+    std::vector<int> seen_stamp; // Per vertex: stamp of the stroke that captured it
+    int current_stamp = 0;
+
+    explicit UndoJournal(size_t budget) : budget_bytes(budget) {}
+
+    // Drops every step (e.g. a cached session re-entered on fresh Blender weights)
+    void clear(size_t budget) {
+        budget_bytes = budget;
+        used_bytes = 0;
+        strokes.clear();
+        open = Stroke();
+        recording = false;
+    }
+
+    void begin() {
+        if (recording) end();
+        open = Stroke();
+        recording = true;
+        if (++current_stamp == 0x7FFFFFFF) {
+            std::fill(seen_stamp.begin(), seen_stamp.end(), 0);
+            current_stamp = 1;
+        }
+    }
+
+    void record(const int* verts, const int* before_indices, const float* before_values, int count) {
+        if (!recording) return;
+        for (int i = 0; i < count; ++i) {
+            int v = verts[i];
+            if ((size_t)v >= seen_stamp.size()) seen_stamp.resize((size_t)v + 1, 0);
+            if (seen_stamp[v] == current_stamp) continue; // Already holds the pre-stroke state
+            seen_stamp[v] = current_stamp;
+
+            size_t base = (size_t)i * MAX_STORAGE;
+            open.verts.push_back(v);
+            open.indices.insert(open.indices.end(), before_indices + base, before_indices + base + MAX_STORAGE);
+            open.values.insert(open.values.end(), before_values + base, before_values + base + MAX_STORAGE);
+        }
+    }
+
+    void end() {
+        if (!recording) return;
+        recording = false;
+        if (open.verts.empty()) return; // Stroke changed nothing -> no undo step
+
+        used_bytes += open.bytes();
+        strokes.push_back(std::move(open));
+        open = Stroke();
+        while (strokes.size() > 1 && used_bytes > budget_bytes) {
+            used_bytes -= strokes.front().bytes();
+            strokes.pop_front();
+        }
+    }
+};
+
+/**
+ * Blender Write-Back Diff
+ *
+ * (vertex, group, weight) triples between what Blender holds (base) and
+ * the current strided weights; weight 0 = remove the vertex from the group.
+ * The base slots of every checked vertex are synced to the current ones.
+ */
+struct WeightChange {
+    int group;
+    int vertex;
+    float weight;
+};
+
+static void collect_weight_changes(
+    int num_verts,
+    int* base_indices,
+    float* base_values,
+    const int* weight_indices,
+    const float* weight_values,
+    const int* vertex_list,
+    int num_list,
+    std::vector<WeightChange>& changes
+) {
+    changes.clear();
+    int num_checked = vertex_list ? num_list : num_verts;
+    for (int i = 0; i < num_checked; ++i) {
+        int v = vertex_list ? vertex_list[i] : i;
+        size_t v_base = (size_t)v * MAX_STORAGE;
+        const int* new_g = weight_indices + v_base;
+        const float* new_w = weight_values + v_base;
+        int* old_g = base_indices + v_base;
+        float* old_w = base_values + v_base;
+
+        // Added / Updated
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            int g = new_g[k];
+            float w = new_w[k];
+            if (g < 0 || w <= 0.0001f) continue;
+            float prev = -1.0f;
+            for (int j = 0; j < MAX_STORAGE; ++j) {
+                if (old_g[j] == g) { prev = old_w[j]; break; }
+            }
+            if (prev <= 0.0001f || std::abs(prev - w) > 0.00001f) {
+                changes.push_back({g, v, w});
+            }
+        }
+        // Removed
+        for (int j = 0; j < MAX_STORAGE; ++j) {
+            int g = old_g[j];
+            if (g < 0 || old_w[j] <= 0.0001f) continue;
+            bool kept = false;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                if (new_g[k] == g && new_w[k] > 0.0001f) { kept = true; break; }
+            }
+            if (!kept) changes.push_back({g, v, 0.0f});
+        }
+        // Sync
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            old_g[k] = new_g[k];
+            old_w[k] = new_w[k];
+        }
+    }
+}
+
+/**
+ * Session Instrumentation
+ *
+ * Plain counters bumped by the session entry points: a few adds and two
+ * steady_clock reads per phase per call, cheap enough to leave on.
+ * Layout is mirrored by wynn_core.SessionStats (check session_stats_size).
+ * Phases (STATS_*): footprint query / merge, kernel, commit (undo record +
+ * pending list), session_diff. Histogram bucket b counts calls of that
+ * phase under 0.0625 ms * 2^b, the last bucket takes the rest.
+ */
+const int STATS_QUERY = 0;
+const int STATS_KERNEL = 1;
+const int STATS_COMMIT = 2;
+const int STATS_DIFF = 3;
+const int STATS_PHASES = 4;
+const int STATS_BUCKETS = 12;
+
+struct SessionStats {
+    long long calls;           // Kernel runs (dab / stroke step / smooth_group) with targets
+    long long verts_processed; // Targets handed to kernels
+    long long verts_changed;   // Dirty vertices
+    long long groups_touched;  // Groups held by the changed vertices (after the change)
+    long long scratch_grows;   // Per-call scratch that had to reallocate
+    long long scratch_reuses;  // ... that was already large enough
+    double phase_ms[STATS_PHASES]; // Totals
+    double last_ms[STATS_PHASES];  // Most recent call of each phase
+    long long histogram[STATS_PHASES][STATS_BUCKETS];
+};
+
+using StatsClock = std::chrono::steady_clock;
+
+static void stats_add_time(SessionStats& st, int phase, StatsClock::time_point t0) {
+    double ms = std::chrono::duration<double, std::milli>(StatsClock::now() - t0).count();
+    st.phase_ms[phase] += ms;
+    st.last_ms[phase] = ms;
+    int bucket = 0;
+    for (double limit = 0.0625; bucket < STATS_BUCKETS - 1 && ms >= limit; limit *= 2.0) ++bucket;
+    st.histogram[phase][bucket]++;
+}
+
+/**
+ * Brush Session
+ *
+ * Everything a dab needs, held on the C++ side for the whole modal
+ * session: CSR adjacency, strided weights + the Blender-side mirror,
+ * spatial index and per-dab scratch. The pool and the undo journal are
+ * borrowed handles (created/destroyed by the caller).
+ *
+ * Changed vertices are collected in a pending list until session_diff
+ * consumes them, so the caller can apply to Blender at its own rate.
+ */
+const int STROKE_MAX_DABS = 256; // Per brush_stroke_to call (long jumps widen the spacing)
+
+// session_get_buffer selectors (mirrored by wynn_core.SESSION_BUFFER_*),
+// int buffers unless noted
+const int SESSION_BUFFER_WEIGHT_INDICES = 0; // [num_verts * MAX_STORAGE]
+const int SESSION_BUFFER_WEIGHT_VALUES = 1;  // float, [num_verts * MAX_STORAGE]
+const int SESSION_BUFFER_DIFF_VERTS = 2;     // session_diff_runs output
+const int SESSION_BUFFER_DIFF_GROUPS = 3;
+const int SESSION_BUFFER_DIFF_WEIGHTS = 4;   // float
+const int SESSION_BUFFER_DIFF_RUNS = 5;      // [num_runs + 1]
+const int SESSION_BUFFER_PENDING_VERTS = 6;  // Not yet written back
+
+struct BrushSession {
+    PoolRef pool;
+    UndoJournal* undo;
+
+    int num_verts = 0;
+    std::vector<int> adj_starts;
+    std::vector<int> adj_indices;
+    std::vector<float> adj_weights;
+    uint64_t topology_fp = 0; // Edge list fingerprint of the CSR above (see session_sync_geometry)
+    uint64_t coords_fp = 0;   // Local coords its weights were computed from
+
+    std::vector<int> weight_indices;  // [num_verts * MAX_STORAGE]
+    std::vector<float> weight_values;
+    std::vector<int> base_indices;    // What Blender holds (diff source)
+    std::vector<float> base_values;
+
+    SpatialGrid grid;
+    std::vector<float> grid_coords; // [num_verts * 3] what the grid was built from (sampled smear)
+
+    // Per-dab scratch (grown on demand, reused)
+    std::vector<int> targets;
+    std::vector<float> factors;
+    std::vector<int> dirty_verts;
+    std::vector<int> before_indices;
+    std::vector<float> before_values;
+    std::vector<int> after_indices;
+    std::vector<float> after_values;
+    int dirty_count = 0;
+
+    // Not yet written back to Blender (union of dirty lists since the last session_diff)
+    std::vector<int> pending_verts;
+    std::vector<unsigned char> pending_mark;
+
+    JobControl* job = nullptr; // Background job running on this session (see SessionJob)
+
+    // session_diff_runs output, read in place by Python (see session_get_buffer)
+    std::vector<WeightChange> diff_changes;
+    std::vector<int> diff_verts;
+    std::vector<int> diff_groups;
+    std::vector<float> diff_weights;
+    std::vector<int> diff_runs; // [num_runs + 1] offsets into diff_verts
+
+    // Stroke engine: last placed dab + merged footprint (slot per vertex, stamped)
+    bool stroke_active = false;
+    float stroke_last[3] = {0.0f, 0.0f, 0.0f};
+    std::vector<int> query_indices;
+    std::vector<float> query_factors;
+    std::vector<int> merge_slot;
+    std::vector<int> merge_stamp;
+    int merge_current = 0;
+
+    int max_influence = MAX_INFLUENCE; // Output cap (engine limit), see session_set_max_influence
+
+    // Per-group GROUP_* bits (empty = normalize across every group), see session_set_group_flags
+    std::vector<unsigned char> group_flags;
+    GroupFlags group_flags_view{nullptr, 0};
+
+    // X-Mirror: vertex -> mirrored vertex (-1 = none), group -> mirrored group (-1 = same group)
+    std::vector<int> mirror_map;
+    std::vector<int> group_remap;
+
+    // Connected Only: footprints grow over the CSR from the vertex under the cursor
+    bool connected_only = false;
+    GeodesicScratch geodesic;
+
+    SessionStats stats{}; // See session_get_stats
+
+    std::unique_ptr<GpuMeshBuffers> gpu; // Device copy for run_mesh_smooth (first GPU call)
+
+    BrushSession(void* pool_handle, void* undo_handle)
+        : pool(pool_handle), undo(static_cast<UndoJournal*>(undo_handle)) {}
+
+    // Moves the pending list into out (session_diff* with vertex_list NULL)
+    void take_pending(std::vector<int>& out) {
+        out.swap(pending_verts);
+        pending_verts.clear();
+        for (int v : out) pending_mark[v] = 0;
+    }
+
+    DeltaOut reserve_delta(int count) {
+        size_t slots = (size_t)count * MAX_STORAGE;
+        bool grows = dirty_verts.size() < (size_t)count || before_indices.size() < slots;
+        (grows ? stats.scratch_grows : stats.scratch_reuses)++;
+        if (dirty_verts.size() < (size_t)count) dirty_verts.resize(count);
+        if (before_indices.size() < slots) {
+            before_indices.resize(slots);
+            before_values.resize(slots);
+            after_indices.resize(slots);
+            after_values.resize(slots);
+        }
+        return DeltaOut{dirty_verts.data(), before_indices.data(), before_values.data(),
+                        after_indices.data(), after_values.data(), 0};
+    }
+
+    const GroupFlags* flags() const {
+        return group_flags.empty() ? nullptr : &group_flags_view;
+    }
+
+    bool mirror_active() const {
+        return mirror_map.size() == (size_t)num_verts && num_verts > 0;
+    }
+
+    int mirror_group(int g) const {
+        if (g >= 0 && g < (int)group_remap.size() && group_remap[g] >= 0) return group_remap[g];
+        return g;
+    }
+
+    // Smear source: active group weight at the nearest vertex (0 if absent).
+    // mirrored: read the mirror counterpart of that vertex instead.
+    float sample_weight(const float* point, int group, bool mirrored = false) const {
+        int v = nearest_spatial_grid(grid, point, nullptr);
+        if (mirrored && v >= 0) v = mirror_map[v];
+        if (v < 0 || v >= num_verts) return -1.0f;
+        size_t v_base = (size_t)v * MAX_STORAGE;
+        for (int k = 0; k < MAX_STORAGE; ++k) {
+            if (weight_indices[v_base + k] == group) return weight_values[v_base + k];
+        }
+        return 0.0f;
+    }
+
+    /**
+     * Kernel over targets[0..count) / factors (mode: 0=Smear, 1=Harden, 2=Blur).
+     * Smear moves the surface from smear_from to smear_to: every group is
+     * sampled per vertex (smear_sampled_pass); without grid coords only the
+     * active group, from the single weight under smear_from.
+     * Records undo + pending, returns the number of changed vertices.
+     */
+    int run_kernel(int count, int mode, float strength, int active_group_index,
+                   const float* smear_from, const float* smear_to) {
+        dirty_count = 0;
+        if (count == 0) return 0;
+
+        if (mode == 2 && adj_starts.size() != (size_t)num_verts + 1) return 0;
+
+        // Mirrored targets go after the primary ones: [0, primary) + [primary, count)
+        int primary = count;
+        if (mirror_active()) count = append_mirror_targets(count);
+
+        DeltaOut delta = reserve_delta(count);
+        StridedStorage store{weight_indices.data(), weight_values.data()};
+        stats.calls++;
+        stats.verts_processed += count;
+        StatsClock::time_point t0 = StatsClock::now();
+
+        with_influence_cap(max_influence, [&](auto cap) {
+            constexpr int K = decltype(cap)::value;
+            if (mode == 2) {
+                // Blur is group agnostic -> one pass over both sides
+                smooth_jacobi_pass<StridedStorage, K>(*pool,
+                    adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                    store, targets.data(), count, strength, false, &delta, flags());
+                return;
+            }
+            if (mode == 0 && smear_from && smear_to && grid_coords.size() == (size_t)num_verts * 3) {
+                float offset[3] = {smear_to[0] - smear_from[0], smear_to[1] - smear_from[1], smear_to[2] - smear_from[2]};
+                smear_sampled_pass<StridedStorage, K>(*pool, grid, grid_coords.data(), num_verts,
+                    store, targets.data(), factors.data(), count, offset,
+                    count > primary ? mirror_map.data() : nullptr, primary, &delta, flags());
+                return;
+            }
+            const float* smear_source = mode == 0 ? smear_from : nullptr;
+            float smear_value = -1.0f;
+            if (smear_source) smear_value = sample_weight(smear_source, active_group_index);
+            apply_vertex_logic_impl<StridedStorage, K>(
+                store, targets.data(), factors.data(), primary,
+                active_group_index, mode, smear_value, &delta, flags());
+
+            if (count > primary) {
+                int mirrored_group = mirror_group(active_group_index);
+                float mirrored_smear = -1.0f;
+                if (smear_source) mirrored_smear = sample_weight(smear_source, mirrored_group, true);
+                apply_vertex_logic_impl<StridedStorage, K>(
+                    store, targets.data() + primary, factors.data() + primary, count - primary,
+                    mirrored_group, mode, mirrored_smear, &delta, flags());
+            }
+        });
+        stats_add_time(stats, STATS_KERNEL, t0);
+
+        commit_delta(delta);
+        return delta.count;
+    }
+
+    // Undo record (when the journal has an open stroke) + pending list for a kernel's dirty output
+    void commit_delta(const DeltaOut& delta) {
+        dirty_count = 0;
+        commit_changes(delta.verts, delta.before_indices, delta.before_values, delta.count);
+    }
+
+    // Same for changed vertices already stored (before_*: [count * MAX_STORAGE])
+    void commit_changes(const int* verts, const int* before_indices, const float* before_values, int count) {
+        StatsClock::time_point t0 = StatsClock::now();
+        if (undo && count > 0) undo->record(verts, before_indices, before_values, count);
+        if (pending_mark.size() < (size_t)num_verts) pending_mark.resize(num_verts, 0);
+        for (int i = 0; i < count; ++i) {
+            int v = verts[i];
+            if (!pending_mark[v]) {
+                pending_mark[v] = 1;
+                pending_verts.push_back(v);
+            }
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                if (weight_indices[v_base + k] >= 0) stats.groups_touched++;
+            }
+        }
+        stats.verts_changed += count;
+        dirty_count += count;
+        stats_add_time(stats, STATS_COMMIT, t0);
+    }
+
+    /**
+     * Full-mesh weight pipeline on the session weights (see
+     * weight_pipeline_strided), using the session's group flags and X-mirror
+     * map. Records undo + pending in stage order. Returns changed vertices.
+     */
+    int run_pipeline(const WeightOp* ops, int num_ops, const unsigned char* vertex_mask) {
+        dirty_count = 0;
+        if (num_verts == 0 || num_ops <= 0) return 0;
+        PipelineContext ctx{flags(), vertex_mask,
+                            mirror_active() ? mirror_map.data() : nullptr,
+                            group_remap.data(), (int)group_remap.size()};
+        std::vector<unsigned char> changed(num_verts, 0);
+        PipelineRecord record;
+        StridedStorage store{weight_indices.data(), weight_values.data()};
+        stats.calls++;
+        stats.verts_processed += num_verts;
+        StatsClock::time_point t0 = StatsClock::now();
+        int total = weight_pipeline_impl(*pool, num_verts, store, ops, num_ops, ctx, changed.data(), &record);
+        stats_add_time(stats, STATS_KERNEL, t0);
+        if (job) job->advance();
+
+        // One commit in (stage, chunk) order
+        std::vector<int> verts, before_indices;
+        std::vector<float> before_values;
+        verts.reserve(total);
+        before_indices.reserve((size_t)total * MAX_STORAGE);
+        before_values.reserve((size_t)total * MAX_STORAGE);
+        for (size_t c = 0; c < record.verts.size(); ++c) {
+            verts.insert(verts.end(), record.verts[c].begin(), record.verts[c].end());
+            before_indices.insert(before_indices.end(), record.indices[c].begin(), record.indices[c].end());
+            before_values.insert(before_values.end(), record.values[c].begin(), record.values[c].end());
+        }
+        commit_changes(verts.data(), before_indices.data(), before_values.data(), (int)verts.size());
+        return total;
+    }
+
+    /**
+     * Weight transfer onto the session weights (see transfer_weights_strided)
+     * with the session's group flags and influence cap. vert_coords: the
+     * session mesh's [num_verts * 3], as the matrix expects. Records undo +
+     * pending in vertex order. Returns changed vertices.
+     */
+    int run_transfer(const TransferSurface& surf, const float* vert_coords, TransferParams params) {
+        dirty_count = 0;
+        if (num_verts == 0 || surf.nodes.empty()) return 0;
+        params.flags = flags();
+        std::vector<int> snap_g(weight_indices);
+        std::vector<float> snap_w(weight_values);
+        std::vector<unsigned char> changed(num_verts, 0);
+        StridedStorage store{weight_indices.data(), weight_values.data()};
+        stats.calls++;
+        stats.verts_processed += num_verts;
+        StatsClock::time_point t0 = StatsClock::now();
+        int total = 0;
+        with_influence_cap(max_influence, [&](auto cap) {
+            constexpr int K = decltype(cap)::value;
+            total = transfer_weights_impl<K>(*pool, surf, num_verts, vert_coords, store, params, changed.data());
+        });
+        stats_add_time(stats, STATS_KERNEL, t0);
+
+        std::vector<int> verts, before_indices;
+        std::vector<float> before_values;
+        verts.reserve(total);
+        before_indices.reserve((size_t)total * MAX_STORAGE);
+        before_values.reserve((size_t)total * MAX_STORAGE);
+        for (int v = 0; v < num_verts; ++v) {
+            if (!changed[v]) continue;
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            verts.push_back(v);
+            before_indices.insert(before_indices.end(), snap_g.begin() + v_base, snap_g.begin() + v_base + MAX_STORAGE);
+            before_values.insert(before_values.end(), snap_w.begin() + v_base, snap_w.begin() + v_base + MAX_STORAGE);
+        }
+        commit_changes(verts.data(), before_indices.data(), before_values.data(), (int)verts.size());
+        return total;
+    }
+
+    /**
+     * Heat weights (see heat_weights_impl) on the session's CSR and weights,
+     * vert_coords in the bones' space. Changed vertices go to the undo
+     * journal and the pending list. Returns changed vertices.
+     */
+    int run_heat(const float* vert_coords, int num_bones, const float* bone_segments, const float* bone_radii,
+                 const int* bone_groups, const HeatParams& params, int* out_iterations) {
+        dirty_count = 0;
+        if (num_verts == 0 || num_bones <= 0 || adj_starts.size() != (size_t)num_verts + 1) return 0;
+        std::vector<int> snap_g(weight_indices);
+        std::vector<float> snap_w(weight_values);
+        stats.calls++;
+        stats.verts_processed += num_verts;
+        StatsClock::time_point t0 = StatsClock::now();
+        int solved = heat_weights_impl(*pool, num_verts, vert_coords, adj_starts.data(), adj_indices.data(),
+                                       adj_weights.data(), num_bones, bone_segments, bone_radii, bone_groups,
+                                       params, weight_indices.data(), weight_values.data(), out_iterations, job);
+        stats_add_time(stats, STATS_KERNEL, t0);
+        if (solved < 0) return 0;
+        return commit_snapshot_diff(snap_g, snap_w);
+    }
+
+    /**
+     * Binary weights (see binary_weights_strided) on the session weights,
+     * vert_coords in the bones' space, geodesic flood over the session CSR
+     * if use_geodesic. Records undo + pending. Returns changed vertices.
+     */
+    int run_binary(const float* vert_coords, int num_bones, const float* bone_segments, const float* bone_radii,
+                   const int* bone_groups, bool use_geodesic) {
+        dirty_count = 0;
+        if (num_verts == 0 || num_bones <= 0) return 0;
+        bool geodesic = use_geodesic && adj_starts.size() == (size_t)num_verts + 1;
+        std::vector<int> snap_g(weight_indices);
+        std::vector<float> snap_w(weight_values);
+        stats.calls++;
+        stats.verts_processed += num_verts;
+        StatsClock::time_point t0 = StatsClock::now();
+        binary_weights_impl(*pool, num_verts, vert_coords, num_bones, bone_segments, bone_radii, bone_groups,
+                            geodesic ? adj_starts.data() : nullptr, geodesic ? adj_indices.data() : nullptr,
+                            nullptr, nullptr, weight_indices.data(), weight_values.data());
+        stats_add_time(stats, STATS_KERNEL, t0);
+        return commit_snapshot_diff(snap_g, snap_w);
+    }
+
+    // Commits every vertex whose slots differ from the snapshot (full-mesh kernels). Returns their count.
+    int commit_snapshot_diff(const std::vector<int>& snap_g, const std::vector<float>& snap_w) {
+        std::vector<int> verts, before_indices;
+        std::vector<float> before_values;
+        for (int v = 0; v < num_verts; ++v) {
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            if (std::equal(snap_g.begin() + v_base, snap_g.begin() + v_base + MAX_STORAGE, weight_indices.begin() + v_base) &&
+                std::equal(snap_w.begin() + v_base, snap_w.begin() + v_base + MAX_STORAGE, weight_values.begin() + v_base)) {
+                continue;
+            }
+            verts.push_back(v);
+            before_indices.insert(before_indices.end(), snap_g.begin() + v_base, snap_g.begin() + v_base + MAX_STORAGE);
+            before_values.insert(before_values.end(), snap_w.begin() + v_base, snap_w.begin() + v_base + MAX_STORAGE);
+        }
+        commit_changes(verts.data(), before_indices.data(), before_values.data(), (int)verts.size());
+        return (int)verts.size();
+    }
+
+    /**
+     * Whole-mesh blur: up to `iterations` Jacobi passes of
+     * smooth_vertex_strided over every vertex, all groups, with the
+     * session's group flags and influence cap. Stops once a pass changes no
+     * weight by `tolerance` or more (<= 0: every pass). backend SMOOTH_*:
+     * AUTO uses the GPU from GPU_MIN_VERTS vertices on, GPU / AUTO fall
+     * back to the CPU when the device can't run it (same result either way).
+     * out_backend / out_passes (may be NULL): what actually ran.
+     * Records undo + pending in vertex order. Returns changed vertices.
+     */
+    int run_mesh_smooth(float factor, int iterations, float tolerance, int backend, int* out_backend, int* out_passes) {
+        dirty_count = 0;
+        if (out_backend) *out_backend = SMOOTH_CPU;
+        if (out_passes) *out_passes = 0;
+        if (num_verts == 0 || iterations <= 0 || adj_starts.size() != (size_t)num_verts + 1) return 0;
+        stats.calls++;
+        stats.verts_processed += num_verts;
+        StatsClock::time_point t0 = StatsClock::now();
+        int cap = MAX_INFLUENCE;
+        with_influence_cap(max_influence, [&](auto c) { cap = decltype(c)::value; });
+
+        if (backend == SMOOTH_GPU || (backend == SMOOTH_AUTO && num_verts >= GPU_MIN_VERTS)) {
+            if (!gpu) gpu.reset(new GpuMeshBuffers());
+            std::vector<int> verts, after_g;
+            std::vector<float> after_w;
+            int passes = gpu_smooth_mesh(*gpu, num_verts, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                         topology_fp, coords_fp, weight_indices.data(), weight_values.data(),
+                                         flags() ? group_flags.data() : nullptr, (int)group_flags.size(), cap,
+                                         factor, iterations, tolerance, job, verts, after_g, after_w);
+            if (passes >= 0) {
+                stats_add_time(stats, STATS_KERNEL, t0);
+                if (out_backend) *out_backend = SMOOTH_GPU;
+                if (out_passes) *out_passes = passes;
+                if (job && job->cancelled()) return 0;
+                // Downloaded slots -> session weights, what they replace -> undo
+                std::vector<int> before_g(after_g.size());
+                std::vector<float> before_w(after_w.size());
+                for (size_t i = 0; i < verts.size(); ++i) {
+                    size_t v_base = (size_t)verts[i] * MAX_STORAGE;
+                    size_t base = i * MAX_STORAGE;
+                    std::copy(weight_indices.begin() + v_base, weight_indices.begin() + v_base + MAX_STORAGE, before_g.begin() + base);
+                    std::copy(weight_values.begin() + v_base, weight_values.begin() + v_base + MAX_STORAGE, before_w.begin() + base);
+                    std::copy(after_g.begin() + base, after_g.begin() + base + MAX_STORAGE, weight_indices.begin() + v_base);
+                    std::copy(after_w.begin() + base, after_w.begin() + base + MAX_STORAGE, weight_values.begin() + v_base);
+                }
+                commit_changes(verts.data(), before_g.data(), before_w.data(), (int)verts.size());
+                return (int)verts.size();
+            }
+        }
+
+        std::vector<int> snap_g(weight_indices);
+        std::vector<float> snap_w(weight_values);
+        if (targets.size() < (size_t)num_verts) {
+            targets.resize(num_verts);
+            factors.resize(num_verts);
+        }
+        for (int v = 0; v < num_verts; ++v) targets[v] = v;
+        StridedStorage store{weight_indices.data(), weight_values.data()};
+        bool track = tolerance > 0.0f;
+        int passes = 0;
+        bool cancelled = false;
+        with_influence_cap(max_influence, [&](auto c) {
+            constexpr int K = decltype(c)::value;
+            while (passes < iterations) {
+                float max_delta = smooth_jacobi_pass<StridedStorage, K>(*pool,
+                    adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                    store, targets.data(), num_verts, factor, track, nullptr, flags());
+                passes++;
+                if (job && !job->advance()) { cancelled = true; return; }
+                if (track && max_delta < tolerance) return;
+            }
+        });
+        stats_add_time(stats, STATS_KERNEL, t0);
+        if (out_passes) *out_passes = passes;
+        if (cancelled) return 0; // finish_session_job restores the submit snapshot
+        return commit_snapshot_diff(snap_g, snap_w);
+    }
+
+    /**
+     * Single-group smooth (vertex_group_smooth + normalize_all(lock_active)):
+     * `iterations` Jacobi passes of w_g = lerp(w_g, CSR-weighted neighbour
+     * average of w_g, factor) over the targets (NULL = every vertex), then
+     * the other groups are rescaled to fill 1 - w_g. Returns changed vertices.
+     * With group flags: a locked / excluded group is left alone, only free
+     * deform groups are rescaled (to 1 - w_g - locked deform weight), and a
+     * non-deform group is smoothed without touching the others.
+     */
+    int smooth_group(const int* target_list, int count, int group, float factor, int iterations) {
+        dirty_count = 0;
+        if (num_verts == 0 || group < 0 || adj_starts.size() != (size_t)num_verts + 1) return 0;
+        const GroupFlags* gf = flags();
+        if (gf && gf->pinned(group)) return 0;
+        bool rescale = !gf || gf->normalized(group);
+        if (!target_list) count = num_verts;
+        if (count <= 0) return 0;
+        if (targets.size() < (size_t)count) {
+            targets.resize(count);
+            factors.resize(count);
+        }
+        for (int t = 0; t < count; ++t) targets[t] = target_list ? target_list[t] : t;
+        stats.calls++;
+        stats.verts_processed += count;
+        StatsClock::time_point t0 = StatsClock::now();
+
+        // Group column for the whole mesh (neighbours outside the targets are read too)
+        std::vector<float> column(num_verts, 0.0f);
+        KernelPool& kp = *pool;
+        kp.threads.parallel_for(num_verts, TARGET_GRAIN * 16, [&](int begin, int end, int) {
+            for (int v = begin; v < end; ++v) {
+                size_t v_base = (size_t)v * MAX_STORAGE;
+                for (int k = 0; k < MAX_STORAGE; ++k) {
+                    if (weight_indices[v_base + k] == group) column[v] = weight_values[v_base + k];
+                }
+            }
+        });
+
+        std::vector<float>& next = factors; // Per-target new value (reused scratch)
+        for (int it = 0; it < iterations; ++it) {
+            kp.threads.parallel_for(count, TARGET_GRAIN, [&](int begin, int end, int) {
+                for (int t = begin; t < end; ++t) {
+                    int v = targets[t];
+                    float sum = 0.0f, total = 0.0f;
+                    for (int i = adj_starts[v]; i < adj_starts[v + 1]; ++i) {
+                        sum += column[adj_indices[i]] * adj_weights[i];
+                        total += adj_weights[i];
+                    }
+                    next[t] = total > 0.0f ? column[v] + (sum / total - column[v]) * factor : column[v];
+                }
+            });
+            for (int t = 0; t < count; ++t) column[targets[t]] = next[t];
+            if (job && !job->advance()) return 0; // Cancelled: nothing written yet
+        }
+
+        DeltaOut delta = reserve_delta(count);
+        kp.reserve_targets(count);
+        kp.threads.parallel_for(count, TARGET_GRAIN, [&](int begin, int end, int) {
+            for (int t = begin; t < end; ++t) {
+                int v = targets[t];
+                size_t v_base = (size_t)v * MAX_STORAGE;
+                int* g = weight_indices.data() + v_base;
+                float* w = weight_values.data() + v_base;
+                int* out_g = kp.out_groups.data() + (size_t)t * MAX_STORAGE;
+                float* out_w = kp.out_weights.data() + (size_t)t * MAX_STORAGE;
+                std::copy(g, g + MAX_STORAGE, out_g);
+                std::copy(w, w + MAX_STORAGE, out_w);
+
+                float value = std::min(std::max(column[v], 0.0f), 1.0f);
+                int slot = -1;
+                float others = 0.0f; // Rescaled to fill the rest
+                float fixed = 0.0f;  // Locked deform weight
+                for (int k = 0; k < MAX_STORAGE; ++k) {
+                    int g_k = out_g[k];
+                    if (g_k == group) slot = k;
+                    else if (g_k >= 0 && (!gf || gf->free_deform(g_k))) others += out_w[k];
+                    else if (g_k >= 0 && gf->normalized(g_k)) fixed += out_w[k];
+                }
+                if (slot < 0 && value > 0.0001f) {
+                    // Free slot, else replace the smallest other (unpinned) influence
+                    for (int k = 0; k < MAX_STORAGE; ++k) {
+                        if (out_g[k] < 0) { slot = k; break; }
+                        if (gf && gf->pinned(out_g[k])) continue;
+                        if (slot < 0 || out_w[k] < out_w[slot]) slot = k;
+                    }
+                    if (slot >= 0) {
+                        if (out_g[slot] >= 0 && (!gf || gf->free_deform(out_g[slot]))) others -= out_w[slot];
+                        out_g[slot] = group;
+                    }
+                }
+                if (slot >= 0) {
+                    out_w[slot] = value;
+                    if (value <= 0.0001f) { out_g[slot] = -1; out_w[slot] = 0.0f; }
+                }
+                if (rescale && others > 0.0f) {
+                    float scale = std::max(0.0f, 1.0f - value - fixed) / others;
+                    for (int k = 0; k < MAX_STORAGE; ++k) {
+                        int g_k = out_g[k];
+                        if (g_k >= 0 && g_k != group && (!gf || gf->free_deform(g_k))) out_w[k] *= scale;
+                    }
+                }
+                kp.out_valid[t] = DeltaOut::changed(g, w, out_g, out_w) ? 2 : 0;
+            }
+        });
+
+        // Serial commit in target order (deterministic dirty list)
+        for (int t = 0; t < count; ++t) {
+            if (kp.out_valid[t] != 2) continue;
+            size_t v_base = (size_t)targets[t] * MAX_STORAGE;
+            const int* out_g = kp.out_groups.data() + (size_t)t * MAX_STORAGE;
+            const float* out_w = kp.out_weights.data() + (size_t)t * MAX_STORAGE;
+            delta.write_at(delta.count++, targets[t], weight_indices.data() + v_base, weight_values.data() + v_base, out_g, out_w);
+            std::copy(out_g, out_g + MAX_STORAGE, weight_indices.data() + v_base);
+            std::copy(out_w, out_w + MAX_STORAGE, weight_values.data() + v_base);
+        }
+        stats_add_time(stats, STATS_KERNEL, t0);
+        commit_delta(delta);
+        return delta.count;
+    }
+
+    /**
+     * Dab footprint: Euclidean range query, or (Connected Only) geodesic
+     * distance from the nearest vertex, seeded with its distance to the center.
+     */
+    int query_footprint(const float* center, float radius, int falloff_mode, float strength,
+                        int* out_indices, float* out_factors, int max_out) {
+        if (!connected_only || adj_starts.size() != (size_t)num_verts + 1) {
+            int found = query_spatial_grid(grid, center, radius, falloff_mode, strength,
+                                           out_indices, out_factors, max_out);
+            return std::min(found, max_out);
+        }
+        float seed_dist = 0.0f;
+        int seed = nearest_spatial_grid(grid, center, &seed_dist);
+        if (seed < 0 || seed_dist >= radius) return 0;
+        return geodesic_falloff_query(geodesic, num_verts, adj_starts.data(), adj_indices.data(), adj_weights.data(),
+                                      &seed, &seed_dist, 1, radius, 0, falloff_mode, strength,
+                                      out_indices, out_factors, max_out);
+    }
+
+    /**
+     * Adds one dab footprint to the merged target list.
+     * merge_mode: 0 = Max factor, 1 = Accumulate (a + b - a*b, stays <= 1).
+     */
+    int merge_footprint(int count, const float* center, float radius, int falloff_mode, float strength, int merge_mode) {
+        int found = query_footprint(center, radius, falloff_mode, strength,
+                                    query_indices.data(), query_factors.data(), (int)query_indices.size());
+        for (int i = 0; i < found; ++i) {
+            int v = query_indices[i];
+            float f = query_factors[i];
+            if (merge_stamp[v] != merge_current) {
+                merge_stamp[v] = merge_current;
+                merge_slot[v] = count;
+                targets[count] = v;
+                factors[count] = f;
+                count++;
+            } else {
+                float& merged = factors[merge_slot[v]];
+                merged = merge_mode == 1 ? merged + f - merged * f : std::max(merged, f);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Appends the mirror counterparts of targets[0..count) with the same
+     * factor (vertices already targeted, e.g. on the symmetry line, are skipped).
+     */
+    int append_mirror_targets(int count) {
+        begin_merge();
+        for (int i = 0; i < count; ++i) merge_stamp[targets[i]] = merge_current;
+        int total = count;
+        for (int i = 0; i < count; ++i) {
+            int u = mirror_map[targets[i]];
+            if (u < 0 || merge_stamp[u] == merge_current) continue;
+            merge_stamp[u] = merge_current;
+            targets[total] = u;
+            factors[total] = factors[i];
+            total++;
+        }
+        return total;
+    }
+
+    void begin_merge() {
+        if (merge_stamp.size() < (size_t)num_verts) {
+            merge_stamp.assign(num_verts, 0);
+            merge_slot.resize(num_verts);
+            merge_current = 0;
+        }
+        if (++merge_current == 0x7FFFFFFF) {
+            std::fill(merge_stamp.begin(), merge_stamp.end(), 0);
+            merge_current = 1;
+        }
+    }
+};
+
+/**
+ * Multi-Mesh Batches
+ *
+ * One operation over several sessions (a character's body, clothes, hair
+ * cards...) on a single pool instead of one mesh after the other:
+ * - Meshes too big to balance as single tasks (at least `remaining
+ *   vertices / threads`) run first, one at a time, with their kernels
+ *   parallel over the batch pool.
+ * - The rest run one mesh per task, largest first. Idle workers claim
+ *   the next mesh from the pool's shared counter, which gives
+ *   longest-first greedy balancing by vertex count. Each worker uses its
+ *   own serial KernelPool, so per-worker scratch is never shared.
+ * Every kernel is deterministic for any thread count, so each mesh ends
+ * up exactly as it would when run alone. Sessions running a background
+ * job are skipped (result -1).
+ */
+struct BatchPools {
+    std::vector<std::unique_ptr<KernelPool>> serial; // Per batch worker, created on first use
+
+    explicit BatchPools(int num_workers) : serial(num_workers) {}
+
+    KernelPool& worker(int w) {
+        if (!serial[w]) serial[w].reset(new KernelPool(1));
+        return *serial[w];
+    }
+};
+
+// task(index) runs on sessions[index] with its pool temporarily swapped. out_results: [num_sessions] or NULL
+template <typename Task>
+static int run_session_batch(KernelPool& kp, BrushSession* const* sessions, int num_sessions,
+                             int* out_results, Task&& task) {
+    std::vector<int> order;
+    long long remaining = 0;
+    for (int i = 0; i < num_sessions; ++i) {
+        if (out_results) out_results[i] = -1;
+        if (!sessions[i] || sessions[i]->job) continue;
+        order.push_back(i);
+        remaining += sessions[i]->num_verts;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return sessions[a]->num_verts > sessions[b]->num_verts;
+    });
+
+    auto run_on = [&](int index, KernelPool& pool) {
+        BrushSession* s = sessions[index];
+        KernelPool* own = s->pool.kp;
+        s->pool.kp = &pool;
+        int result = task(index);
+        s->pool.kp = own;
+        if (out_results) out_results[index] = result;
+        return result;
+    };
+
+    int threads = kp.threads.size();
+    int total = 0;
+    size_t first_small = 0;
+    for (; first_small < order.size(); ++first_small) {
+        int verts = sessions[order[first_small]]->num_verts;
+        if (threads == 1 || (long long)verts * threads < remaining) break;
+        total += run_on(order[first_small], kp);
+        remaining -= verts;
+    }
+
+    BatchPools pools(threads);
+    std::vector<int> results(order.size(), 0);
+    kp.threads.parallel_for((int)(order.size() - first_small), 1, [&](int begin, int end, int worker) {
+        for (int t = begin; t < end; ++t) {
+            results[t] = run_on(order[first_small + t], pools.worker(worker));
+        }
+    });
+    for (int r : results) total += r;
+    return total;
+}
+
+/**
+ * Background Jobs
+ *
+ * A job runs one session operation (smooth, weight pipeline, heat solve)
+ * on its own thread, with the session's pool for the parallel parts, so
+ * Blender's UI thread stays free. The caller hands the session over
+ * until job_finish: no other session call in between (wynn_core keeps
+ * the core out of its cache meanwhile, and finishes every job before
+ * session_destroy). Inputs are copied at submit.
+ * The session's weights at submit are kept as a snapshot, so a cancelled
+ * job is rolled back completely, and smoothing works on its own Jacobi
+ * column anyway, so nothing is written until the last iteration.
+ */
+const int JOB_RUNNING = 0;
+const int JOB_DONE = 1;
+const int JOB_CANCELLED = 2;
+
+struct SessionJob {
+    BrushSession* session = nullptr;
+    JobControl control;
+    std::atomic<int> state{JOB_RUNNING};
+    int result = 0;
+    std::vector<int> snap_indices; // Session weights at submit
+    std::vector<float> snap_values;
+    size_t snap_pending = 0;       // pending_verts.size() at submit
+    std::thread worker;
+};
+
+// total: progress units the work reports through session->job
+static SessionJob* start_session_job(BrushSession* s, int total, std::function<int()> work) {
+    if (s->job) return nullptr; // One job per session
+    SessionJob* job = new SessionJob();
+    job->session = s;
+    job->control.total = std::max(total, 1);
+    job->snap_indices = s->weight_indices;
+    job->snap_values = s->weight_values;
+    job->snap_pending = s->pending_verts.size();
+    s->job = &job->control;
+    job->worker = std::thread([job, work]() {
+        job->result = work();
+        job->state.store(job->control.cancelled() ? JOB_CANCELLED : JOB_DONE, std::memory_order_release);
+    });
+    return job;
+}
+
+// Joins the worker and gives the session back. Cancelled: weights and pending list as at submit.
+static int finish_session_job(SessionJob* job) {
+    if (job->worker.joinable()) job->worker.join();
+    BrushSession* s = job->session;
+    s->job = nullptr;
+    int result = job->result;
+    if (job->state.load(std::memory_order_acquire) == JOB_CANCELLED) {
+        s->weight_indices.swap(job->snap_indices);
+        s->weight_values.swap(job->snap_values);
+        for (size_t i = job->snap_pending; i < s->pending_verts.size(); ++i) s->pending_mark[s->pending_verts[i]] = 0;
+        s->pending_verts.resize(job->snap_pending);
+        s->dirty_count = 0;
+        result = -1;
+    }
+    delete job;
+    return result;
+}
+
+extern "C" {
+
+    /**
+     * Kernel Pool Lifetime
+     * Create once per modal session (WynnWeightBrush.invoke), destroy on exit.
+     * num_threads <= 0 uses all hardware threads.
+     */
+    EXPORT void* pool_create(int num_threads) {
+        return new KernelPool(num_threads);
+    }
+
+    EXPORT void pool_destroy(void* pool) {
+        delete static_cast<KernelPool*>(pool);
+    }
+
+    EXPORT int pool_size(void* pool) {
+        return pool ? static_cast<KernelPool*>(pool)->threads.size() : 1;
+    }
+
+    /**
+     * Jacobi Smoothing (Multithreaded)
+     *
+     * Same math as smooth_strided, but every target reads the pre-pass state
+     * of its neighbours (double buffered), so the targets can be split across
+     * the pool and the result doesn't depend on target order.
+     *
+     * Pointers: same as smooth_strided.
+     * - pool: handle from pool_create (NULL = single threaded)
+     * - target_indices must not contain duplicates.
+     */
+    EXPORT void smooth_strided_jacobi(
+        void* pool,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+
+        int* weight_indices,
+        float* weight_values,
+
+        const int* target_indices,
+        int num_targets,
+        float factor
+    ) {
+        PoolRef kp(pool);
+        smooth_jacobi_pass(*kp,
+            adj_starts, adj_indices, adj_weights,
+            StridedStorage{weight_indices, weight_values},
+            target_indices, num_targets, factor);
+    }
+
+    /**
+     * smooth_strided_jacobi + Dirty-Vertex Output
+     * Extra outputs: same as apply_vertex_logic_strided_tracked.
+     * Returns: number of changed vertices (in target order).
+     */
+    EXPORT int smooth_strided_jacobi_tracked(
+        void* pool,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+
+        int* weight_indices,
+        float* weight_values,
+
+        const int* target_indices,
+        int num_targets,
+        float factor,
+
+        int* out_verts,
+        int* out_before_indices,
+        float* out_before_values,
+        int* out_after_indices,
+        float* out_after_values
+    ) {
+        PoolRef kp(pool);
+        DeltaOut delta{out_verts, out_before_indices, out_before_values, out_after_indices, out_after_values, 0};
+        smooth_jacobi_pass(*kp,
+            adj_starts, adj_indices, adj_weights,
+            StridedStorage{weight_indices, weight_values},
+            target_indices, num_targets, factor, false, &delta);
+        return delta.count;
+    }
+
+    /**
+     * Optimized Smoothing with Strided Data and In-Place Updates
+     * 
+     * Pointers:
+     * - adj_starts/indices/weights: Standard CSR graph (Read Only)
+     * 
+     * - weight_indices: [num_verts * MAX_STORAGE] (Read/Write)
+     * - weight_values:  [num_verts * MAX_STORAGE] (Read/Write)
+     * 
+     * - target_indices: Vertices to process
+     * - num_targets: Count
+     * - factor: usage varies (0.0 - 1.0)
+     */
+    EXPORT void smooth_strided(
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        
+        int* weight_indices,
+        float* weight_values,
+        
+        const int* target_indices,
+        int num_targets,
+        float factor
+    ) {
+        smooth_seidel_impl(adj_starts, adj_indices, adj_weights, StridedStorage{weight_indices, weight_values},
+                           target_indices, num_targets, factor, nullptr);
+    }
+
+    /**
+     * smooth_strided + Dirty-Vertex Output
+     * Extra outputs: same as apply_vertex_logic_strided_tracked.
+     * Returns: number of changed vertices.
+     */
+    EXPORT int smooth_strided_tracked(
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        int* weight_indices,
+        float* weight_values,
+        const int* target_indices,
+        int num_targets,
+        float factor,
+        int* out_verts,
+        int* out_before_indices,
+        float* out_before_values,
+        int* out_after_indices,
+        float* out_after_values
+    ) {
+        DeltaOut delta{out_verts, out_before_indices, out_before_values, out_after_indices, out_after_values, 0};
+        smooth_seidel_impl(adj_starts, adj_indices, adj_weights, StridedStorage{weight_indices, weight_values},
+                           target_indices, num_targets, factor, &delta);
+        return delta.count;
+    }
+
+    /**
+     * Multi-Iteration Smoothing (Jacobi)
+     *
+     * Runs up to `iterations` smooth_strided_jacobi passes in one call.
+     * Stops early once the largest weight change of a pass drops below
+     * `tolerance` (tolerance <= 0 always runs every pass).
+     *
+     * Pointers: same as smooth_strided_jacobi.
+     * Returns: number of passes actually run.
+     */
+    EXPORT int smooth_strided_iterations(
+        void* pool,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+
+        int* weight_indices,
+        float* weight_values,
+
+        const int* target_indices,
+        int num_targets,
+        float factor,
+        int iterations,
+        float tolerance
+    ) {
+        PoolRef kp(pool);
+
+        bool track = tolerance > 0.0f;
+        int passes = 0;
+        while (passes < iterations) {
+            float max_delta = smooth_jacobi_pass(*kp,
+                adj_starts, adj_indices, adj_weights,
+                StridedStorage{weight_indices, weight_values},
+                target_indices, num_targets, factor, track);
+            passes++;
+            if (track && max_delta < tolerance) break;
+        }
+        return passes;
+    }
+
+    /**
+     * Optimized Vertex Logic (Smear / Harden)
+     * Does NOT use Adjacency (Vertex independent)
+     * 
+     * target_factors: Per-vertex factor (strength * falloff)
+     */
+    EXPORT void apply_vertex_logic_strided(
+        int* weight_indices,
+        float* weight_values,
+        const int* target_indices,
+        const float* target_factors,
+        int num_targets,
+        int active_group_index,
+        int mode, // 0=Smear, 1=Harden
+        float smear_value
+    ) {
+        apply_vertex_logic_impl(StridedStorage{weight_indices, weight_values}, target_indices, target_factors,
+                                num_targets, active_group_index, mode, smear_value, nullptr);
+    }
+
+    /**
+     * apply_vertex_logic_strided + Dirty-Vertex Output
+     *
+     * out_verts: [num_targets] changed vertices (compact)
+     * out_before_* / out_after_*: [num_targets * MAX_STORAGE] slots per changed vertex
+     * Returns: number of changed vertices.
+     */
+    EXPORT int apply_vertex_logic_strided_tracked(
+        int* weight_indices,
+        float* weight_values,
+        const int* target_indices,
+        const float* target_factors,
+        int num_targets,
+        int active_group_index,
+        int mode,
+        float smear_value,
+        int* out_verts,
+        int* out_before_indices,
+        float* out_before_values,
+        int* out_after_indices,
+        float* out_after_values
+    ) {
+        DeltaOut delta{out_verts, out_before_indices, out_before_values, out_after_indices, out_after_values, 0};
+        apply_vertex_logic_impl(StridedStorage{weight_indices, weight_values}, target_indices, target_factors,
+                                num_targets, active_group_index, mode, smear_value, &delta);
+        return delta.count;
+    }
+
+    /**
+     * Sampled Smear (see smear_sampled_pass): every target takes
+     * lerp(self, weights at (its position - offset), factor) over all groups.
+     * grid: spatial_create handle built from vert_coords (same space as offset).
+     * offset: stroke delta (cursor - previous cursor).
+     * out_*: dirty-vertex output as apply_vertex_logic_strided_tracked, or all NULL.
+     * Returns: number of changed vertices (0 untracked).
+     */
+    EXPORT int smear_strided_sampled(
+        void* pool,
+        void* grid,
+        int num_verts,
+        const float* vert_coords,
+        int* weight_indices,
+        float* weight_values,
+        const int* target_indices,
+        const float* target_factors,
+        int num_targets,
+        const float* offset,
+        int* out_verts,
+        int* out_before_indices,
+        float* out_before_values,
+        int* out_after_indices,
+        float* out_after_values
+    ) {
+        const SpatialGrid& g = *static_cast<SpatialGrid*>(grid);
+        if (num_targets <= 0 || g.num_verts != num_verts) return 0;
+        PoolRef kp(pool);
+        DeltaOut delta{out_verts, out_before_indices, out_before_values, out_after_indices, out_after_values, 0};
+        smear_sampled_pass(*kp, g, vert_coords, num_verts, StridedStorage{weight_indices, weight_values},
+                           target_indices, target_factors, num_targets, offset, nullptr, num_targets,
+                           out_verts ? &delta : nullptr);
+        return delta.count;
+    }
+
+    /**
+     * Quantized Storage (16-bit group + 16-bit unorm weight per slot)
+     * Same stride/slot layout as the strided buffers, half the bytes.
+     * See QuantizedStorage; the kernels below are the strided kernels
+     * instantiated on that policy.
+     */
+    EXPORT void quantize_weights_strided(
+        int num_verts,
+        const int* weight_indices,
+        const float* weight_values,
+        uint16_t* out_indices,
+        uint16_t* out_values
+    ) {
+        QuantizedStorage dst{out_indices, out_values};
+        for (int v = 0; v < num_verts; ++v) {
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            dst.store(v_base, weight_indices + v_base, weight_values + v_base);
+        }
+    }
+
+    EXPORT void dequantize_weights_strided(
+        int num_verts,
+        const uint16_t* q_indices,
+        const uint16_t* q_values,
+        int* out_indices,
+        float* out_values
+    ) {
+        const QuantizedStorage src{const_cast<uint16_t*>(q_indices), const_cast<uint16_t*>(q_values)};
+        for (int v = 0; v < num_verts; ++v) {
+            size_t v_base = (size_t)v * MAX_STORAGE;
+            src.load(v_base, out_indices + v_base, out_values + v_base);
+        }
+    }
+
+    /**
+     * smooth_strided_jacobi on quantized storage.
+     */
+    EXPORT void smooth_quantized_jacobi(
+        void* pool,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+
+        uint16_t* q_indices,
+        uint16_t* q_values,
+
+        const int* target_indices,
+        int num_targets,
+        float factor
+    ) {
+        PoolRef kp(pool);
+        smooth_jacobi_pass(*kp,
+            adj_starts, adj_indices, adj_weights,
+            QuantizedStorage{q_indices, q_values},
+            target_indices, num_targets, factor);
+    }
+
+    /**
+     * smooth_strided (Seidel) on quantized storage.
+     */
+    EXPORT void smooth_quantized(
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        uint16_t* q_indices,
+        uint16_t* q_values,
+        const int* target_indices,
+        int num_targets,
+        float factor
+    ) {
+        smooth_seidel_impl(adj_starts, adj_indices, adj_weights, QuantizedStorage{q_indices, q_values},
+                           target_indices, num_targets, factor, nullptr);
+    }
+
+    /**
+     * apply_vertex_logic_strided on quantized storage.
+     */
+    EXPORT void apply_vertex_logic_quantized(
+        uint16_t* q_indices,
+        uint16_t* q_values,
+        const int* target_indices,
+        const float* target_factors,
+        int num_targets,
+        int active_group_index,
+        int mode, // 0=Smear, 1=Harden
+        float smear_value
+    ) {
+        apply_vertex_logic_impl(QuantizedStorage{q_indices, q_values}, target_indices, target_factors,
+                                num_targets, active_group_index, mode, smear_value, nullptr);
+    }
+
+    /**
+     * Build Adjacency Graph (CSR) from Raw Edges
+     * Replaces slow Python loop.
+     * 
+     * edge_indices: [num_edges * 2] (flattened pairs)
+     * vert_coords: [num_verts * 3] (flattened x,y,z)
+     * 
+     * Output:
+     * adj_starts: [num_verts + 1] (Pre-allocated)
+     * adj_indices: [num_edges * 2] (Pre-allocated)
+     * adj_weights: [num_edges * 2] (Pre-allocated)
+     */
+    EXPORT void build_adjacency_graph(
+        int num_verts,
+        int num_edges,
+        const int* edge_indices,
+        const float* vert_coords,
+        int* adj_starts,
+        int* adj_indices,
+        float* adj_weights
+    ) {
+        PoolRef kp(nullptr);
+        build_adjacency_impl(*kp, num_verts, num_edges, edge_indices, vert_coords,
+                             adj_starts, adj_indices, adj_weights);
+    }
+
+    /**
+     * Build Adjacency Graph (CSR), Multithreaded
+     * Same arguments and identical output as build_adjacency_graph.
+     * - pool: handle from pool_create (NULL = single threaded)
+     */
+    EXPORT void build_adjacency_graph_mt(
+        void* pool,
+        int num_verts,
+        int num_edges,
+        const int* edge_indices,
+        const float* vert_coords,
+        int* adj_starts,
+        int* adj_indices,
+        float* adj_weights
+    ) {
+        PoolRef kp(pool);
+        build_adjacency_impl(*kp, num_verts, num_edges, edge_indices, vert_coords,
+                             adj_starts, adj_indices, adj_weights);
+    }
+
+    /**
+     * Edge Weights (SIMD Batch)
+     * out_weights[i] = 1 / (edge_length + 0.0001), same as build_adjacency_graph.
+     *
+     * edge_indices: [num_edges * 2] (flattened pairs)
+     * vert_coords: [num_verts * 3] (flattened x,y,z)
+     * out_weights: [num_edges] (Pre-allocated)
+     */
+    EXPORT void compute_edge_weights(
+        int num_edges,
+        const int* edge_indices,
+        const float* vert_coords,
+        float* out_weights
+    ) {
+        edge_weights_batch(0, num_edges, edge_indices, vert_coords, out_weights);
+    }
+
+    /**
+     * Edge Weights In Place (see update_edge_weights_impl)
+     * For a CSR whose topology is unchanged but whose coords moved:
+     * same result as rebuilding with build_adjacency_graph.
+     * - pool: handle from pool_create (NULL = single threaded)
+     */
+    EXPORT void update_edge_weights(
+        void* pool,
+        int num_verts,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* vert_coords,
+        float* adj_weights
+    ) {
+        PoolRef kp(pool);
+        update_edge_weights_impl(*kp, num_verts, adj_starts, adj_indices, vert_coords, adj_weights);
+    }
+
+    /**
+     * Buffer Fingerprint (see fingerprint_buffer)
+     * Hash the edge array and the coordinate array separately to tell
+     * topology changes from pose / shape / edit moves.
+     */
+    EXPORT unsigned long long mesh_fingerprint(void* pool, const void* data, long long num_bytes) {
+        PoolRef kp(pool);
+        return fingerprint_buffer(*kp, data, num_bytes > 0 ? (size_t)num_bytes : 0);
+    }
+
+    /**
+     * Working-set size of extract_subgraph for the same targets, so the
+     * caller can allocate exact outputs instead of full-mesh ones.
+     * out_num_entries: local CSR entries. Returns: number of local vertices.
+     */
+    EXPORT int subgraph_size(
+        const int* adj_starts,
+        const int* adj_indices,
+        int num_verts,
+        const int* targets,
+        int num_targets,
+        int* out_num_entries
+    ) {
+        return extract_subgraph_impl(adj_starts, adj_indices, nullptr, num_verts, targets, num_targets,
+                                     nullptr, nullptr, nullptr, nullptr, nullptr, out_num_entries);
+    }
+
+    /**
+     * Extract Subgraph (full-mesh CSR -> local working set, see extract_subgraph_impl)
+     * targets: [num_targets] global vertex ids
+     *
+     * Output (Pre-allocated; exact sizes from subgraph_size, or the upper bounds):
+     * out_local_to_global: [num_local]     local id -> global id     (<= num_verts)
+     * out_local_targets:   [num_targets]   local id of each target
+     * out_starts:          [num_local + 1]                           (<= num_verts + 1)
+     * out_indices / out_weights: [num_entries]                       (<= adj_starts[num_verts])
+     * Returns: number of local vertices (targets + ring).
+     */
+    EXPORT int extract_subgraph(
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        int num_verts,
+        const int* targets,
+        int num_targets,
+        int* out_local_to_global,
+        int* out_local_targets,
+        int* out_starts,
+        int* out_indices,
+        float* out_weights
+    ) {
+        return extract_subgraph_impl(adj_starts, adj_indices, adj_weights, num_verts, targets, num_targets,
+                                     out_local_to_global, out_local_targets, out_starts, out_indices, out_weights,
+                                     nullptr);
+    }
+
+    /**
+     * Spatial Index (Uniform Grid)
+     * Replaces the Python KDTree for brush queries. Rebuild whenever the
+     * evaluated (world space) coordinates change.
+     */
+    EXPORT void* spatial_create() {
+        return new SpatialGrid();
+    }
+
+    EXPORT void spatial_destroy(void* grid) {
+        delete static_cast<SpatialGrid*>(grid);
+    }
+
+    /**
+     * vert_coords: [num_verts * 3] world space (flattened x,y,z)
+     * pool: handle from pool_create (NULL = single threaded)
+     */
+    EXPORT void spatial_build(void* grid, void* pool, int num_verts, const float* vert_coords) {
+        PoolRef kp(pool);
+        build_spatial_grid(*kp, *static_cast<SpatialGrid*>(grid), num_verts, vert_coords);
+    }
+
+    /**
+     * Brush Range Query: vertices inside the radius + their factors
+     * (strength * falloff, see brush_falloff for falloff_mode).
+     *
+     * out_indices / out_factors: [max_out]
+     * Returns: number of vertices in range (may exceed max_out -> truncated).
+     */
+    EXPORT int query_brush(
+        void* grid,
+        const float* center,
+        float radius,
+        int falloff_mode,
+        float strength,
+        int* out_indices,
+        float* out_factors,
+        int max_out
+    ) {
+        return query_spatial_grid(*static_cast<SpatialGrid*>(grid), center, radius, falloff_mode,
+                                  strength, out_indices, out_factors, max_out);
+    }
+
+    /**
+     * Nearest Vertex
+     * out_dist: distance to it (may be NULL)
+     * Returns: vertex index, -1 if the index is empty.
+     */
+    EXPORT int find_nearest(void* grid, const float* point, float* out_dist) {
+        return nearest_spatial_grid(*static_cast<SpatialGrid*>(grid), point, out_dist);
+    }
+
+    /**
+     * Geodesic Scratch Lifetime (see GeodesicScratch)
+     * Sized for num_verts up front; reuse it across queries on the same mesh.
+     */
+    EXPORT void* geodesic_create(int num_verts) {
+        GeodesicScratch* scratch = new GeodesicScratch();
+        scratch->begin(num_verts);
+        return scratch;
+    }
+
+    EXPORT void geodesic_destroy(void* scratch) {
+        delete static_cast<GeodesicScratch*>(scratch);
+    }
+
+    /**
+     * Geodesic Falloff
+     * Vertices within max_distance of the seeds along the CSR edges, with
+     * factor = strength * falloff(distance / max_distance) (falloff_mode as
+     * in query_brush), in order of increasing distance.
+     *
+     * seed_dist: [num_seeds] initial distance per seed, NULL = 0
+     * metric: 0 = edge length, 1 = hops (max_distance = steps + 1 with the
+     *         linear falloff reproduces the edit-mode ring falloff)
+     * Returns: number of vertices written (at most max_out).
+     */
+    EXPORT int geodesic_falloff(
+        void* scratch,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        int num_verts,
+        const int* seeds,
+        const float* seed_dist,
+        int num_seeds,
+        float max_distance,
+        int metric,
+        int falloff_mode,
+        float strength,
+        int* out_indices,
+        float* out_factors,
+        int max_out
+    ) {
+        return geodesic_falloff_query(*static_cast<GeodesicScratch*>(scratch), num_verts,
+                                      adj_starts, adj_indices, adj_weights, seeds, seed_dist, num_seeds,
+                                      max_distance, metric, falloff_mode, strength,
+                                      out_indices, out_factors, max_out);
+    }
+
+    /**
+     * X-Mirror Map (position based)
+     * out_map[v] = vertex closest to (-x, y, z) if within tolerance, else -1.
+     * vert_coords: [num_verts * 3] object (local) space
+     * Returns: number of mapped vertices.
+     */
+    EXPORT int build_mirror_map(void* pool, int num_verts, const float* vert_coords, float tolerance, int* out_map) {
+        PoolRef kp(pool);
+        SpatialGrid grid;
+        build_spatial_grid(*kp, grid, num_verts, vert_coords);
+
+        (*kp).threads.parallel_for(num_verts, TARGET_GRAIN * 16, [&](int begin, int end, int) {
+            for (int v = begin; v < end; ++v) {
+                float mirrored[3] = {-vert_coords[v * 3], vert_coords[v * 3 + 1], vert_coords[v * 3 + 2]};
+                float dist = 0.0f;
+                int u = nearest_spatial_grid(grid, mirrored, &dist);
+                out_map[v] = (u >= 0 && dist <= tolerance) ? u : -1;
+            }
+        });
+
+        int matched = 0;
+        for (int v = 0; v < num_verts; ++v) matched += out_map[v] >= 0;
+        return matched;
+    }
+
+    /**
+     * Binary (Rigid) Weights: every vertex goes to its nearest bone
+     * with weight 1.0 (replaces heat + limit_total + clean + normalize).
+     *
+     * vert_coords:   [num_verts * 3] in the same space as the bones
+     * bone_segments: [num_bones * 6] head xyz, tail xyz
+     * bone_radii:    [num_bones] capsule radius, NULL = plain segments
+     * bone_groups:   [num_bones] vertex group per bone
+     * adj_starts / adj_indices: CSR from build_adjacency_graph for the
+     *   geodesic flood (see flood_bone_labels), NULL = Euclidean only
+     *
+     * Outputs (each may be NULL):
+     * out_bone [num_verts] bone index (-1 only when num_bones == 0),
+     * out_dist [num_verts] distance to that bone's capsule,
+     * weight_indices / weight_values [num_verts * MAX_STORAGE]: slots of
+     *   bone groups are dropped, non-bone groups are kept after the new
+     *   1.0 slot (pass -1 filled buffers for a clean binary layout).
+     * Returns: number of assigned vertices.
+     */
+    EXPORT int binary_weights_strided(
+        void* pool,
+        int num_verts,
+        const float* vert_coords,
+        int num_bones,
+        const float* bone_segments,
+        const float* bone_radii,
+        const int* bone_groups,
+        const int* adj_starts,
+        const int* adj_indices,
+        int* out_bone,
+        float* out_dist,
+        int* weight_indices,
+        float* weight_values
+    ) {
+        PoolRef kp(pool);
+        return binary_weights_impl(*kp, num_verts, vert_coords, num_bones, bone_segments, bone_radii, bone_groups,
+                                   adj_starts, adj_indices, out_bone, out_dist, weight_indices, weight_values);
+    }
+
+    /**
+     * Heat Diffusion Weights (see heat_weights_impl): a native stand-in
+     * for Blender's bone heat, usable where its solver fails.
+     *
+     * vert_coords / bone_segments / bone_radii / bone_groups: as in
+     *   binary_weights_strided (bone_radii may be NULL)
+     * adj_starts / adj_indices / adj_weights: CSR from build_adjacency_graph
+     * params: see HeatParams (use_geodesic -> flood_bone_labels)
+     * weight_indices / weight_values: [num_verts * MAX_STORAGE], in-out
+     * out_iterations: [num_bones] CG iterations per bone, may be NULL
+     * Returns: the largest iteration count (0 = nothing solved).
+     */
+    EXPORT int heat_weights_strided(
+        void* pool,
+        int num_verts,
+        const float* vert_coords,
+        const int* adj_starts,
+        const int* adj_indices,
+        const float* adj_weights,
+        int num_bones,
+        const float* bone_segments,
+        const float* bone_radii,
+        const int* bone_groups,
+        const HeatParams* params,
+        int* weight_indices,
+        float* weight_values,
+        int* out_iterations
+    ) {
+        if (num_verts <= 0 || num_bones <= 0 || !params) return 0;
+        PoolRef kp(pool);
+        return heat_weights_impl(*kp, num_verts, vert_coords, adj_starts, adj_indices, adj_weights,
+                                 num_bones, bone_segments, bone_radii, bone_groups, *params,
+                                 weight_indices, weight_values, out_iterations);
+    }
+
+    EXPORT int heat_params_size() {
+        return (int)sizeof(HeatParams);
+    }
+
+    /**
+     * Weight Transfer Source (see TransferSurface)
+     * surface_build(surface, pool, num_verts, vert_coords, matrix,
+     *               num_tris, tris, weight_indices, weight_values)
+     * vert_coords: [num_verts * 3], mapped through matrix (row-major 4x4,
+     *   e.g. matrix_world; NULL = as is) into the shared transfer space
+     * tris: [num_tris * 3] (loop triangles)
+     * weight_indices / weight_values: [num_verts * MAX_STORAGE] strided
+     * Everything is copied, one surface serves any number of targets.
+     */
+    EXPORT void* surface_create() {
+        return new TransferSurface();
+    }
+
+    EXPORT void surface_destroy(void* surface) {
+        delete static_cast<TransferSurface*>(surface);
+    }
+
+    EXPORT void surface_build(
+        void* surface,
+        void* pool,
+        int num_verts,
+        const float* vert_coords,
+        const float* matrix,
+        int num_tris,
+        const int* tris,
+        const int* weight_indices,
+        const float* weight_values
+    ) {
+        TransferSurface& surf = *static_cast<TransferSurface*>(surface);
+        PoolRef kp(pool);
+        surf.num_verts = num_verts;
+        surf.coords.resize((size_t)num_verts * 3);
+        (*kp).threads.parallel_for(num_verts, TRANSFER_VERT_GRAIN, [&](int begin, int end, int) {
+            for (int v = begin; v < end; ++v) {
+                transform_point(matrix, vert_coords + (size_t)v * 3, surf.coords.data() + (size_t)v * 3);
+            }
+        });
+        // Triangles with an out of range corner are dropped
+        surf.tris.clear();
+        surf.tris.reserve((size_t)num_tris * 3);
+        for (int t = 0; t < num_tris; ++t) {
+            const int* tri = tris + (size_t)t * 3;
+            if (tri[0] < 0 || tri[1] < 0 || tri[2] < 0 ||
+                tri[0] >= num_verts || tri[1] >= num_verts || tri[2] >= num_verts) continue;
+            surf.tris.insert(surf.tris.end(), tri, tri + 3);
+        }
+        surf.weight_indices.assign(weight_indices, weight_indices + (size_t)num_verts * MAX_STORAGE);
+        surf.weight_values.assign(weight_values, weight_values + (size_t)num_verts * MAX_STORAGE);
+        build_triangle_bvh(surf);
+    }
+
+    /**
+     * Weight Transfer: each target vertex takes the barycentric blend of
+     * the source weights at its closest surface point, capped at
+     * max_influence and normalized (deform groups only with group flags,
+     * pinned groups keep their target weights). Replaces Data Transfer.
+     *
+     * vert_coords: [num_verts * 3] target coords, matrix (row-major 4x4,
+     *   NULL = identity) maps them into the surface_build space
+     * group_map: [num_map] source group -> target group (-1 = skip),
+     *   NULL = same indices
+     * max_distance: vertices farther from the surface are left as is (<= 0: no limit)
+     * vertex_mask: [num_verts] or NULL
+     * weight_indices / weight_values: target strided weights, in place
+     * out_changed: [num_verts] 0 / 1, may be NULL
+     * Returns: number of changed vertices.
+     */
+    EXPORT int transfer_weights_strided(
+        void* pool,
+        void* surface,
+        int num_verts,
+        const float* vert_coords,
+        const float* matrix,
+        const int* group_map,
+        int num_map,
+        const unsigned char* group_flags,
+        int num_groups,
+        int max_influence,
+        float max_distance,
+        const unsigned char* vertex_mask,
+        int* weight_indices,
+        float* weight_values,
+        unsigned char* out_changed
+    ) {
+        if (num_verts <= 0 || !surface) return 0;
+        PoolRef kp(pool);
+        GroupFlags view{group_flags, num_groups};
+        TransferParams params{group_map, num_map, matrix, max_distance, vertex_mask,
+                              (group_flags && num_groups > 0) ? &view : nullptr};
+        std::vector<unsigned char> local;
+        if (!out_changed) {
+            local.resize(num_verts);
+            out_changed = local.data();
+        }
+        StridedStorage store{weight_indices, weight_values};
+        int total = 0;
+        with_influence_cap(max_influence, [&](auto cap) {
+            constexpr int K = decltype(cap)::value;
+            total = transfer_weights_impl<K>(*kp, *static_cast<TransferSurface*>(surface),
+                                             num_verts, vert_coords, store, params, out_changed);
+        });
+        return total;
+    }
+
+    /**
+     * Pack Vertex Group Weights -> Strided Buffers
+     * Input is the bulk layout Python can build in one pass:
+     *
+     * group_counts: [num_verts] (groups per vertex, v.groups order)
+     * groups:       [sum(group_counts)] (concatenated group indices)
+     * weights:      [sum(group_counts)] (concatenated weights)
+     *
+     * Output (Pre-allocated, [num_verts * MAX_STORAGE]):
+     * weight_indices / weight_values. First MAX_STORAGE entries per vertex
+     * are kept (same as the old Python loop), remainder is -1/0.0.
+     */
+    EXPORT void pack_weights_strided(
+        int num_verts,
+        const int* group_counts,
+        const int* groups,
+        const float* weights,
+        int* weight_indices,
+        float* weight_values
+    ) {
+        int cursor = 0;
+        for (int v = 0; v < num_verts; ++v) {
+            int count = group_counts[v];
+            int kept = std::min(count, MAX_STORAGE);
+            int v_base = v * MAX_STORAGE;
+            for (int k = 0; k < kept; ++k) {
+                weight_indices[v_base + k] = groups[cursor + k];
+                weight_values[v_base + k] = weights[cursor + k];
+            }
+            for (int k = kept; k < MAX_STORAGE; ++k) {
+                weight_indices[v_base + k] = -1;
+                weight_values[v_base + k] = 0.0f;
+            }
+            cursor += count;
+        }
+    }
+
+    /**
+     * Unpack Strided Buffers -> Bulk Layout (inverse of pack_weights_strided)
+     * Empty slots and weights <= 0.0001 are skipped.
+     *
+     * out_counts:  [num_verts]
+     * out_groups / out_weights: [num_verts * MAX_STORAGE] (upper bound)
+     * Returns: total entries written.
+     */
+    EXPORT int unpack_weights_strided(
+        int num_verts,
+        const int* weight_indices,
+        const float* weight_values,
+        int* out_counts,
+        int* out_groups,
+        float* out_weights
+    ) {
+        int cursor = 0;
+        for (int v = 0; v < num_verts; ++v) {
+            int v_base = v * MAX_STORAGE;
+            int count = 0;
+            for (int k = 0; k < MAX_STORAGE; ++k) {
+                int g = weight_indices[v_base + k];
+                float w = weight_values[v_base + k];
+                if (g < 0 || w <= 0.0001f) continue;
+                out_groups[cursor] = g;
+                out_weights[cursor] = w;
+                cursor++;
+                count++;
+            }
+            out_counts[v] = count;
+        }
+        return cursor;
+    }
+
+    /**
+     * Weight Pipeline: normalize / clean / limit-total / mirror in one sweep
+     *
+     * ops: [num_ops] WeightOp {type PIPE_*, subset, ivalue, fvalue}, run in
+     * order on every vertex (see PIPE_* for the parameters):
+     *   PIPE_NORMALIZE -> vertex_group_normalize_all (ivalue = lock_active group)
+     *   PIPE_CLEAN     -> vertex_group_clean (fvalue = limit, ivalue = keep_single)
+     *   PIPE_LIMIT     -> vertex_group_limit_total (ivalue = limit)
+     *   PIPE_MIRROR    -> every vertex takes its mirror's weights, groups remapped
+     *                     (vertex_mask = receiving side, e.g. -X to symmetrize)
+     * group_flags: [num_groups] GROUP_* bits or NULL (all plain, subset 1 = all).
+     * vertex_mask: [num_verts] nonzero = process, NULL = every vertex.
+     * mirror_map: [num_verts] from build_mirror_map, NULL = MIRROR skipped.
+     * group_remap: [num_remap] mirrored group per group (-1 = same), may be NULL.
+     * out_changed: [num_verts] 1 = vertex changed, may be NULL.
+     * pool: handle from pool_create (NULL = single threaded)
+     * Returns: number of changed vertices.
+     */
+    EXPORT int weight_pipeline_strided(
+        void* pool,
+        int num_verts,
+        int* weight_indices,
+        float* weight_values,
+        const WeightOp* ops,
+        int num_ops,
+        const unsigned char* group_flags,
+        int num_groups,
+        const unsigned char* vertex_mask,
+        const int* mirror_map,
+        const int* group_remap,
+        int num_remap,
+        unsigned char* out_changed
+    ) {
+        if (num_verts <= 0 || num_ops <= 0) return 0;
+        PoolRef kp(pool);
+        GroupFlags gf{group_flags, group_flags ? num_groups : 0};
+        PipelineContext ctx{group_flags ? &gf : nullptr, vertex_mask, mirror_map,
+                            group_remap, group_remap ? num_remap : 0};
+        std::vector<unsigned char> changed;
+        if (!out_changed) {
+            changed.assign(num_verts, 0);
+            out_changed = changed.data();
+        } else {
+            std::fill(out_changed, out_changed + num_verts, 0);
+        }
+        return weight_pipeline_impl(*kp, num_verts, StridedStorage{weight_indices, weight_values},
+                                    ops, num_ops, ctx, out_changed, nullptr);
+    }
+
+    /**
+     * Diff Strided Buffers against the Blender-side state
+     *
+     * base_indices/base_values: what Blender currently holds (Read/Write).
+     *   Synced to the new state for every diffed vertex, so the next diff
+     *   only reports newer changes.
+     * weight_indices/weight_values: current kernel state (Read Only)
+     * vertex_list: vertices to check (NULL = all num_verts)
+     *
+     * Output (Pre-allocated, [num_checked * MAX_STORAGE * 2]):
+     * out_verts / out_groups / out_weights: changed (vertex, group, weight)
+     * triples, weight 0.0 = remove from group. Sorted by group (checked order
+     * within a group), so Python can batch vertex_groups[g].add/remove calls.
+     * Returns: number of triples.
+     */
+    EXPORT int diff_weights_strided(
+        int num_verts,
+        int* base_indices,
+        float* base_values,
+        const int* weight_indices,
+        const float* weight_values,
+        const int* vertex_list,
+        int num_list,
+        int* out_verts,
+        int* out_groups,
+        float* out_weights
+    ) {
+        std::vector<WeightChange> changes;
+        collect_weight_changes(num_verts, base_indices, base_values, weight_indices, weight_values,
+                               vertex_list, num_list, changes);
+
+        std::stable_sort(changes.begin(), changes.end(), [](const WeightChange& a, const WeightChange& b) {
+            return a.group < b.group;
+        });
+
+        for (size_t i = 0; i < changes.size(); ++i) {
+            out_verts[i] = changes[i].vertex;
+            out_groups[i] = changes[i].group;
+            out_weights[i] = changes[i].weight;
+        }
+        return (int)changes.size();
+    }
+
+    /**
+     * Undo Journal
+     *
+     * Usage (per modal session):
+     *   undo_create(budget) -> undo_begin_stroke on press
+     *   -> undo_record(delta of every dab, see *_tracked kernels)
+     *   -> undo_end_stroke on release -> undo_pop on Ctrl+Z.
+     */
+    EXPORT void* undo_create(long long budget_bytes) {
+        return new UndoJournal(budget_bytes > 0 ? (size_t)budget_bytes : 0);
+    }
+
+    EXPORT void undo_destroy(void* journal) {
+        delete static_cast<UndoJournal*>(journal);
+    }
+
+    /**
+     * Drops every undo step and sets a new budget (<= 0: keep only the newest step).
+     */
+    EXPORT void undo_clear(void* journal, long long budget_bytes) {
+        static_cast<UndoJournal*>(journal)->clear(budget_bytes > 0 ? (size_t)budget_bytes : 0);
+    }
+
+    EXPORT void undo_begin_stroke(void* journal) {
+        static_cast<UndoJournal*>(journal)->begin();
+    }
+
+    /**
+     * verts / before_*: dirty-vertex output of a *_tracked kernel (count entries).
+     */
+    EXPORT void undo_record(
+        void* journal,
+        const int* verts,
+        const int* before_indices,
+        const float* before_values,
+        int count
+    ) {
+        static_cast<UndoJournal*>(journal)->record(verts, before_indices, before_values, count);
+    }
+
+    /**
+     * Returns: number of undo steps held.
+     */
+    EXPORT int undo_end_stroke(void* journal) {
+        UndoJournal* j = static_cast<UndoJournal*>(journal);
+        j->end();
+        return (int)j->strokes.size();
+    }
+
+    EXPORT int undo_count(void* journal) {
+        return (int)static_cast<UndoJournal*>(journal)->strokes.size();
+    }
+
+    EXPORT long long undo_bytes(void* journal) {
+        return (long long)static_cast<UndoJournal*>(journal)->used_bytes;
+    }
+
+    /**
+     * Number of vertices undo_pop will restore (size for out_verts).
+     * Closes an open stroke first, like undo_pop.
+     */
+    EXPORT int undo_peek_size(void* journal) {
+        UndoJournal* j = static_cast<UndoJournal*>(journal);
+        j->end();
+        return j->strokes.empty() ? 0 : (int)j->strokes.back().verts.size();
+    }
+
+    /**
+     * Restores the newest stroke into the strided buffers (all groups).
+     * out_verts: [undo_peek_size] restored vertices (write-back list)
+     * Returns: number of restored vertices (0 = journal empty).
+     */
+    EXPORT int undo_pop(void* journal, int* weight_indices, float* weight_values, int* out_verts) {
+        UndoJournal* j = static_cast<UndoJournal*>(journal);
+        j->end();
+        if (j->strokes.empty()) return 0;
+
+        const UndoJournal::Stroke& stroke = j->strokes.back();
+        int count = (int)stroke.verts.size();
+        for (int i = 0; i < count; ++i) {
+            int v = stroke.verts[i];
+            size_t src = (size_t)i * MAX_STORAGE;
+            size_t dst = (size_t)v * MAX_STORAGE;
+            std::copy(stroke.indices.begin() + src, stroke.indices.begin() + src + MAX_STORAGE, weight_indices + dst);
+            std::copy(stroke.values.begin() + src, stroke.values.begin() + src + MAX_STORAGE, weight_values + dst);
+            out_verts[i] = v;
+        }
+
+        j->used_bytes -= stroke.bytes();
+        j->strokes.pop_back();
+        return count;
+    }
+
+    /**
+     * Brush Session
+     *
+     * Usage (per modal session):
+     *   session_create(pool, undo)
+     *   -> session_set_adjacency / session_set_coords / session_set_weights
+     *   -> brush_dab per dab -> session_diff (write back to Blender)
+     *   -> session_destroy (before the pool / journal).
+     */
+    EXPORT void* session_create(void* pool, void* undo) {
+        return new BrushSession(pool, undo);
+    }
+
+    EXPORT void session_destroy(void* session) {
+        delete static_cast<BrushSession*>(session);
+    }
+
+    /**
+     * CSR adjacency from raw edges (see build_adjacency_graph).
+     */
+    EXPORT void session_set_adjacency(
+        void* session,
+        int num_verts,
+        int num_edges,
+        const int* edge_indices,
+        const float* vert_coords
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        s->adj_starts.resize((size_t)num_verts + 1);
+        s->adj_indices.resize((size_t)num_edges * 2);
+        s->adj_weights.resize((size_t)num_edges * 2);
+        build_adjacency_impl(*s->pool, num_verts, num_edges, edge_indices, vert_coords,
+                             s->adj_starts.data(), s->adj_indices.data(), s->adj_weights.data());
+        s->topology_fp = fingerprint_buffer(*s->pool, edge_indices, (size_t)num_edges * 2 * sizeof(int));
+        s->coords_fp = fingerprint_buffer(*s->pool, vert_coords, (size_t)num_verts * 3 * sizeof(float));
+    }
+
+    /**
+     * Incremental adjacency update for a re-entered session.
+     * Fingerprints the edge list and the local coords separately:
+     * - topology changed (or no CSR yet): full session_set_adjacency
+     * - only coords changed: edge weights recomputed in place (parallel),
+     *   CSR structure kept
+     * Returns: 0 = unchanged, 1 = weights refreshed, 2 = rebuilt.
+     */
+    EXPORT int session_sync_geometry(
+        void* session,
+        int num_verts,
+        int num_edges,
+        const int* edge_indices,
+        const float* vert_coords
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        uint64_t topology_fp = fingerprint_buffer(*s->pool, edge_indices, (size_t)num_edges * 2 * sizeof(int));
+        bool same_topology = s->adj_starts.size() == (size_t)num_verts + 1
+            && s->adj_indices.size() == (size_t)num_edges * 2
+            && s->topology_fp == topology_fp;
+        if (!same_topology) {
+            session_set_adjacency(session, num_verts, num_edges, edge_indices, vert_coords);
+            return 2;
+        }
+        uint64_t coords_fp = fingerprint_buffer(*s->pool, vert_coords, (size_t)num_verts * 3 * sizeof(float));
+        if (coords_fp == s->coords_fp) return 0;
+        update_edge_weights_impl(*s->pool, num_verts, s->adj_starts.data(), s->adj_indices.data(),
+                                 vert_coords, s->adj_weights.data());
+        s->coords_fp = coords_fp;
+        return 1;
+    }
+
+    /**
+     * Spatial index from world-space coords [num_verts * 3].
+     */
+    EXPORT void session_set_coords(void* session, int num_verts, const float* vert_coords) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        build_spatial_grid(*s->pool, s->grid, num_verts, vert_coords);
+        s->grid_coords.assign(vert_coords, vert_coords + (size_t)num_verts * 3);
+        if (s->targets.size() < (size_t)num_verts) {
+            s->targets.resize(num_verts);
+            s->factors.resize(num_verts);
+        }
+    }
+
+    /**
+     * Weights from flat Blender lists (see pack_weights_strided).
+     * Also resets the Blender mirror used by session_diff.
+     */
+    EXPORT void session_set_weights(
+        void* session,
+        int num_verts,
+        const int* group_counts,
+        const int* groups,
+        const float* weights
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        size_t slots = (size_t)num_verts * MAX_STORAGE;
+        s->num_verts = num_verts;
+        s->weight_indices.resize(slots);
+        s->weight_values.resize(slots);
+        pack_weights_strided(num_verts, group_counts, groups, weights,
+                             s->weight_indices.data(), s->weight_values.data());
+        s->base_indices = s->weight_indices;
+        s->base_values = s->weight_values;
+        s->dirty_count = 0;
+        s->pending_verts.clear();
+        s->pending_mark.assign(num_verts, 0);
+    }
+
+    /**
+     * One-call refresh of a (cached) session from the current mesh state:
+     * - edges / local_coords: session_sync_geometry (CSR kept when possible)
+     * - world_coords: spatial index, NULL = keep (only brushes query it)
+     * - group_counts / groups / weights: session_set_weights, NULL = keep
+     * Returns: session_sync_geometry result (0 unchanged, 1 weights, 2 rebuilt).
+     */
+    EXPORT int session_update(
+        void* session,
+        int num_verts,
+        int num_edges,
+        const int* edge_indices,
+        const float* local_coords,
+        const float* world_coords,
+        const int* group_counts,
+        const int* groups,
+        const float* weights
+    ) {
+        int result = session_sync_geometry(session, num_verts, num_edges, edge_indices, local_coords);
+        if (world_coords) session_set_coords(session, num_verts, world_coords);
+        if (group_counts) session_set_weights(session, num_verts, group_counts, groups, weights);
+        return result;
+    }
+
+    /**
+     * Smooth one vertex group on the session weights (see BrushSession::smooth_group).
+     * targets: [num_targets] distinct vertex ids, NULL = every vertex.
+     * Changes land in the pending list (session_diff(NULL) writes them back).
+     * Returns: number of changed vertices.
+     */
+    EXPORT int session_smooth_group(
+        void* session,
+        const int* targets,
+        int num_targets,
+        int group,
+        float factor,
+        int iterations
+    ) {
+        return static_cast<BrushSession*>(session)->smooth_group(targets, num_targets, group, factor, iterations);
+    }
+
+    /**
+     * Whole-mesh blur of every group on the session weights (see
+     * BrushSession::run_mesh_smooth). backend: 0 = auto, 1 = CPU, 2 = GPU
+     * (CPU if no device can run it). out_backend / out_passes: may be NULL.
+     * Changes land in the pending list. Returns: number of changed vertices.
+     */
+    EXPORT int session_smooth_mesh(
+        void* session,
+        float factor,
+        int iterations,
+        float tolerance,
+        int backend,
+        int* out_backend,
+        int* out_passes
+    ) {
+        return static_cast<BrushSession*>(session)->run_mesh_smooth(factor, iterations, tolerance, backend,
+                                                                     out_backend, out_passes);
+    }
+
+    /**
+     * OpenCL device session_smooth_mesh runs on (first GPU that builds the
+     * kernels). The first call opens the runtime and compiles them.
+     * out_name: [size] device name, may be NULL.
+     * Returns: 1 if there is one, 0 = CPU only.
+     */
+    EXPORT int gpu_device_info(char* out_name, int size) {
+        GpuDevice& dev = gpu_device();
+        if (out_name && size > 0) {
+            std::strncpy(out_name, dev.ready ? dev.name : "", size - 1);
+            out_name[size - 1] = '\0';
+        }
+        return dev.ready ? 1 : 0;
+    }
+
+    /**
+     * Influence cap for every kernel run by this session (1/2/4/8, see
+     * with_influence_cap). Weights come out limited + normalized, so no
+     * vertex_group_limit_total pass is needed afterwards.
+     */
+    EXPORT void session_set_max_influence(void* session, int max_influence) {
+        static_cast<BrushSession*>(session)->max_influence = max_influence;
+    }
+
+    /**
+     * Per-group flags (GROUP_DEFORM=1, GROUP_LOCKED=2, GROUP_EXCLUDED=4),
+     * one byte per vertex group index; copied. Every session kernel then
+     * normalizes only across deform groups and keeps locked / excluded
+     * weights as stored, so no normalize_all pass is needed afterwards.
+     * NULL / 0 groups = normalize across every group (default).
+     */
+    EXPORT void session_set_group_flags(void* session, const unsigned char* flags, int num_groups) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        if (!flags || num_groups <= 0) s->group_flags.clear();
+        else s->group_flags.assign(flags, flags + num_groups);
+        s->group_flags_view = GroupFlags{s->group_flags.data(), (int)s->group_flags.size()};
+    }
+
+    /**
+     * Connected Only brush: dab footprints follow the surface (geodesic
+     * distance over the session CSR) instead of the Euclidean radius.
+     * Needs session_set_adjacency; without a CSR it falls back to Euclidean.
+     */
+    EXPORT void session_set_connected_only(void* session, int enabled) {
+        static_cast<BrushSession*>(session)->connected_only = enabled != 0;
+    }
+
+    /**
+     * X-Mirror for every dab of this session (see build_mirror_map).
+     * mirror_map: [num_verts], NULL = mirror off. Call after session_set_weights.
+     * group_remap: [num_groups] mirrored group per group (-1 = same group,
+     * e.g. center groups), may be NULL.
+     */
+    EXPORT void session_set_mirror(void* session, const int* mirror_map, const int* group_remap, int num_groups) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        if (!mirror_map) {
+            s->mirror_map.clear();
+            s->group_remap.clear();
+            return;
+        }
+        s->mirror_map.assign(mirror_map, mirror_map + s->num_verts);
+        if (group_remap) s->group_remap.assign(group_remap, group_remap + num_groups);
+        else s->group_remap.clear();
+    }
+
+    /**
+     * One Brush Dab: range query + falloff + kernel + dirty tracking
+     * (+ undo record when the journal has an open stroke).
+     *
+     * - prev_center: previous cursor, NULL = none. Smear drags the weights
+     *   under prev_center -> center (sampled per vertex, see smear_sampled_pass)
+     * - mode: 0=Smear, 1=Harden, 2=Blur (Jacobi)
+     * - strength: Smear/Harden factor = strength * falloff.
+     *   Blur uses strength as one uniform factor (falloff only picks targets).
+     * Returns: number of changed vertices (see session_diff).
+     */
+    EXPORT int brush_dab(
+        void* session,
+        const float* center,
+        const float* prev_center,
+        float radius,
+        float strength,
+        int mode,
+        int falloff_mode,
+        int active_group_index
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        s->dirty_count = 0;
+        if (s->num_verts == 0 || s->grid.num_verts != s->num_verts) return 0;
+        if (mode != 2 && active_group_index < 0) return 0;
+
+        StatsClock::time_point t0 = StatsClock::now();
+        int count = s->query_footprint(center, radius, falloff_mode, strength,
+                                       s->targets.data(), s->factors.data(), (int)s->targets.size());
+        stats_add_time(s->stats, STATS_QUERY, t0);
+        return s->run_kernel(count, mode, strength, active_group_index, prev_center, center);
+    }
+
+    /**
+     * Stroke Engine
+     *
+     * brush_stroke_begin: new stroke (press, or cursor left the mesh).
+     * brush_stroke_to: places dabs every radius * spacing from the last dab
+     * towards center (first call: one dab at center), merges their
+     * footprints (merge_mode: 0 = Max, 1 = Accumulate) and runs the kernel
+     * once over the union. Smear drags from the previous dab to the last one.
+     * Returns: number of changed vertices (0 if the cursor moved less than
+     * one spacing -> the remainder carries over to the next call).
+     */
+    EXPORT void brush_stroke_begin(void* session) {
+        static_cast<BrushSession*>(session)->stroke_active = false;
+    }
+
+    EXPORT int brush_stroke_to(
+        void* session,
+        const float* center,
+        float radius,
+        float spacing,
+        float strength,
+        int mode,
+        int falloff_mode,
+        int active_group_index,
+        int merge_mode
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        s->dirty_count = 0;
+        if (s->num_verts == 0 || s->grid.num_verts != s->num_verts) return 0;
+        if (mode != 2 && active_group_index < 0) return 0;
+        if (s->query_indices.size() < (size_t)s->num_verts) {
+            s->query_indices.resize(s->num_verts);
+            s->query_factors.resize(s->num_verts);
+            s->stats.scratch_grows++;
+        }
+
+        StatsClock::time_point t0 = StatsClock::now();
+        float prev[3] = {s->stroke_last[0], s->stroke_last[1], s->stroke_last[2]};
+        bool has_prev = s->stroke_active;
+        s->begin_merge();
+        int count = 0;
+
+        if (!s->stroke_active) {
+            count = s->merge_footprint(count, center, radius, falloff_mode, strength, merge_mode);
+            std::copy(center, center + 3, s->stroke_last);
+            s->stroke_active = true;
+        } else {
+            float d[3] = {center[0] - prev[0], center[1] - prev[1], center[2] - prev[2]};
+            float dist = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            float step = std::max(radius * spacing, 1e-6f);
+            if (dist < step) return 0;
+
+            int num_dabs = (int)(dist / step);
+            if (num_dabs > STROKE_MAX_DABS) {
+                num_dabs = STROKE_MAX_DABS;
+                step = dist / num_dabs;
+            }
+            float pos[3];
+            for (int i = 1; i <= num_dabs; ++i) {
+                float t = (step * i) / dist;
+                for (int a = 0; a < 3; ++a) pos[a] = prev[a] + d[a] * t;
+                count = s->merge_footprint(count, pos, radius, falloff_mode, strength, merge_mode);
+            }
+            std::copy(pos, pos + 3, s->stroke_last);
+        }
+        stats_add_time(s->stats, STATS_QUERY, t0);
+
+        return s->run_kernel(count, mode, strength, active_group_index, has_prev ? prev : nullptr, s->stroke_last);
+    }
+
+    /**
+     * Number of changed vertices not yet written back (session_diff(NULL) consumes them).
+     */
+    EXPORT int session_pending_count(void* session) {
+        return (int)static_cast<BrushSession*>(session)->pending_verts.size();
+    }
+
+    /**
+     * Blender write-back list (see diff_weights_strided) and mirror sync.
+     * vertex_list: vertices to check, NULL = all pending changed vertices.
+     * out_*: [num_checked * 16]
+     */
+    EXPORT int session_diff(
+        void* session,
+        const int* vertex_list,
+        int num_list,
+        int* out_verts,
+        int* out_groups,
+        float* out_weights
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        std::vector<int> pending;
+        if (!vertex_list) {
+            s->take_pending(pending);
+            vertex_list = pending.data();
+            num_list = (int)pending.size();
+        }
+        if (num_list == 0) return 0;
+        StatsClock::time_point t0 = StatsClock::now();
+        int changes = diff_weights_strided(s->num_verts,
+            s->base_indices.data(), s->base_values.data(),
+            s->weight_indices.data(), s->weight_values.data(),
+            vertex_list, num_list, out_verts, out_groups, out_weights);
+        stats_add_time(s->stats, STATS_DIFF, t0);
+        return changes;
+    }
+
+    /**
+     * session_diff into session-owned buffers, sorted by (group, weight,
+     * vertex) and split into runs of one group + one weight, so the caller
+     * can write back with one vertex_groups[g].add(verts, w) / remove(verts)
+     * per run straight from session_get_buffer views, no per-element work.
+     * Run r: DIFF_VERTS[DIFF_RUNS[r] .. DIFF_RUNS[r + 1]), group / weight
+     * at DIFF_GROUPS / DIFF_WEIGHTS[DIFF_RUNS[r]] (weight 0 = remove).
+     * vertex_list: as session_diff. Buffers stay valid until the next call.
+     * Returns: number of runs.
+     */
+    EXPORT int session_diff_runs(void* session, const int* vertex_list, int num_list) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        std::vector<int> pending;
+        if (!vertex_list) {
+            s->take_pending(pending);
+            vertex_list = pending.data();
+            num_list = (int)pending.size();
+        }
+        std::vector<WeightChange>& changes = s->diff_changes;
+        changes.clear();
+        s->diff_runs.assign(1, 0);
+        if (num_list == 0) return 0;
+
+        StatsClock::time_point t0 = StatsClock::now();
+        collect_weight_changes(s->num_verts,
+            s->base_indices.data(), s->base_values.data(),
+            s->weight_indices.data(), s->weight_values.data(),
+            vertex_list, num_list, changes);
+        std::sort(changes.begin(), changes.end(), [](const WeightChange& a, const WeightChange& b) {
+            if (a.group != b.group) return a.group < b.group;
+            if (a.weight != b.weight) return a.weight < b.weight;
+            return a.vertex < b.vertex;
+        });
+
+        size_t n = changes.size();
+        s->diff_verts.resize(n);
+        s->diff_groups.resize(n);
+        s->diff_weights.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            const WeightChange& c = changes[i];
+            s->diff_verts[i] = c.vertex;
+            s->diff_groups[i] = c.group;
+            s->diff_weights[i] = c.weight;
+            if (i > 0 && (c.group != changes[i - 1].group || c.weight != changes[i - 1].weight)) {
+                s->diff_runs.push_back((int)i);
+            }
+        }
+        if (n > 0) s->diff_runs.push_back((int)n);
+        stats_add_time(s->stats, STATS_DIFF, t0);
+        return (int)s->diff_runs.size() - 1;
+    }
+
+    /**
+     * Direct pointer to session memory for zero-copy reads
+     * (ctypes from_address -> memoryview / numpy.frombuffer).
+     * which: SESSION_BUFFER_* below. out_count: element count (int or
+     * float, see the list). NULL when empty. The pointer is valid until
+     * the next call that resizes that buffer: session_update /
+     * session_set_weights for the weights, session_diff_runs for DIFF_*,
+     * any kernel / diff call for PENDING_VERTS.
+     */
+    EXPORT const void* session_get_buffer(void* session, int which, int* out_count) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        const void* ptr = nullptr;
+        size_t count = 0;
+        switch (which) {
+            case SESSION_BUFFER_WEIGHT_INDICES: ptr = s->weight_indices.data(); count = s->weight_indices.size(); break;
+            case SESSION_BUFFER_WEIGHT_VALUES:  ptr = s->weight_values.data();  count = s->weight_values.size(); break;
+            case SESSION_BUFFER_DIFF_VERTS:     ptr = s->diff_verts.data();     count = s->diff_changes.size(); break;
+            case SESSION_BUFFER_DIFF_GROUPS:    ptr = s->diff_groups.data();    count = s->diff_changes.size(); break;
+            case SESSION_BUFFER_DIFF_WEIGHTS:   ptr = s->diff_weights.data();   count = s->diff_changes.size(); break;
+            case SESSION_BUFFER_DIFF_RUNS:      ptr = s->diff_runs.data();      count = s->diff_runs.size(); break;
+            case SESSION_BUFFER_PENDING_VERTS:  ptr = s->pending_verts.data();  count = s->pending_verts.size(); break;
+            default: break;
+        }
+        if (count == 0) ptr = nullptr;
+        if (out_count) *out_count = (int)count;
+        return ptr;
+    }
+
+    /**
+     * Weight pipeline on the session weights (see weight_pipeline_strided),
+     * with the session's group flags and X-mirror map (session_set_mirror;
+     * MIRROR is skipped without one). Changes go to the undo journal and
+     * the pending list -> one session_diff writes everything back.
+     * Returns: number of changed vertices.
+     */
+    EXPORT int session_weight_pipeline(void* session, const WeightOp* ops, int num_ops, const unsigned char* vertex_mask) {
+        return static_cast<BrushSession*>(session)->run_pipeline(ops, num_ops, vertex_mask);
+    }
+
+    /**
+     * Weight transfer onto the session weights (see transfer_weights_strided),
+     * using the session's group flags and max influence. Changes go to the
+     * undo journal and the pending list (session_diff writes them back).
+     * Returns: number of changed vertices.
+     */
+    EXPORT int session_transfer_weights(
+        void* session,
+        void* surface,
+        const float* vert_coords,
+        const float* matrix,
+        const int* group_map,
+        int num_map,
+        float max_distance,
+        const unsigned char* vertex_mask
+    ) {
+        if (!surface) return 0;
+        TransferParams params{group_map, num_map, matrix, max_distance, vertex_mask, nullptr};
+        return static_cast<BrushSession*>(session)->run_transfer(
+            *static_cast<TransferSurface*>(surface), vert_coords, params);
+    }
+
+    /**
+     * Heat weights on the session weights and CSR (see heat_weights_strided).
+     * Changes go to the undo journal and the pending list (session_diff
+     * writes them back). Returns: number of changed vertices.
+     */
+    EXPORT int session_heat_weights(
+        void* session,
+        const float* vert_coords,
+        int num_bones,
+        const float* bone_segments,
+        const float* bone_radii,
+        const int* bone_groups,
+        const HeatParams* params,
+        int* out_iterations
+    ) {
+        if (!params) return 0;
+        return static_cast<BrushSession*>(session)->run_heat(
+            vert_coords, num_bones, bone_segments, bone_radii, bone_groups, *params, out_iterations);
+    }
+
+    /**
+     * Multi-mesh batches (see run_session_batch): one operation over
+     * sessions[num_sessions] on one pool, same arguments and results as
+     * the per-session calls. out_changed: [num_sessions] changed vertices
+     * per session (-1 = skipped) or NULL. Changes go to each session's
+     * undo journal and pending list (session_diff per session writes back).
+     * Returns: total changed vertices.
+     *
+     * batch_weight_pipeline: masks [num_sessions] vertex masks (entries
+     *   may be NULL), masks itself NULL = no mask anywhere.
+     * batch_smooth_group: groups [num_sessions] group index per session
+     *   (names differ per mesh; -1 = skip), targets = every vertex.
+     * batch_binary_weights: per session coords [num_verts * 3] in that
+     *   mesh's bone space, segments [num_bones * 6] and bone_groups
+     *   [num_bones]; one num_bones for all (same armature).
+     */
+    EXPORT int batch_weight_pipeline(
+        void* pool,
+        void* const* sessions,
+        int num_sessions,
+        const WeightOp* ops,
+        int num_ops,
+        const unsigned char* const* masks,
+        int* out_changed
+    ) {
+        PoolRef kp(pool);
+        return run_session_batch(*kp, reinterpret_cast<BrushSession* const*>(sessions), num_sessions, out_changed,
+            [&](int i) {
+                return static_cast<BrushSession*>(sessions[i])->run_pipeline(ops, num_ops, masks ? masks[i] : nullptr);
+            });
+    }
+
+    EXPORT int batch_smooth_group(
+        void* pool,
+        void* const* sessions,
+        int num_sessions,
+        const int* groups,
+        float factor,
+        int iterations,
+        int* out_changed
+    ) {
+        PoolRef kp(pool);
+        return run_session_batch(*kp, reinterpret_cast<BrushSession* const*>(sessions), num_sessions, out_changed,
+            [&](int i) {
+                return static_cast<BrushSession*>(sessions[i])->smooth_group(nullptr, 0, groups[i], factor, iterations);
+            });
+    }
+
+    EXPORT int batch_binary_weights(
+        void* pool,
+        void* const* sessions,
+        int num_sessions,
+        const float* const* vert_coords,
+        int num_bones,
+        const float* const* bone_segments,
+        const int* const* bone_groups,
+        int use_geodesic,
+        int* out_changed
+    ) {
+        PoolRef kp(pool);
+        return run_session_batch(*kp, reinterpret_cast<BrushSession* const*>(sessions), num_sessions, out_changed,
+            [&](int i) {
+                return static_cast<BrushSession*>(sessions[i])->run_binary(
+                    vert_coords[i], num_bones, bone_segments[i], nullptr, bone_groups[i], use_geodesic != 0);
+            });
+    }
+
+    /**
+     * Background jobs (see SessionJob). Each submit returns a job handle,
+     * NULL if the session already runs one. Arguments as in the blocking
+     * calls: job_smooth_groups = session_smooth_group for each of
+     * groups[num_groups] in turn, job_weight_pipeline =
+     * session_weight_pipeline, job_heat_weights = session_heat_weights
+     * (out_iterations, if given, must stay valid until job_finish),
+     * job_smooth_mesh = session_smooth_mesh.
+     */
+    EXPORT void* job_smooth_groups(
+        void* session,
+        const int* target_list,
+        int count,
+        const int* groups,
+        int num_groups,
+        float factor,
+        int iterations
+    ) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        std::vector<int> targets;
+        if (target_list) targets.assign(target_list, target_list + std::max(count, 0));
+        std::vector<int> group_list(groups, groups + std::max(num_groups, 0));
+        bool all = !target_list;
+        return start_session_job(s, (int)group_list.size() * std::max(iterations, 1), [=]() {
+            int changed = 0;
+            for (int g : group_list) {
+                if (s->job->cancelled()) break;
+                changed += s->smooth_group(all ? nullptr : targets.data(), all ? 0 : count, g, factor, iterations);
+            }
+            return changed;
+        });
+    }
+
+    EXPORT void* job_weight_pipeline(void* session, const WeightOp* ops, int num_ops, const unsigned char* vertex_mask) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        std::vector<WeightOp> op_list(ops, ops + std::max(num_ops, 0));
+        std::vector<unsigned char> mask;
+        if (vertex_mask) mask.assign(vertex_mask, vertex_mask + s->num_verts);
+        return start_session_job(s, 1, [=]() {
+            return s->run_pipeline(op_list.data(), (int)op_list.size(), mask.empty() ? nullptr : mask.data());
+        });
+    }
+
+    EXPORT void* job_heat_weights(
+        void* session,
+        const float* vert_coords,
+        int num_bones,
+        const float* bone_segments,
+        const float* bone_radii,
+        const int* bone_groups,
+        const HeatParams* params,
+        int* out_iterations
+    ) {
+        if (!params || num_bones <= 0) return nullptr;
+        BrushSession* s = static_cast<BrushSession*>(session);
+        std::vector<float> coords(vert_coords, vert_coords + (size_t)s->num_verts * 3);
+        std::vector<float> segments(bone_segments, bone_segments + (size_t)num_bones * 6);
+        std::vector<float> radii;
+        if (bone_radii) radii.assign(bone_radii, bone_radii + num_bones);
+        std::vector<int> group_list(bone_groups, bone_groups + num_bones);
+        HeatParams p = *params;
+        return start_session_job(s, (num_bones + HEAT_BATCH - 1) / HEAT_BATCH, [=]() {
+            return s->run_heat(coords.data(), num_bones, segments.data(), radii.empty() ? nullptr : radii.data(),
+                               group_list.data(), p, out_iterations);
+        });
+    }
+
+    EXPORT void* job_smooth_mesh(void* session, float factor, int iterations, float tolerance, int backend) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        return start_session_job(s, iterations, [=]() {
+            return s->run_mesh_smooth(factor, iterations, tolerance, backend, nullptr, nullptr);
+        });
+    }
+
+    /**
+     * Job state without blocking: JOB_RUNNING / JOB_DONE / JOB_CANCELLED
+     * (cancelled jobs report it once their worker has stopped).
+     * out_progress: finished fraction [0, 1], may be NULL.
+     */
+    EXPORT int job_poll(void* job, float* out_progress) {
+        SessionJob* j = static_cast<SessionJob*>(job);
+        if (out_progress) {
+            *out_progress = std::min(1.0f, (float)j->control.done.load(std::memory_order_relaxed) / j->control.total);
+        }
+        return j->state.load(std::memory_order_acquire);
+    }
+
+    // Asks the worker to stop at its next check (returns at once, see job_finish)
+    EXPORT void job_cancel(void* job) {
+        static_cast<SessionJob*>(job)->control.cancel.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Waits for the worker, hands the session back and frees the job.
+     * Returns: the operation's result (changed vertices; pending -> write
+     * back with session_diff), -1 if cancelled (session as at submit).
+     */
+    EXPORT int job_finish(void* job) {
+        return finish_session_job(static_cast<SessionJob*>(job));
+    }
+
+    /**
+     * Instrumentation counters of the session (see SessionStats).
+     * out: caller-owned struct; session_stats_size() = sizeof(SessionStats)
+     * so the Python mirror can check it matches this DLL.
+     */
+    EXPORT void session_get_stats(void* session, SessionStats* out) {
+        *out = static_cast<BrushSession*>(session)->stats;
+    }
+
+    EXPORT int session_stats_size() {
+        return (int)sizeof(SessionStats);
+    }
+
+    EXPORT void session_reset_stats(void* session) {
+        static_cast<BrushSession*>(session)->stats = SessionStats{};
+    }
+
+    /**
+     * Undo the newest stroke of the session's journal (see undo_pop).
+     * out_verts: [undo_peek_size] -> pass to session_diff.
+     */
+    EXPORT int session_undo_pop(void* session, int* out_verts) {
+        BrushSession* s = static_cast<BrushSession*>(session);
+        if (!s->undo || s->num_verts == 0) return 0;
+        return undo_pop(s->undo, s->weight_indices.data(), s->weight_values.data(), out_verts);
     }
 }
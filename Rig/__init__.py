@@ -6,6 +6,10 @@ from . import WeightMode
 from . import PaintWeight
 from . import WynnWeightBrush
 from . import EditModeWeight
+from . import TransferWeights
+from . import HeatWeights
+from . import BatchWeights
+from . import wynn_core
 
 
 # Define a list of all classes in this module to register
@@ -15,6 +19,10 @@ classes_to_register = [
     pie.VIEW3D_MT_custom_pie_menu,
     pie.WYNN_MT_edit_weights,
     Smooth.WYNN_OT_smooth_weights,
+    Smooth.WYNN_OT_smooth_mesh_weights,
+    TransferWeights.WYNN_OT_transfer_weights,
+    HeatWeights.WYNN_OT_parent_heat_weights,
+    BatchWeights.WYNN_OT_batch_weights,
 ]
 
 def register():
@@ -27,6 +35,9 @@ def register():
     WynnWeightBrush.register()
     EditModeWeight.register()
 
+    missing = wynn_core.missing_features(wynn_core.load_dll())
+    if missing:
+        print(f"WynnCore: {wynn_core.DLL_OUTDATED} (missing: {', '.join(missing)})")
     
     # You can also register keymaps or other things here
     # Keymap Registration
@@ -1,10 +1,243 @@
 import bpy
+import ctypes
+import itertools
+from . import wynn_core
+from .WeightJobs import refuse_if_busy
 
-def apply_binary_weights(mesh_obj, armature_obj, target_bone_names=None, from_weight_paint=False):
+def deform_candidates(armature_obj, target_bone_names=None, from_weight_paint=False):
+    """Bones to bind to: the named ones (deform only in weight paint), else every deform bone."""
+    bones = armature_obj.data.bones
+    if target_bone_names:
+        return [b for b in bones if b.name in target_bone_names and (b.use_deform or not from_weight_paint)]
+    return [b for b in bones if b.use_deform]
+
+def parent_to_armature(mesh_obj, armature_obj):
+    """Parent with empty groups (no heat), keeping a pre-existing Armature modifier only."""
+    bpy.ops.object.mode_set(mode='OBJECT')
+    bpy.ops.object.select_all(action='DESELECT')
+    mesh_obj.select_set(True)
+    armature_obj.select_set(True)
+    bpy.context.view_layer.objects.active = armature_obj
+
+    existing_mod_names = {m.name for m in mesh_obj.modifiers if m.type == 'ARMATURE'}
+    bpy.ops.object.parent_set(type='ARMATURE')
+
+    # Clean up duplicate modifiers if one already existed
+    new_mods = [m for m in mesh_obj.modifiers if m.type == 'ARMATURE' and m.name not in existing_mod_names]
+    if existing_mod_names and new_mods:
+        for mod in new_mods:
+            mesh_obj.modifiers.remove(mod)
+    bpy.context.view_layer.objects.active = mesh_obj
+
+def bone_segments_local(mesh_obj, armature_obj, candidates):
+    """Rest pose head / tail of each bone in mesh-local space -> c_float[num_bones * 6]."""
+    to_local = mesh_obj.matrix_world.inverted() @ armature_obj.matrix_world
+    segments = (ctypes.c_float * (len(candidates) * 6))()
+    for b, bone in enumerate(candidates):
+        head = to_local @ bone.head_local
+        tail = to_local @ bone.tail_local
+        segments[b * 6:b * 6 + 6] = [head.x, head.y, head.z, tail.x, tail.y, tail.z]
+    return segments
+
+def restore_object_mode(mesh_obj, original_mode):
+    if mesh_obj.mode != original_mode and original_mode in {'EDIT', 'WEIGHT_PAINT', 'OBJECT'}:
+        try:
+            bpy.context.view_layer.objects.active = mesh_obj
+            bpy.ops.object.mode_set(mode=original_mode)
+        except:
+            pass
+
+def apply_binary_weights_native(mesh_obj, armature_obj, target_bone_names=None, from_weight_paint=False, use_geodesic=True):
+    """
+    Native rigid binding: each vertex gets weight 1.0 in the group of its
+    nearest bone segment (optionally refined by a geodesic flood over the
+    mesh edges). No heat solve, so it can't fail on holes or overlaps.
+    The candidate groups are rebound, and in weight paint only at the
+    masked vertices. Every other (unlocked) deform group is cleared on the
+    vertices that got a bone, so each ends up with exactly one influence
+    as after the Bone Heat path's limit_total(1). Returns None when the
+    DLL path is unavailable or fails (caller falls back).
+    """
+    dll = wynn_core.load_dll()
+    if not wynn_core.has_binary_api(dll):
+        return None
+
+    candidates = deform_candidates(armature_obj, target_bone_names, from_weight_paint)
+    if not candidates:
+        print("Binary Weights: no deform bones to bind to.")
+        return {'CANCELLED'}
+
+    original_mode = mesh_obj.mode
+    try:
+        if not from_weight_paint:
+            parent_to_armature(mesh_obj, armature_obj)
+
+        mesh = mesh_obj.data
+        num_verts = len(mesh.vertices)
+        if num_verts == 0:
+            return {'FINISHED'}
+
+        coords = (ctypes.c_float * (num_verts * 3))()
+        mesh.vertices.foreach_get("co", coords)
+
+        num_bones = len(candidates)
+        segments = bone_segments_local(mesh_obj, armature_obj, candidates)
+
+        adj_starts = adj_indices = None
+        num_edges = len(mesh.edges)
+        if use_geodesic and num_edges > 0:
+            edges = (ctypes.c_int * (num_edges * 2))()
+            mesh.edges.foreach_get("vertices", edges)
+            adj_starts = (ctypes.c_int * (num_verts + 1))()
+            adj_indices = (ctypes.c_int * (num_edges * 2))()
+            adj_weights = (ctypes.c_float * (num_edges * 2))()
+            dll.build_adjacency_graph(num_verts, num_edges, edges, coords, adj_starts, adj_indices, adj_weights)
+
+        out_bone = (ctypes.c_int * num_verts)()
+        pool = dll.pool_create(0)
+        try:
+            dll.binary_weights_strided(pool, num_verts, coords, num_bones, segments, None, None,
+                                       adj_starts, adj_indices, out_bone, None, None, None)
+        finally:
+            dll.pool_destroy(pool)
+
+        # Weight paint: only the masked vertices are rebound
+        mask = wynn_core.selection_mask(mesh) if from_weight_paint else None
+        if mask is not None:
+            verts = list(itertools.compress(range(num_verts), wynn_core.buffer_view(mask)))
+        else:
+            verts = list(range(num_verts))
+
+        # Sorted by bone (unbound -1 first): one vertex run per bone, grouped in C
+        bone_of = wynn_core.buffer_view(out_bone).tolist()
+        per_bone = {b: list(run) for b, run in
+                    itertools.groupby(sorted(verts, key=bone_of.__getitem__), key=bone_of.__getitem__) if b >= 0}
+        bound = list(itertools.chain.from_iterable(per_bone.values()))
+
+        # Batched write-back: one remove per group, one add per bone
+        candidate_names = {bone.name for bone in candidates}
+        for bone in candidates:
+            vg = mesh_obj.vertex_groups.get(bone.name)
+            if vg is not None:
+                vg.remove(verts)
+        for bone in armature_obj.data.bones:
+            vg = mesh_obj.vertex_groups.get(bone.name)
+            if bone.use_deform and bone.name not in candidate_names and vg is not None and not vg.lock_weight:
+                vg.remove(bound)
+
+        for b, bone in enumerate(candidates):
+            if b not in per_bone:
+                continue
+            vg = mesh_obj.vertex_groups.get(bone.name)
+            if vg is None:
+                vg = mesh_obj.vertex_groups.new(name=bone.name)
+            vg.add(per_bone[b], 1.0, 'REPLACE')
+
+        mesh.update()
+        print(f"Rigid binding applied to {mesh_obj.name} (native, {num_bones} bones)")
+        return {'FINISHED'}
+
+    except Exception as e:
+        print(f"Error applying native binary weights: {e}")
+        return None
+
+    finally:
+        restore_object_mode(mesh_obj, original_mode)
+
+def prepare_bone_groups(mesh_obj, armature_obj, target_bone_names=None, from_weight_paint=False, parent=True):
+    """
+    Parents (object mode) and creates the missing candidate groups for a
+    native bind. Returns (segments, bone_groups) for wynn_core.heat_weights,
+    start_heat_job or batch_binary_weights, None without deform bones.
+    Existing weights stay: the native solve replaces the candidate groups
+    only, so other bones' groups are left alone. parent=False leaves the
+    parenting to the caller (a background job parents once it applied).
+    """
+    candidates = deform_candidates(armature_obj, target_bone_names, from_weight_paint)
+    if not candidates:
+        print("Bone Groups: no deform bones to bind to.")
+        return None
+    if parent and not from_weight_paint:
+        parent_to_armature(mesh_obj, armature_obj)
+
+    groups = []
+    for bone in candidates:
+        vg = mesh_obj.vertex_groups.get(bone.name)
+        if vg is None:
+            vg = mesh_obj.vertex_groups.new(name=bone.name)
+        groups.append(vg.index)
+
+    segments = bone_segments_local(mesh_obj, armature_obj, candidates)
+    return segments, (ctypes.c_int * len(groups))(*groups)
+
+def apply_heat_weights_native(mesh_obj, armature_obj, target_bone_names=None, from_weight_paint=False,
+                              use_geodesic=True, max_influence=4, report=None):
+    """
+    Native Auto Weights: per-bone heat diffusion over the mesh edges in the
+    core DLL (see wynn_core.heat_weights). Smooth weights like Bone Heat,
+    but it solves on any mesh, so it's also the fallback when Bone Heat
+    fails. Returns None when the DLL path is unavailable. Bones whose solve
+    did not converge are warned about through report (an operator's
+    report), else on the console.
+    """
+    dll = wynn_core.load_dll()
+    if not wynn_core.has_heat_api(dll):
+        return None
+
+    original_mode = mesh_obj.mode
+    try:
+        prepared = prepare_bone_groups(mesh_obj, armature_obj, target_bone_names, from_weight_paint)
+        if prepared is None:
+            return {'CANCELLED'}
+        if len(mesh_obj.data.vertices) == 0:
+            return {'FINISHED'}
+
+        segments, bone_groups = prepared
+        _, unconverged = wynn_core.heat_weights(dll, mesh_obj, segments, bone_groups, max_influence,
+                                                use_geodesic=use_geodesic)
+        mesh_obj.data.update()
+        print(f"Heat weights applied to {mesh_obj.name} (native, {len(bone_groups)} bones)")
+        if unconverged:
+            warning = f"Heat weights on {mesh_obj.name}: {unconverged} bone(s) did not converge, weights are approximate"
+            if report:
+                report({'WARNING'}, warning)
+            else:
+                print(warning)
+        return {'FINISHED'}
+
+    except Exception as e:
+        print(f"Error applying native heat weights: {e}")
+        return {'CANCELLED'}
+
+    finally:
+        restore_object_mode(mesh_obj, original_mode)
+
+def binarize_weights(mesh_obj, clean_limit, clean_first):
+    """
+    limit_total(1) + clean(limit) + normalize_all, in that order (clean_first)
+    or with clean last, as one native pipeline pass over the selection
+    (paint mask). Returns None if the DLL can't (caller runs the bpy.ops).
+    """
+    ops = [wynn_core.limit_op(1)]
+    clean = wynn_core.clean_op(clean_limit)
+    if clean_first:
+        ops += [clean, wynn_core.normalize_op()]
+    else:
+        ops += [wynn_core.normalize_op(), clean]
+    return wynn_core.run_weight_pipeline(mesh_obj, ops, wynn_core.selection_mask(mesh_obj.data))
+
+def apply_binary_weights(mesh_obj, armature_obj, target_bone_names=None, from_weight_paint=False, use_native=True, use_geodesic=True):
     """
     Applies binary weights (0.0 or 1.0) using Auto Weights (Heat) + Limit Total.
     Includes robust context switching to avoid poll() errors.
+    Tries the native nearest-bone path first (see apply_binary_weights_native),
+    and solves the heat natively if Blender's Bone Heat fails.
     """
+    if use_native:
+        result = apply_binary_weights_native(mesh_obj, armature_obj, target_bone_names, from_weight_paint, use_geodesic)
+        if result is not None:
+            return result
+
     original_mode = bpy.context.mode
     
     restore_deform_settings = []
@@ -34,12 +267,16 @@ def apply_binary_weights(mesh_obj, armature_obj, target_bone_names=None, from_we
                 bpy.ops.paint.weight_from_bones(type='AUTOMATIC')
             except RuntimeError:
                 print("ERROR: Bone Heat Weighting failed. Check mesh geometry.")
-                return {'HEAT_FAILED'}
+                # Same bones as weight_from_bones: the selected ones
+                if apply_heat_weights_native(mesh_obj, armature_obj, target_bone_names, True, use_geodesic) != {'FINISHED'}:
+                    return {'HEAT_FAILED'}
+                print("Bone Heat replaced by the native heat solve")
             
-            # 3. Process weights (Binarize)
-            bpy.ops.object.vertex_group_limit_total(limit=1)
-            bpy.ops.object.vertex_group_clean(group_select_mode='ALL', limit=0.5)
-            bpy.ops.object.vertex_group_normalize_all(lock_active=False)
+            # 3. Process weights (Binarize): one native sweep, else three Blender passes
+            if binarize_weights(mesh_obj, clean_limit=0.5, clean_first=True) is None:
+                bpy.ops.object.vertex_group_limit_total(limit=1)
+                bpy.ops.object.vertex_group_clean(group_select_mode='ALL', limit=0.5)
+                bpy.ops.object.vertex_group_normalize_all(lock_active=False)
 
         # --- PATH 2: Called from Object Mode ---
         else:
@@ -57,7 +294,9 @@ def apply_binary_weights(mesh_obj, armature_obj, target_bone_names=None, from_we
                 bpy.ops.object.parent_set(type='ARMATURE_AUTO')
             except RuntimeError:
                 print("ERROR: Bone Heat Weighting failed. Check mesh geometry.")
-                return {'HEAT_FAILED'}
+                if apply_heat_weights_native(mesh_obj, armature_obj, target_bone_names, False, use_geodesic) != {'FINISHED'}:
+                    return {'HEAT_FAILED'}
+                print("Bone Heat replaced by the native heat solve")
 
             # Clean up duplicate modifiers if one already existed
             new_mods = [m for m in mesh_obj.modifiers if m.type == 'ARMATURE' and m.name not in existing_mod_names]
@@ -77,9 +316,10 @@ def apply_binary_weights(mesh_obj, armature_obj, target_bone_names=None, from_we
             
             bpy.context.object.data.use_paint_mask_vertex = True
 
-            bpy.ops.object.vertex_group_limit_total(limit=1)
-            bpy.ops.object.vertex_group_normalize_all(lock_active=False)
-            bpy.ops.object.vertex_group_clean(group_select_mode='ALL', limit=0.001)
+            if binarize_weights(mesh_obj, clean_limit=0.001, clean_first=False) is None:
+                bpy.ops.object.vertex_group_limit_total(limit=1)
+                bpy.ops.object.vertex_group_normalize_all(lock_active=False)
+                bpy.ops.object.vertex_group_clean(group_select_mode='ALL', limit=0.001)
 
         print(f"Rigid binding applied to {mesh_obj.name}")
         return {'FINISHED'}
@@ -114,6 +354,18 @@ class WYNN_OT_parent_binary_weights(bpy.types.Operator):
         default=False
     )
 
+    use_native: bpy.props.BoolProperty(
+        name="Native (Nearest Bone)",
+        description="Assign each vertex to its nearest bone in the core DLL instead of Bone Heat",
+        default=True
+    )
+
+    use_geodesic: bpy.props.BoolProperty(
+        name="Geodesic Flood",
+        description="Grow bone regions over the mesh surface so gaps (e.g. arm vs torso) don't leak",
+        default=True
+    )
+
     @classmethod
     def poll(cls, context):
         return context.active_object is not None and context.mode == 'OBJECT'
@@ -148,6 +400,8 @@ class WYNN_OT_parent_binary_weights(bpy.types.Operator):
         if not mesh_obj or not armature:
             self.report({'ERROR'}, "Selection must include a Mesh and an Armature.")
             return {'CANCELLED'}
+        if refuse_if_busy(self, [mesh_obj]):
+            return {'CANCELLED'}
 
         target_bone_names = None
         if self.use_selected_bones:
@@ -166,7 +420,8 @@ class WYNN_OT_parent_binary_weights(bpy.types.Operator):
                 self.report({'WARNING'}, "'Selected Bones Only' is checked, but no bones are selected.")
                 return {'CANCELLED'}
 
-        result = apply_binary_weights(mesh_obj, armature, target_bone_names, from_weight_paint=False)
+        result = apply_binary_weights(mesh_obj, armature, target_bone_names, from_weight_paint=False,
+                                      use_native=self.use_native, use_geodesic=self.use_geodesic)
         
         if result == {'HEAT_FAILED'}:
             self.report({'ERROR'}, "Bone Heat Failed: Mesh has holes, overlaps, or bad scale.")
@@ -181,6 +436,18 @@ class WYNN_OT_assign_binary_weights(bpy.types.Operator):
     bl_label = "Assign Binary Weight to Bone"
     bl_options = {'REGISTER', 'UNDO'}
 
+    use_native: bpy.props.BoolProperty(
+        name="Native (Nearest Bone)",
+        description="Assign each vertex to its nearest bone in the core DLL instead of Bone Heat",
+        default=True
+    )
+
+    use_geodesic: bpy.props.BoolProperty(
+        name="Geodesic Flood",
+        description="Grow bone regions over the mesh surface so gaps (e.g. arm vs torso) don't leak",
+        default=True
+    )
+
     @classmethod
     def poll(cls, context):
         return (context.active_object and 
@@ -189,6 +456,8 @@ class WYNN_OT_assign_binary_weights(bpy.types.Operator):
 
     def execute(self, context):
         mesh_obj = context.active_object
+        if refuse_if_busy(self, [mesh_obj]):
+            return {'CANCELLED'}
         armature = None
         # Find the armature from the mesh's modifiers
         for mod in mesh_obj.modifiers:
@@ -203,7 +472,8 @@ class WYNN_OT_assign_binary_weights(bpy.types.Operator):
         # In Weight Paint mode, selected pose bones are in context.selected_pose_bones
         target_bone_names = {pb.name for pb in context.selected_pose_bones}
 
-        result = apply_binary_weights(mesh_obj, armature, target_bone_names, from_weight_paint=True)
+        result = apply_binary_weights(mesh_obj, armature, target_bone_names, from_weight_paint=True,
+                                      use_native=self.use_native, use_geodesic=self.use_geodesic)
 
         if result == {'HEAT_FAILED'}:
             self.report({'ERROR'}, "Bone Heat Failed: Mesh has holes, overlaps, or bad scale.")
@@ -0,0 +1,13 @@
+@echo off
+echo Building WynnWeightBench.exe with g++...
+
+g++ -o WynnWeightBench.exe WynnWeightBench.cpp -O3 -std=c++17 -static
+
+if %errorlevel% neq 0 (
+    echo Build Failed!
+    pause
+    exit /b %errorlevel%
+)
+
+echo Build Successful!
+echo Run: WynnWeightBench.exe --mesh grid:256 --mesh sphere:256x512 ^> bench.jsonl
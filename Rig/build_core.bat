@@ -1,7 +1,7 @@
 @echo off
 echo Building WynnWeightLogic.dll with g++...
 
-g++ -shared -o WynnWeightLogic.dll WynnWeightLogic.cpp -O3
+g++ -shared -o WynnWeightLogic.dll WynnWeightLogic.cpp -O3 -std=c++17 -static
 
 if %errorlevel% neq 0 (
     echo Build Failed!
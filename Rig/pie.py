@@ -11,6 +11,7 @@ class WYNN_MT_edit_weights(bpy.types.Menu):
         if is_weight_paint:
             layout.operator("wynn.assign_binary_weights", text="Assign Binary Weight", icon='GROUP_BONE')
             layout.operator("wynn.smooth_weights", text="Smooth Symmetrize", icon='SMOOTHCURVE')
+            layout.operator("wynn.smooth_mesh_weights", text="Smooth All Groups", icon='MOD_SMOOTH')
             layout.operator("wynn.edit_weight_shape", text="Edit Weight Shape", icon='SCULPTMODE_HLT')
         elif context.mode == 'EDIT_MESH':
             col = layout.column(align=True)
@@ -20,6 +21,9 @@ class WYNN_MT_edit_weights(bpy.types.Menu):
             col.operator("wynn.edit_add_weight", text="Add Weight", icon='ADD')
         else:
             layout.operator("wynn.parent_binary_weights", text="Parent Binary Weights", icon='GROUP_BONE')
+            layout.operator("wynn.parent_heat_weights", text="Parent Auto Weights (Native)", icon='BONE_DATA')
+            layout.operator("wynn.transfer_weights", text="Transfer Weights", icon='MOD_DATA_TRANSFER')
+            layout.operator("wynn.batch_weights", text="Batch Weights (Selected Meshes)", icon='OUTLINER_OB_GROUP_INSTANCE')
 
 class VIEW3D_MT_custom_pie_menu(bpy.types.Menu):
     """Pie menu for rigging helper tools"""
@@ -0,0 +1,1117 @@
+"""
+Shared access to the native core (WynnWeightLogic.dll).
+
+- load_dll(): one CDLL for every operator, session argtypes declared once.
+- Per-mesh core cache: thread pool, undo journal, spatial index and a
+  brush session (CSR + strided weights) stay resident between operators,
+  keyed by the mesh datablock. The brush, Smooth.py and edit-mode tools
+  on the same mesh reuse them instead of paying full startup each time;
+  session_update re-syncs only what changed.
+- Full-mesh CSR cache for callers that need raw arrays (edit mode).
+- Weight transfer: source meshes as native triangle BVH surfaces.
+- Multi-mesh batches: one operation over many meshes' sessions on one
+  shared pool (run_batch), balanced by vertex count natively.
+- Background jobs: long session operations on a worker thread, polled
+  from a modal timer (WeightJob), so the viewport stays responsive.
+- Zero-copy reads: buffer_view / session_buffer expose ctypes arrays and
+  session memory through the buffer protocol, so results are converted in
+  bulk (slice .tolist(), numpy.frombuffer) instead of element by element.
+"""
+import array
+import ctypes
+import os
+import zlib
+
+STRIDE = 8 # Fixed stride matches C++ (MAX_STORAGE)
+# Per-group flags (match C++ GROUP_*)
+GROUP_DEFORM = 1
+GROUP_LOCKED = 2
+GROUP_EXCLUDED = 4
+MAX_CACHED_MESHES = 2 # Resident cores (a 300k mesh holds ~40MB of weights + CSR)
+
+_dll = None
+_dll_failed = False
+
+def get_dll_path():
+    return os.path.join(os.path.dirname(__file__), "WynnWeightLogic.dll")
+
+def load_dll():
+    """The shared CDLL, or None if it is missing / fails to load."""
+    global _dll, _dll_failed
+    if _dll or _dll_failed:
+        return _dll
+    dll_path = get_dll_path()
+    if not os.path.exists(dll_path):
+        print(f"WynnCore: DLL NOT FOUND at {dll_path}")
+        _dll_failed = True
+        return None
+    try:
+        dll = ctypes.CDLL(dll_path)
+    except OSError as e:
+        print(f"WynnCore: DLL Found but Failed to Load: {e}")
+        _dll_failed = True
+        return None
+
+    try:
+        dll.build_adjacency_graph.argtypes = [
+            ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+    except AttributeError:
+        print("WynnCore: build_adjacency_graph MISSING (Old DLL?)")
+
+    try:
+        # binary_weights_strided(pool, num_verts, coords, num_bones, segments, radii, bone_groups,
+        #                        adj_starts, adj_indices, out_bone, out_dist, weight_indices, weight_values)
+        dll.binary_weights_strided.argtypes = [
+            ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float),
+            ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_int),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        dll.binary_weights_strided.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: binary_weights_strided MISSING (Old DLL?)")
+
+    try:
+        dll.update_edge_weights.argtypes = [
+            ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int),
+            ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float)
+        ]
+    except AttributeError:
+        print("WynnCore: update_edge_weights MISSING (Old DLL?)")
+
+    try:
+        dll.pool_create.argtypes = [ctypes.c_int]
+        dll.pool_create.restype = ctypes.c_void_p
+        dll.pool_destroy.argtypes = [ctypes.c_void_p]
+        dll.undo_create.argtypes = [ctypes.c_longlong]
+        dll.undo_create.restype = ctypes.c_void_p
+        dll.undo_destroy.argtypes = [ctypes.c_void_p]
+        dll.undo_clear.argtypes = [ctypes.c_void_p, ctypes.c_longlong]
+        dll.spatial_create.restype = ctypes.c_void_p
+        dll.spatial_destroy.argtypes = [ctypes.c_void_p]
+        dll.session_create.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        dll.session_create.restype = ctypes.c_void_p
+        dll.session_destroy.argtypes = [ctypes.c_void_p]
+        # session_update(s, nv, ne, edges, local_coords, world_coords|None, counts|None, groups, weights)
+        dll.session_update.argtypes = [
+            ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        dll.session_update.restype = ctypes.c_int
+        # session_smooth_group(s, targets|None, num_targets, group, factor, iterations)
+        dll.session_smooth_group.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_int, ctypes.c_float, ctypes.c_int
+        ]
+        dll.session_smooth_group.restype = ctypes.c_int
+        dll.session_pending_count.argtypes = [ctypes.c_void_p]
+        dll.session_pending_count.restype = ctypes.c_int
+        dll.session_diff.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        dll.session_diff.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: session API MISSING (Old DLL?)")
+
+    try:
+        dll.session_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(SessionStats)]
+        dll.session_reset_stats.argtypes = [ctypes.c_void_p]
+        dll.session_stats_size.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: session stats MISSING (Old DLL?)")
+
+    try:
+        dll.build_mirror_map.argtypes = [
+            ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.c_float, ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.build_mirror_map.restype = ctypes.c_int
+        dll.session_set_mirror.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.c_int
+        ]
+        # session_weight_pipeline(s, ops, num_ops, vertex_mask|None) -> changed verts
+        dll.session_weight_pipeline.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(WeightOp), ctypes.c_int, ctypes.POINTER(ctypes.c_ubyte)
+        ]
+        dll.session_weight_pipeline.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: session_weight_pipeline MISSING (Old DLL?)")
+
+    try:
+        # session_get_buffer(s, which, out_count*) -> const void* (session-owned)
+        dll.session_get_buffer.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+        dll.session_get_buffer.restype = ctypes.c_void_p
+        # session_diff_runs(s, vertex_list|None, num_list) -> num_runs
+        dll.session_diff_runs.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+        dll.session_diff_runs.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: session_get_buffer MISSING (Old DLL?)")
+
+    try:
+        dll.pack_weights_strided.argtypes = [
+            ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        dll.session_set_max_influence.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        dll.surface_create.restype = ctypes.c_void_p
+        dll.surface_destroy.argtypes = [ctypes.c_void_p]
+        # surface_build(surface, pool, nv, coords, matrix|None, num_tris, tris, weight_indices, weight_values)
+        dll.surface_build.argtypes = [
+            ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float),
+            ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)
+        ]
+        # session_transfer_weights(s, surface, coords, matrix|None, group_map|None, num_map, max_distance, mask|None)
+        dll.session_transfer_weights.argtypes = [
+            ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float, ctypes.POINTER(ctypes.c_ubyte)
+        ]
+        dll.session_transfer_weights.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: weight transfer MISSING (Old DLL?)")
+
+    try:
+        # heat_weights_strided(pool, nv, coords, adj_starts, adj_indices, adj_weights, num_bones,
+        #                      segments, radii|None, bone_groups, params*, weight_indices, weight_values, out_iterations|None)
+        dll.heat_weights_strided.argtypes = [
+            ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float),
+            ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_int),
+            ctypes.POINTER(HeatParams), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.heat_weights_strided.restype = ctypes.c_int
+        # session_heat_weights(s, coords, num_bones, segments, radii|None, bone_groups, params*, out_iterations|None)
+        dll.session_heat_weights.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.c_int, ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(HeatParams), ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.session_heat_weights.restype = ctypes.c_int
+        dll.heat_params_size.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: heat weights MISSING (Old DLL?)")
+
+    try:
+        # job_smooth_groups(s, targets|None, num_targets, groups, num_groups, factor, iterations) -> job
+        dll.job_smooth_groups.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_float, ctypes.c_int
+        ]
+        dll.job_smooth_groups.restype = ctypes.c_void_p
+        # job_weight_pipeline(s, ops, num_ops, mask|None) -> job
+        dll.job_weight_pipeline.argtypes = [ctypes.c_void_p, ctypes.POINTER(WeightOp), ctypes.c_int, ctypes.POINTER(ctypes.c_ubyte)]
+        dll.job_weight_pipeline.restype = ctypes.c_void_p
+        # job_heat_weights(s, coords, num_bones, segments, radii|None, bone_groups, params*, out_iterations|None) -> job
+        dll.job_heat_weights.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.c_int, ctypes.POINTER(ctypes.c_float),
+            ctypes.POINTER(ctypes.c_float), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(HeatParams), ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.job_heat_weights.restype = ctypes.c_void_p
+        dll.job_poll.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_float)]
+        dll.job_poll.restype = ctypes.c_int
+        dll.job_cancel.argtypes = [ctypes.c_void_p]
+        dll.job_finish.argtypes = [ctypes.c_void_p]
+        dll.job_finish.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: background jobs MISSING (Old DLL?)")
+
+    try:
+        # batch_*(pool, sessions, num_sessions, ..., out_changed|None) -> total changed
+        dll.batch_weight_pipeline.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p), ctypes.c_int,
+            ctypes.POINTER(WeightOp), ctypes.c_int, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.batch_smooth_group.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.c_float, ctypes.c_int, ctypes.POINTER(ctypes.c_int)
+        ]
+        # batch_binary_weights(pool, sessions, n, coords[n], num_bones, segments[n], bone_groups[n], use_geodesic, out)
+        dll.batch_binary_weights.argtypes = [
+            ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p), ctypes.c_int,
+            ctypes.POINTER(ctypes.c_void_p), ctypes.c_int, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p),
+            ctypes.c_int, ctypes.POINTER(ctypes.c_int)
+        ]
+        for fn in (dll.batch_weight_pipeline, dll.batch_smooth_group, dll.batch_binary_weights):
+            fn.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: multi-mesh batches MISSING (Old DLL?)")
+
+    try:
+        # session_smooth_mesh(s, factor, iterations, tolerance, backend, out_backend*|None, out_passes*|None) -> changed
+        dll.session_smooth_mesh.argtypes = [
+            ctypes.c_void_p, ctypes.c_float, ctypes.c_int, ctypes.c_float, ctypes.c_int,
+            ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int)
+        ]
+        dll.session_smooth_mesh.restype = ctypes.c_int
+        # job_smooth_mesh(s, factor, iterations, tolerance, backend) -> job
+        dll.job_smooth_mesh.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_int, ctypes.c_float, ctypes.c_int]
+        dll.job_smooth_mesh.restype = ctypes.c_void_p
+        dll.gpu_device_info.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        dll.gpu_device_info.restype = ctypes.c_int
+    except AttributeError:
+        print("WynnCore: whole-mesh smoothing MISSING (Old DLL?)")
+
+    try:
+        dll.session_set_group_flags.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_ubyte), ctypes.c_int]
+    except AttributeError:
+        print("WynnCore: session_set_group_flags MISSING (Old DLL?)")
+
+    _dll = dll
+    return _dll
+
+def has_session_api(dll):
+    return dll is not None and hasattr(dll, 'session_update') and hasattr(dll, 'undo_clear')
+
+def has_binary_api(dll):
+    return dll is not None and hasattr(dll, 'binary_weights_strided') and hasattr(dll, 'pool_create')
+
+# --- DLL VERSION GATE ---
+
+DLL_OUTDATED = "WynnWeightLogic.dll is older than the addon: rebuild it with Rig/build_core.bat"
+
+def dll_ready(cls, has_api):
+    """poll() gate for operators with no fallback: greys them out until the DLL exports has_api"""
+    if has_api(load_dll()):
+        return True
+    cls.poll_message_set(DLL_OUTDATED)
+    return False
+
+def missing_features(dll):
+    """Names of the native features the loaded DLL lacks (printed once at register)"""
+    checks = (
+        ("cached sessions", has_session_api),
+        ("native binary weights", has_binary_api),
+        ("weight transfer", has_transfer_api),
+        ("heat weights", has_heat_api),
+        ("background jobs", has_job_api),
+        ("multi-mesh batches", has_batch_api),
+        ("whole-mesh smoothing", has_mesh_smooth_api),
+    )
+    return [name for name, has_api in checks if not has_api(dll)]
+
+# --- INSTRUMENTATION ---
+
+STATS_PHASES = ('query', 'kernel', 'commit', 'diff') # C++ STATS_* order
+STATS_BUCKETS = 12 # Bucket b: calls under 0.0625ms * 2^b (last: the rest)
+
+class SessionStats(ctypes.Structure):
+    """Mirror of the C++ SessionStats (session_get_stats)."""
+    _fields_ = [
+        ('calls', ctypes.c_longlong),
+        ('verts_processed', ctypes.c_longlong),
+        ('verts_changed', ctypes.c_longlong),
+        ('groups_touched', ctypes.c_longlong),
+        ('scratch_grows', ctypes.c_longlong),
+        ('scratch_reuses', ctypes.c_longlong),
+        ('phase_ms', ctypes.c_double * len(STATS_PHASES)),
+        ('last_ms', ctypes.c_double * len(STATS_PHASES)),
+        ('histogram', (ctypes.c_longlong * STATS_BUCKETS) * len(STATS_PHASES)),
+    ]
+
+def read_session_stats(dll, session, out=None):
+    """Session counters into `out` (a SessionStats, reused), None if unsupported by this DLL."""
+    if not session or not hasattr(dll, 'session_get_stats'):
+        return None
+    if dll.session_stats_size() != ctypes.sizeof(SessionStats):
+        return None # Layout changed: DLL and addon out of sync
+    if out is None:
+        out = SessionStats()
+    dll.session_get_stats(session, ctypes.byref(out))
+    return out
+
+def histogram_percentile(stats, phase, fraction):
+    """Upper bound (ms) of the bucket holding the given fraction of a phase's calls."""
+    buckets = stats.histogram[phase]
+    total = sum(buckets)
+    if total == 0:
+        return 0.0
+    seen = 0
+    for b in range(STATS_BUCKETS):
+        seen += buckets[b]
+        if seen >= total * fraction:
+            return 0.0625 * (2 ** b)
+    return 0.0625 * (2 ** (STATS_BUCKETS - 1))
+
+# --- ZERO-COPY BUFFERS ---
+
+# session_get_buffer selectors (match C++ SESSION_BUFFER_*): (id, ctype)
+SESSION_BUFFER_WEIGHT_INDICES = (0, ctypes.c_int)
+SESSION_BUFFER_WEIGHT_VALUES = (1, ctypes.c_float)
+SESSION_BUFFER_DIFF_VERTS = (2, ctypes.c_int)
+SESSION_BUFFER_DIFF_GROUPS = (3, ctypes.c_int)
+SESSION_BUFFER_DIFF_WEIGHTS = (4, ctypes.c_float)
+SESSION_BUFFER_DIFF_RUNS = (5, ctypes.c_int)
+SESSION_BUFFER_PENDING_VERTS = (6, ctypes.c_int)
+
+_VIEW_FORMATS = {ctypes.c_int: 'i', ctypes.c_float: 'f', ctypes.c_ubyte: 'B'}
+
+def buffer_view(c_array, ctype=None):
+    """
+    Flat memoryview ('i' / 'f' / 'B') over a ctypes array, no copy.
+    Slices convert in C (view[a:b].tolist()), and the view can go straight
+    to foreach_set or numpy.frombuffer. ctypes arrays alone export '<i',
+    which memoryview cannot index, hence the cast.
+    """
+    ctype = ctype or c_array._type_
+    return memoryview(c_array).cast('B').cast(_VIEW_FORMATS[ctype])
+
+def session_buffer(dll, session, buffer):
+    """
+    View over session memory (SESSION_BUFFER_*), None if empty or
+    unsupported. Valid until the session resizes that buffer (see the
+    C++ session_get_buffer) -> read it right away, don't keep it.
+    """
+    if not session or not hasattr(dll, 'session_get_buffer'):
+        return None
+    which, ctype = buffer
+    count = ctypes.c_int(0)
+    ptr = dll.session_get_buffer(session, which, ctypes.byref(count))
+    if not ptr or count.value == 0:
+        return None
+    return buffer_view((ctype * count.value).from_address(ptr), ctype)
+
+# --- PER-MESH CORE CACHE ---
+
+class CoreHandles:
+    """Native handles of one mesh (session borrows pool + journal)."""
+    __slots__ = ('pool', 'undo', 'grid', 'session', 'mirror_map', 'fingerprints')
+
+    def __init__(self, pool, undo, grid, session, mirror_map=None):
+        self.pool = pool
+        self.undo = undo
+        self.grid = grid
+        self.session = session
+        self.mirror_map = mirror_map # Brush: X-mirror vertex map (local coords)
+        self.fingerprints = None # mesh_fingerprints of the Blender data last read by update_session
+
+_cores = {} # {mesh pointer: CoreHandles}, insertion order = least recently released first
+
+def create_core(dll, undo_budget_mb=256, num_threads=0):
+    pool = dll.pool_create(num_threads) # 0 = All cores
+    undo = dll.undo_create(undo_budget_mb * 1024 * 1024)
+    grid = dll.spatial_create()
+    session = dll.session_create(pool, undo)
+    return CoreHandles(pool, undo, grid, session)
+
+def destroy_core(dll, core):
+    dll.session_destroy(core.session)
+    dll.pool_destroy(core.pool)
+    dll.undo_destroy(core.undo)
+    dll.spatial_destroy(core.grid)
+
+def acquire_core(mesh, undo_budget_mb=256):
+    """
+    Takes the cached core of this mesh out of the cache (the caller owns it
+    until release_core). The journal is cleared: Blender's weights are the
+    source of truth whenever a new operator starts. None if not cached.
+    """
+    core = _cores.pop(mesh.as_pointer(), None)
+    if core is not None:
+        load_dll().undo_clear(core.undo, undo_budget_mb * 1024 * 1024)
+    return core
+
+def release_core(mesh, core):
+    """Puts a core back (evicting the oldest meshes beyond MAX_CACHED_MESHES)."""
+    dll = load_dll()
+    key = mesh.as_pointer()
+    old = _cores.pop(key, None)
+    if old is not None and old is not core:
+        destroy_core(dll, old)
+    _cores[key] = core
+    while len(_cores) > MAX_CACHED_MESHES:
+        oldest = next(iter(_cores))
+        destroy_core(dll, _cores.pop(oldest))
+
+def free_all_cores():
+    global _batch_pool
+    cancel_all_jobs()
+    for core in _cores.values():
+        destroy_core(_dll, core)
+    _cores.clear()
+    if _batch_pool is not None:
+        _dll.pool_destroy(_batch_pool)
+        _batch_pool = None
+    _csr_cache.clear()
+
+def pack_mesh_weights(mesh):
+    """Bulk layout for pack_weights_strided / session_set_weights (counts, groups, weights)."""
+    # Blender has no bulk getter for v.groups: read each element once, then let
+    # array pack the values and hand ctypes the bytes (no per-element ctypes calls)
+    per_vertex = [v.groups for v in mesh.vertices]
+    items = [g for vg in per_vertex for g in vg]
+    counts = array.array('i', map(len, per_vertex))
+    groups = array.array('i', [g.group for g in items])
+    weights = array.array('f', [g.weight for g in items])
+    c_counts = (ctypes.c_int * len(counts)).from_buffer_copy(counts)
+    c_groups = (ctypes.c_int * len(groups)).from_buffer_copy(groups) if items else (ctypes.c_int * 1)()
+    c_weights = (ctypes.c_float * len(weights)).from_buffer_copy(weights) if items else (ctypes.c_float * 1)()
+    return c_counts, c_groups, c_weights
+
+def mesh_fingerprints(mesh, c_edges=None, packed=None):
+    """
+    (topology, weights) fingerprints of the mesh as Blender holds it now:
+    vertex count + edge list, and the pack_mesh_weights buffers. Buffers
+    already read for the same state can be passed in.
+    """
+    if c_edges is None:
+        c_edges = (ctypes.c_int * (len(mesh.edges) * 2))()
+        mesh.edges.foreach_get("vertices", c_edges)
+    weights_hash = 0
+    for buf in packed or pack_mesh_weights(mesh):
+        weights_hash = zlib.crc32(memoryview(buf).cast('B'), weights_hash)
+    return (len(mesh.vertices), zlib.crc32(memoryview(c_edges).cast('B'))), weights_hash
+
+def update_session(dll, core, obj, world_coords=None, weights=True):
+    """
+    Re-syncs a (possibly cached) session with the mesh: CSR only if the
+    edges / local coords fingerprints changed, spatial index if
+    world_coords is given, weights re-read from Blender unless weights=False.
+    Returns the session_update result (0 unchanged, 1 edge weights, 2 rebuilt).
+    """
+    mesh = obj.data
+    num_verts = len(mesh.vertices)
+    num_edges = len(mesh.edges)
+    c_edges = (ctypes.c_int * (num_edges * 2))()
+    mesh.edges.foreach_get("vertices", c_edges)
+    c_coords = (ctypes.c_float * (num_verts * 3))()
+    mesh.vertices.foreach_get("co", c_coords)
+
+    if weights:
+        packed = pack_mesh_weights(mesh)
+        core.fingerprints = mesh_fingerprints(mesh, c_edges, packed)
+    else:
+        packed = (None, None, None)
+    return dll.session_update(core.session, num_verts, num_edges, c_edges, c_coords, world_coords, *packed)
+
+def deform_group_names(obj):
+    """
+    Names of the groups driven by a deform bone of the object's armature(s)
+    (modifiers + armature parent), as BONE_DEFORM sees them. None if the
+    object has no armature (every group then counts as deform).
+    """
+    armatures = [mod.object for mod in obj.modifiers if mod.type == 'ARMATURE' and mod.object]
+    if obj.parent and obj.parent.type == 'ARMATURE':
+        armatures.append(obj.parent)
+    if not armatures:
+        return None
+    return {bone.name for arm in armatures for bone in arm.data.bones if bone.use_deform}
+
+def pack_group_flags(obj, excluded=()):
+    """GROUP_* byte per vertex group index: deform bones, lock_weight, `excluded` names."""
+    deform = deform_group_names(obj)
+    flags = []
+    for vg in obj.vertex_groups:
+        f = GROUP_DEFORM if deform is None or vg.name in deform else 0
+        if vg.lock_weight:
+            f |= GROUP_LOCKED
+        if vg.name in excluded:
+            f |= GROUP_EXCLUDED
+        flags.append(f)
+    return (ctypes.c_ubyte * max(1, len(flags)))(*flags), len(flags)
+
+def set_group_flags(dll, session, obj, excluded=()):
+    """
+    Makes the session kernels normalize only across deform groups and keep
+    locked groups as they are. False if the DLL predates group flags (kernels
+    then normalize across every group).
+    """
+    if not hasattr(dll, 'session_set_group_flags'):
+        return False
+    c_flags, num_groups = pack_group_flags(obj, excluded)
+    dll.session_set_group_flags(session, c_flags, num_groups)
+    return True
+
+# --- WEIGHT PIPELINE ---
+
+# WeightOp.type (match C++ PIPE_*)
+PIPE_NORMALIZE = 0 # ivalue: lock_active group index (-1 = none)
+PIPE_CLEAN = 1     # fvalue: limit, ivalue: keep_single
+PIPE_LIMIT = 2     # ivalue: limit
+PIPE_MIRROR = 3    # X-mirror (vertex mask = receiving side)
+# WeightOp.subset
+SUBSET_ALL = 0
+SUBSET_DEFORM = 1 # BONE_DEFORM
+
+class WeightOp(ctypes.Structure):
+    """One step of session_weight_pipeline (C++ WeightOp)."""
+    _fields_ = [
+        ('type', ctypes.c_int),
+        ('subset', ctypes.c_int),
+        ('ivalue', ctypes.c_int),
+        ('fvalue', ctypes.c_float),
+    ]
+
+def normalize_op(subset=SUBSET_ALL, lock_group=-1):
+    return WeightOp(PIPE_NORMALIZE, subset, lock_group, 0.0)
+
+def clean_op(limit=0.0, keep_single=False, subset=SUBSET_ALL):
+    return WeightOp(PIPE_CLEAN, subset, 1 if keep_single else 0, limit)
+
+def limit_op(limit=4, subset=SUBSET_ALL):
+    return WeightOp(PIPE_LIMIT, subset, limit, 0.0)
+
+def mirror_op():
+    return WeightOp(PIPE_MIRROR, SUBSET_ALL, 0, 0.0)
+
+def symmetrical_group_name(name):
+    """Counterpart of a vertex group name (same rules as Smooth.py / the brush)."""
+    endings = {'.L': '.R', '_L': '_R', '.R': '.L', '_R': '_L', '.l': '.r', '.r': '.l'}
+    for suffix, opposite in endings.items():
+        if name.endswith(suffix):
+            return name[:-len(suffix)] + opposite
+    return None
+
+def mirror_group_remap(obj):
+    """Group index -> mirrored group index (-1 = same group), for session_set_mirror."""
+    vertex_groups = obj.vertex_groups
+    remap = (ctypes.c_int * max(1, len(vertex_groups)))()
+    for vg in vertex_groups:
+        mirror_name = symmetrical_group_name(vg.name)
+        mirror_vg = vertex_groups.get(mirror_name) if mirror_name else None
+        remap[vg.index] = mirror_vg.index if mirror_vg else -1
+    return remap, len(vertex_groups)
+
+def ensure_mirror_map(dll, core, mesh, geometry_changed=False):
+    """X-mirror vertex map of the core (local coords), rebuilt when the geometry changed."""
+    num_verts = len(mesh.vertices)
+    if geometry_changed or core.mirror_map is None or len(core.mirror_map) != num_verts:
+        c_coords = (ctypes.c_float * (num_verts * 3))()
+        mesh.vertices.foreach_get("co", c_coords)
+        core.mirror_map = (ctypes.c_int * num_verts)()
+        dll.build_mirror_map(core.pool, num_verts, c_coords, 0.001, core.mirror_map)
+    return core.mirror_map
+
+def selection_mask(mesh, always=False):
+    """Vertex selection as a byte mask when a paint mask is on or always is set (None = every vertex)."""
+    if not (always or mesh.use_paint_mask_vertex or mesh.use_paint_mask):
+        return None
+    num_verts = len(mesh.vertices)
+    select = [False] * num_verts
+    mesh.vertices.foreach_get("select", select)
+    return (ctypes.c_ubyte * num_verts)(*select)
+
+def run_weight_pipeline(obj, ops, vertex_mask=None):
+    """
+    Runs normalize / clean / limit / mirror steps (WeightOp list) natively
+    in one parallel sweep over the mesh's session weights and writes the
+    result back to Blender once, instead of one Blender operator pass per
+    step. Group flags apply (locked groups stay, SUBSET_DEFORM = BONE_DEFORM).
+    Returns the number of changed vertices, or None if the DLL lacks the
+    pipeline (caller falls back to the bpy.ops).
+    """
+    dll = load_dll()
+    if not has_session_api(dll) or not hasattr(dll, 'session_weight_pipeline'):
+        return None
+    mesh = obj.data
+    core = acquire_core(mesh) or create_core(dll)
+    try:
+        set_group_flags(dll, core.session, obj)
+        geometry = update_session(dll, core, obj)
+        use_mirror = any(op.type == PIPE_MIRROR for op in ops)
+        if use_mirror:
+            remap, num_groups = mirror_group_remap(obj)
+            dll.session_set_mirror(core.session, ensure_mirror_map(dll, core, mesh, geometry != 0), remap, num_groups)
+        c_ops = (WeightOp * len(ops))(*ops)
+        changed = dll.session_weight_pipeline(core.session, c_ops, len(ops), vertex_mask)
+        if use_mirror:
+            dll.session_set_mirror(core.session, None, None, 0) # Brush sets its own (use_mirror)
+        apply_session_diff(dll, core, obj)
+    finally:
+        release_core(mesh, core)
+    return changed
+
+# --- WEIGHT TRANSFER ---
+
+def has_transfer_api(dll):
+    return has_session_api(dll) and hasattr(dll, 'session_transfer_weights')
+
+def matrix_rows(matrix):
+    """4x4 mathutils Matrix -> row-major c_float[16] (C++ transform_point)."""
+    return (ctypes.c_float * 16)(*[matrix[r][c] for r in range(4) for c in range(4)])
+
+def build_transfer_surface(dll, obj):
+    """
+    Native transfer source (triangle BVH + strided weights) of obj's mesh in
+    world space. One surface serves every target; free it with
+    dll.surface_destroy.
+    """
+    mesh = obj.data
+    mesh.calc_loop_triangles()
+    num_verts = len(mesh.vertices)
+    num_tris = len(mesh.loop_triangles)
+    c_coords = (ctypes.c_float * (num_verts * 3))()
+    mesh.vertices.foreach_get("co", c_coords)
+    c_tris = (ctypes.c_int * max(1, num_tris * 3))()
+    mesh.loop_triangles.foreach_get("vertices", c_tris)
+
+    c_weight_indices = (ctypes.c_int * (num_verts * STRIDE))()
+    c_weight_values = (ctypes.c_float * (num_verts * STRIDE))()
+    dll.pack_weights_strided(num_verts, *pack_mesh_weights(mesh), c_weight_indices, c_weight_values)
+
+    surface = dll.surface_create()
+    dll.surface_build(surface, None, num_verts, c_coords, matrix_rows(obj.matrix_world),
+                      num_tris, c_tris, c_weight_indices, c_weight_values)
+    return surface
+
+def transfer_group_map(source, target, create_groups=True):
+    """
+    Source group index -> target group index by name (c_int array, -1 =
+    skipped). Missing target groups are created when create_groups is set.
+    """
+    names = [vg.name for vg in source.vertex_groups]
+    target_groups = target.vertex_groups
+    group_map = []
+    for name in names:
+        vg = target_groups.get(name)
+        if vg is None and create_groups:
+            vg = target_groups.new(name=name)
+        group_map.append(vg.index if vg is not None else -1)
+    return (ctypes.c_int * max(1, len(group_map)))(*group_map), len(group_map)
+
+def transfer_weights(dll, surface, obj, group_map, num_map, max_influence=4, max_distance=0.0, vertex_mask=None):
+    """
+    Projects the surface's weights onto obj (closest surface point,
+    barycentric blend, capped + normalized natively, locked groups kept)
+    on the mesh's resident session, one write-back. Returns changed vertices.
+    """
+    mesh = obj.data
+    num_verts = len(mesh.vertices)
+    core = acquire_core(mesh) or create_core(dll)
+    try:
+        set_group_flags(dll, core.session, obj)
+        update_session(dll, core, obj)
+        c_coords = (ctypes.c_float * (num_verts * 3))()
+        mesh.vertices.foreach_get("co", c_coords)
+        dll.session_set_max_influence(core.session, int(max_influence))
+        changed = dll.session_transfer_weights(
+            core.session, surface, c_coords, matrix_rows(obj.matrix_world),
+            group_map, num_map, max_distance, vertex_mask
+        )
+        dll.session_set_max_influence(core.session, STRIDE) # Back to the engine limit for the next user
+        apply_session_diff(dll, core, obj)
+    finally:
+        release_core(mesh, core)
+    return changed
+
+# --- HEAT WEIGHTS ---
+
+class HeatParams(ctypes.Structure):
+    """Mirror of the C++ HeatParams (checked against heat_params_size)."""
+    _fields_ = [
+        ("heat", ctypes.c_float),
+        ("min_weight", ctypes.c_float),
+        ("tolerance", ctypes.c_float),
+        ("max_iterations", ctypes.c_int),
+        ("max_influence", ctypes.c_int),
+        ("use_geodesic", ctypes.c_int),
+    ]
+
+def has_heat_api(dll):
+    return (has_session_api(dll) and hasattr(dll, 'session_heat_weights') and
+            dll.heat_params_size() == ctypes.sizeof(HeatParams)) # Layout changed: DLL and addon out of sync
+
+HEAT_MAX_ITERATIONS = 1000 # Per batch of bones; a solve that hits it did not converge
+
+def heat_params(max_influence=4, min_weight=0.01, use_geodesic=True, heat=1.0):
+    return HeatParams(heat, min_weight, 1e-4, HEAT_MAX_ITERATIONS, int(max_influence), int(use_geodesic))
+
+def heat_unconverged(iterations):
+    """Bones whose solve stopped at HEAT_MAX_ITERATIONS (iterations: the out_iterations buffer)."""
+    return sum(1 for it in iterations if it >= HEAT_MAX_ITERATIONS) if iterations is not None else 0
+
+def heat_weights(dll, obj, segments, bone_groups, max_influence=4, min_weight=0.01, use_geodesic=True, heat=1.0):
+    """
+    Bone heat on the mesh's resident session: diffusion solve per bone over
+    the mesh edges (segments: c_float[num_bones * 6] head / tail in mesh
+    space, bone_groups: c_int[num_bones]), then a single write-back. Bone
+    groups are replaced, the others kept. Returns (changed vertices,
+    bones that did not converge).
+    """
+    mesh = obj.data
+    num_verts = len(mesh.vertices)
+    num_bones = len(bone_groups)
+    params = heat_params(max_influence, min_weight, use_geodesic, heat)
+    core = acquire_core(mesh) or create_core(dll)
+    try:
+        update_session(dll, core, obj)
+        c_coords = (ctypes.c_float * (num_verts * 3))()
+        mesh.vertices.foreach_get("co", c_coords)
+        c_iterations = (ctypes.c_int * num_bones)()
+        changed = dll.session_heat_weights(core.session, c_coords, num_bones, segments, None,
+                                           bone_groups, ctypes.byref(params), c_iterations)
+        apply_session_diff(dll, core, obj)
+    finally:
+        release_core(mesh, core)
+    return changed, heat_unconverged(c_iterations)
+
+# --- MULTI-MESH BATCHES ---
+
+_batch_pool = None # One all-core pool shared by every batch
+
+def has_batch_api(dll):
+    return has_session_api(dll) and hasattr(dll, 'batch_weight_pipeline')
+
+def _pointer_array(arrays):
+    return (ctypes.c_void_p * len(arrays))(*[ctypes.cast(a, ctypes.c_void_p) if a is not None else None for a in arrays])
+
+def run_batch(dll, objs, submit):
+    """
+    One native call over several meshes on the shared batch pool: every
+    mesh's session is synced (cached core, else a temporary single-thread
+    one), submit(pool, sessions, count, out_changed) runs the batch_* call,
+    then each mesh is written back. Meshes busy with a background job are
+    skipped. Returns changed vertices per object (-1 = skipped).
+    """
+    global _batch_pool
+    if _batch_pool is None:
+        _batch_pool = dll.pool_create(0)
+    cores = [] # (obj, core, cached)
+    try:
+        for obj in objs:
+            mesh = obj.data
+            if job_running(mesh):
+                cores.append((obj, None, False))
+                continue
+            core = acquire_core(mesh)
+            cached = core is not None
+            if core is None:
+                core = create_core(dll, num_threads=1) # Batch kernels run on the batch pool
+            cores.append((obj, core, cached))
+            set_group_flags(dll, core.session, obj)
+            update_session(dll, core, obj)
+
+        num = len(cores)
+        sessions = (ctypes.c_void_p * num)(*[core.session if core else None for _, core, _ in cores])
+        out_changed = (ctypes.c_int * num)()
+        submit(_batch_pool, sessions, num, out_changed)
+        for obj, core, _ in cores:
+            if core is not None:
+                apply_session_diff(dll, core, obj)
+        return list(out_changed)
+    finally:
+        for obj, core, cached in cores:
+            if core is None:
+                continue
+            if cached:
+                release_core(obj.data, core)
+            else:
+                destroy_core(dll, core)
+
+def batch_weight_pipeline(dll, objs, ops, masks=None):
+    """run_weight_pipeline over every mesh at once (masks: per object, entries may be None)."""
+    c_ops = (WeightOp * len(ops))(*ops)
+    c_masks = _pointer_array(masks) if masks else None
+    return run_batch(dll, objs, lambda pool, sessions, num, out: dll.batch_weight_pipeline(
+        pool, sessions, num, c_ops, len(ops), c_masks, out))
+
+def batch_smooth_group(dll, objs, group_name, factor, iterations):
+    """Smooths the group called group_name on every mesh that has it (each mesh's own index)."""
+    groups = []
+    for obj in objs:
+        vg = obj.vertex_groups.get(group_name)
+        groups.append(vg.index if vg is not None else -1)
+    c_groups = (ctypes.c_int * len(groups))(*groups)
+    return run_batch(dll, objs, lambda pool, sessions, num, out: dll.batch_smooth_group(
+        pool, sessions, num, c_groups, factor, iterations, out))
+
+def batch_binary_weights(dll, objs, bindings, use_geodesic=True):
+    """
+    Nearest-bone binding of every mesh at once. bindings: per object
+    (segments, bone_groups) in that mesh's space, same bone order for all.
+    """
+    coords = []
+    for obj in objs:
+        mesh = obj.data
+        c_coords = (ctypes.c_float * (len(mesh.vertices) * 3))()
+        mesh.vertices.foreach_get("co", c_coords)
+        coords.append(c_coords)
+    num_bones = len(bindings[0][1]) if bindings else 0
+    c_coords = _pointer_array(coords)
+    c_segments = _pointer_array([b[0] for b in bindings])
+    c_bone_groups = _pointer_array([b[1] for b in bindings])
+    return run_batch(dll, objs, lambda pool, sessions, num, out: dll.batch_binary_weights(
+        pool, sessions, num, c_coords, num_bones, c_segments, c_bone_groups, int(use_geodesic), out))
+
+# --- WHOLE-MESH SMOOTH ---
+
+SMOOTH_AUTO = 0 # session_smooth_mesh backends (match C++ SMOOTH_*)
+SMOOTH_CPU = 1
+SMOOTH_GPU = 2
+
+_gpu_name = None # gpu_device_name cache ('' = no device)
+
+def has_mesh_smooth_api(dll):
+    return has_session_api(dll) and hasattr(dll, 'session_smooth_mesh')
+
+def gpu_device_name(dll):
+    """The OpenCL GPU session_smooth_mesh runs on, None if CPU only (the first call builds the kernels)."""
+    global _gpu_name
+    if not has_mesh_smooth_api(dll):
+        return None
+    if _gpu_name is None:
+        name = ctypes.create_string_buffer(256)
+        _gpu_name = name.value.decode(errors='replace') if dll.gpu_device_info(name, len(name)) else ''
+    return _gpu_name or None
+
+def gpu_probed():
+    """True once gpu_device_name has opened the runtime (later calls are free, UI code can ask)."""
+    return _gpu_name is not None
+
+def smooth_mesh(dll, obj, factor, iterations, tolerance=0.0, backend=SMOOTH_AUTO):
+    """
+    Blurs every group over the whole mesh on its resident session: Jacobi
+    passes as in smooth_strided_iterations, early out below tolerance,
+    deform-only normalization, locked groups kept. AUTO runs big meshes on
+    the GPU when there is one (same result as the CPU). Returns
+    (changed vertices, backend used, passes run).
+    """
+    mesh = obj.data
+    out_backend = ctypes.c_int(SMOOTH_CPU)
+    out_passes = ctypes.c_int(0)
+    core = acquire_core(mesh) or create_core(dll)
+    try:
+        set_group_flags(dll, core.session, obj)
+        update_session(dll, core, obj)
+        changed = dll.session_smooth_mesh(core.session, factor, iterations, tolerance, backend,
+                                          ctypes.byref(out_backend), ctypes.byref(out_passes))
+        apply_session_diff(dll, core, obj)
+    finally:
+        release_core(mesh, core)
+    return changed, out_backend.value, out_passes.value
+
+# --- BACKGROUND JOBS ---
+
+JOB_RUNNING = 0 # job_poll states (match C++ JOB_*)
+JOB_DONE = 1
+JOB_CANCELLED = 2
+JOB_STALE = -2 # WeightJob.finish: the mesh changed while the job ran, result dropped
+
+_jobs = {} # {mesh pointer: WeightJob}, one running job per mesh
+
+def has_job_api(dll):
+    return has_session_api(dll) and hasattr(dll, 'job_finish')
+
+def job_running(mesh):
+    return mesh.as_pointer() in _jobs
+
+class WeightJob:
+    """
+    A native job on a worker thread (see start_smooth_job & co). It owns
+    the mesh's core until finish(), so nothing else touches the session
+    meanwhile; poll() never blocks the UI. iterations: the heat job's
+    out_iterations buffer (see heat_unconverged), None for other jobs.
+    """
+    __slots__ = ('dll', 'core', 'key', 'handle', '_progress', 'iterations', 'fingerprints')
+
+    def __init__(self, dll, core, key, handle):
+        self.dll = dll
+        self.core = core
+        self.key = key
+        self.handle = handle
+        self._progress = ctypes.c_float(0.0)
+        self.iterations = None
+        self.fingerprints = core.fingerprints # Mesh state the job was submitted on
+
+    def poll(self):
+        """(state, progress 0..1)"""
+        state = self.dll.job_poll(self.handle, ctypes.byref(self._progress))
+        return state, self._progress.value
+
+    def cancel(self):
+        self.dll.job_cancel(self.handle)
+
+    def finish(self, obj=None):
+        """
+        Waits for the worker, writes the result back to obj (one diff) and
+        returns the core to the cache. obj=None (object gone) drops the
+        core instead, and so does a mesh whose topology or weights changed
+        since submit (the diff would overwrite those edits). Returns
+        changed vertices, -1 if cancelled (untouched), JOB_STALE if dropped
+        for a changed mesh.
+        """
+        result = self.dll.job_finish(self.handle)
+        self.handle = None
+        _jobs.pop(self.key, None)
+        if obj is None:
+            destroy_core(self.dll, self.core)
+            return result
+        if result >= 0 and mesh_fingerprints(obj.data) != self.fingerprints:
+            print(f"WynnCore: {obj.name} changed while its job ran, result dropped")
+            destroy_core(self.dll, self.core)
+            return JOB_STALE
+        try:
+            if result >= 0:
+                apply_session_diff(self.dll, self.core, obj)
+        finally:
+            release_core(obj.data, self.core)
+        return result
+
+def _start_job(dll, obj, submit):
+    """Prepares the mesh's session like the blocking calls, then submit(session) -> handle."""
+    mesh = obj.data
+    if not has_job_api(dll) or job_running(mesh):
+        return None
+    core = acquire_core(mesh) or create_core(dll)
+    set_group_flags(dll, core.session, obj)
+    update_session(dll, core, obj)
+    handle = submit(core.session)
+    if not handle:
+        release_core(mesh, core)
+        return None
+    job = WeightJob(dll, core, mesh.as_pointer(), handle)
+    _jobs[job.key] = job
+    return job
+
+def start_smooth_job(dll, obj, groups, factor, iterations, targets=None, num_targets=0):
+    """session_smooth_group over groups (indices) in the background. None if unavailable / busy."""
+    c_groups = (ctypes.c_int * len(groups))(*groups)
+    return _start_job(dll, obj, lambda session: dll.job_smooth_groups(
+        session, targets, num_targets, c_groups, len(groups), factor, iterations))
+
+def start_pipeline_job(dll, obj, ops, vertex_mask=None):
+    """run_weight_pipeline in the background (no MIRROR: the mirror map stays with the brush)."""
+    c_ops = (WeightOp * len(ops))(*ops)
+    return _start_job(dll, obj, lambda session: dll.job_weight_pipeline(session, c_ops, len(ops), vertex_mask))
+
+def start_heat_job(dll, obj, segments, bone_groups, max_influence=4, min_weight=0.01, use_geodesic=True, heat=1.0):
+    """heat_weights in the background (arguments copied at submit, iterations on the job)."""
+    mesh = obj.data
+    c_coords = (ctypes.c_float * (len(mesh.vertices) * 3))()
+    mesh.vertices.foreach_get("co", c_coords)
+    params = heat_params(max_influence, min_weight, use_geodesic, heat)
+    c_iterations = (ctypes.c_int * len(bone_groups))()
+    job = _start_job(dll, obj, lambda session: dll.job_heat_weights(
+        session, c_coords, len(bone_groups), segments, None, bone_groups, ctypes.byref(params), c_iterations))
+    if job is not None:
+        job.iterations = c_iterations # Written by the worker, read after finish()
+    return job
+
+def start_mesh_smooth_job(dll, obj, factor, iterations, tolerance=0.0, backend=SMOOTH_AUTO):
+    """smooth_mesh in the background (progress per pass)."""
+    if not has_mesh_smooth_api(dll):
+        return None
+    return _start_job(dll, obj, lambda session: dll.job_smooth_mesh(session, factor, iterations, tolerance, backend))
+
+def cancel_all_jobs():
+    """Stops every job and drops its result (unregister / file load)."""
+    for job in list(_jobs.values()):
+        job.cancel()
+        job.finish(None)
+
+# --- WRITE BACK ---
+
+def write_weight_changes(obj, out_verts, out_groups, out_weights, num_changes):
+    """(vertex, group, weight) triples -> Blender, batched per group (weight 0 = remove)."""
+    removes = {} # {group: [verts]}
+    adds = {}    # {(group, weight): [verts]}
+    out_verts = buffer_view(out_verts)[:num_changes].tolist()
+    out_groups = buffer_view(out_groups)[:num_changes].tolist()
+    out_weights = buffer_view(out_weights)[:num_changes].tolist()
+    for v_idx, g_idx, w in zip(out_verts, out_groups, out_weights):
+        if w <= 0.0:
+            removes.setdefault(g_idx, []).append(v_idx)
+        else:
+            adds.setdefault((g_idx, w), []).append(v_idx)
+
+    vertex_groups = obj.vertex_groups
+    for g_idx, verts in removes.items():
+        try: vertex_groups[g_idx].remove(verts)
+        except RuntimeError: pass
+    for (g_idx, w), verts in adds.items():
+        try: vertex_groups[g_idx].add(verts, w, 'REPLACE')
+        except RuntimeError: pass
+    return num_changes
+
+def write_session_diff_runs(dll, session, obj, vertex_list=None, count=0):
+    """
+    session_diff_runs -> Blender: one add / remove call per (group, weight)
+    run, vertex lists sliced from the session's buffers. Returns the number
+    of (vertex, group) writes, None if the DLL is too old.
+    """
+    if not hasattr(dll, 'session_diff_runs'):
+        return None
+    num_runs = dll.session_diff_runs(session, vertex_list, count if vertex_list else 0)
+    if num_runs == 0:
+        return 0
+    runs = session_buffer(dll, session, SESSION_BUFFER_DIFF_RUNS).tolist()
+    verts = session_buffer(dll, session, SESSION_BUFFER_DIFF_VERTS)
+    groups = session_buffer(dll, session, SESSION_BUFFER_DIFF_GROUPS)
+    weights = session_buffer(dll, session, SESSION_BUFFER_DIFF_WEIGHTS)
+
+    vertex_groups = obj.vertex_groups
+    for r in range(num_runs):
+        start, end = runs[r], runs[r + 1]
+        g_idx = groups[start]
+        w = weights[start]
+        try:
+            if w <= 0.0:
+                vertex_groups[g_idx].remove(verts[start:end].tolist())
+            else:
+                vertex_groups[g_idx].add(verts[start:end].tolist(), w, 'REPLACE')
+        except RuntimeError: pass
+    return runs[num_runs]
+
+def apply_session_diff(dll, core, obj):
+    """Writes every pending session change back to Blender. Returns the number of (vertex, group) writes."""
+    pending = dll.session_pending_count(core.session)
+    if pending == 0:
+        return 0
+    written = write_session_diff_runs(dll, core.session, obj)
+    if written is not None:
+        return written
+    capacity = pending * STRIDE * 2
+    c_verts = (ctypes.c_int * capacity)()
+    c_groups = (ctypes.c_int * capacity)()
+    c_weights = (ctypes.c_float * capacity)()
+    num_changes = dll.session_diff(core.session, None, 0, c_verts, c_groups, c_weights)
+    return write_weight_changes(obj, c_verts, c_groups, c_weights, num_changes)
+
+# --- FULL-MESH CSR (raw arrays) ---
+
+# {mesh pointer: (topology_hash, coords_hash, (starts, indices, weights))}, least recently used first
+_csr_cache = {}
+
+def get_mesh_csr(dll, mesh):
+    """
+    Full-mesh CSR (adj_starts, adj_indices, adj_weights) of mesh's current
+    data (edit mode: call obj.update_from_editmode() first). Rebuilt when
+    the topology (edges) hash changes, weights refreshed in place when only
+    the coordinates hash does. Like the cores, only the MAX_CACHED_MESHES
+    most recently used meshes stay cached. None if the DLL is too old.
+    """
+    if dll is None or not hasattr(dll, 'build_adjacency_graph'):
+        return None
+    num_verts = len(mesh.vertices)
+    num_edges = len(mesh.edges)
+
+    c_coords = (ctypes.c_float * (num_verts * 3))()
+    mesh.vertices.foreach_get("co", c_coords)
+    c_edges = (ctypes.c_int * (num_edges * 2))()
+    mesh.edges.foreach_get("vertices", c_edges)
+
+    key = mesh.as_pointer()
+    topology_hash = (num_verts, zlib.crc32(memoryview(c_edges).cast('B')))
+    coords_hash = zlib.crc32(memoryview(c_coords).cast('B'))
+    cached = _csr_cache.pop(key, None) # Re-inserted below: most recently used last
+    if cached and cached[0] == topology_hash:
+        if cached[1] == coords_hash:
+            _csr_cache[key] = cached
+            return cached[2]
+        if hasattr(dll, 'update_edge_weights'):
+            # Same topology, moved verts: refresh the weights, keep the CSR structure
+            c_adj_starts, c_adj_indices, c_adj_weights = cached[2]
+            dll.update_edge_weights(None, num_verts, c_adj_starts, c_adj_indices, c_coords, c_adj_weights)
+            _csr_cache[key] = (topology_hash, coords_hash, cached[2])
+            return cached[2]
+
+    c_adj_starts = (ctypes.c_int * (num_verts + 1))()
+    c_adj_indices = (ctypes.c_int * (num_edges * 2))()
+    c_adj_weights = (ctypes.c_float * (num_edges * 2))()
+    dll.build_adjacency_graph(num_verts, num_edges, c_edges, c_coords, c_adj_starts, c_adj_indices, c_adj_weights)
+
+    csr = (c_adj_starts, c_adj_indices, c_adj_weights)
+    _csr_cache[key] = (topology_hash, coords_hash, csr)
+    while len(_csr_cache) > MAX_CACHED_MESHES:
+        del _csr_cache[next(iter(_csr_cache))]
+    return csr